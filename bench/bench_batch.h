@@ -0,0 +1,78 @@
+#include "test.h"
+#include "arith.h"
+#include "batch_solve.h"
+#include "complex_array.h"
+
+/// Polynomials solved by one run of a batch solver bench
+#define BATCH_BENCH_COUNT 64
+/// Points a multipoint evaluator bench evaluates at
+#define BATCH_EVAL_LEN    1024
+
+Polynomial *make_bench_cubics (void);
+Polynomial *make_bench_cubics (void) {
+  Polynomial *polys = (Polynomial *) calloc(BATCH_BENCH_COUNT, sizeof(Polynomial));
+  for (size_t i = 0; i < BATCH_BENCH_COUNT; i++)
+    polys[i] = { 'x', {.e = {(double) (i % 7) - 3}, .d = {(double) (i % 5) - 2}, .c = {1}, .b = {1}} };
+
+  return polys;
+}
+
+Polynomial *bench_cubics = make_bench_cubics();
+Solutions   bench_batch_sols[BATCH_BENCH_COUNT]   = {};
+RootErrors  bench_batch_errors[BATCH_BENCH_COUNT] = {};
+
+BENCH(batch_64_cubics_closed_form) {
+  for (size_t i = 0; i < BATCH_BENCH_COUNT; i++)
+    solve_polynomial(bench_cubics[i], &bench_batch_sols[i]);
+  DO_NOT_OPTIMIZE(bench_batch_sols);
+}
+
+BENCH(batch_64_cubics_double) {
+  batch_solve(bench_cubics, BATCH_BENCH_COUNT, PRECISION_DOUBLE, bench_batch_sols, bench_batch_errors);
+  DO_NOT_OPTIMIZE(bench_batch_sols);
+}
+
+BENCH(batch_64_cubics_double_double) {
+  batch_solve(bench_cubics, BATCH_BENCH_COUNT, PRECISION_DOUBLE_DOUBLE, bench_batch_sols, bench_batch_errors);
+  DO_NOT_OPTIMIZE(bench_batch_sols);
+}
+
+BENCH(batch_64_cubics_single) {
+  batch_solve(bench_cubics, BATCH_BENCH_COUNT, PRECISION_SINGLE, bench_batch_sols, bench_batch_errors);
+  DO_NOT_OPTIMIZE(bench_batch_sols);
+}
+
+complex_array_t make_eval_points (void);
+complex_array_t make_eval_points (void) {
+  complex_array_t points = complex_array_new(BATCH_EVAL_LEN);
+  for (size_t i = 0; i < BATCH_EVAL_LEN; i++)
+    cmplx_array_set(points, i, { (double) (i % 17) / 8 - 1, (double) (i % 13) / 6 - 1 });
+
+  return points;
+}
+
+complex_array_single_t make_eval_points_single (complex_array_t points);
+complex_array_single_t make_eval_points_single (complex_array_t points) {
+  complex_array_single_t single = complex_array_single_new(BATCH_EVAL_LEN);
+  for (size_t i = 0; i < BATCH_EVAL_LEN; i++) {
+    single.real[i] = (float) points.real[i];
+    single.imag[i] = (float) points.imag[i];
+  }
+
+  return single;
+}
+
+complex_array_t        bench_eval_points        = make_eval_points();
+complex_array_t        bench_eval_values        = complex_array_new(BATCH_EVAL_LEN);
+complex_array_single_t bench_eval_points_single = make_eval_points_single(bench_eval_points);
+complex_array_single_t bench_eval_values_single = complex_array_single_new(BATCH_EVAL_LEN);
+
+BENCH(batch_eval_1024_double) {
+  batch_eval(&bench_cubics[1], bench_eval_points, bench_eval_values, BATCH_EVAL_LEN);
+  DO_NOT_OPTIMIZE(bench_eval_values);
+}
+
+BENCH(batch_eval_1024_single) {
+  batch_eval_single(&bench_cubics[1], bench_eval_points_single, bench_eval_values_single, BATCH_EVAL_LEN);
+  DO_NOT_OPTIMIZE(bench_eval_values_single);
+}
@@ -0,0 +1,61 @@
+#include "test.h"
+#include "complex.h"
+#include "complex_array.h"
+
+/// Numbers in the arrays of the complex kernel benches
+#define COMPLEX_BENCH_LEN 1024
+
+complex_t *make_bench_numbers (unsigned int seed);
+complex_t *make_bench_numbers (unsigned int seed) {
+  complex_t *numbers = (complex_t *) calloc(COMPLEX_BENCH_LEN, sizeof(complex_t));
+  for (size_t i = 0; i < COMPLEX_BENCH_LEN; i++)
+    numbers[i] = { (double) ((i * seed) % 17) - 8.5, (double) ((i * seed) % 13) - 6.5 };
+
+  return numbers;
+}
+
+complex_array_t make_bench_array (const complex_t *numbers);
+complex_array_t make_bench_array (const complex_t *numbers) {
+  complex_array_t array = complex_array_new(COMPLEX_BENCH_LEN);
+  for (size_t i = 0; i < COMPLEX_BENCH_LEN; i++)
+    cmplx_array_set(array, i, numbers[i]);
+
+  return array;
+}
+
+complex_t      *bench_numbers_a = make_bench_numbers(3);
+complex_t      *bench_numbers_b = make_bench_numbers(7);
+complex_t      *bench_numbers_c = make_bench_numbers(11);
+complex_array_t bench_array_a   = make_bench_array(bench_numbers_a);
+complex_array_t bench_array_b   = make_bench_array(bench_numbers_b);
+complex_array_t bench_array_c   = make_bench_array(bench_numbers_c);
+complex_array_t bench_array_out = complex_array_new(COMPLEX_BENCH_LEN);
+complex_t       bench_numbers_out[COMPLEX_BENCH_LEN] = {};
+
+#define COMPLEX_SCALAR_BENCH(name, ...)                                \
+  BENCH(name) {                                                        \
+    const complex_t *a = bench_numbers_a, *b = bench_numbers_b;        \
+    const complex_t *c = bench_numbers_c;                              \
+    for (size_t i = 0; i < COMPLEX_BENCH_LEN; i++)                     \
+      bench_numbers_out[i] = __VA_ARGS__;                              \
+    DO_NOT_OPTIMIZE(bench_numbers_out);                                \
+    (void) a; (void) b; (void) c;                                      \
+  }
+
+#define COMPLEX_ARRAY_BENCH(name, ...)                                 \
+  BENCH(name) {                                                        \
+    complex_array_t a = bench_array_a, b = bench_array_b;              \
+    complex_array_t c = bench_array_c, out = bench_array_out;          \
+    __VA_ARGS__;                                                       \
+    DO_NOT_OPTIMIZE(out);                                              \
+    (void) a; (void) b; (void) c;                                      \
+  }
+
+COMPLEX_SCALAR_BENCH(complex_1024_mul_scalar,  cmplx_mul(a[i], b[i]))
+COMPLEX_ARRAY_BENCH (complex_1024_mul_array,   cmplx_array_mul(out, a, b, COMPLEX_BENCH_LEN))
+COMPLEX_SCALAR_BENCH(complex_1024_div_scalar,  cmplx_div(a[i], b[i]))
+COMPLEX_ARRAY_BENCH (complex_1024_div_array,   cmplx_array_div(out, a, b, COMPLEX_BENCH_LEN))
+COMPLEX_SCALAR_BENCH(complex_1024_fma_scalar,  cmplx_fma(a[i], b[i], c[i]))
+COMPLEX_ARRAY_BENCH (complex_1024_fma_array,   cmplx_array_fma(out, a, b, c, COMPLEX_BENCH_LEN))
+COMPLEX_SCALAR_BENCH(complex_1024_sqrt_scalar, cmplx_sqrt(a[i]))
+COMPLEX_ARRAY_BENCH (complex_1024_sqrt_array,  cmplx_array_sqrt(out, a, COMPLEX_BENCH_LEN))
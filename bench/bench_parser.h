@@ -0,0 +1,49 @@
+#include "test.h"
+#include "parser.h"
+#include "evaluate.h"
+#include "alloc.h"
+#include "symbols.h"
+
+#define PARSE_STMT_BENCH(name, source)                                 \
+  BENCH(name) {                                                        \
+    Statement *stmt = (Statement *) counted_calloc(1, sizeof(Statement)); \
+    parse_stmt(source, stmt);                                          \
+    DO_NOT_OPTIMIZE(stmt);                                             \
+    destory_stmt(stmt);                                                \
+  }
+
+PARSE_STMT_BENCH(parse_stmt_solve,   "solve x^2 + 3*x + 2")
+PARSE_STMT_BENCH(parse_stmt_let,     "let A = (x + 1) * (x - 2)")
+PARSE_STMT_BENCH(parse_stmt_complex, "(2.5 + 3i) * (x - 1i)^2 / 4")
+PARSE_STMT_BENCH(parse_stmt_call,    "(A * B)(2)(3)")
+
+Expr *bench_parse_expr (const char *source);
+Expr *bench_parse_expr (const char *source) {
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
+  parse_expr(source, expr);
+  return expr;
+}
+
+Env *make_bench_env ();
+Env *make_bench_env () {
+  Env *env = (Env *) calloc(1, sizeof(Env));
+  env_set_value(env, symbol_intern("A", 1), { TP_POLYNOMIAL, { .poly = { 'x', {.e = {1}, .d = {1}} } } });
+  env_set_value(env, symbol_intern("B", 1), { TP_NUMBER,     { .num  = {2, -1} } });
+  return env;
+}
+
+Env *bench_env = make_bench_env();
+
+#define EVAL_EXPR_BENCH(name, source)                                  \
+  Expr *_BENCH_EXPR_##name = bench_parse_expr(source);                 \
+  BENCH(name) {                                                        \
+    Value val = {};                                                    \
+    eval_expr(bench_env, _BENCH_EXPR_##name, &val);                  \
+    DO_NOT_OPTIMIZE(val);                                              \
+  }
+
+EVAL_EXPR_BENCH(eval_expr_number,      "1 + 2 * 3 - 4 / 5")
+EVAL_EXPR_BENCH(eval_expr_poly_mul,    "(x + 1) * (x - 2) * (x + 3)")
+EVAL_EXPR_BENCH(eval_expr_poly_pow,    "(x - 1)^4")
+EVAL_EXPR_BENCH(eval_expr_vars,        "A * A * B + A(B)")
+EVAL_EXPR_BENCH(eval_expr_poly_chain,  "4*x^4 + 3*x^3 + 2*x^2 + x + 1")
@@ -0,0 +1,72 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "shm_client.h"
+#include "shm_server.h"
+
+/*
+ * Round trips through a shared-memory server running in a thread of the
+ * benchmark itself. Run with `just bench-shm` to get one request per sample,
+ * so that the median and p99 are per request.
+ */
+
+char      bench_shm_name[64] = {};
+pthread_t bench_shm_thread   = {};
+ShmRing  *bench_shm_ring     = NULL;
+
+void    *bench_shm_serve (void *);
+void     bench_shm_stop  (void);
+ShmRing *bench_shm_attach (void);
+
+void *bench_shm_serve (void *) {
+  serve_shm(bench_shm_name);
+  return NULL;
+}
+
+void bench_shm_stop (void) {
+  serve_shm_stop();
+  pthread_join(bench_shm_thread, NULL);
+  shm_ring_detach(bench_shm_ring);
+}
+
+/* start the server on first use, so that filtered out runs don't pay for it */
+ShmRing *bench_shm_attach (void) {
+  if (bench_shm_ring)
+    return bench_shm_ring;
+
+  snprintf(bench_shm_name, sizeof(bench_shm_name), "/equation_solver_bench_%d", (int) getpid());
+  pthread_create(&bench_shm_thread, NULL, bench_shm_serve, NULL);
+
+  while (!(bench_shm_ring = shm_ring_attach(bench_shm_name)))
+    usleep(1000);
+
+  atexit(bench_shm_stop);
+  return bench_shm_ring;
+}
+
+#define SHM_BENCH(name, _coeffs)                                       \
+  BENCH(name) {                                                        \
+    ShmRequest  request  = { _coeffs };                                \
+    ShmResponse response = {};                                         \
+    DO_NOT_OPTIMIZE(request);                                          \
+    shm_ring_solve(bench_shm_attach(), &request, &response);           \
+    DO_NOT_OPTIMIZE(response);                                         \
+  }
+
+// the same requests without the ring, to see what the transport costs
+#define SHM_SOLVE_BENCH(name, _coeffs)                                 \
+  BENCH(name) {                                                        \
+    ShmRequest  request  = { _coeffs };                                \
+    ShmResponse response = {};                                         \
+    DO_NOT_OPTIMIZE(request);                                          \
+    shm_solve_request(&request, &response);                            \
+    DO_NOT_OPTIMIZE(response);                                         \
+  }
+
+// (real, imaginary) pairs from the lowest degree to the highest
+SHM_BENCH(shm_ring_deg_2,       P({{2, 0}, {-3, 0}, {1, 0}}))
+SHM_BENCH(shm_ring_deg_3,       P({{-6, 0}, {11, 0}, {-6, 0}, {1, 0}}))
+SHM_SOLVE_BENCH(shm_direct_deg_2, P({{2, 0}, {-3, 0}, {1, 0}}))
+SHM_SOLVE_BENCH(shm_direct_deg_3, P({{-6, 0}, {11, 0}, {-6, 0}, {1, 0}}))
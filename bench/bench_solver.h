@@ -0,0 +1,43 @@
+#include "test.h"
+#include "equation.h"
+#include "polynomial.h"
+#include "arith.h"
+
+#define COMPUTE_SOLUTIONS_BENCH(name, a, b, c)   \
+  BENCH(name) {                                  \
+    Equation eq = (Equation){ a, b, c };         \
+    DO_NOT_OPTIMIZE(eq);                         \
+    compute_solutions(&eq);                      \
+    DO_NOT_OPTIMIZE(eq);                         \
+  }
+
+COMPUTE_SOLUTIONS_BENCH(compute_solutions_two_real,   1, -3,  2)
+COMPUTE_SOLUTIONS_BENCH(compute_solutions_complex,    1,  2,  5)
+COMPUTE_SOLUTIONS_BENCH(compute_solutions_single,     1, -2,  1)
+COMPUTE_SOLUTIONS_BENCH(compute_solutions_linear,     0,  2, -1)
+
+#define P(...) __VA_ARGS__
+#define SOLVER_BENCH(name, solver, ...)          \
+  BENCH(name) {                                  \
+    Polynomial p = { 'x', { .coeffs = __VA_ARGS__ } };\
+    Solutions sols = {};                         \
+    DO_NOT_OPTIMIZE(p);                          \
+    solver(p, &sols);                            \
+    DO_NOT_OPTIMIZE(sols);                       \
+  }
+#define SOLVE_POLYNOMIAL_BENCH(name, _coeffs) SOLVER_BENCH(name, solve_polynomial, _coeffs)
+
+// coefficients go from the lowest degree to the highest
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_1,         P({{-1}, {2}}))
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_2_real,    P({{2}, {-3}, {1}}))
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_2_complex, P({{5}, {2}, {1}}))
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_2_cmplx_coeffs, P({{1, 1}, {0, -2}, {1}}))
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_3_triple,  P({{-1}, {3}, {-3}, {1}}))
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_3_cube_roots, P({{-8}, {0}, {0}, {1}}))
+SOLVE_POLYNOMIAL_BENCH(solve_polynomial_deg_3_double,  P({{2}, {-3}, {0}, {1}}))
+
+// the same polynomials in double-double, next to the ones above for the cost of it
+SOLVER_BENCH(solve_polynomial_dd_deg_2_real,    solve_polynomial_dd, P({{2}, {-3}, {1}}))
+SOLVER_BENCH(solve_polynomial_dd_deg_3_triple,  solve_polynomial_dd, P({{-1}, {3}, {-3}, {1}}))
+SOLVER_BENCH(solve_polynomial_dd_deg_3_double,  solve_polynomial_dd, P({{2}, {-3}, {0}, {1}}))
+SOLVER_BENCH(solve_polynomial_dd_deg_3_general, solve_polynomial_dd, P({{-6}, {11}, {-6}, {1}}))
@@ -0,0 +1,13 @@
+#include "test.h"
+#include "test_ext.h"
+
+#include "bench_solver.h"
+#include "bench_parser.h"
+#include "bench_shm.h"
+#include "bench_complex.h"
+#include "bench_batch.h"
+
+int main(int argc, const char *argv[]) {
+  fl_use_program_hooks();
+  fl_run_benches(argc, argv);
+}
@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @brief A counting allocator, so that allocations per command can be measured
+ */
+
+#ifndef LIB_ALLOC
+#define LIB_ALLOC
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Allocation counters of a single thread
+typedef struct {
+  /// Number of allocations made
+  uint64_t allocs;
+  /// Number of blocks freed
+  uint64_t frees;
+  /// Total bytes requested, freed or not
+  uint64_t bytes;
+  /// Bytes that are currently allocated
+  uint64_t live_bytes;
+  /// Largest #AllocStats.live_bytes since the start or #alloc_reset_peak
+  uint64_t peak_bytes;
+} AllocStats;
+
+/// Size of the first block of an #Arena, later ones double
+#define ARENA_BLOCK_SIZE 4096
+
+/// One block of an #Arena, the memory follows it
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t             size;
+  size_t             used;
+} ArenaBlock;
+
+/// Memory that is handed out in pieces and freed all at once, see #arena_alloc
+typedef struct {
+  /// The block that is being filled, and the ones before it
+  ArenaBlock *blocks;
+} Arena;
+
+/**
+ * Like `calloc`, but counted in the calling thread's #AllocStats. The block
+ * must be freed with #counted_free.
+ */
+void *counted_calloc  (size_t count, size_t size);
+
+/**
+ * Like `malloc`, but counted. The block must be freed with #counted_free.
+ */
+void *counted_malloc  (size_t size);
+
+/**
+ * Like `realloc`, but counted. \p block must come from this allocator.
+ * A successful resize counts as one allocation.
+ */
+void *counted_realloc (void *block, size_t size);
+
+/**
+ * Free a block from #counted_malloc, #counted_calloc or #counted_realloc.
+ * Does nothing for NULL.
+ */
+void  counted_free    (void *block);
+
+/**
+ * Get the calling thread's counters. They only ever grow, so take the
+ * difference of two calls to measure a piece of code.
+ */
+AllocStats alloc_stats (void);
+
+/**
+ * Start measuring #AllocStats.peak_bytes from the current live bytes.
+ *
+ * @returns the peak before the reset, to hand back to #alloc_merge_peak when
+ *          the nested measurement is done
+ */
+uint64_t alloc_reset_peak (void);
+
+/**
+ * Raise #AllocStats.peak_bytes to \p peak if it is lower.
+ */
+void alloc_merge_peak (uint64_t peak);
+
+/**
+ * Take zeroed and aligned memory from an arena, adding a counted block when
+ * the current one is full.
+ *
+ * @returns the memory, valid until #arena_destroy, or NULL if out of memory
+ */
+void *arena_alloc (Arena *arena, size_t size);
+
+/**
+ * Free every block of an arena at once.
+ */
+void arena_destroy (Arena *arena);
+
+
+#endif // LIB_ALLOC
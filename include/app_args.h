@@ -10,15 +10,46 @@
 
 #include <stdio.h>
 
+#include "evaluate.h"
+
 /// A structure for holding the equation solver's command line arguments.
 typedef struct {
-  /// Float calculations precision, specified in decimal digits.
+  /// Float calculations precision, specified in decimal digits. Zero solves with
+  /// the exact formulas, see #Env.precision.
   unsigned int precision;
   /// A file handle to output to. Default is stdout.
   FILE *file;
   /// A string that specifies the equation from command line args. If
   /// there isn't an equation in the arguments, this will be NULL.
   const char *equation;
+  /// Whether to record per-phase timings and print them on exit.
+  bool stats;
+  /// Whether to also count hardware events of every phase. Implies #Args.stats.
+  bool perf;
+  /// A file to write a Chrome trace of the execution to, or NULL if not tracing.
+  const char *trace;
+  /// A Unix socket path to serve on instead of opening a shell, or NULL.
+  const char *serve;
+  /// A shared memory name to serve solve requests on, or NULL.
+  const char *serve_shm;
+  /// Number of threads that solve polynomials for the server.
+  unsigned int workers;
+  /// Most connections the server handles at once.
+  unsigned int max_connections;
+  /// Bytes of unsent output after which the server stops reading from a connection.
+  unsigned int max_buffer;
+  /// Whether to read and write files with a thread even if io_uring is available.
+  bool io_thread;
+  /// Lines that go through the stages of a batch run together.
+  unsigned int batch_size;
+  /// Whether to compile the whole input before running it, see #run_script_file.
+  bool script;
+  /// Threads that run the independent statements of a script.
+  unsigned int jobs;
+  /// Whether the shell recomputes variables when what they depend on changes.
+  ReactiveMode reactive;
+  /// A file to keep the variables of the shell in across restarts, or NULL, see #session_open.
+  const char *session;
 } Args;
 
 /**
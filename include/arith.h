@@ -17,5 +17,34 @@
  */
 int solve_polynomial (Polynomial p, Solutions *sols);
 
+/**
+ *  #solve_polynomial in double-double arithmetic, for the polynomials whose
+ *  roots are too close together for doubles to tell apart. Real quadratics and
+ *  cubics go through the same closed-form formulas, with tolerances for
+ *  double-double, and everything else through the Durand-Kerner iteration of
+ *  #batch_solve, which reports a multiple root once per multiplicity. Roots
+ *  are only merged or rounded to zero where they are the same double.
+ *
+ *  A few times slower than #solve_polynomial where there is a closed form,
+ *  and about fifteen times slower than #batch_solve in double where there isn't.
+ *
+ *  @param p    The polynomial to solve
+ *  @param sols Where to write the roots
+ *  @returns zero if \p p could not be solved, otherwise a non-zero value
+ */
+int solve_polynomial_dd (Polynomial p, Solutions *sols);
+
+/**
+ *  Find all the roots of a #Polynomial of any supported degree with the
+ *  Durand-Kerner iteration. Slower than #solve_polynomial, but doesn't depend
+ *  on closed-form formulas, so it's used as a reference to check them against.
+ *  Multiple roots are reported as many times as their multiplicity.
+ *
+ *  @param p    The polynomial to solve
+ *  @param sols Where to write the roots
+ *  @returns zero if the iteration did not converge, otherwise a non-zero value
+ */
+int solve_polynomial_iterative (Polynomial p, Solutions *sols);
+
 
 #endif // LIB_ARITH
@@ -0,0 +1,159 @@
+/**
+ * @file
+ * @brief Asynchronous line reader and writer for batch files
+ *
+ * Reads of the input are kept in flight ahead of the line that is being
+ * executed, and output is written in large chunks behind it, so that I/O
+ * overlaps with parsing and solving. Uses io_uring through raw syscalls when
+ * the kernel allows it, and a thread doing plain `pread`/`pwrite` otherwise.
+ */
+
+#ifndef LIB_ASYNC_IO
+#define LIB_ASYNC_IO
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/// Size of one read or write
+#define ASYNC_IO_CHUNK  (1 << 20)
+/// Reads of the input in flight at once
+#define ASYNC_IO_READS  4
+/// Output chunks that can be waiting to be written at once
+#define ASYNC_IO_WRITES 4
+
+/// How the I/O is actually done
+typedef enum {
+  /// An io_uring instance
+  ASYNC_IO_URING,
+  /// A thread doing the requests one by one with blocking syscalls
+  ASYNC_IO_THREAD,
+} AsyncIoBackend;
+
+/// Queue of I/O requests, shared by the readers and writers that use it. Only
+/// one thread may use a queue.
+typedef struct AsyncIo AsyncIo;
+
+/// A read or write of a single chunk
+typedef struct {
+  int     fd;
+  bool    write;
+  char   *data;
+  size_t  len;
+  /// Offset in the file, or -1 for the current position of a stream
+  int64_t offset;
+  /// Submitted and not completed yet
+  bool    pending;
+  /// Bytes transferred, or a negative errno
+  ssize_t result;
+} AsyncOp;
+
+/// Reads a file by lines, #ASYNC_IO_READS chunks ahead
+typedef struct {
+  AsyncIo *io;
+  int      fd;
+  /// Chunk i of the file goes into buffer i % #ASYNC_IO_READS
+  char    *buffers[ASYNC_IO_READS];
+  AsyncOp  reads[ASYNC_IO_READS];
+  /// Bytes in each buffer so far, short reads are continued until it's full
+  size_t   filled[ASYNC_IO_READS];
+  /// Whether a buffer is done: full, or all that was left of the file
+  bool     ready[ASYNC_IO_READS];
+  /// File offset of chunk zero
+  int64_t  start;
+  /// Chunk that lines are taken from, and the position in it
+  uint64_t chunk;
+  size_t   pos;
+  /// Next chunk to request
+  uint64_t next_chunk;
+  /// A chunk came back short, nothing after it is requested
+  bool     eof;
+  /// A read failed, which was logged
+  bool     failed;
+  /// A line that spans chunks is put together here
+  char    *line;
+  size_t   line_len;
+  size_t   line_cap;
+} AsyncReader;
+
+/// Collects output and writes it in chunks
+typedef struct {
+  AsyncIo *io;
+  int      fd;
+  char    *buffers[ASYNC_IO_WRITES];
+  AsyncOp  writes[ASYNC_IO_WRITES];
+  /// Buffer that is being filled, and how much of it is
+  size_t   current;
+  size_t   filled;
+  /// Where the next chunk goes, or -1 when #AsyncWriter.fd can't seek
+  int64_t  offset;
+  /// A write failed, which was logged, so the rest is dropped
+  bool     failed;
+} AsyncWriter;
+
+/**
+ * Set up a request queue.
+ *
+ * @param backend #ASYNC_IO_URING to fall back to a thread if io_uring is
+ *                unavailable, or #ASYNC_IO_THREAD to use a thread anyway
+ *
+ * @returns the queue, or NULL if neither could be set up (which is logged)
+ */
+AsyncIo *async_io_create (AsyncIoBackend backend);
+
+/**
+ * The backend that \p io ended up with.
+ */
+AsyncIoBackend async_io_backend (AsyncIo *io);
+
+/**
+ * Free a queue. Every reader and writer that used it must be closed already.
+ */
+void async_io_destroy (AsyncIo *io);
+
+/**
+ * Start reading \p fd from its current position. Reads go ahead by offset,
+ * so \p fd must be a regular file.
+ */
+void async_reader_open (AsyncReader *reader, AsyncIo *io, int fd);
+
+/**
+ * Get the next line, without its newline.
+ *
+ * @returns the line, valid until the next call, or NULL at the end of the
+ *          file or on an error (which is logged)
+ */
+const char *async_reader_line (AsyncReader *reader);
+
+/**
+ * Wait for the reads in flight and free the buffers. Doesn't close the file.
+ */
+void async_reader_close (AsyncReader *reader);
+
+/**
+ * Start writing to \p fd, at its current position if it can seek.
+ */
+void async_writer_open (AsyncWriter *writer, AsyncIo *io, int fd);
+
+/**
+ * Queue \p len bytes of output.
+ */
+void async_writer_write (AsyncWriter *writer, const char *data, size_t len);
+
+/**
+ * Write out the rest and wait for it, then free the buffers. Leaves the file
+ * position after the output. Doesn't close the file.
+ *
+ * @returns false if some of the output couldn't be written
+ */
+bool async_writer_close (AsyncWriter *writer);
+
+/**
+ * A stdio stream that writes through \p writer, so that it can be used as
+ * the output of #execute_command. Close it before the writer.
+ */
+FILE *async_writer_stream (AsyncWriter *writer);
+
+
+#endif // LIB_ASYNC_IO
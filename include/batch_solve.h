@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @brief Solving many polynomials and evaluating at many points at once
+ *
+ * The closed-form solvers of arith.h branch on every polynomial, so they
+ * can't work on more than one at a time. The solvers here run the
+ * Durand-Kerner iteration of #solve_polynomial_iterative on a vector of
+ * polynomials of the same degree at once, one polynomial per lane, in single
+ * precision (four lanes) or double precision (two lanes), or one polynomial
+ * at a time in double-double, for roots too close together for doubles to
+ * tell apart. Their roots are approximate, so each one comes with a bound of
+ * its error, which is computed in double precision, or in double-double for
+ * the roots found in it. A screening pass can solve in single precision and
+ * solve again only the roots whose bound is too wide for it.
+ */
+
+#ifndef LIB_BATCH_SOLVE
+#define LIB_BATCH_SOLVE
+
+
+#include <float.h>
+#include <stddef.h>
+
+#include "complex_array.h"
+#include "double_double.h"
+#include "polynomial.h"
+
+/// Decimal digits of single precision, the roots of #batch_solve are found in
+/// float for this many digits or less, and in double for more
+#define PRECISION_SINGLE FLT_DIG
+/// Decimal digits of double precision, the roots are found in double-double
+/// for more
+#define PRECISION_DOUBLE DBL_DIG
+/// Decimal digits of double-double precision
+#define PRECISION_DOUBLE_DOUBLE DD_DIG
+
+/// How far the roots of #batch_solve may be from the exact ones
+typedef struct {
+  /// An exact root is within this distance of each of #Solutions.x, +inf if
+  /// the iteration couldn't tell two roots apart
+  double radius[POLY_MAX_DEG];
+} RootErrors;
+
+/**
+ * Find the roots of \p count polynomials, many at a time.
+ *
+ * Polynomials of degree one or less are solved like #solve_polynomial does.
+ * The rest are solved to \p digits, and every root of them is reported as
+ * many times as its multiplicity, which also widens its bound.
+ *
+ * @param polys  Polynomials to solve
+ * @param count  Number of \p polys
+ * @param digits Decimal digits to find the roots to, see #PRECISION_SINGLE
+ * @param sols   Where to write the roots of each polynomial to
+ * @param errors Where to write the bounds of the roots of each polynomial to
+ */
+void batch_solve (const Polynomial *polys, size_t count, unsigned int digits,
+                  Solutions *sols, RootErrors *errors);
+
+/**
+ * Bound how far the roots of \p p in \p sols are from its exact roots, which
+ * must all be in \p sols.
+ *
+ * Each root is within #RootErrors.radius of an exact one, and the roots whose
+ * circles don't overlap any other are around different exact roots. Roots
+ * whose circles overlap are bounded by the width of all of those circles.
+ */
+void estimate_root_errors (const Polynomial *p, const Solutions *sols, RootErrors *errors);
+
+/// Largest error, relative to the root or absolute below one, that a root
+/// found in double may have before #escalate_roots finds it again
+#define ESCALATE_TOLERANCE 1e-12
+
+/**
+ * Estimate the error of every root of \p p in \p sols from its condition
+ * number and residual, and find the ones whose error may be above
+ * #ESCALATE_TOLERANCE again in double-double. That is a Durand-Kerner
+ * iteration that only moves those roots, along with any roots that were
+ * merged with them, and keeps the rest as they are.
+ *
+ * The roots found again take the place of the first one that failed, and the
+ * ones that double-double can't tell apart either are merged into one, like
+ * the closed-form solvers merge a multiple root. Almost all roots pass, and
+ * cost a Horner's method of \p p and its derivative each.
+ *
+ * @param p    The polynomial whose roots are in \p sols
+ * @param deg  The degree of \p p, see #polynomial_deg
+ * @param sols Roots of \p p found in double, all of them but for multiplicity
+ * @returns how many of the roots in \p sols were found again
+ */
+int escalate_roots (const Polynomial *p, int deg, Solutions *sols);
+
+/**
+ * Evaluate \p p at \p count points: values[i] = p(points[i]). \p values may be
+ * \p points.
+ */
+void batch_eval        (const Polynomial *p, complex_array_t points, complex_array_t values,
+                        size_t count);
+
+/**
+ * #batch_eval in single precision
+ */
+void batch_eval_single (const Polynomial *p, complex_array_single_t points,
+                        complex_array_single_t values, size_t count);
+
+
+#endif // LIB_BATCH_SOLVE
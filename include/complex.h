@@ -6,6 +6,10 @@
 #ifndef LIB_COMPLEX
 #define LIB_COMPLEX
 
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
 /// A complex number consisting of two doubles
 typedef struct {
   /// Real component
@@ -38,7 +42,9 @@ double cmplx_arg (const complex_t a);
  *
  * @returns #a + #b
  */
-complex_t cmplx_add (const complex_t a, const complex_t b);
+inline complex_t cmplx_add (const complex_t a, const complex_t b) {
+  return { a.real + b.real, a.imag + b.imag };
+}
 
 /**
  * Substract a complex number from another one
@@ -48,7 +54,9 @@ complex_t cmplx_add (const complex_t a, const complex_t b);
  *
  * @returns #a - #b
  */
-complex_t cmplx_sub (const complex_t a, const complex_t b);
+inline complex_t cmplx_sub (const complex_t a, const complex_t b) {
+  return { a.real - b.real, a.imag - b.imag };
+}
 
 /**
  * Multiply two complex number together
@@ -58,24 +66,58 @@ complex_t cmplx_sub (const complex_t a, const complex_t b);
  *
  * @returns #a * #b
  */
-complex_t cmplx_mul (const complex_t a, const complex_t b);
+inline complex_t cmplx_mul (const complex_t a, const complex_t b) {
+  return {
+    a.real * b.real - a.imag * b.imag,
+    a.real * b.imag + a.imag * b.real,
+  };
+}
 
 /**
- * Divide a complex number by another
+ * Multiply two complex numbers and add a third one
+ *
+ * @param a first factor
+ * @param b second factor
+ * @param c what to add
+ *
+ * @returns #a * #b + #c
+ */
+inline complex_t cmplx_fma (const complex_t a, const complex_t b, const complex_t c) {
+  return {
+    a.real * b.real - a.imag * b.imag + c.real,
+    a.real * b.imag + a.imag * b.real + c.imag,
+  };
+}
+
+/**
+ * Divide a complex number by another with Smith's method, which divides by
+ * the larger component of #b first, so that it doesn't overflow or lose
+ * precision where |#b|^2 would
  *
  * @param a first number
- * @param b second number
+ * @param b second number, not zero
  *
  * @returns #a / #b
  */
-complex_t cmplx_div (const complex_t a, const complex_t b);
+inline complex_t cmplx_div (const complex_t a, const complex_t b) {
+  assert(fabs(b.real) > 0 || fabs(b.imag) > 0);
+
+  if (fabs(b.real) >= fabs(b.imag)) {
+    double ratio = b.imag / b.real;
+    double denom = b.real + b.imag * ratio;
+    return { (a.real + a.imag * ratio) / denom, (a.imag - a.real * ratio) / denom };
+  }
+
+  double ratio = b.real / b.imag;
+  double denom = b.real * ratio + b.imag;
+  return { (a.real * ratio + a.imag) / denom, (a.imag * ratio - a.real) / denom };
+}
 
 /**
- * Raise a complex number to the power of another one.
- * **!!! Only works if b's imaginary part is zero!**
+ * Raise a complex number to a whole power, by squaring and multiplying
  *
  * @param a first number
- * @param b second number
+ * @param b the power, not negative
  *
  * @returns #a ** #b
  */
@@ -108,7 +150,9 @@ complex_t cmplx_cbrt (const complex_t a, int k);
  *
  * @returns -#a
  */
-complex_t cmplx_negate (const complex_t a);
+inline complex_t cmplx_negate (const complex_t a) {
+  return { -a.real, -a.imag };
+}
 
 /**
  * Replaces any `-0` in the components of a complex number with just `0`
@@ -141,6 +185,14 @@ bool cmplx_is_zero (const complex_t a);
  */
 void print_complex (const complex_t x);
 
+/**
+ * Print a complex number to \p out
+ *
+ * @param out Where to print to
+ * @param x   the number to print
+ */
+void fprint_complex (FILE *out, const complex_t x);
+
 /**
  * The constant equal to `i`
  */
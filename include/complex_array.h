@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @brief Arrays of complex numbers with the real and imaginary parts apart
+ *
+ * A #complex_t array interleaves the parts, so every operation has to shuffle
+ * them before it can work on more than one number at once. Here the real
+ * parts and the imaginary parts are two arrays of their own, and the kernels
+ * below go over them a vector of numbers at a time, with the same results as
+ * the scalar functions of complex.h, bit for bit. They are meant to be the
+ * building blocks of solvers that handle many polynomials at once.
+ *
+ * Every kernel takes the number of elements to work on, and its output may be
+ * one of its inputs.
+ */
+
+#ifndef LIB_COMPLEX_ARRAY
+#define LIB_COMPLEX_ARRAY
+
+
+#include <stddef.h>
+
+#include "complex.h"
+
+/// Complex numbers as two arrays, a number is real[i] + imag[i] * i
+typedef struct {
+  double *real;
+  double *imag;
+} complex_array_t;
+
+/// A #complex_array_t in single precision, with twice the numbers per vector
+typedef struct {
+  float *real;
+  float *imag;
+} complex_array_single_t;
+
+/**
+ * Allocate an array of \p count numbers with #counted_malloc, as one block.
+ * The numbers aren't initialized. Free it with #complex_array_free.
+ */
+complex_array_t complex_array_new (size_t count);
+
+/**
+ * Free an array made with #complex_array_new, and zero it.
+ */
+void complex_array_free (complex_array_t *array);
+
+/**
+ * #complex_array_new in single precision
+ */
+complex_array_single_t complex_array_single_new (size_t count);
+
+/**
+ * #complex_array_free in single precision
+ */
+void complex_array_single_free (complex_array_single_t *array);
+
+/**
+ * Get a number of an array
+ */
+inline complex_t cmplx_array_get (complex_array_t array, size_t i) {
+  return { array.real[i], array.imag[i] };
+}
+
+/**
+ * Set a number of an array
+ */
+inline void cmplx_array_set (complex_array_t array, size_t i, complex_t x) {
+  array.real[i] = x.real;
+  array.imag[i] = x.imag;
+}
+
+/**
+ * out = a + b, see #cmplx_add
+ */
+void cmplx_array_add  (complex_array_t out, complex_array_t a, complex_array_t b, size_t count);
+
+/**
+ * out = a - b, see #cmplx_sub
+ */
+void cmplx_array_sub  (complex_array_t out, complex_array_t a, complex_array_t b, size_t count);
+
+/**
+ * out = a * b, see #cmplx_mul
+ */
+void cmplx_array_mul  (complex_array_t out, complex_array_t a, complex_array_t b, size_t count);
+
+/**
+ * out = a / b with Smith's method, see #cmplx_div. None of \p b may be zero.
+ */
+void cmplx_array_div  (complex_array_t out, complex_array_t a, complex_array_t b, size_t count);
+
+/**
+ * out = a * b + c, see #cmplx_fma
+ */
+void cmplx_array_fma  (complex_array_t out, complex_array_t a, complex_array_t b,
+                       complex_array_t c, size_t count);
+
+/**
+ * out = sqrt(a), see #cmplx_sqrt
+ */
+void cmplx_array_sqrt (complex_array_t out, complex_array_t a, size_t count);
+
+
+#endif // LIB_COMPLEX_ARRAY
@@ -0,0 +1,223 @@
+/**
+ * @file
+ * @brief Double-double numbers, about twice the digits of a double
+ *
+ * A double-double is an unevaluated sum of two doubles, hi + lo, with lo no
+ * more than half an ulp of hi. That is 106 bits of mantissa with the exponent
+ * range of a double, and every operation is a handful of double ones, with
+ * the rounding error of each of them caught by an error-free transformation.
+ *
+ * The operators below let the same code run on doubles and on double-doubles,
+ * which is how the solvers are made generic over their precision.
+ */
+
+#ifndef LIB_DOUBLE_DOUBLE
+#define LIB_DOUBLE_DOUBLE
+
+
+#include <math.h>
+
+/// Decimal digits that a double-double keeps, like DBL_DIG for a double
+#define DD_DIG     31
+/// The machine epsilon of a double-double, 2^-104
+#define DD_EPSILON 0x1p-104
+
+/// A number with about 31 decimal digits: hi + lo, |lo| <= ulp(hi) / 2
+typedef struct {
+  /// The double nearest to the number
+  double hi;
+  /// What is left of the number
+  double lo;
+} dd_t;
+
+/**
+ * Add two doubles without a rounding error
+ *
+ * @returns #a + #b, exactly
+ */
+inline dd_t dd_two_sum (const double a, const double b) {
+  double sum = a + b;
+  double b_part = sum - a;
+  return { sum, (a - (sum - b_part)) + (b - b_part) };
+}
+
+/**
+ * #dd_two_sum for |#a| >= |#b|, which needs half the operations
+ *
+ * @returns #a + #b, exactly
+ */
+inline dd_t dd_quick_two_sum (const double a, const double b) {
+  double sum = a + b;
+  return { sum, b - (sum - a) };
+}
+
+/**
+ * Multiply two doubles without a rounding error. With a fused multiply-add
+ * in hardware that is all it takes, without one both are split in halves
+ * whose products are exact.
+ *
+ * @returns #a * #b, exactly
+ */
+inline dd_t dd_two_prod (const double a, const double b) {
+  double product = a * b;
+#ifdef FP_FAST_FMA
+  return { product, fma(a, b, -product) };
+#else
+  // 2^27 + 1 splits a double into two halves of 26 bits
+  double a_split = 134217729.0 * a, b_split = 134217729.0 * b;
+  double a_hi = a_split - (a_split - a), a_lo = a - a_hi;
+  double b_hi = b_split - (b_split - b), b_lo = b - b_hi;
+  return { product, ((a_hi * b_hi - product) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo };
+#endif
+}
+
+/**
+ * Convert a double to a double-double
+ */
+inline dd_t dd_from (const double a) {
+  return { a, 0 };
+}
+
+/**
+ * Round a double-double to the nearest double
+ */
+inline double dd_to_double (const dd_t a) {
+  return a.hi + a.lo;
+}
+
+/**
+ * Negate a double-double
+ *
+ * @returns -#a
+ */
+inline dd_t dd_negate (const dd_t a) {
+  return { -a.hi, -a.lo };
+}
+
+/**
+ * Add two double-doubles, with the error of adding the low parts kept too
+ *
+ * @returns #a + #b
+ */
+inline dd_t dd_add (const dd_t a, const dd_t b) {
+  dd_t high = dd_two_sum(a.hi, b.hi);
+  dd_t low  = dd_two_sum(a.lo, b.lo);
+
+  high = dd_quick_two_sum(high.hi, high.lo + low.hi);
+  return dd_quick_two_sum(high.hi, high.lo + low.lo);
+}
+
+/**
+ * Subtract a double-double from another one
+ *
+ * @returns #a - #b
+ */
+inline dd_t dd_sub (const dd_t a, const dd_t b) {
+  return dd_add(a, dd_negate(b));
+}
+
+/**
+ * Multiply two double-doubles. The product of the low parts is below the
+ * precision and left out.
+ *
+ * @returns #a * #b
+ */
+inline dd_t dd_mul (const dd_t a, const dd_t b) {
+  dd_t product = dd_two_prod(a.hi, b.hi);
+  return dd_quick_two_sum(product.hi, product.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+/**
+ * Divide a double-double by another one, by long division with a double
+ * quotient digit at a time
+ *
+ * @param a first number
+ * @param b second number, not zero
+ *
+ * @returns #a / #b
+ */
+dd_t dd_div (const dd_t a, const dd_t b);
+
+/**
+ * The absolute value of a double-double
+ *
+ * @returns |#a|
+ */
+inline dd_t dd_abs (const dd_t a) {
+  return signbit(a.hi) ? dd_negate(a) : a;
+}
+
+/**
+ * The square root of a double-double: the double one, and a Newton step
+ *
+ * @param a the number, not negative
+ *
+ * @returns sqrt(#a)
+ */
+dd_t dd_sqrt (const dd_t a);
+
+/**
+ * The real cube root of a double-double: the double one, and a Newton step
+ *
+ * @returns cbrt(#a)
+ */
+dd_t dd_cbrt (const dd_t a);
+
+/**
+ * #a with the sign of #b
+ */
+inline dd_t dd_copysign (const dd_t a, const dd_t b) {
+  return signbit(a.hi) == signbit(b.hi) ? a : dd_negate(a);
+}
+
+/**
+ * Compare two double-doubles
+ *
+ * @returns whether #a < #b
+ */
+inline bool dd_less (const dd_t a, const dd_t b) {
+  return a.hi < b.hi || (!(a.hi > b.hi) && a.lo < b.lo);
+}
+
+/// #dd_add
+inline dd_t operator+ (const dd_t a, const dd_t b)   { return dd_add(a, b); }
+/// #dd_add of a double
+inline dd_t operator+ (const dd_t a, const double b) { return dd_add(a, dd_from(b)); }
+/// #dd_add of a double
+inline dd_t operator+ (const double a, const dd_t b) { return dd_add(dd_from(a), b); }
+/// #dd_sub
+inline dd_t operator- (const dd_t a, const dd_t b)   { return dd_sub(a, b); }
+/// #dd_sub of a double
+inline dd_t operator- (const dd_t a, const double b) { return dd_sub(a, dd_from(b)); }
+/// #dd_sub of a double
+inline dd_t operator- (const double a, const dd_t b) { return dd_sub(dd_from(a), b); }
+/// #dd_negate
+inline dd_t operator- (const dd_t a)                 { return dd_negate(a); }
+/// #dd_mul
+inline dd_t operator* (const dd_t a, const dd_t b)   { return dd_mul(a, b); }
+/// #dd_mul by a double
+inline dd_t operator* (const dd_t a, const double b) { return dd_mul(a, dd_from(b)); }
+/// #dd_mul by a double
+inline dd_t operator* (const double a, const dd_t b) { return dd_mul(dd_from(a), b); }
+/// #dd_div
+inline dd_t operator/ (const dd_t a, const dd_t b)   { return dd_div(a, b); }
+/// #dd_div by a double
+inline dd_t operator/ (const dd_t a, const double b) { return dd_div(a, dd_from(b)); }
+/// #dd_div of a double
+inline dd_t operator/ (const double a, const dd_t b) { return dd_div(dd_from(a), b); }
+
+/// #dd_less
+inline bool operator<  (const dd_t a, const dd_t b)   { return dd_less(a, b); }
+/// #dd_less than a double
+inline bool operator<  (const dd_t a, const double b) { return dd_less(a, dd_from(b)); }
+/// #dd_less, the other way around
+inline bool operator>  (const dd_t a, const dd_t b)   { return dd_less(b, a); }
+/// #dd_less than a double, the other way around
+inline bool operator>  (const dd_t a, const double b) { return dd_less(dd_from(b), a); }
+/// Not #dd_less, the other way around
+inline bool operator<= (const dd_t a, const dd_t b)   { return !dd_less(b, a); }
+/// Not #dd_less than a double, the other way around
+inline bool operator<= (const dd_t a, const double b) { return !dd_less(dd_from(b), a); }
+
+
+#endif // LIB_DOUBLE_DOUBLE
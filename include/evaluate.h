@@ -6,11 +6,12 @@
 #ifndef LIB_EVALUATE
 #define LIB_EVALUATE
 
-#define MAX_VARS 128
+#include <stdint.h>
 
 #include "polynomial.h"
 #include "complex.h"
 #include "parser.h"
+#include "var_tree.h"
 
 /// Internal value type - either a complex number, or a #Polynomial
 typedef enum {
@@ -20,7 +21,8 @@ typedef enum {
   TP_POLYNOMIAL
 } ValueType;
 
-/// Internal representation of a value
+/// Internal representation of a value, that the evaluator works with. Variables
+/// are stored as a #PackedValue instead
 typedef struct {
   /// Type of the value
   ValueType type;
@@ -32,18 +34,144 @@ typedef struct {
   };
 } Value;
 
-/// Internal representation of a stored variable
+/// How a #PackedValue holds its value
+typedef enum {
+  /// A number with no imaginary part, in #PackedValue.real
+  PACKED_REAL,
+  /// A number, in #PackedValue.num
+  PACKED_COMPLEX,
+  /// A polynomial of degree 1 at most with real coefficients, in #PackedValue.linear
+  PACKED_LINEAR,
+  /// Any other polynomial, in #PackedValue.poly
+  PACKED_POLY,
+} PackedType;
+
+/// Coefficients of a polynomial in a #PackedValue, only as many as its degree needs
 typedef struct {
-  /// Whether this cell is used
-  bool used;
+  char      var;
+  /// Highest power with a coefficient that isn't zero, or zero if there is none
+  int       degree;
+  /// degree + 1 coefficients, x^0 first
+  complex_t coeffs[];
+} PackedPoly;
+
+/// A #Value the way variables are stored: numbers and small polynomials are
+/// kept inline, and other polynomials out of line with only the coefficients
+/// they use, so that it takes 24 bytes instead of the 96 of a #Value
+typedef struct {
+  PackedType type;
+  /// Variable of a #PACKED_LINEAR polynomial
+  char       var;
+  union {
+    double      real;
+    complex_t   num;
+    /// Real parts of x^0 and x^1
+    double      linear[2];
+    /// Owned by the value, allocated with #counted_malloc
+    PackedPoly *poly;
+  };
+} PackedValue;
+
+/// A list of variables, by their symbols
+typedef struct {
+  int      *vars;
+  uint32_t  count;
+  uint32_t  cap;
+} VarList;
+
+/// Internal representation of a stored variable
+typedef struct VarDescription {
   /// Value of the variable
-  Value val;
+  PackedValue val;
+  /// Whether this cell is used
+  bool        used;
+  /// Something it reads changed, so the value has to be computed again
+  bool        dirty;
+
+  /// What the value is computed from in reactive mode, or NULL if it's just a value
+  Expr       *expr;
+  /// Variables that #VarDescription.expr reads
+  VarList     reads;
+  /// Variables whose expressions read this one
+  VarList     dependents;
 } VarDescription;
 
+/// How an #Env keeps the variables that depend on each other up to date
+typedef enum {
+  /// Variables keep the value they were set to
+  REACTIVE_OFF,
+  /// Variables that depend on a changed one are computed again once they are read
+  REACTIVE_LAZY,
+  /// Variables that depend on a changed one are computed again right away
+  REACTIVE_EAGER,
+} ReactiveMode;
+
+/// A file the commands that change variables are recorded in, see #session_open
+typedef struct Session Session;
+
+/// A `solve` that is solved again whenever a variable it reads changes, see #env_watch
+typedef struct {
+  /// A #CMD_SOLVE statement
+  Statement *stmt;
+  VarList    reads;
+  /// A variable it reads changed since it was last solved
+  bool       stale;
+} Watcher;
+
+/// A statement kept by a `prepare` command
+typedef struct {
+  char       name[STMT_NAME_LEN];
+  /// Parsed and with constants folded, see #fold_constants
+  Statement *stmt;
+  /// Number of values that `exec` needs
+  int        param_count;
+} PreparedStatement;
+
 /// Runtime environment, that contains stuff like variable values
 typedef struct {
-  /// Var dictionary
-  VarDescription vars[MAX_VARS];
+  /// Variables by their symbol, see #symbol_intern. Shared with the
+  /// snapshots and forks of the #Env until one of them changes
+  VarTree            vars;
+  /// Snapshots taken with the `snapshot` command, the last one on top
+  VarTree           *snapshots;
+  size_t             snapshot_count;
+  size_t             snapshot_cap;
+
+  /// Statements prepared in this environment, see #env_prepare
+  PreparedStatement *prepared;
+  size_t             prepared_count;
+
+  /// Variables of a compiled script by slot, owned by the script
+  VarDescription    *slots;
+  size_t             slot_count;
+
+  /// Whether `let` keeps the expression and updates what depends on it
+  ReactiveMode       reactive;
+  /// Solves to run again when their variables change, see #env_watch
+  Watcher           *watchers;
+  size_t             watcher_count;
+  /// Number of times a variable was computed again in reactive mode
+  uint64_t           recomputed;
+  /// Bumped for every walk over the dependencies of variables
+  uint64_t           mark;
+  /// The last #Env.mark of a walk that got to each variable, by symbol. Kept
+  /// apart from the variables, so that walking them doesn't copy any
+  uint64_t          *marks;
+  size_t             mark_count;
+
+  /// Where the commands that change variables are recorded, or NULL
+  Session           *session;
+
+  /// Decimal digits that `solve` finds roots to with #batch_solve, or zero
+  /// for the closed-form solvers of #solve_polynomial
+  unsigned int       precision;
+  /// Leave the polynomials of `solve` to the caller, to solve many of them at
+  /// once with #solve_results
+  bool               defer_solve;
+
+  /// Values of the parameters of the prepared statement that is running
+  const complex_t   *params;
+  int                param_count;
 } Env;
 
 /// #EVAL_OK or any sort of evaluation error
@@ -79,25 +207,154 @@ typedef enum {
  */
 EvalStatus eval_expr (Env *env, Expr *expr, Value *output);
 
+/**
+ * Pack a value to store it, see #PackedValue.
+ *
+ * @returns the packed value, free it with #destroy_packed_value
+ */
+PackedValue pack_value (Value value);
+
+/**
+ * Get back a value that was packed with #pack_value.
+ */
+Value unpack_value (const PackedValue *packed);
+
+/**
+ * Copy a packed value, along with its polynomial.
+ */
+PackedValue copy_packed_value (const PackedValue *packed);
+
+/**
+ * Free the polynomial of a packed value, if it has one.
+ */
+void destroy_packed_value (PackedValue *packed);
+
 /**
  * Get a variable value from and #Env
  *
- * @param env      Variable storage
- * @param var_name Name of the variable to get
- * @param output   Where to write the value
+ * @param env    Variable storage
+ * @param var    Symbol of the variable to get
+ * @param output Where to write the value
  *
- * @returns #NO_VARIABLE if it failed, or #EVAL_OK if succeeded
+ * @returns #NO_VARIABLE if it failed, or #EVAL_OK if succeeded. A dirty
+ *          variable is computed again first, which can fail with any #EvalStatus
  */
-EvalStatus env_get_value (Env *env, char var_name, Value *output);
+EvalStatus env_get_value (Env *env, int var, Value *output);
 
 /**
  * Set a variable to some value in an #Env
  *
- * @param env      Variable storage
- * @param var_name Name of the variable to set
- * @param val      Value of the variable
+ * @param env Variable storage
+ * @param var Symbol of the variable to set
+ * @param val Value of the variable
+ */
+void env_set_value (Env *env, int var, Value val);
+
+/**
+ * Set a variable in reactive mode: remember what it's computed from, and mark
+ * everything that depends on it as dirty, or compute it again in
+ * #REACTIVE_EAGER mode. Only the variables downstream of \p var are visited.
+ *
+ * @param var   Symbol of the variable to set
+ * @param value Its value
+ * @param expr  What the value was computed from, copied to compute it again.
+ *              The variable is kept as a plain value if this is NULL, doesn't
+ *              read variables, has parameters, or would make it depend on itself
+ */
+void env_bind (Env *env, int var, Value value, const Expr *expr);
+
+/**
+ * Solve \p stmt again whenever a variable it reads changes. Only has an effect
+ * in reactive mode.
+ *
+ * @param stmt A #CMD_SOLVE statement, which the #Env takes ownership of
+ *
+ * @returns the number of the watcher, counting from one
+ */
+size_t env_watch (Env *env, Statement *stmt);
+
+/**
+ * Take a snapshot of the variables of an #Env, which later changes don't
+ * affect. Takes the same time however many variables there are, since it
+ * only shares them until either side changes one.
+ *
+ * @returns the variables, release them with #var_tree_release
+ */
+VarTree env_snapshot (const Env *env);
+
+/**
+ * Bring the variables of an #Env back to a snapshot from #env_snapshot. The
+ * snapshot stays valid, and watchers are solved again since their variables
+ * may have changed.
+ */
+void env_restore (Env *env, const VarTree *snapshot);
+
+/**
+ * Take a snapshot with #env_snapshot and keep it on top of #Env.snapshots.
+ *
+ * @returns the number of the snapshot, counting from one
+ */
+size_t env_push_snapshot (Env *env);
+
+/**
+ * Restore the snapshot on top of #Env.snapshots with #env_restore, and drop it.
+ *
+ * @returns the number of the snapshot, or zero if there are none
+ */
+size_t env_rollback (Env *env);
+
+/**
+ * Start \p fork as an #Env with the same variables and reactive mode as \p env,
+ * and nothing else. Either can change its variables without the other seeing it.
+ *
+ * @param fork A zeroed #Env, free it with #env_destroy
+ */
+void env_fork (const Env *env, Env *fork);
+
+/**
+ * Get a variable of a compiled script from an #Env.
+ *
+ * @param slot Slot of the variable, counting from one
+ *
+ * @returns #NO_VARIABLE if it wasn't set yet, or #EVAL_OK if it was
+ */
+EvalStatus env_get_slot (Env *env, int slot, Value *output);
+
+/**
+ * Set a variable of a compiled script in an #Env.
+ *
+ * @param slot Slot of the variable, counting from one
+ */
+void env_set_slot (Env *env, int slot, Value val);
+
+/**
+ * Keep a prepared statement in an #Env, replacing one with the same name.
+ *
+ * @param env         Where to keep it
+ * @param name        Name to find it by with #env_get_prepared
+ * @param stmt        The statement, which the #Env takes ownership of
+ * @param param_count Number of values it has to be run with
+ */
+void env_prepare (Env *env, const char *name, Statement *stmt, int param_count);
+
+/**
+ * Find a statement kept with #env_prepare.
+ *
+ * @returns the statement, or NULL if there is none with this name
+ */
+const PreparedStatement *env_get_prepared (const Env *env, const char *name);
+
+/**
+ * Free what an #Env allocated, along with its variables and snapshots.
+ */
+void env_destroy (Env *env);
+
+/**
+ * Evaluate the parts of \p expr that don't depend on variables or parameters
+ * ahead of time, so that they aren't recomputed on every run. Parts that fail
+ * to evaluate are left as they are, to report the error when it runs.
  */
-void env_set_value (Env *env, char var_name, Value val);
+void fold_constants (Expr *expr);
 
 /**
  * Print a value to stdout
@@ -106,5 +363,13 @@ void env_set_value (Env *env, char var_name, Value val);
  */
 void print_value (Value val);
 
+/**
+ * Print a value to \p out
+ *
+ * @param out Where to print to
+ * @param val #Value to print
+ */
+void fprint_value (FILE *out, Value val);
+
 #endif // LIB_EVALUATE
 
@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @brief Execution of shell commands, shared by the REPL and the server
+ */
+
+#ifndef LIB_EXECUTE
+#define LIB_EXECUTE
+
+
+#include <stdio.h>
+
+#include "batch_solve.h"
+#include "evaluate.h"
+#include "log.h"
+#include "parser.h"
+#include "polynomial.h"
+
+/**
+ * Report an error of a command: log it in the shell, or print it as an
+ * `error: ` line when the output is captured for someone else.
+ */
+#define REPORT_ERROR(out, ...) {                                    \
+    if ((out) == stdout) {                                          \
+      LOG_ERROR(__VA_ARGS__);                                       \
+    } else {                                                        \
+      fprintf(out, "error: ");                                      \
+      fprintf(out, __VA_ARGS__);                                    \
+      fputc('\n', out);                                             \
+    }                                                               \
+  }
+
+/**
+ * Parse, execute and print the result of a single command.
+ *
+ * Output goes to \p out. Errors are logged when \p out is stdout, and
+ * printed to \p out as `error: <message>` lines otherwise, so that a captured
+ * output carries them along.
+ *
+ * @param env    Variables of the session, NULL for a one-off command
+ * @param source Command text, without a trailing newline
+ * @param out    Where to print results to
+ *
+ * @returns an #EvalStatus of the command, or zero if it didn't evaluate anything
+ */
+int execute_command (Env *env, const char *source, FILE *out);
+
+/// What executing a #Statement produced, see #run_statement
+typedef struct {
+  Command     cmd;
+  /// Reported instead of the result if not NULL
+  const char *error;
+  /// The value of a #CMD_EXPR or #CMD_LET
+  Value       value;
+  /// The polynomial of a #CMD_SOLVE or #CMD_WATCH, and its roots
+  Polynomial  poly;
+  Solutions   sols;
+  /// Decimal digits #CommandResult.sols were found to, zero if they are exact
+  unsigned int precision;
+  /// How far each root may be from the exact one, if #CommandResult.precision is set
+  RootErrors  errors;
+  /// Number of the watcher that was solved, see #env_watch. watch only
+  size_t      watcher;
+  /// Number of the snapshot that was taken or rolled back to, counting from
+  /// one. snapshot and rollback only
+  size_t      snapshot;
+} CommandResult;
+
+/// Error of a command that doesn't parse
+extern const char PARSE_ERROR[];
+
+/**
+ * The parsing half of #execute_command.
+ *
+ * @param out Where to report a parse error to, or NULL to not report it
+ *
+ * @returns a statement to pass to #execute_statement and free with
+ *          #destory_stmt, or NULL if it couldn't be parsed
+ */
+Statement *parse_command (const char *source, FILE *out);
+
+/**
+ * The executing half of #execute_command: #run_statement, then #print_result,
+ * then #run_watchers.
+ */
+int execute_statement (Env *env, Statement *command, FILE *out);
+
+/**
+ * Evaluate and solve a statement without printing anything, so that the
+ * result can be printed somewhere else later.
+ *
+ * @returns the #EvalStatus of its expression
+ */
+EvalStatus run_statement (Env *env, Statement *command, CommandResult *result);
+
+/**
+ * Solve and print the watchers of a reactive #Env that some variable they
+ * read changed for, see #env_bind.
+ */
+void run_watchers (Env *env, FILE *out);
+
+/**
+ * Solve #CommandResult.poly into #CommandResult.sols, or set an error.
+ */
+void solve_result (CommandResult *result);
+
+/**
+ * #solve_result for many results at once, with #batch_solve if \p precision
+ * is set.
+ *
+ * @param precision Decimal digits to find the roots to, see #Env.precision
+ */
+void solve_results (CommandResult *const *results, size_t count, unsigned int precision);
+
+/**
+ * Print a result of #run_statement, or report its error.
+ */
+void print_result (const CommandResult *result, FILE *out);
+
+/**
+ * Evaluate the argument of a `solve` command and check that it's a polynomial.
+ *
+ * @param env     Variables to evaluate with
+ * @param command A #CMD_SOLVE statement
+ * @param poly    Where to write the polynomial to
+ * @param out     Where to report errors to
+ *
+ * @returns whether there is a polynomial to solve
+ */
+bool eval_solve_argument (Env *env, Statement *command, Polynomial *poly, FILE *out);
+
+/**
+ * Solve \p poly and print it along with the solutions, or report that it couldn't be solved.
+ *
+ * @param precision Decimal digits to find the roots to, see #Env.precision
+ *
+ * @returns whether it was solved
+ */
+bool solve_and_print (Polynomial poly, unsigned int precision, FILE *out);
+
+/**
+ * Evaluate the expression of \p command and report an error if that fails.
+ */
+EvalStatus eval_and_handle_errors (Env *env, Statement *command, Value *value, FILE *out);
+
+/**
+ * Evaluate the expression of \p command.
+ *
+ * @param error Set to a message if that fails
+ */
+EvalStatus eval_statement (Env *env, Statement *command, Value *value, const char **error);
+
+
+#endif // LIB_EXECUTE
@@ -20,6 +20,7 @@
 #endif
 
 #include <stdarg.h>
+#include <stdio.h>
 
 // ------- PROTOTYPES -------
 
@@ -37,6 +38,12 @@ void           fl_set_log_format(FL_LogFormat format);
 extern FL_LogFormat _fl_log_format;
 extern bool         _fl_do_logs;
 
+/**
+ * Send logs to \p stream, NULL for stdout (the default). Every log line is
+ * written with \p stream locked, so lines from different threads don't mix.
+ */
+void fl_set_log_stream (FILE *stream);
+
 /**
  * Turn logs back on.
  * \relates fl_logs_off
@@ -8,6 +8,12 @@
 
 
 #include "complex.h"
+#include "polynomial.h"
+
+/// Longest name of a prepared statement, including the terminator
+#define STMT_NAME_LEN 32
+/// Most parameters of a prepared statement
+#define STMT_MAX_PARAMS 16
 
 /// Available operators
 typedef enum {
@@ -35,8 +41,14 @@ typedef enum {
   NUMBER,
   /// A polynomial variable (like `x`, or `y`)
   POLY_VAR,
-  /// An identifier - currently a single uppercase letter
-  IDENTIFIER
+  /// An identifier - an uppercase letter, then letters, digits and underscores
+  IDENTIFIER,
+  /// A parameter of a prepared statement, like `?1`
+  PARAMETER,
+  /// A polynomial that doesn't depend on anything, only made by #fold_constants
+  CONSTANT_POLY,
+  /// An identifier that was resolved to a slot of a compiled script
+  SLOT,
 } NodeType;
 
 /// An AST node
@@ -50,8 +62,14 @@ typedef struct Expr {
     struct { complex_t val;  };
     /// Plynomial variable node data
     struct { char poly_name; };
-    /// Identifier node data
-    struct { char var_name;  };
+    /// Identifier node data, see #symbol_intern
+    struct { int symbol;  };
+    /// Parameter node data, counting from one
+    struct { int param; };
+    /// Constant polynomial node data, allocated with #counted_malloc
+    struct { Polynomial *poly; };
+    /// Slot node data, the slot counting from one
+    struct { int slot_symbol; int slot; };
   };
 } Expr;
 
@@ -66,12 +84,19 @@ typedef struct Expr {
 int  parse_expr (const char *source, Expr *output);
 
 /**
- * Free all allocated child nodes of an #Expr. Assumes \p ast is also allocated on the heap.
+ * Free all allocated child nodes of an #Expr. Assumes \p ast is also allocated with #counted_calloc.
  *
  * @param ast The tree to destory
  */
 void destroy_expr (Expr *ast);
 
+/**
+ * Make a copy of an #Expr tree, allocated like #parse_expr does.
+ *
+ * @returns the copy, or NULL if \p ast is NULL
+ */
+Expr *clone_expr (const Expr *ast);
+
 /**
  * Recursively print an #Expr tree to stdout
  *
@@ -90,19 +115,44 @@ typedef enum {
   /// Shows a funny video
   CMD_PORNO,
   /// Evaluates an expression and prints the reslut
-  CMD_EXPR
+  CMD_EXPR,
+  /// Prints per-phase timing statistics
+  CMD_STATS,
+  /// Keeps a statement with parameters to run later
+  CMD_PREPARE,
+  /// Runs a prepared statement with values for its parameters
+  CMD_EXEC,
+  /// Solves a polynomial, and again whenever a variable in it changes
+  CMD_WATCH,
+  /// Remembers the variables as they are
+  CMD_SNAPSHOT,
+  /// Brings the variables back to the last snapshot and forgets it
+  CMD_ROLLBACK,
 } Command;
 
 /// A struct for storing parsed commands
-typedef struct {
+typedef struct Statement {
   /// Comman type
   Command cmd;
 
-  /// The expression referenced in the command. let, expr and solve only
+  /// The expression referenced in the command. let, expr, solve and watch only
   Expr *expr;
 
-  /// The variable referenced in the command. let only
-  char var;
+  /// Symbol of the variable referenced in the command. let only
+  int var;
+  /// Slot of #Statement.var in a compiled script counting from one, or zero. let only
+  int slot;
+
+  /// Name of the prepared statement. prepare and exec only
+  char name[STMT_NAME_LEN];
+  /// The statement to keep, which can have parameters. prepare only
+  struct Statement *prepared;
+  /// Highest parameter of #Statement.prepared. prepare only
+  int param_count;
+
+  /// Values of the parameters. exec only
+  complex_t *args;
+  int arg_count;
 } Statement;
 
 /**
@@ -116,7 +166,14 @@ typedef struct {
 int  parse_stmt (const char *source, Statement *output);
 
 /**
- * Free a #Statement. Assumes that \p stmt itself was allocated on the heap
+ * Get the highest parameter in an expression.
+ *
+ * @returns the number of the parameter, or zero if there are none
+ */
+int expr_max_param (const Expr *ast);
+
+/**
+ * Free a #Statement. Assumes that \p stmt itself was allocated with #counted_calloc
  *
  * @param stmt The statement to destroy
  */
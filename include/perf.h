@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief Hardware performance counters through Linux `perf_event_open`
+ */
+
+#ifndef LIB_PERF
+#define LIB_PERF
+
+
+#include <stdint.h>
+
+/// Hardware events that are counted together in one group
+typedef enum {
+  /// CPU cycles
+  PERF_CYCLES,
+  /// Retired instructions
+  PERF_INSTRUCTIONS,
+  /// Mispredicted branches
+  PERF_BRANCH_MISSES,
+  /// Last level cache misses
+  PERF_CACHE_MISSES,
+  /// Number of counters, not a counter itself
+  PERF_COUNTER_COUNT,
+} PerfCounter;
+
+/// A snapshot, or a difference of snapshots, of all the counters
+typedef struct {
+  /// Counter values, indexed by #PerfCounter
+  uint64_t values[PERF_COUNTER_COUNT];
+} PerfSample;
+
+/// Human-readable counter names, indexed by #PerfCounter
+extern const char *PERF_COUNTER_NAMES[PERF_COUNTER_COUNT];
+
+/**
+ * Ask for counters to be opened in every thread that calls #perf_read.
+ * Only the calling thread's counters are opened right away.
+ *
+ * @returns whether the counters could be opened in the calling thread. If not,
+ *          a warning is logged once, and #perf_read keeps returning zeros.
+ */
+bool perf_enable (void);
+
+/**
+ * Stop counting and close the calling thread's counters. The counters of
+ * other threads are closed when they exit.
+ */
+void perf_disable (void);
+
+/**
+ * Whether #perf_enable was called and succeeded.
+ */
+bool perf_enabled (void);
+
+/**
+ * Whether \p counter could be opened. Some machines (VMs mostly) only
+ * support a subset of the events.
+ */
+bool perf_has_counter (PerfCounter counter);
+
+/**
+ * Read the calling thread's counters, scaled for multiplexing. Opens them
+ * first if this thread hasn't yet. Fills \p sample with zeros if counters
+ * are unavailable or disabled.
+ */
+void perf_read (PerfSample *sample);
+
+/**
+ * Compute \p end - \p start for every counter.
+ */
+PerfSample perf_diff (PerfSample start, PerfSample end);
+
+
+#endif // LIB_PERF
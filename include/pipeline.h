@@ -0,0 +1,93 @@
+/**
+ * @file
+ * @brief Batch execution as a pipeline of three threads
+ *
+ * One stage reads and parses lines, one evaluates and solves them in order,
+ * and one formats and writes the results. Lines move between the stages in
+ * batches through bounded lock-free queues, and the batches go back to the
+ * first stage once written, so the memory in use stays fixed.
+ */
+
+#ifndef LIB_PIPELINE
+#define LIB_PIPELINE
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "async_io.h"
+
+/// Batches that can wait between two stages
+#define PIPELINE_QUEUE_LEN 4
+/// Batches in the pipeline, the first stage waits for one to be written
+/// before it reads any further
+#define PIPELINE_BATCHES   8
+
+/// Stages of the pipeline
+typedef enum {
+  /// Reading lines and parsing them
+  STAGE_PARSE,
+  /// Evaluating and solving
+  STAGE_SOLVE,
+  /// Formatting and writing
+  STAGE_WRITE,
+  /// Number of stages, not a stage itself
+  STAGE_COUNT,
+} PipelineStage;
+
+/// Names of #PipelineStage s, for reports
+extern const char *STAGE_NAMES[STAGE_COUNT];
+
+/// Settings of a #run_pipeline run
+typedef struct {
+  /// A regular file to read lines from
+  int            in_fd;
+  /// Where to write the results to
+  int            out_fd;
+  /// Lines in one batch
+  unsigned int   batch_size;
+  /// How to do the I/O
+  AsyncIoBackend backend;
+  /// Decimal digits to find roots to, see #Env.precision
+  unsigned int   precision;
+} PipelineConfig;
+
+/// Where the time of a stage went
+typedef struct {
+  uint64_t records;
+  /// Working, including its own I/O
+  uint64_t busy_ns;
+  /// Waiting for a batch from the previous stage
+  uint64_t starved_ns;
+  /// Waiting for the next stage to take a batch or give one back
+  uint64_t blocked_ns;
+} StageReport;
+
+/// Utilization of every stage of a #run_pipeline run
+typedef struct {
+  uint64_t    wall_ns;
+  StageReport stages[STAGE_COUNT];
+} PipelineReport;
+
+/**
+ * Execute every line of a file, like the shell would, with the output
+ * going to #PipelineConfig.out_fd. Errors are written to the output as
+ * `error: <message>` lines. The stages log from their own threads, so if the
+ * output goes to stdout, move the logs elsewhere with #fl_set_log_stream.
+ *
+ * @param config Where to read and write
+ * @param report Where to write the utilization of the stages to
+ *
+ * @returns false if the pipeline couldn't be set up or some output couldn't be
+ *          written (which is logged)
+ */
+bool run_pipeline (PipelineConfig config, PipelineReport *report);
+
+/**
+ * Print a table with the share of the wall time every stage spent working and
+ * waiting, the stage that is busy the most is the bottleneck.
+ */
+void pipeline_print_report (FILE *out, const PipelineReport *report);
+
+
+#endif // LIB_PIPELINE
@@ -54,6 +54,23 @@ typedef struct {
  */
 void print_solutions (Solutions sols);
 
+/**
+ * Output a provided #Solutions to \p out nicely. Roots that print the same
+ * are printed, and counted, once.
+ *
+ * @param out  Where to print to
+ * @param sols #Solutions to output
+ */
+void fprint_solutions (FILE *out, Solutions sols);
+
+/**
+ * Like #fprint_solutions, but with how far each root may be from the exact one.
+ * A root printed for several gets the largest of their distances.
+ *
+ * @param errors A distance for every root of \p sols, or NULL to not print any
+ */
+void fprint_solutions_with_errors (FILE *out, Solutions sols, const double *errors);
+
 /// Errors that can arise when doing #Polynomial arithmetic
 typedef enum {
   /// Everything was computed correctly
@@ -70,6 +87,11 @@ typedef enum {
  */
 int polynomial_deg(Polynomial a);
 
+/**
+ * Whether all the coefficients of \p p are real, with no imaginary part at all
+ */
+bool polynomial_is_real (const Polynomial *p);
+
 /**
  * Compute a negated polynomial
  *
@@ -113,6 +135,68 @@ PolynomialError polynomial_sub    (Polynomial a, Polynomial b, Polynomial *outpu
  */
 PolynomialError polynomial_mul    (Polynomial a, Polynomial b, Polynomial *output);
 
+/**
+ * The functions below work on a polynomial in place, through pointers, so
+ * that a chain of operations doesn't copy the whole #Polynomial at every
+ * step. They leave the polynomial as it was when they return an error.
+ */
+
+/**
+ * Negate a polynomial in place
+ *
+ * @param acc Polynomial to negate
+ */
+void polynomial_negate_inplace (Polynomial *acc);
+
+/**
+ * Add a polynomial to another one
+ *
+ * @param acc Polynomial to add to
+ * @param b   What to add
+ *
+ * @returns Whether an error was encountered
+ */
+PolynomialError polynomial_add_inplace (Polynomial *acc, const Polynomial *b);
+
+/**
+ * Subtract a polynomial from another one
+ *
+ * @param acc Polynomial to subtract from
+ * @param b   What to subtract
+ *
+ * @returns Whether an error was encountered
+ */
+PolynomialError polynomial_sub_inplace (Polynomial *acc, const Polynomial *b);
+
+/**
+ * Multiply a polynomial by a number in place
+ *
+ * @param acc Polynomial to multiply
+ * @param k   The number
+ */
+void polynomial_scale_inplace (Polynomial *acc, complex_t k);
+
+/**
+ * Add \p k times \p b to a polynomial, in one pass over the coefficients
+ *
+ * @param acc Polynomial to add to
+ * @param b   Polynomial to multiply
+ * @param k   What to multiply \p b by
+ *
+ * @returns Whether an error was encountered
+ */
+PolynomialError polynomial_fma_inplace (Polynomial *acc, const Polynomial *b, complex_t k);
+
+/**
+ * Multiply a polynomial by another one in place
+ *
+ * @param acc Polynomial to multiply
+ * @param b   What to multiply it by, may be \p acc itself
+ *
+ * @returns Whether an error was encountered
+ */
+PolynomialError polynomial_mul_inplace (Polynomial *acc, const Polynomial *b);
+
 /**
  * Evaluate a polynomial at a point
  *
@@ -130,6 +214,14 @@ complex_t polynomial_eval (Polynomial p, complex_t v);
  */
 void print_polynomial (Polynomial p);
 
+/**
+ * Print a polynomial to \p out
+ *
+ * @param out Where to print to
+ * @param p   The polynomial to describe
+ */
+void fprint_polynomial (FILE *out, Polynomial p);
+
 #endif // LIB_POLYNOMIAL
 
 
@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @brief Scripts that are compiled as a whole before they run
+ *
+ * The shell parses and executes a line at a time, so a typo halfway through a
+ * file is only found after the first half ran. A script is parsed completely
+ * first and every parse error is reported with its line before anything runs.
+ * The statements are then copied into a single #Arena, and the variables that
+ * `let` assigns are resolved to slots, so that running it doesn't look
+ * anything up by name.
+ *
+ * The slots that statements read and write also tell which of them depend on
+ * each other, so the statements in between two barriers (the commands that
+ * touch more than a slot, like `exec` or `stats`) form a DAG, and the ones
+ * that don't depend on each other run on different threads. Their results are
+ * printed in source order, so the output is the same as running them one by one.
+ */
+
+#ifndef LIB_SCRIPT
+#define LIB_SCRIPT
+
+
+#include <stdio.h>
+
+#include "alloc.h"
+#include "parser.h"
+
+/// A statement of a #Script
+typedef struct {
+  /// Line of the source it came from, counting from one
+  int        line;
+  Statement *stmt;
+  /// Runs after everything before it is done, and before anything after it starts
+  bool       barrier;
+  /// Statements before it that it has to wait for, since the last barrier
+  size_t     dependency_count;
+  /// Statements after it that wait for it, up to the next barrier
+  size_t    *dependents;
+  size_t     dependent_count;
+} ScriptStatement;
+
+/// A compiled script, see #compile_script
+typedef struct {
+  /// Holds the statements and their expressions. The statements of `prepare`
+  /// are allocated separately, since the #Env takes them over
+  Arena            arena;
+  ScriptStatement *stmts;
+  size_t           stmt_count;
+  /// Number of variables that are assigned with `let`
+  size_t           slot_count;
+  /// Has a `snapshot` or `rollback`, which only work on the variables of the
+  /// #Env, so none of them get slots and the statements run in order
+  bool             by_name;
+} Script;
+
+/**
+ * Parse every line of \p source and compile it into a #Script. Empty lines are
+ * skipped, like in the shell.
+ *
+ * @param source The whole script
+ * @param script Where to write it to, free it with #destroy_script
+ * @param out    Where to report the lines that didn't parse to, see #REPORT_ERROR
+ *
+ * @returns the number of lines that didn't parse, the script is empty unless
+ *          it's zero
+ */
+size_t compile_script (const char *source, Script *script, FILE *out);
+
+/**
+ * Execute the statements of a script with a fresh #Env and print their
+ * results in order. A script can only be run once, since `prepare` hands its
+ * statement over to the #Env.
+ *
+ * @param threads   Threads to run independent statements on, one runs them in order
+ * @param precision Decimal digits that `solve` finds roots to, see #Env.precision
+ */
+void run_script (Script *script, unsigned int threads, unsigned int precision, FILE *out);
+
+/**
+ * Free everything a #Script holds.
+ */
+void destroy_script (Script *script);
+
+/**
+ * Read the whole \p file, compile it and run it with #run_script if it compiled.
+ *
+ * @returns false if it couldn't be read or didn't compile, which is reported
+ */
+bool run_script_file (FILE *file, unsigned int threads, unsigned int precision, FILE *out);
+
+
+#endif // LIB_SCRIPT
@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief A Unix socket server that executes statements for many clients at once
+ *
+ * The protocol is line-based: every line a client sends is executed like a
+ * shell command, and answered with the output it would print (errors as
+ * `error: <message>` lines), followed by a line with a single `.`.
+ * Every connection has its own variables.
+ */
+
+#ifndef LIB_SERVER
+#define LIB_SERVER
+
+
+/// Longest statement a client can send, including the newline
+#define SERVER_MAX_LINE 1024
+
+/// Limits of a #serve run
+typedef struct {
+  /// Path of the Unix socket, replaced if it already exists
+  const char   *path;
+  /// Number of threads that solve polynomials, so that a slow solve only
+  /// holds up the connection that asked for it
+  unsigned int  workers;
+  /// Most connections handled at once, the rest wait in the listen backlog
+  unsigned int  max_connections;
+  /// Unsent output bytes after which a connection isn't read from until the
+  /// client catches up
+  unsigned int  max_buffer;
+  /// Decimal digits that `solve` finds roots to, see #Env.precision
+  unsigned int  precision;
+} ServerConfig;
+
+/**
+ * Serve clients on a single-threaded `epoll` loop until SIGINT or SIGTERM.
+ * The signals are only taken while waiting for events, so a server that
+ * runs in a thread of its own is stopped by sending one to that thread.
+ *
+ * @returns false if the socket couldn't be set up (which is logged), true
+ *          after a clean shutdown
+ */
+bool serve (ServerConfig config);
+
+
+#endif // LIB_SERVER
@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @brief Variables of the shell kept in a memory-mapped file across restarts
+ *
+ * Every `let`, `snapshot` and `rollback` of the shell is appended to the
+ * file as a record with the value that was computed and the expression it
+ * came from, in a binary form. The file is mapped, so a record is as good as
+ * written once it's copied in, even if the process dies right after.
+ *
+ * Opening the file replays the records into an #Env the way the shell ran
+ * them, which only decodes them: nothing is parsed or evaluated again. The
+ * header and every record have a checksum, a file that doesn't match its
+ * version or header checksum isn't used at all, and records after one that
+ * doesn't match its checksum are dropped. Once most of the records set
+ * variables that were set again later, the file is written anew with only
+ * the variables as they are.
+ */
+
+#ifndef LIB_SESSION
+#define LIB_SESSION
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "evaluate.h"
+#include "polynomial.h"
+
+/// "EQSESSON", identifies the file
+#define SESSION_MAGIC      0x4e4f535345535145ull
+/// Bumped whenever the layout changes
+#define SESSION_VERSION    1
+/// Size of a new file, it's doubled whenever it fills up
+#define SESSION_START_SIZE (1 << 16)
+/// Records a file has at least before it's rewritten with only the live variables
+#define SESSION_MIN_COMPACT 1024
+
+/// Start of the file
+typedef struct {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+  /// Of the fields after it
+  uint64_t checksum;
+  /// Bytes of records after the header
+  uint64_t used;
+  /// Number of records
+  uint64_t records;
+} SessionHeader;
+
+/// What a #SessionRecord does
+typedef enum {
+  /// Sets a variable
+  SESSION_LET,
+  /// Takes a snapshot, see #env_push_snapshot
+  SESSION_SNAPSHOT,
+  /// Rolls back to the last snapshot, see #env_rollback
+  SESSION_ROLLBACK,
+} SessionRecordType;
+
+/// A #Value in a file
+typedef struct {
+  /// A #ValueType
+  uint32_t type;
+  /// The variable of a polynomial
+  char     var;
+  char     reserved[3];
+  /// (real, imaginary) pairs, x^0 first. A number is the first one
+  double   coeffs[POLY_COEFF_LEN][2];
+} SessionValue;
+
+/// Start of every record. A #SESSION_LET is followed by the name of the
+/// variable and its expression, and every record is padded to 8 bytes
+typedef struct {
+  /// Of everything after it, up to #SessionRecord.size
+  uint64_t     checksum;
+  /// The whole record, with the padding
+  uint32_t     size;
+  /// A #SessionRecordType
+  uint8_t      type;
+  /// Has to be computed again, see #VarDescription.dirty
+  uint8_t      dirty;
+  uint16_t     name_len;
+  /// Bytes of the expression, zero if it isn't kept
+  uint32_t     expr_len;
+  uint32_t     reserved;
+  SessionValue value;
+} SessionRecord;
+
+/// An open session file, see #session_open
+typedef struct Session {
+  int            fd;
+  /// Where the file is mapped, and how much of it
+  char          *map;
+  size_t         size;
+  /// Path of the file, to replace it when it's rewritten
+  char          *path;
+  /// A write failed, which was logged, so nothing is written any more
+  bool           failed;
+} Session;
+
+/**
+ * Open a session file, creating it if there is none, and replay it into
+ * \p env. From then on #run_statement records the commands that change
+ * variables of \p env in it, see #Env.session.
+ *
+ * @param session Where to keep the session, close it with #session_close
+ *                before destroying \p env
+ * @param path    The file
+ * @param env     An #Env with no variables, in the mode that the session is
+ *                continued in. Expressions are kept in the file either way,
+ *                but only a reactive #Env recomputes from them
+ *
+ * @returns false if the file couldn't be opened, or was written by another
+ *          version or corrupted, which is logged
+ */
+bool session_open (Session *session, const char *path, Env *env);
+
+/**
+ * Append a `let` to the session.
+ *
+ * @param var   Symbol of the variable
+ * @param value What it was set to
+ * @param expr  What it was computed from, or NULL. Expressions with
+ *              parameters aren't kept
+ * @param dirty Whether it's yet to be computed from \p expr
+ */
+void session_record_let (Session *session, int var, Value value, const Expr *expr, bool dirty);
+
+/**
+ * Append a #SESSION_SNAPSHOT or a #SESSION_ROLLBACK to the session.
+ */
+void session_record (Session *session, SessionRecordType type);
+
+/**
+ * Flush the session to its file and unmap it.
+ */
+void session_close (Session *session);
+
+
+#endif // LIB_SESSION
@@ -0,0 +1,232 @@
+/**
+ * @file
+ * @brief Client side of the shared-memory solver transport, see #serve_shm
+ *
+ * A standalone header that builds as C or C++ and doesn't need anything else
+ * from this project: co-located processes include it, attach to the region by
+ * name and solve polynomials with no syscalls on the fast path.
+ *
+ * The region is a ring of #SHM_RING_SLOTS slots. Clients take a ticket from
+ * #ShmRing.tail, which picks the slot, and every slot goes through
+ * `seq == ticket` (free) -> `ticket + 1` (request written) -> `ticket + 2`
+ * (response written) -> `ticket + SHM_RING_SLOTS` (free for the next lap).
+ * The server serves tickets in order, so a client must not give up on a
+ * ticket it took: the server would wait for it forever.
+ *
+ * A server that crashes can't clear #ShmRing.server_alive, so waiting clients
+ * also check now and then that the process in #ShmRing.server_pid still exists.
+ */
+
+#ifndef LIB_SHM_CLIENT
+#define LIB_SHM_CLIENT
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+#endif
+
+/// "SOLVRING", identifies the region
+#define SHM_RING_MAGIC   0x474e4952564c4f53ull
+/// Bumped whenever the layout changes
+#define SHM_RING_VERSION 2
+/// Number of requests that can be in flight at once
+#define SHM_RING_SLOTS   64
+/// Number of coefficients of a request, x^0 first
+#define SHM_COEFFS       5
+/// Most roots in a response
+#define SHM_ROOTS        4
+/// #ShmResponse.count of a polynomial that is identically zero
+#define SHM_INFINITE     -1
+/// Spins after which a waiting side starts giving up its time slice, so that
+/// the other side gets to run when they share a core
+#define SHM_SPINS_BEFORE_YIELD 100
+/// Polls between two checks that the server process still exists
+#define SHM_SPINS_PER_LIVENESS_CHECK 1000
+
+/// Keeps the fields that different sides write on different cache lines
+#define SHM_CACHE_LINE   __attribute__((aligned(64)))
+
+/// A polynomial to solve, as (real, imaginary) pairs
+typedef struct {
+  double coeffs[SHM_COEFFS][2];
+} ShmRequest;
+
+/// Roots of a #ShmRequest, as (real, imaginary) pairs
+typedef struct {
+  /// Non-zero if the roots were found
+  int32_t status;
+  /// Number of roots, or #SHM_INFINITE
+  int32_t count;
+  double  roots[SHM_ROOTS][2];
+} ShmResponse;
+
+/// One request in flight
+typedef struct {
+  /// The state of the slot, see the file description
+  uint64_t    seq;
+  ShmRequest  request;
+  ShmResponse response;
+} SHM_CACHE_LINE ShmSlot;
+
+/// The whole shared region
+typedef struct {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+
+  /// Next ticket to hand out to a client
+  SHM_CACHE_LINE uint64_t tail;
+
+  /// Set while the server sleeps on #ShmRing.wakeups
+  SHM_CACHE_LINE uint32_t server_sleeping;
+  /// Futex word that clients bump to wake the server
+  uint32_t wakeups;
+  /// Cleared by the server on shutdown
+  uint32_t server_alive;
+  /// Process of the server, for when it dies without clearing #ShmRing.server_alive
+  int32_t  server_pid;
+
+  ShmSlot slots[SHM_RING_SLOTS];
+} ShmRing;
+
+/**
+ * Map the ring that a server created under \p name.
+ *
+ * @returns the ring, or NULL if there is no server or it has a different version
+ */
+static inline ShmRing *shm_ring_attach (const char *name) {
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0)
+    return NULL;
+
+  void *region = mmap(NULL, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED)
+    return NULL;
+
+  ShmRing *ring = (ShmRing *) region;
+  if (ring->magic != SHM_RING_MAGIC || ring->version != SHM_RING_VERSION) {
+    munmap(region, sizeof(ShmRing));
+    return NULL;
+  }
+
+  return ring;
+}
+
+/**
+ * Unmap a ring from #shm_ring_attach.
+ */
+static inline void shm_ring_detach (ShmRing *ring) {
+  munmap(ring, sizeof(ShmRing));
+}
+
+/**
+ * Wait a little before polling again: tell the CPU we are spinning, or yield
+ * once we have been spinning for a while.
+ *
+ * @param spins Polls so far, zero it when the wait starts
+ */
+static inline void shm_ring_pause (unsigned int *spins) {
+  if (++*spins >= SHM_SPINS_BEFORE_YIELD) {
+    sched_yield();
+    return;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+/**
+ * Check whether the server of \p ring is still serving: it hasn't shut down,
+ * and its process exists (in our PID namespace). Kept out of line, the
+ * waiting loops only get here every #SHM_SPINS_PER_LIVENESS_CHECK polls.
+ */
+__attribute__((noinline, unused))
+static int shm_ring_server_alive (const ShmRing *ring) {
+  if (!__atomic_load_n(&ring->server_alive, __ATOMIC_ACQUIRE))
+    return 0;
+
+  // EPERM means the process exists but belongs to someone else
+  pid_t pid = __atomic_load_n(&ring->server_pid, __ATOMIC_RELAXED);
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/**
+ * Pause while waiting on the server, see #shm_ring_pause.
+ *
+ * @returns zero if the server went away, otherwise a non-zero value
+ */
+static inline int shm_ring_wait (const ShmRing *ring, unsigned int *spins) {
+  if (!__atomic_load_n(&ring->server_alive, __ATOMIC_RELAXED))
+    return 0;
+  if (*spins % SHM_SPINS_PER_LIVENESS_CHECK == SHM_SPINS_PER_LIVENESS_CHECK - 1 &&
+      !shm_ring_server_alive(ring))
+    return 0;
+
+  shm_ring_pause(spins);
+  return 1;
+}
+
+/**
+ * Solve a polynomial through the server. Safe to call from many threads and
+ * processes at once, blocks (spinning, then yielding) until the response is there.
+ *
+ * @param ring     An attached ring
+ * @param request  The coefficients
+ * @param response Where to write the roots
+ *
+ * @returns zero if the server went away, otherwise a non-zero value
+ */
+static inline int shm_ring_solve (ShmRing *ring, const ShmRequest *request, ShmResponse *response) {
+  uint64_t ticket = __atomic_fetch_add(&ring->tail, 1, __ATOMIC_RELAXED);
+  ShmSlot *slot   = &ring->slots[ticket % SHM_RING_SLOTS];
+  unsigned int spins = 0;
+
+  // wait for the previous lap of this slot to be picked up
+  while (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ticket) {
+    if (!shm_ring_wait(ring, &spins))
+      return 0;
+  }
+
+  spins = 0;
+  memcpy(&slot->request, request, sizeof(ShmRequest));
+  __atomic_store_n(&slot->seq, ticket + 1, __ATOMIC_RELEASE);
+
+  // the store above and this load must not be reordered, or a server that
+  // is just going to sleep could miss the request
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->server_sleeping, __ATOMIC_RELAXED)) {
+    __atomic_fetch_add(&ring->wakeups, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+    syscall(SYS_futex, &ring->wakeups, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+  }
+
+  while (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ticket + 2) {
+    if (!shm_ring_wait(ring, &spins))
+      return 0;
+  }
+
+  memcpy(response, &slot->response, sizeof(ShmResponse));
+  __atomic_store_n(&slot->seq, ticket + SHM_RING_SLOTS, __ATOMIC_RELEASE);
+  return 1;
+}
+
+
+#endif // LIB_SHM_CLIENT
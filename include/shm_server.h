@@ -0,0 +1,37 @@
+/**
+ * @file
+ * @brief A solver server over a shared-memory ring, see shm_client.h
+ */
+
+#ifndef LIB_SHM_SERVER
+#define LIB_SHM_SERVER
+
+
+#include "shm_client.h"
+
+/**
+ * Create a shared-memory ring under \p name (a `shm_open` name, like
+ * `/equation_solver`) and answer the requests clients put into it until
+ * SIGINT, SIGTERM or #serve_shm_stop. The calling thread spins while
+ * requests keep coming and sleeps on a futex when they stop. A region left
+ * under \p name by a server that is gone is replaced, one whose server is
+ * still running is not.
+ *
+ * @returns false if the region couldn't be created or is already being served
+ *          (which is logged), true
+ *          after a clean shutdown
+ */
+bool serve_shm (const char *name);
+
+/**
+ * Make #serve_shm return. Safe to call from any thread.
+ */
+void serve_shm_stop (void);
+
+/**
+ * Solve a single request the way #serve_shm does.
+ */
+void shm_solve_request (const ShmRequest *request, ShmResponse *response);
+
+
+#endif // LIB_SHM_SERVER
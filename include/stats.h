@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @brief Per-phase latency statistics of command execution
+ */
+
+#ifndef LIB_STATS
+#define LIB_STATS
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "timer.h"
+#include "perf.h"
+#include "alloc.h"
+
+/// Phases of executing a single command
+typedef enum {
+  /// The whole command, from source to output
+  PHASE_COMMAND,
+  /// #parse_stmt
+  PHASE_PARSE,
+  /// #eval_expr
+  PHASE_EVAL,
+  /// #solve_polynomial
+  PHASE_SOLVE,
+  /// Printing the result
+  PHASE_PRINT,
+  /// Number of phases, not a phase itself
+  PHASE_COUNT,
+} StatsPhase;
+
+/// Every power of two is split into this many linear sub-buckets, which
+/// bounds the relative error of a recorded value by 1 / 16
+#define HISTOGRAM_SUB_BUCKETS 16
+/// Enough buckets for any 64-bit value
+#define HISTOGRAM_BUCKETS     (61 * HISTOGRAM_SUB_BUCKETS)
+
+/// A log-linear (HDR-style) histogram of tick counts
+typedef struct {
+  /// Number of values in each bucket
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  /// Total number of recorded values
+  uint64_t total_count;
+  /// Sum of all recorded values
+  uint64_t total;
+  /// Smallest recorded value
+  uint64_t min;
+  /// Largest recorded value
+  uint64_t max;
+} Histogram;
+
+/// Whether timings are recorded. Checking it is the only cost of disabled stats.
+/// Threads may be running when it changes, so it is only read through
+/// #stats_are_enabled
+extern bool stats_enabled;
+
+/**
+ * Read #stats_enabled. It's a relaxed atomic load, which is a plain one on
+ * every target, and a thread that starts recording in the middle of a phase
+ * only misses that phase.
+ */
+inline bool stats_are_enabled (void) {
+  return __atomic_load_n(&stats_enabled, __ATOMIC_RELAXED);
+}
+
+/// A phase that is being measured, see #STATS_BEGIN
+typedef struct {
+  /// #fl_ticks at the start, zero if stats were off
+  uint64_t   start;
+  /// Hardware counters at the start, if they are enabled
+  PerfSample counters;
+  /// Allocation counters at the start
+  AllocStats allocs;
+  /// Peak of the enclosing span, restored at the end
+  uint64_t   outer_peak;
+} StatsSpan;
+
+/**
+ * Turn recording on or off.
+ */
+void stats_enable (bool enable);
+
+/**
+ * Also count cycles, instructions, branch and cache misses of every phase
+ * with #perf_read. Turns recording on.
+ *
+ * @returns whether the counters are available. If they aren't, only timings are recorded
+ */
+bool stats_enable_perf (void);
+
+/**
+ * Record a duration of \p phase in the calling thread's histograms.
+ *
+ * @param phase The measured phase
+ * @param ticks The duration in #fl_ticks
+ */
+void stats_record (StatsPhase phase, uint64_t ticks);
+
+/**
+ * Count roots that #solve_polynomial found, and how many of them it had to
+ * find again in double-double, see #escalate_roots.
+ *
+ * @param roots     The roots found in double
+ * @param escalated How many of them were found again
+ */
+void stats_count_roots (uint64_t roots, uint64_t escalated);
+
+/**
+ * Start measuring a phase. Use #STATS_BEGIN instead.
+ */
+void stats_span_begin (StatsSpan *span);
+
+/**
+ * Finish measuring a phase and record it. Use #STATS_END instead.
+ */
+void stats_span_end   (StatsSpan *span, StatsPhase phase);
+
+/**
+ * Add a value to a #Histogram.
+ */
+void histogram_record (Histogram *hist, uint64_t value);
+
+/**
+ * Get a value that is larger than or equal to \p percentile percent of the
+ * recorded values, up to the bucket precision.
+ *
+ * @param hist       The histogram
+ * @param percentile A number between 0 and 100
+ */
+uint64_t histogram_percentile (const Histogram *hist, double percentile);
+
+/**
+ * Merge the histograms of all threads and print a table with the count,
+ * mean and percentiles of every phase, a table of its allocations, and how
+ * many of the roots were escalated to double-double.
+ *
+ * @param out Where to print to
+ */
+void stats_print (FILE *out);
+
+/**
+ * Start timing a phase in the current scope. Reads the clock only when stats are enabled.
+ */
+#define STATS_BEGIN(name)                                           \
+  StatsSpan _stats_span_##name = {};                                \
+  if (stats_are_enabled())                                         \
+    stats_span_begin(&_stats_span_##name)
+
+/**
+ * Finish timing a phase started by #STATS_BEGIN with the same name and record it
+ * as \p phase. Phases that started while stats were off are not recorded.
+ */
+#define STATS_END(name, phase) {                                    \
+    if (stats_are_enabled() && _stats_span_##name.start)            \
+      stats_span_end(&_stats_span_##name, phase);                   \
+  }
+
+
+#endif // LIB_STATS
@@ -0,0 +1,42 @@
+/**
+ * @file
+ * @brief Interned names of variables
+ *
+ * Every identifier is turned into a small integer once, when it's parsed, so
+ * that an #Env can keep its variables in a vector indexed by it and never
+ * compare names. The table is shared by all threads and only ever grows.
+ */
+
+#ifndef LIB_SYMBOLS
+#define LIB_SYMBOLS
+
+
+#include <stddef.h>
+
+/// Longest identifier, including the terminator
+#define SYMBOL_MAX_LEN 64
+
+/**
+ * Get the symbol of a name, adding it to the table if it's new.
+ *
+ * @param name The name, doesn't have to be terminated
+ * @param len  Its length, less than #SYMBOL_MAX_LEN
+ *
+ * @returns the symbol, symbols are numbered from zero in the order they are added
+ */
+int symbol_intern (const char *name, size_t len);
+
+/**
+ * Get the name of a symbol from #symbol_intern.
+ *
+ * @returns the name, which lives as long as the program
+ */
+const char *symbol_name (int symbol);
+
+/**
+ * Number of symbols in the table, every symbol is less than this.
+ */
+int symbol_count (void);
+
+
+#endif // LIB_SYMBOLS
@@ -1,6 +1,7 @@
 /**
  * @file
- * @brief A testing library that works quite similarly to gtest
+ * @brief A testing library that works quite similarly to gtest, with
+ *        google-benchmark-like microbenchmarks on top
  */
 
 #ifndef LIB_TEST
@@ -10,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 /// Max length of an error message
 #define FL_MAX_MSG 1024
@@ -50,6 +52,206 @@ void  fl_test_runner (int *failed_num);
  */
 [[noreturn]] void fl_run_tests();
 
+// ------- RANDOMIZED TESTING -------
+
+/// A small, fast pseudo-random generator (splitmix64). Fully determined by it's seed
+typedef struct {
+  uint64_t state;
+} FL_Rng;
+
+/// Next raw 64-bit value
+uint64_t fl_rng_next    (FL_Rng *rng);
+/// Uniform double in [\p lo; \p hi)
+double   fl_rng_uniform (FL_Rng *rng, double lo, double hi);
+/// Uniform integer in [0; \p n)
+size_t   fl_rng_below   (FL_Rng *rng, size_t n);
+
+/**
+ * A property that has to hold for randomly generated test cases. Cases are
+ * opaque blobs of #FL_Property.case_size bytes, so they can live in preallocated
+ * buffers and the engine never allocates per case.
+ */
+typedef struct {
+  /// Size of a single test case in bytes
+  size_t case_size;
+  /// Passed to every callback as is, e.g. generator settings
+  const void *context;
+
+  /// Fill \p test_case with a random case. Must only use \p rng for randomness
+  void (*generate) (const void *context, FL_Rng *rng, void *test_case);
+
+  /// Check the property. Return zero and write a message to \p msg
+  /// (#FL_MAX_MSG long) if it doesn't hold, otherwise return non-zero
+  int  (*check)    (const void *context, const void *test_case, char *msg);
+
+  /// Optional. Write the \p attempt 'th simpler version of \p test_case to
+  /// \p candidate. Return zero when there are no candidates left
+  int  (*shrink)   (const void *context, const void *test_case, size_t attempt, void *candidate);
+} FL_Property;
+
+/**
+ * Check \p prop on \p iterations random cases. Every case gets it's own seed,
+ * the first one is taken from the `FL_SEED` environment variable if it is set,
+ * so a failing case can be reproduced exactly. `FL_ITERATIONS` overrides
+ * \p iterations. A failing case is shrunk greedily with #FL_Property.shrink
+ * before it's reported.
+ *
+ * @param name       Name mixed into the default seed, usually the test name
+ * @param prop       The property to check
+ * @param iterations How many cases to generate
+ * @param msg        Where to write the failure message, #FL_MAX_MSG long
+ *
+ * @returns zero if the property failed on some case, otherwise a non-zero value
+ */
+int fl_check_property (const char *name, const FL_Property *prop, size_t iterations, char *msg);
+
+// ------- HOOKS -------
+
+/// Most counters a #FL_BenchCounters can have
+#define FL_MAX_BENCH_COUNTERS 8
+
+/**
+ * Counters that benchmarks read around their samples and report per
+ * iteration, like hardware counters. A program plugs its own in with
+ * #fl_set_bench_counters, and `--perf` turns them on.
+ */
+typedef struct {
+  /// Number of counters, at most #FL_MAX_BENCH_COUNTERS
+  size_t              count;
+  /// Names of the counters, for the table and the JSON
+  const char *const  *names;
+  /// Start counting in this thread, returns false if that isn't possible
+  bool (*enable)  (void);
+  /// Stop counting
+  void (*disable) (void);
+  /// Whether counter \p index is actually counted
+  bool (*has)     (size_t index);
+  /// Read every counter into \p values
+  void (*read)    (uint64_t *values);
+} FL_BenchCounters;
+
+/**
+ * Read \p counters in the benchmarks, NULL to read none (the default).
+ */
+void fl_set_bench_counters (const FL_BenchCounters *counters);
+
+/// Returns how many allocations the calling thread has made, see #ASSERT_MAX_ALLOCS
+typedef uint64_t (*FL_AllocCounter) (void);
+
+extern FL_AllocCounter _fl_alloc_counter;
+
+/**
+ * Count allocations with \p counter in #ASSERT_MAX_ALLOCS, NULL for none (the default).
+ */
+void fl_set_alloc_counter (FL_AllocCounter counter);
+
+// ------- BENCHMARKS -------
+
+/// Statistics of a single benchmark run. All times are nanoseconds per iteration
+typedef struct {
+  /// Iterations in each sample
+  size_t  iterations;
+  /// Number of collected samples
+  size_t  sample_count;
+  /// Per-iteration time of every sample, sorted ascending
+  double *samples;
+
+  double  median;
+  double  p99;
+  double  mean;
+  double  stddev;
+  double  min;
+  double  max;
+
+  /// Whether counters were read, see #fl_set_bench_counters
+  bool    has_counters;
+  /// Counters per iteration, in the order of #FL_BenchCounters.names
+  double  counters[FL_MAX_BENCH_COUNTERS];
+} _FL_BenchResult;
+
+typedef struct {
+  const char *name;
+  void (*func)();
+
+  _FL_BenchResult res;
+} _FL_Bench;
+
+extern _FL_Bench *_fl_bench_data;
+extern size_t     _fl_bench_count;
+extern size_t     _fl_bench_capacity;
+
+int  _fl_add_bench (const char bench_name[], void (*bench)());
+
+/**
+ * Time a single registered benchmark: warm it up, pick an iteration count
+ * so that a sample takes about \p sample_ns, then collect \p sample_count samples.
+ *
+ * @param bench        The benchmark to run
+ * @param sample_count How many samples to collect
+ * @param sample_ns    Target duration of one sample
+ */
+void  fl_bench_runner (_FL_Bench *bench, size_t sample_count, double sample_ns);
+
+/**
+ * Save the samples of every benchmark that has been run to \p path, so that
+ * a later run can be compared against them with #fl_compare_bench_baseline.
+ *
+ * @returns zero if the file could not be written, otherwise a non-zero value
+ */
+int     fl_save_bench_baseline    (const char *path);
+
+/**
+ * Compare every benchmark that has been run against the samples saved in \p path.
+ * A benchmark regressed if a one-sided Mann-Whitney U test says its samples are
+ * slower than the baseline ones with p < #FL_BENCH_ALPHA, and its median got
+ * slower by more than \p threshold percent.
+ *
+ * @param path      The baseline file written by #fl_save_bench_baseline
+ * @param threshold Smallest median slowdown in percent that counts as a regression
+ *
+ * @returns The number of regressed benchmarks, or -1 if the baseline could not be read
+ */
+int     fl_compare_bench_baseline (const char *path, double threshold);
+
+/// Significance level of the regression test in #fl_compare_bench_baseline
+#define FL_BENCH_ALPHA 0.01
+
+/**
+ * Run all the registered benchmarks. Call it from a separate main() that includes
+ * all #BENCH declarations. Understands `--filter`, `--samples`, `--sample-time`,
+ * `--json`, `--save-baseline`, `--baseline`, `--threshold` and `--perf`, see `--help`.
+ * With `--baseline` the exit code is 1 if any benchmark regressed.
+ */
+[[noreturn]] void fl_run_benches (int argc, const char *argv[]);
+
+/**
+ * Pretend to read \p x, so that the compiler can't throw away the computation
+ * that produced it. Works for values of any type, including structs.
+ */
+#define DO_NOT_OPTIMIZE(x) asm volatile("" : : "r"(&(x)) : "memory")
+
+/**
+ * Pretend to read and write all of memory, so that stores before it can't be
+ * elided and loads after it can't be hoisted.
+ */
+#define CLOBBER_MEMORY() asm volatile("" : : : "memory")
+
+/**
+ * Define a benchmark like this:
+ * ```c
+ * BENCH(example_bench) {
+ *   Equation eq = { 1, -3, 2 };
+ *   compute_solutions(&eq);
+ *   DO_NOT_OPTIMIZE(eq);
+ * }
+ * ```
+ * The body is a single iteration, the runner calls it as many times as it needs.
+ */
+#define BENCH(name)                                                      \
+  void _FL_BENCH_##name();                                               \
+  int  _FL_BENCH_RES_##name = _fl_add_bench(#name, &_FL_BENCH_##name);   \
+  void _FL_BENCH_##name()
+
 // ------- TEST MACROS -------
 
 /**
@@ -69,14 +271,23 @@ void  fl_test_runner (int *failed_num);
   int  _FL_TEST_RES_##name = _fl_add_test(#name, &_FL_TEST_##name);   \
   void _FL_TEST_##name()
 
-#define SUCCESS() {                                                   \
-    _fl_test_data[_fl_current_test_index].res.status = FL_SUCCESS;    \
+// a failure that was recorded without leaving the test sticks
+#define SUCCESS() {                                                                 \
+    _FL_TestResult *_fl_test_result = &_fl_test_data[_fl_current_test_index].res;   \
+    if (_fl_test_result->status != FL_FAIL)                                         \
+      _fl_test_result->status = FL_SUCCESS;                                         \
   }
 
-#define FAIL_WITH_MSG(...) {                                                        \
+/// Mark the test as failed, but let it go on, e.g. to free what it allocated
+#define RECORD_FAIL_WITH_MSG(...) {                                                 \
       _FL_TestResult *_fl_test_result = &_fl_test_data[_fl_current_test_index].res; \
+      if (_fl_test_result->status != FL_FAIL)                                       \
+        snprintf(_fl_test_result->message, FL_MAX_MSG, __VA_ARGS__);                \
       _fl_test_result->status = FL_FAIL;                                            \
-      snprintf(_fl_test_result->message, FL_MAX_MSG, __VA_ARGS__);                  \
+    }
+
+#define FAIL_WITH_MSG(...) {                                                        \
+      RECORD_FAIL_WITH_MSG(__VA_ARGS__);                                            \
       return;                                                                       \
     }
 
@@ -92,4 +303,40 @@ void  fl_test_runner (int *failed_num);
 #define ASSERT_EQ(x, y) ASSERT_BOOL_MSG(x == y, "Assertion failed: `%s` != `%s`", #x, #y)
 #define ASSERT_NE(x, y) ASSERT_BOOL_MSG(x != y, "Assertion failed: `%s` == `%s`", #x, #y)
 
+/**
+ * Check an #FL_Property on \p iterations random cases, see #fl_check_property.
+ */
+#define ASSERT_PROPERTY(prop, iterations) {                                   \
+    char _fl_property_msg[FL_MAX_MSG] = {};                                   \
+    ASSERT_BOOL_MSG(                                                          \
+      fl_check_property(_fl_test_data[_fl_current_test_index].name,           \
+                        &(prop), iterations, _fl_property_msg),               \
+      "%s", _fl_property_msg);                                                \
+  }
+
+/**
+ * Run the code in the rest of the arguments and check that it makes at most
+ * \p max allocations in this thread, as counted by #fl_set_alloc_counter.
+ * Keeps allocation-free paths allocation-free. A failure doesn't leave the
+ * test, so that it still frees whatever the code allocated.
+ */
+#define ASSERT_MAX_ALLOCS(max, ...) {                                         \
+    FL_AllocCounter _fl_counter = _fl_alloc_counter;                          \
+    uint64_t _fl_allocs_before = _fl_counter ? _fl_counter() : 0;             \
+    __VA_ARGS__;                                                              \
+    unsigned long long _fl_allocs =                                           \
+      (unsigned long long) (_fl_counter ? _fl_counter() - _fl_allocs_before : 0); \
+    if (!_fl_counter) {                                                       \
+      RECORD_FAIL_WITH_MSG(                                                   \
+        "Assertion failed: no allocation counter to check `%s` with, see fl_set_alloc_counter", \
+        #__VA_ARGS__);                                                        \
+    } else if (_fl_allocs <= (max)) {                                         \
+      SUCCESS();                                                              \
+    } else {                                                                  \
+      RECORD_FAIL_WITH_MSG(                                                   \
+        "Assertion failed: `%s` made %llu allocations, at most %llu expected", \
+        #__VA_ARGS__, _fl_allocs, (unsigned long long) (max));                \
+    }                                                                         \
+  }
+
 #endif // LIB_TEST
@@ -0,0 +1,21 @@
+/**
+ * @file
+ * @brief The allocation counters and hardware counters of this program,
+ *        plugged into the testing library of test.h
+ */
+
+#ifndef LIB_TEST_EXT
+#define LIB_TEST_EXT
+
+
+#include "test.h"
+
+/**
+ * Count the allocations of #counted_malloc and friends in #ASSERT_MAX_ALLOCS,
+ * and read the counters of perf.h in benchmarks run with `--perf`. Call it
+ * before running the tests or the benchmarks.
+ */
+void fl_use_program_hooks (void);
+
+
+#endif // LIB_TEST_EXT
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief Low-overhead timestamps for benchmarks and instrumentation
+ */
+
+#ifndef LIB_TIMER
+#define LIB_TIMER
+
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  /// Defined if #fl_ticks reads the CPU timestamp counter
+  #define FL_HAS_TSC
+#endif
+
+/**
+ * Monotonic wall-clock time in nanoseconds (`CLOCK_MONOTONIC`).
+ */
+uint64_t fl_now_ns (void);
+
+/**
+ * Read a raw timestamp. On x86 this is `rdtsc`, which is a couple of
+ * nanoseconds, everywhere else it falls back to #fl_now_ns. Convert the
+ * difference of two readings with #fl_ticks_to_ns.
+ */
+static inline uint64_t fl_ticks (void) {
+#ifdef FL_HAS_TSC
+  return __rdtsc();
+#else
+  return fl_now_ns();
+#endif
+}
+
+/**
+ * Number of #fl_ticks per nanosecond. Calibrated against `CLOCK_MONOTONIC`
+ * on the first call (which takes about 10ms), cached afterwards.
+ */
+double fl_ticks_per_ns (void);
+
+/**
+ * Convert a #fl_ticks difference to nanoseconds.
+ */
+double fl_ticks_to_ns (uint64_t ticks);
+
+
+#endif // LIB_TIMER
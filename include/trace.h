@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @brief Chrome trace-event (Perfetto) recording of command execution
+ */
+
+#ifndef LIB_TRACE
+#define LIB_TRACE
+
+
+#include <stdint.h>
+
+#include "timer.h"
+
+/// Only this many outer levels of #eval_expr recursion get their own span,
+/// deeper ones are too short and too many to be useful
+#define TRACE_EVAL_MAX_DEPTH 3
+
+/// Longest argument value that is kept with an event, longer ones are truncated
+#define TRACE_ARG_LEN 64
+
+/// A finished span in a thread's buffer
+typedef struct {
+  /// Event name, must be a string literal
+  const char *name;
+  /// #fl_ticks at the start
+  uint64_t    start;
+  /// #fl_ticks at the end
+  uint64_t    end;
+  /// Name of the single argument, NULL if there is none. Must be a string literal
+  const char *arg_name;
+  /// Value of the argument
+  char        arg[TRACE_ARG_LEN];
+} TraceEvent;
+
+/// Whether spans are recorded. Checking it is the only cost of disabled tracing
+extern bool trace_enabled;
+
+/**
+ * Start recording spans. They are kept in per-thread buffers and written to
+ * \p path as trace-event JSON on exit, which can be opened in
+ * `chrome://tracing` or https://ui.perfetto.dev.
+ *
+ * @returns whether \p path could be opened for writing
+ */
+bool trace_enable (const char *path);
+
+/**
+ * Add a finished span to the calling thread's buffer. Use #TRACE_END instead.
+ *
+ * @param name     Event name, a string literal
+ * @param start    #fl_ticks at the start
+ * @param end      #fl_ticks at the end
+ * @param arg_name Argument name, a string literal, or NULL
+ * @param arg      Argument value, copied. Ignored if \p arg_name is NULL
+ */
+void trace_record (const char *name, uint64_t start, uint64_t end,
+                   const char *arg_name, const char *arg);
+
+/**
+ * Write all the recorded spans and free the buffers. Called on exit by
+ * #trace_enable, no need to call it by hand.
+ */
+void trace_flush (void);
+
+/**
+ * Start a span in the current scope. Reads the clock only when tracing is enabled.
+ */
+#define TRACE_BEGIN(name)                                           \
+  uint64_t _trace_start_##name = trace_enabled ? fl_ticks() : 0
+
+/**
+ * Finish a span started by #TRACE_BEGIN with the same name and record it as \p event.
+ */
+#define TRACE_END(name, event)                                      \
+  TRACE_END_ARG(name, event, NULL, NULL)
+
+/**
+ * Like #TRACE_END, but attach an argument that is shown with the span.
+ */
+#define TRACE_END_ARG(name, event, arg_name, arg) {                 \
+    if (trace_enabled && _trace_start_##name)                       \
+      trace_record(event, _trace_start_##name, fl_ticks(),          \
+                   arg_name, arg);                                  \
+  }
+
+
+#endif // LIB_TRACE
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Persistent tree of variables, that is shared between snapshots of an #Env
+ *
+ * The variables are kept in the leaves of a radix tree keyed by their symbol,
+ * and every node counts the trees that point to it. Taking a snapshot of a
+ * tree only counts one more reference to its root, and a change copies the
+ * nodes on the way to the variable that are shared with some other tree
+ * first, so snapshots and forks of an #Env never see each other's changes
+ * and cost nothing until something changes.
+ */
+
+#ifndef LIB_VAR_TREE
+#define LIB_VAR_TREE
+
+
+#include <stddef.h>
+
+/// Bits of a symbol that every level of the tree takes
+#define VAR_TREE_BITS  5
+/// Children of a node, and variables in a leaf
+#define VAR_TREE_WIDTH (1 << VAR_TREE_BITS)
+
+typedef struct VarDescription VarDescription;
+
+/// A node of a #VarTree, either a leaf of variables or a node of children
+typedef struct VarNode VarNode;
+
+/// A tree of #VarDescription s by symbol. A zeroed one is empty
+typedef struct {
+  VarNode     *root;
+  /// Levels above the leaves, the tree holds symbols below
+  /// #VAR_TREE_WIDTH << (#VAR_TREE_BITS * depth)
+  unsigned int depth;
+} VarTree;
+
+/**
+ * Find a variable in a tree.
+ *
+ * @returns the variable, which is valid until the tree changes, or NULL if
+ *          no variable near it was ever changed
+ */
+const VarDescription *var_tree_get (const VarTree *tree, int var);
+
+/**
+ * Get a variable of a tree to change it, copying the nodes on the way to it
+ * that are shared with another tree.
+ *
+ * @returns the variable, zeroed if it's new. It stays valid until the tree
+ *          is released, or restored to something else
+ */
+VarDescription *var_tree_edit (VarTree *tree, int var);
+
+/**
+ * Another reference to the same variables, which has to be released with
+ * #var_tree_release. Doesn't copy anything.
+ */
+VarTree var_tree_share (const VarTree *tree);
+
+/**
+ * Drop a reference to the variables of a tree, freeing the nodes nothing
+ * else points to, and empty it.
+ */
+void var_tree_release (VarTree *tree);
+
+
+#endif // LIB_VAR_TREE
@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @brief A counting allocator, so that allocations per command can be measured
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+
+/// Size of every block, stored right before it. Padded to keep the block aligned
+typedef union {
+  size_t      size;
+  max_align_t _align;
+} AllocHeader;
+
+/// Headers that an #ArenaBlock takes up
+#define ARENA_HEADER_SLOTS ((sizeof(ArenaBlock) + sizeof(AllocHeader) - 1) / sizeof(AllocHeader))
+
+thread_local AllocStats _alloc_stats = {};
+
+AllocHeader *block_header (void *block);
+void         count_alloc  (size_t size);
+void         count_free   (size_t size);
+
+AllocHeader *block_header (void *block) {
+  return (AllocHeader *) block - 1;
+}
+
+void count_alloc (size_t size) {
+  _alloc_stats.allocs++;
+  _alloc_stats.bytes      += size;
+  _alloc_stats.live_bytes += size;
+
+  if (_alloc_stats.live_bytes > _alloc_stats.peak_bytes)
+    _alloc_stats.peak_bytes = _alloc_stats.live_bytes;
+}
+
+void count_free (size_t size) {
+  _alloc_stats.frees++;
+
+  // blocks can be freed by another thread than the one that allocated them
+  _alloc_stats.live_bytes = _alloc_stats.live_bytes > size ? _alloc_stats.live_bytes - size : 0;
+}
+
+void *counted_malloc (size_t size) {
+  AllocHeader *header = (AllocHeader *) malloc(sizeof(AllocHeader) + size);
+  if (!header)
+    return NULL;
+
+  header->size = size;
+  count_alloc(size);
+  return header + 1;
+}
+
+void *counted_calloc (size_t count, size_t size) {
+  if (size && count > (SIZE_MAX - sizeof(AllocHeader)) / size)
+    return NULL;
+
+  void *block = counted_malloc(count * size);
+  if (block)
+    memset(block, 0, count * size);
+
+  return block;
+}
+
+void *counted_realloc (void *block, size_t size) {
+  if (!block)
+    return counted_malloc(size);
+
+  size_t old_size = block_header(block)->size;
+
+  AllocHeader *header = (AllocHeader *) realloc(block_header(block), sizeof(AllocHeader) + size);
+  if (!header)
+    return NULL;
+
+  header->size = size;
+  count_free(old_size);
+  count_alloc(size);
+  return header + 1;
+}
+
+void counted_free (void *block) {
+  if (!block)
+    return;
+
+  AllocHeader *header = block_header(block);
+  count_free(header->size);
+  free(header);
+}
+
+AllocStats alloc_stats (void) {
+  return _alloc_stats;
+}
+
+uint64_t alloc_reset_peak (void) {
+  uint64_t peak = _alloc_stats.peak_bytes;
+  _alloc_stats.peak_bytes = _alloc_stats.live_bytes;
+  return peak;
+}
+
+void alloc_merge_peak (uint64_t peak) {
+  if (peak > _alloc_stats.peak_bytes)
+    _alloc_stats.peak_bytes = peak;
+}
+
+void *arena_alloc (Arena *arena, size_t size) {
+  const size_t align = alignof(max_align_t);
+  size = (size + align - 1) / align * align;
+
+  ArenaBlock *block = arena->blocks;
+  if (!block || block->size - block->used < size) {
+    size_t block_size = block ? block->size * 2 : ARENA_BLOCK_SIZE;
+    while (block_size < size)
+      block_size *= 2;
+
+    // the header is padded like AllocHeader, so that the memory stays aligned
+    ArenaBlock *next = (ArenaBlock *) counted_malloc(sizeof(AllocHeader[ARENA_HEADER_SLOTS]) + block_size);
+    if (!next)
+      return NULL;
+
+    *next = { .next = block, .size = block_size, .used = 0 };
+    arena->blocks = block = next;
+  }
+
+  char *memory = (char *) block + sizeof(AllocHeader[ARENA_HEADER_SLOTS]) + block->used;
+  block->used += size;
+
+  memset(memory, 0, size);
+  return memory;
+}
+
+void arena_destroy (Arena *arena) {
+  while (arena->blocks) {
+    ArenaBlock *next = arena->blocks->next;
+    counted_free(arena->blocks);
+    arena->blocks = next;
+  }
+}
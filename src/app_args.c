@@ -6,11 +6,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "arg_parse.h"
 #include "app_args.h"
+#include "batch_solve.h"
 
 int file_validator (const char *file,     char *error);
+int count_validator (const char *value,    char *error);
+int reactive_validator (const char *value, char *error);
+int precision_validator (const char *value, char *error);
 
 const ArgSpecItem arg_data[] = {
   {
@@ -21,6 +26,105 @@ const ArgSpecItem arg_data[] = {
     .value = REQUIRED_VALUE,
     .validator = file_validator,
   },
+  {
+    .long_flag = "stats",
+    .arg_type = FLAG,
+    .help = "Record per-phase timings and print them on exit",
+    .value = NO_VALUE,
+  },
+  {
+    .long_flag = "perf",
+    .arg_type = FLAG,
+    .help = "Like --stats, but also count cycles, instructions and cache misses",
+    .value = NO_VALUE,
+  },
+  {
+    .long_flag = "trace",
+    .arg_type = FLAG,
+    .help = "Write a Chrome/Perfetto trace of the execution to this file on exit",
+    .value = REQUIRED_VALUE,
+  },
+  {
+    .long_flag = "serve",
+    .arg_type = FLAG,
+    .help = "Serve statements over a Unix socket at this path instead of opening a shell",
+    .value = REQUIRED_VALUE,
+  },
+  {
+    .long_flag = "serve-shm",
+    .arg_type = FLAG,
+    .help = "Solve polynomials over a shared-memory ring with this name, like /equation_solver",
+    .value = REQUIRED_VALUE,
+  },
+  {
+    .long_flag = "workers",
+    .arg_type = FLAG,
+    .help = "Number of threads that solve polynomials for --serve. Default: 4",
+    .value = REQUIRED_VALUE,
+    .validator = count_validator,
+  },
+  {
+    .long_flag = "max-connections",
+    .arg_type = FLAG,
+    .help = "Most clients --serve handles at once, the rest wait in the backlog. Default: 64",
+    .value = REQUIRED_VALUE,
+    .validator = count_validator,
+  },
+  {
+    .long_flag = "max-buffer",
+    .arg_type = FLAG,
+    .help = "Unsent bytes after which --serve stops reading from a client. Default: 65536",
+    .value = REQUIRED_VALUE,
+    .validator = count_validator,
+  },
+  {
+    .long_flag = "io-thread",
+    .arg_type = FLAG,
+    .help = "Read files and write output with a thread instead of io_uring",
+    .value = NO_VALUE,
+  },
+  {
+    .long_flag = "batch-size",
+    .arg_type = FLAG,
+    .help = "Lines passed between the stages of a file run at once. Default: 64",
+    .value = REQUIRED_VALUE,
+    .validator = count_validator,
+  },
+  {
+    .long_flag = "script",
+    .arg_type = FLAG,
+    .help = "Parse the whole input and report every error before running any of it",
+    .value = NO_VALUE,
+  },
+  {
+    .long_flag = "jobs",
+    .arg_type = FLAG,
+    .help = "Threads that run independent statements of a --script at once. Default: one per CPU",
+    .value = REQUIRED_VALUE,
+    .validator = count_validator,
+  },
+  {
+    .long_flag = "reactive",
+    .arg_type = FLAG,
+    .help = "Keep the expressions of let and update what depends on a variable when it changes, "
+            "once it's read (lazy) or right away (eager)",
+    .value = REQUIRED_VALUE,
+    .validator = reactive_validator,
+  },
+  {
+    .long_flag = "session",
+    .arg_type = FLAG,
+    .help = "Keep the variables of the shell in this file, and pick them up from it on the next start",
+    .value = REQUIRED_VALUE,
+  },
+  {
+    .long_flag = "precision",
+    .arg_type = FLAG,
+    .help = "Find roots with an iteration in single, double or double-double precision, and "
+            "print how far each may be off, instead of with the exact formulas",
+    .value = REQUIRED_VALUE,
+    .validator = precision_validator,
+  },
   {
     .long_flag = "equation",
     .arg_type = POSITIONAL,
@@ -46,9 +150,17 @@ Args get_args (const int argc, const char *argv[]) {
     exit(1);
   }
 
+  // -1 if the count is unknown, which as unsigned would be a lot of threads
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
   Args args = {
     .file = stdin,
     .equation = NULL,
+    .workers = 4,
+    .max_connections = 64,
+    .max_buffer = 65536,
+    .batch_size = 64,
+    .jobs = cpus > 0 ? (unsigned int) cpus : 1,
   };
 
   for (size_t i = 0; i < output_len; i++) {
@@ -58,6 +170,40 @@ Args get_args (const int argc, const char *argv[]) {
       args.file = fopen(current_arg.value.str_val, "r");
     } else if (!strcmp(current_arg.long_flag, "equation")) {
       args.equation = current_arg.value.str_val;
+    } else if (!strcmp(current_arg.long_flag, "stats")) {
+      args.stats = current_arg.value.bool_val;
+    } else if (!strcmp(current_arg.long_flag, "perf")) {
+      args.perf  = current_arg.value.bool_val;
+      args.stats = args.stats || args.perf;
+    } else if (!strcmp(current_arg.long_flag, "trace")) {
+      args.trace = current_arg.value.str_val;
+    } else if (!strcmp(current_arg.long_flag, "serve")) {
+      args.serve = current_arg.value.str_val;
+    } else if (!strcmp(current_arg.long_flag, "serve-shm")) {
+      args.serve_shm = current_arg.value.str_val;
+    } else if (!strcmp(current_arg.long_flag, "workers")) {
+      args.workers = (unsigned int) strtoul(current_arg.value.str_val, NULL, 10);
+    } else if (!strcmp(current_arg.long_flag, "max-connections")) {
+      args.max_connections = (unsigned int) strtoul(current_arg.value.str_val, NULL, 10);
+    } else if (!strcmp(current_arg.long_flag, "max-buffer")) {
+      args.max_buffer = (unsigned int) strtoul(current_arg.value.str_val, NULL, 10);
+    } else if (!strcmp(current_arg.long_flag, "io-thread")) {
+      args.io_thread = current_arg.value.bool_val;
+    } else if (!strcmp(current_arg.long_flag, "batch-size")) {
+      args.batch_size = (unsigned int) strtoul(current_arg.value.str_val, NULL, 10);
+    } else if (!strcmp(current_arg.long_flag, "script")) {
+      args.script = current_arg.value.bool_val;
+    } else if (!strcmp(current_arg.long_flag, "jobs")) {
+      args.jobs = (unsigned int) strtoul(current_arg.value.str_val, NULL, 10);
+    } else if (!strcmp(current_arg.long_flag, "reactive")) {
+      args.reactive = strcmp(current_arg.value.str_val, "eager") ? REACTIVE_LAZY : REACTIVE_EAGER;
+    } else if (!strcmp(current_arg.long_flag, "session")) {
+      args.session = current_arg.value.str_val;
+    } else if (!strcmp(current_arg.long_flag, "precision")) {
+      const char *precision = current_arg.value.str_val;
+      args.precision = !strcmp(precision, "single") ? PRECISION_SINGLE
+                     : !strcmp(precision, "double") ? PRECISION_DOUBLE
+                     :                                PRECISION_DOUBLE_DOUBLE;
     }
   }
 
@@ -83,3 +229,33 @@ int file_validator (const char *file, char *error) {
 }
 
 
+
+int count_validator (const char *value, char *error) {
+  char *end = NULL;
+  unsigned long count = strtoul(value, &end, 10);
+
+  if (*value == '-' || *end || !count || count > 1000000000) {
+    strncpy(error, "Expected a positive integer!", MAX_ERROR);
+    return 0;
+  }
+
+  return 1;
+}
+
+int reactive_validator (const char *value, char *error) {
+  if (strcmp(value, "lazy") && strcmp(value, "eager")) {
+    strncpy(error, "Expected lazy or eager!", MAX_ERROR);
+    return 0;
+  }
+
+  return 1;
+}
+
+int precision_validator (const char *value, char *error) {
+  if (strcmp(value, "single") && strcmp(value, "double") && strcmp(value, "double-double")) {
+    strncpy(error, "Expected single, double or double-double!", MAX_ERROR);
+    return 0;
+  }
+
+  return 1;
+}
@@ -6,12 +6,17 @@
 #include <cmath>
 #include <complex>
 #include <math.h>
+#include <stdio.h>
 
 #include "equation.h"
+#include "batch_solve.h"
 #include "complex.h"
+#include "double_double.h"
 #include "polynomial.h"
 #include "arith.h"
 #include "log.h"
+#include "stats.h"
+#include "trace.h"
 
 int is_zero (const double x) {
   return fabs(x) < EPSILON;
@@ -26,15 +31,84 @@ double normalize_zero (const double x) {
 }
 
 int solve_degree_2 (Polynomial p, Solutions *sols);
+int store_root_pair (complex_t x1, complex_t x2, Solutions *sols);
 
 int solve_degree_3 (Polynomial p, Solutions *sols);
 int solve_depressed_qubic (Polynomial poly, complex_t p, complex_t q, Solutions *sols);
 complex_t cardano_unsubstitute (Polynomial poly, const complex_t y);
+double cubic_root_scale (Polynomial poly);
+
+/// Relative tolerance for the special cases of the depressed cubic
+#define CUBIC_REL_EPSILON 1e-9
 
 int solve_degree_4 (Polynomial p, Solutions *sols);
 
+int store_distinct_pair (complex_t x1, complex_t x2, Solutions *sols);
+
+/// Relative tolerance for the special cases of the cubic in double-double
+#define CUBIC_DD_REL_EPSILON 1e-25
+
+#define CF_REAL                      double
+#define CF_NAME(name)                name
+#define CF_FROM_DOUBLE(x)            (x)
+#define CF_TO_DOUBLE(x)              (x)
+#define CF_SQRT                      sqrt
+#define CF_CBRT                      cbrt
+#define CF_ABS                       fabs
+#define CF_COPYSIGN                  copysign
+#define CF_SIGNBIT                   signbit
+#define CF_REL_EPSILON               CUBIC_REL_EPSILON
+#define CF_TIDY(x)                   cmplx_normalize_zero(x)
+#define CF_STORE_PAIR(x1, x2, sols)  store_root_pair(x1, x2, sols)
+#include "closed_form.h"
+#undef CF_REAL
+#undef CF_NAME
+#undef CF_FROM_DOUBLE
+#undef CF_TO_DOUBLE
+#undef CF_SQRT
+#undef CF_CBRT
+#undef CF_ABS
+#undef CF_COPYSIGN
+#undef CF_SIGNBIT
+#undef CF_REL_EPSILON
+#undef CF_TIDY
+#undef CF_STORE_PAIR
+
+// in double-double, roots are only as close as EPSILON if they really are,
+// so none of them are rounded to zero or merged unless they are the same double
+#define CF_REAL                      dd_t
+#define CF_NAME(name)                name##_dd
+#define CF_FROM_DOUBLE(x)            dd_from(x)
+#define CF_TO_DOUBLE(x)              dd_to_double(x)
+#define CF_SQRT                      dd_sqrt
+#define CF_CBRT                      dd_cbrt
+#define CF_ABS                       dd_abs
+#define CF_COPYSIGN                  dd_copysign
+#define CF_SIGNBIT(x)                signbit((x).hi)
+#define CF_REL_EPSILON               CUBIC_DD_REL_EPSILON
+#define CF_TIDY(x)                   (x)
+#define CF_STORE_PAIR(x1, x2, sols)  store_distinct_pair(x1, x2, sols)
+#include "closed_form.h"
+#undef CF_REAL
+#undef CF_NAME
+#undef CF_FROM_DOUBLE
+#undef CF_TO_DOUBLE
+#undef CF_SQRT
+#undef CF_CBRT
+#undef CF_ABS
+#undef CF_COPYSIGN
+#undef CF_SIGNBIT
+#undef CF_REL_EPSILON
+#undef CF_TIDY
+#undef CF_STORE_PAIR
+
+/// Iteration limit of #solve_polynomial_iterative
+#define MAX_ITERATIONS 1000
+
 int solve_polynomial (Polynomial p, Solutions *sols) {
   int deg = polynomial_deg(p);
+  // nearly everything that comes in is real, and only needs real sqrt and cbrt
+  bool real = polynomial_is_real(&p);
   if (deg == -1) {
     // 0 = 0
     sols->count = INFINITE_SOLUTIONS;
@@ -47,17 +121,79 @@ int solve_polynomial (Polynomial p, Solutions *sols) {
     // dx + e = 0
     // x = -e / d
     sols->count = 1;
-    sols->x1 = cmplx_normalize_zero(
-      cmplx_div(cmplx_negate(p.e), p.d)
-    );
+    if (real)
+      sols->x1 = { normalize_zero(-p.e.real / p.d.real) };
+    else
+      sols->x1 = cmplx_normalize_zero(
+        cmplx_div(cmplx_negate(p.e), p.d)
+      );
     return 1;
+  }
+
+  // the closed-form branches are the only ones worth a span
+  int res = 0;
+  TRACE_BEGIN(solve);
+
+  if (deg == 2 && real) {
+    res = solve_real_degree_2(p, sols);
+    TRACE_END(solve, "solve_real_degree_2");
   } else if (deg == 2) {
-    return solve_degree_2(p, sols);
+    res = solve_degree_2(p, sols);
+    TRACE_END(solve, "solve_degree_2");
+  } else if (deg == 3 && real) {
+    res = solve_real_degree_3(p, sols);
+    TRACE_END(solve, "solve_real_degree_3");
   } else if (deg == 3) {
-    return solve_degree_3(p, sols);
+    res = solve_degree_3(p, sols);
+    TRACE_END(solve, "solve_degree_3");
   }
 
-  return 0;
+  // the roots that doubles got wrong, near multiple ones, are found again in
+  // double-double, which only a few ever need
+  if (res) {
+    int count     = sols->count;
+    int escalated = escalate_roots(&p, deg, sols);
+    if (stats_are_enabled())
+      stats_count_roots((uint64_t) count, (uint64_t) escalated);
+  }
+
+  return res;
+}
+
+int solve_polynomial_dd (Polynomial p, Solutions *sols) {
+  int  deg  = polynomial_deg(p);
+  bool real = polynomial_is_real(&p);
+
+  if (deg <= 0)
+    return solve_polynomial(p, sols);
+
+  if (deg == 1) {
+    // a single division rounds once, so it is as good in double, but a
+    // root below EPSILON is still a root
+    sols->count = 1;
+    sols->x1 = real ? complex_t{ -p.e.real / p.d.real } : cmplx_div(cmplx_negate(p.e), p.d);
+    return 1;
+  }
+
+  int res = 0;
+  TRACE_BEGIN(solve);
+
+  if (deg == 2 && real) {
+    res = solve_real_degree_2_dd(p, sols);
+    TRACE_END(solve, "solve_real_degree_2_dd");
+  } else if (deg == 3 && real) {
+    res = solve_real_degree_3_dd(p, sols);
+    TRACE_END(solve, "solve_real_degree_3_dd");
+  }
+
+  if (res)
+    return res;
+
+  // everything without a closed form, and the cubics that are only near its
+  // special cases, which are the ones that need the precision the most
+  RootErrors errors = {};
+  batch_solve(&p, 1, PRECISION_DOUBLE_DOUBLE, sols, &errors);
+  return 1;
 }
 
 int solve_degree_2 (Polynomial p, Solutions *sols) {
@@ -85,7 +221,12 @@ int solve_degree_2 (Polynomial p, Solutions *sols) {
     cmplx_add(cmplx_negate(p.d), d_sqrt),
     cmplx_mul(p.c, {2})
   ));
-  
+
+  return store_root_pair(x1, x2, sols);
+}
+
+/* the two roots of a quadratic, or one if they are the same */
+int store_root_pair (complex_t x1, complex_t x2, Solutions *sols) {
   if (cmplx_eq(x1, x2)) {
     sols->count = 1;
     sols->x1 = x1;
@@ -98,6 +239,17 @@ int solve_degree_2 (Polynomial p, Solutions *sols) {
   return 1;
 }
 
+/* the two roots of a quadratic, or one if they round to the same double */
+int store_distinct_pair (complex_t x1, complex_t x2, Solutions *sols) {
+  if (!(cmplx_mag(cmplx_sub(x1, x2)) > 0))
+    return store_root_pair(x1, x1, sols);
+
+  sols->count = 2;
+  sols->x1 = x1;
+  sols->x2 = x2;
+  return 1;
+}
+
 int solve_degree_3 (Polynomial p, Solutions *sols) {
   // bx^3 + cx^2 + dx + e = 0
   // ax^3 + bx^2 + cx + d = 0
@@ -135,13 +287,23 @@ int solve_degree_3 (Polynomial p, Solutions *sols) {
 }
 
 int solve_depressed_qubic (Polynomial poly, complex_t p, complex_t q, Solutions *sols) {
-  if (is_zero(cmplx_mag(p))) {
+  // p and q scale like y^2 and y^3, so compare them against a root size estimate
+  double scale = cubic_root_scale(poly);
+  bool   zero_p = cmplx_mag(p) <= CUBIC_REL_EPSILON * scale * scale;
+  bool   zero_q = cmplx_mag(q) <= CUBIC_REL_EPSILON * scale * scale * scale;
+
+  if (zero_p && zero_q) {
+    // y^3 = 0, a triple root
     sols->count = 1;
-    // y = cbrt(-q)
-    complex_t y = cmplx_cbrt(cmplx_negate(q), 0);
-    
-    // x1 = y - b/(3*a)
-    sols->x1 = cardano_unsubstitute(poly, y);
+    sols->x1 = cardano_unsubstitute(poly, {});
+    return 1;
+  }
+
+  if (zero_p) {
+    // y^3 = -q, three cube roots
+    sols->count = 3;
+    for (int k = 0; k < 3; k++)
+      sols->x[k] = cardano_unsubstitute(poly, cmplx_cbrt(cmplx_negate(q), k));
     return 1;
   }
   
@@ -152,16 +314,15 @@ int solve_depressed_qubic (Polynomial poly, complex_t p, complex_t q, Solutions
   complex_t disc = cmplx_add(half_q_squared, third_p_cubed);
   LOG_DEBUG("discriminant: %lg + %lgi", disc.real, disc.imag);
   
-  if (is_zero(cmplx_mag(disc))) {
-    LOG_DEBUG("two real roots!");
+  double disc_scale = cmplx_mag(half_q_squared) + cmplx_mag(third_p_cubed);
+  if (cmplx_mag(disc) <= CUBIC_REL_EPSILON * disc_scale) {
+    LOG_DEBUG("a simple and a double root!");
 
     sols->count = 2;
     
-    complex_t y2 = cmplx_cbrt(
-      cmplx_div(q, {2}),
-      1
-    );
-    complex_t y1 = cmplx_mul({-2}, y2);
+    // y1 = 3q / p, y2 = y3 = -3q / 2p
+    complex_t y1 = cmplx_div(cmplx_mul({3}, q), p);
+    complex_t y2 = cmplx_mul({-0.5}, y1);
     
     sols->x1 = cardano_unsubstitute(poly, y1);
     sols->x2 = cardano_unsubstitute(poly, y2);
@@ -172,11 +333,84 @@ int solve_depressed_qubic (Polynomial poly, complex_t p, complex_t q, Solutions
   return 0;
 }
 
+/* max(|b/a|, sqrt|c/a|, cbrt|d/a|) is within a constant factor of the largest root */
+double cubic_root_scale (Polynomial poly) {
+  double lead = cmplx_mag(poly.b);
+  return fmax(cmplx_mag(poly.c) / lead,
+              fmax(sqrt(cmplx_mag(poly.d) / lead), cbrt(cmplx_mag(poly.e) / lead)));
+}
+
 complex_t cardano_unsubstitute (Polynomial poly, const complex_t y) {
   // y - b / (3 * a)
   return cmplx_sub(y, cmplx_div(poly.c, cmplx_mul({3}, poly.b)));
 }
 
+int solve_polynomial_iterative (Polynomial p, Solutions *sols) {
+  int deg = polynomial_deg(p);
+  if (deg <= 1)
+    return solve_polynomial(p, sols);
+
+  TRACE_BEGIN(iterative);
+
+  // make the polynomial monic: z^deg + ... = 0
+  complex_t monic[POLY_COEFF_LEN] = {};
+  for (int i = 0; i <= deg; i++)
+    monic[i] = cmplx_div(p.coeffs[i], p.coeffs[deg]);
+
+  // Cauchy's bound: all roots lie within 1 + max |c_i|
+  double bound = 0;
+  for (int i = 0; i < deg; i++)
+    bound = fmax(bound, cmplx_mag(monic[i]));
+  bound += 1;
+
+  // the usual starting points: powers of a number that is neither real nor a root of unity
+  complex_t z[POLY_MAX_DEG] = {};
+  complex_t seed = { 0.4 * bound / 1.3, 0.9 * bound / 1.3 };
+  z[0] = seed;
+  for (int i = 1; i < deg; i++)
+    z[i] = cmplx_mul(z[i - 1], cmplx_div(seed, {cmplx_mag(seed)}));
+
+  bool converged = false;
+  for (int iteration = 0; iteration < MAX_ITERATIONS && !converged; iteration++) {
+    converged = true;
+
+    for (int i = 0; i < deg; i++) {
+      // z_i -= p(z_i) / prod_{j != i} (z_i - z_j)
+      complex_t value = monic[deg];
+      for (int k = deg - 1; k >= 0; k--)
+        value = cmplx_add(cmplx_mul(value, z[i]), monic[k]);
+
+      complex_t denominator = {1};
+      for (int j = 0; j < deg; j++) {
+        if (j != i)
+          denominator = cmplx_mul(denominator, cmplx_sub(z[i], z[j]));
+      }
+
+      // two approximations collided, nudge them apart
+      if (!(cmplx_mag(denominator) > 0))
+        denominator = {EPSILON * EPSILON};
+
+      complex_t step = cmplx_div(value, denominator);
+      z[i] = cmplx_sub(z[i], step);
+
+      if (cmplx_mag(step) > 1e-15 * (1 + cmplx_mag(z[i])))
+        converged = false;
+    }
+  }
+
+  sols->count = deg;
+  for (int i = 0; i < deg; i++)
+    sols->x[i] = cmplx_normalize_zero(z[i]);
+
+  if (trace_enabled) {
+    char degree[16];
+    snprintf(degree, sizeof(degree), "%d", deg);
+    TRACE_END_ARG(iterative, "solve_iterative", "degree", degree);
+  }
+
+  return converged;
+}
+
 /* a == 0 case */
 void solve_linear_equation (Equation *const eq) {
   const double b = eq->b, c = eq->c;
@@ -205,17 +439,10 @@ void solve_quadratic_equation (Equation *const eq) {
     eq->tag = SINGLE;
     eq->solutions[0] = {normalize_zero(-b / (2 * a))};
   } else {
-    complex_t d_sqrt = cmplx_sqrt({d});
-    
     eq->tag = DOUBLE;
-    eq->solutions[0] = cmplx_normalize_zero(cmplx_div(
-      cmplx_sub({-b}, d_sqrt),
-      cmplx_mul({a}, {2})
-    ));
-    eq->solutions[1] = cmplx_normalize_zero(cmplx_div(
-      cmplx_add({-b}, d_sqrt),
-      cmplx_mul({a}, {2})
-    ));
+    real_quadratic_roots(a, b, c, &eq->solutions[0], &eq->solutions[1]);
+    eq->solutions[0] = cmplx_normalize_zero(eq->solutions[0]);
+    eq->solutions[1] = cmplx_normalize_zero(eq->solutions[1]);
   }
 }
 
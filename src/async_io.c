@@ -0,0 +1,717 @@
+/**
+ * @file
+ * @brief Asynchronous line reader and writer for batch files
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+  #include <linux/io_uring.h>
+#endif
+
+#include "async_io.h"
+#include "log.h"
+
+/// Requests that can be queued at once, enough for a reader and a writer
+#define ASYNC_IO_DEPTH 16
+
+struct AsyncIo {
+  AsyncIoBackend backend;
+
+  // ------- IO_URING -------
+  int       ring_fd;
+  void     *sq_ring;
+  size_t    sq_ring_size;
+  void     *cq_ring;
+  size_t    cq_ring_size;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+#ifdef __linux__
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+#endif
+  size_t    sqes_size;
+  /// Submitted requests whose completions weren't reaped yet
+  unsigned  in_flight;
+  /// Waiting on the ring failed, every request after that fails too
+  bool      broken;
+
+  // ------- THREAD -------
+  pthread_t       thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  submitted;
+  pthread_cond_t  completed;
+  AsyncOp        *queue[ASYNC_IO_DEPTH];
+  size_t          queue_head;
+  size_t          queue_len;
+  bool            stopping;
+};
+
+bool     uring_setup       (AsyncIo *io);
+void     uring_destroy     (AsyncIo *io);
+void     uring_submit      (AsyncIo *io, AsyncOp *op);
+bool     uring_reap        (AsyncIo *io);
+void     uring_drain       (AsyncIo *io);
+void     uring_cancel_all  (AsyncIo *io);
+void     uring_wait        (AsyncIo *io, AsyncOp *op);
+bool     thread_setup      (AsyncIo *io);
+void     thread_destroy    (AsyncIo *io);
+void     thread_submit     (AsyncIo *io, AsyncOp *op);
+void     thread_wait       (AsyncIo *io, AsyncOp *op);
+void    *thread_worker     (void *arg);
+ssize_t  perform_op        (const AsyncOp *op);
+void     async_io_submit   (AsyncIo *io, AsyncOp *op);
+void     async_io_wait     (AsyncIo *io, AsyncOp *op);
+bool     reader_chunk      (AsyncReader *reader);
+void     reader_request    (AsyncReader *reader);
+void     reader_append     (AsyncReader *reader, const char *data, size_t len);
+void     writer_flush      (AsyncWriter *writer);
+void     writer_complete   (AsyncWriter *writer, size_t index);
+ssize_t  stream_write      (void *cookie, const char *data, size_t len);
+
+AsyncIo *async_io_create (AsyncIoBackend backend) {
+  AsyncIo *io = (AsyncIo *) calloc(1, sizeof(AsyncIo));
+  io->ring_fd = -1;
+
+  if (backend == ASYNC_IO_URING && uring_setup(io)) {
+    io->backend = ASYNC_IO_URING;
+    return io;
+  }
+
+  if (thread_setup(io)) {
+    io->backend = ASYNC_IO_THREAD;
+    return io;
+  }
+
+  free(io);
+  return NULL;
+}
+
+AsyncIoBackend async_io_backend (AsyncIo *io) {
+  return io->backend;
+}
+
+void async_io_destroy (AsyncIo *io) {
+  switch (io->backend) {
+    case ASYNC_IO_URING:
+      uring_destroy(io);
+      break;
+    case ASYNC_IO_THREAD:
+      thread_destroy(io);
+      break;
+    default:
+      break;
+  }
+
+  free(io);
+}
+
+void async_io_submit (AsyncIo *io, AsyncOp *op) {
+  op->pending = true;
+  op->result  = 0;
+
+  if (io->backend == ASYNC_IO_URING)
+    uring_submit(io, op);
+  else
+    thread_submit(io, op);
+}
+
+/* block until op is completed, completions of other requests are recorded on the way */
+void async_io_wait (AsyncIo *io, AsyncOp *op) {
+  if (io->backend == ASYNC_IO_URING)
+    uring_wait(io, op);
+  else
+    thread_wait(io, op);
+}
+
+// ------- IO_URING -------
+
+#ifdef __linux__
+
+bool uring_setup (AsyncIo *io) {
+  struct io_uring_params params = {};
+  int fd = (int) syscall(SYS_io_uring_setup, ASYNC_IO_DEPTH, &params);
+  if (fd < 0) {
+    // no kernel support, or disabled by a sysctl or a seccomp filter
+    LOG_DEBUG("io_uring is unavailable: %s", strerror(errno));
+    return false;
+  }
+
+  // reads and writes at the current position of pipes and terminals
+  if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+    LOG_DEBUG("io_uring is too old");
+    close(fd);
+    return false;
+  }
+
+  io->ring_fd      = fd;
+  io->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  io->cq_ring_size = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+  io->sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (io->cq_ring_size > io->sq_ring_size)
+      io->sq_ring_size = io->cq_ring_size;
+    io->cq_ring_size = io->sq_ring_size;
+  }
+
+  io->sq_ring = mmap(NULL, io->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_SQ_RING);
+  if (io->sq_ring == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    io->cq_ring = io->sq_ring;
+  } else {
+    io->cq_ring = mmap(NULL, io->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_CQ_RING);
+    if (io->cq_ring == MAP_FAILED) {
+      munmap(io->sq_ring, io->sq_ring_size);
+      close(fd);
+      return false;
+    }
+  }
+
+  void *sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    if (io->cq_ring != io->sq_ring)
+      munmap(io->cq_ring, io->cq_ring_size);
+    munmap(io->sq_ring, io->sq_ring_size);
+    close(fd);
+    return false;
+  }
+
+  char *sq = (char *) io->sq_ring;
+  char *cq = (char *) io->cq_ring;
+  io->sq_tail  = (unsigned *) (sq + params.sq_off.tail);
+  io->sq_mask  = (unsigned *) (sq + params.sq_off.ring_mask);
+  io->sq_array = (unsigned *) (sq + params.sq_off.array);
+  io->cq_head  = (unsigned *) (cq + params.cq_off.head);
+  io->cq_tail  = (unsigned *) (cq + params.cq_off.tail);
+  io->cq_mask  = (unsigned *) (cq + params.cq_off.ring_mask);
+  io->cqes     = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+  io->sqes     = (struct io_uring_sqe *) sqes;
+
+  return true;
+}
+
+void uring_destroy (AsyncIo *io) {
+  munmap(io->sqes, io->sqes_size);
+  if (io->cq_ring != io->sq_ring)
+    munmap(io->cq_ring, io->cq_ring_size);
+  munmap(io->sq_ring, io->sq_ring_size);
+  close(io->ring_fd);
+}
+
+void uring_submit (AsyncIo *io, AsyncOp *op) {
+  // the completion queue is twice as long, so this keeps it from overflowing
+  while (io->in_flight >= ASYNC_IO_DEPTH && !io->broken) {
+    if (!uring_reap(io))
+      uring_drain(io);
+  }
+
+  if (io->broken) {
+    op->result  = -EIO;
+    op->pending = false;
+    return;
+  }
+
+  unsigned tail  = *io->sq_tail;
+  unsigned index = tail & *io->sq_mask;
+
+  struct io_uring_sqe *sqe = &io->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode    = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd        = op->fd;
+  sqe->addr      = (uintptr_t) op->data;
+  sqe->len       = (uint32_t) op->len;
+  sqe->off       = (uint64_t) op->offset;
+  sqe->user_data = (uintptr_t) op;
+
+  io->sq_array[index] = index;
+  __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  while (syscall(SYS_io_uring_enter, io->ring_fd, 1, 0, 0, NULL, 0) < 0) {
+    if (errno == EINTR)
+      continue;
+
+    // out of kernel resources, free some up by waiting for a completion
+    int  error       = errno;
+    bool reap_failed = false;
+    if ((error == EAGAIN || error == EBUSY) && io->in_flight) {
+      if (uring_reap(io))
+        continue;
+      reap_failed = true;
+    }
+
+    LOG_ERROR("Could not submit to io_uring: %s", strerror(error));
+    op->result  = -error;
+    op->pending = false;
+
+    // the kernel didn't take the entry, so a later submission mustn't send it
+    __atomic_store_n(io->sq_tail, tail, __ATOMIC_RELEASE);
+    if (reap_failed)
+      uring_drain(io);
+    return;
+  }
+
+  io->in_flight++;
+}
+
+/* wait for one completion and record it, returns false if that failed */
+bool uring_reap (AsyncIo *io) {
+  unsigned head = *io->cq_head;
+
+  while (head == __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE)) {
+    if (syscall(SYS_io_uring_enter, io->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+        errno != EINTR) {
+      LOG_ERROR("Could not wait for io_uring: %s", strerror(errno));
+      return false;
+    }
+  }
+
+  struct io_uring_cqe *cqe = &io->cqes[head & *io->cq_mask];
+  AsyncOp *op = (AsyncOp *) (uintptr_t) cqe->user_data;
+  op->result  = cqe->res;
+  op->pending = false;
+
+  __atomic_store_n(io->cq_head, head + 1, __ATOMIC_RELEASE);
+  io->in_flight--;
+  return true;
+}
+
+void uring_wait (AsyncIo *io, AsyncOp *op) {
+  while (op->pending) {
+    if (!uring_reap(io))
+      uring_drain(io);
+  }
+}
+
+/*
+ * Waiting on the ring failed, but the kernel may still write into the buffers
+ * of the requests in flight, which their callers free once they see an error.
+ * Cancel what can be cancelled and wait for every completion by watching the
+ * completion queue, which needs no io_uring_enter. Requests after this fail.
+ */
+void uring_drain (AsyncIo *io) {
+  io->broken = true;
+  uring_cancel_all(io);
+
+  while (io->in_flight) {
+    unsigned head = *io->cq_head;
+    if (head == __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE)) {
+      struct timespec pause = { 0, 1000000 };
+      nanosleep(&pause, NULL);
+      continue;
+    }
+
+    struct io_uring_cqe *cqe = &io->cqes[head & *io->cq_mask];
+    AsyncOp *op = (AsyncOp *) (uintptr_t) cqe->user_data;
+    __atomic_store_n(io->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    // the completion of the cancel request itself has no op
+    if (!op)
+      continue;
+
+    op->result  = cqe->res;
+    op->pending = false;
+    io->in_flight--;
+  }
+}
+
+/* ask the kernel to cancel every request in flight, if it still takes any */
+void uring_cancel_all (AsyncIo *io) {
+  unsigned tail  = *io->sq_tail;
+  unsigned index = tail & *io->sq_mask;
+
+  struct io_uring_sqe *sqe = &io->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+
+  io->sq_array[index] = index;
+  __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  // a kernel that doesn't know the flag fails the cancel, then the requests
+  // just have to finish on their own
+  if (syscall(SYS_io_uring_enter, io->ring_fd, 1, 0, 0, NULL, 0) < 0)
+    __atomic_store_n(io->sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool uring_setup   (AsyncIo *)          { return false; }
+void uring_destroy (AsyncIo *)          {}
+void uring_submit  (AsyncIo *, AsyncOp *) {}
+bool uring_reap    (AsyncIo *)          { return false; }
+void uring_drain   (AsyncIo *)          {}
+void uring_cancel_all (AsyncIo *)       {}
+void uring_wait    (AsyncIo *, AsyncOp *) {}
+
+#endif
+
+// ------- THREAD -------
+
+bool thread_setup (AsyncIo *io) {
+  pthread_mutex_init(&io->lock, NULL);
+  pthread_cond_init(&io->submitted, NULL);
+  pthread_cond_init(&io->completed, NULL);
+
+  int error = pthread_create(&io->thread, NULL, thread_worker, io);
+  if (error) {
+    LOG_ERROR("Could not start an I/O thread: %s", strerror(error));
+    pthread_cond_destroy(&io->completed);
+    pthread_cond_destroy(&io->submitted);
+    pthread_mutex_destroy(&io->lock);
+    return false;
+  }
+
+  return true;
+}
+
+void thread_destroy (AsyncIo *io) {
+  pthread_mutex_lock(&io->lock);
+  io->stopping = true;
+  pthread_cond_signal(&io->submitted);
+  pthread_mutex_unlock(&io->lock);
+
+  pthread_join(io->thread, NULL);
+  pthread_cond_destroy(&io->completed);
+  pthread_cond_destroy(&io->submitted);
+  pthread_mutex_destroy(&io->lock);
+}
+
+void thread_submit (AsyncIo *io, AsyncOp *op) {
+  pthread_mutex_lock(&io->lock);
+
+  while (io->queue_len == ASYNC_IO_DEPTH)
+    pthread_cond_wait(&io->completed, &io->lock);
+
+  io->queue[(io->queue_head + io->queue_len) % ASYNC_IO_DEPTH] = op;
+  io->queue_len++;
+
+  pthread_cond_signal(&io->submitted);
+  pthread_mutex_unlock(&io->lock);
+}
+
+void thread_wait (AsyncIo *io, AsyncOp *op) {
+  pthread_mutex_lock(&io->lock);
+  while (op->pending)
+    pthread_cond_wait(&io->completed, &io->lock);
+  pthread_mutex_unlock(&io->lock);
+}
+
+/* does the requests in the order they were submitted, so writes to a stream stay in order */
+void *thread_worker (void *arg) {
+  AsyncIo *io = (AsyncIo *) arg;
+
+  pthread_mutex_lock(&io->lock);
+  while (true) {
+    while (!io->queue_len && !io->stopping)
+      pthread_cond_wait(&io->submitted, &io->lock);
+
+    if (!io->queue_len)
+      break;
+
+    AsyncOp *op = io->queue[io->queue_head];
+    io->queue_head = (io->queue_head + 1) % ASYNC_IO_DEPTH;
+    io->queue_len--;
+    pthread_mutex_unlock(&io->lock);
+
+    ssize_t result = perform_op(op);
+
+    pthread_mutex_lock(&io->lock);
+    op->result  = result;
+    op->pending = false;
+    pthread_cond_broadcast(&io->completed);
+  }
+  pthread_mutex_unlock(&io->lock);
+
+  return NULL;
+}
+
+ssize_t perform_op (const AsyncOp *op) {
+  ssize_t result = 0;
+
+  do {
+    if (op->offset < 0)
+      result = op->write ? write(op->fd, op->data, op->len) : read(op->fd, op->data, op->len);
+    else if (op->write)
+      result = pwrite(op->fd, op->data, op->len, op->offset);
+    else
+      result = pread(op->fd, op->data, op->len, op->offset);
+  } while (result < 0 && errno == EINTR);
+
+  return result < 0 ? -errno : result;
+}
+
+// ------- READER -------
+
+void async_reader_open (AsyncReader *reader, AsyncIo *io, int fd) {
+  *reader = {};
+  reader->io = io;
+  reader->fd = fd;
+
+  off_t start = lseek(fd, 0, SEEK_CUR);
+  reader->start = start < 0 ? 0 : start;
+
+  for (size_t i = 0; i < ASYNC_IO_READS; i++) {
+    // one more byte for the terminator of a last line without a newline
+    reader->buffers[i] = (char *) malloc(ASYNC_IO_CHUNK + 1);
+    reader_request(reader);
+  }
+}
+
+/* start reading the next chunk into its buffer, which must be consumed already */
+void reader_request (AsyncReader *reader) {
+  if (reader->eof)
+    return;
+
+  uint64_t chunk = reader->next_chunk++;
+  size_t   index = chunk % ASYNC_IO_READS;
+  AsyncOp *op    = &reader->reads[index];
+
+  reader->filled[index] = 0;
+  reader->ready[index]  = false;
+
+  op->fd     = reader->fd;
+  op->write  = false;
+  op->data   = reader->buffers[index];
+  op->len    = ASYNC_IO_CHUNK;
+  op->offset = reader->start + (int64_t) (chunk * ASYNC_IO_CHUNK);
+  async_io_submit(reader->io, op);
+}
+
+/* wait until the current chunk is ready, returns false on a read error */
+bool reader_chunk (AsyncReader *reader) {
+  size_t   index = reader->chunk % ASYNC_IO_READS;
+  AsyncOp *op    = &reader->reads[index];
+
+  while (!reader->ready[index]) {
+    async_io_wait(reader->io, op);
+
+    if (op->result < 0) {
+      LOG_ERROR("Could not read the input: %s", strerror((int) -op->result));
+      reader->failed = true;
+      reader->eof    = true;
+      return false;
+    }
+
+    size_t got = (size_t) op->result;
+    reader->filled[index] += got;
+
+    if (!got || reader->filled[index] == ASYNC_IO_CHUNK) {
+      reader->ready[index] = true;
+      reader->eof = reader->eof || reader->filled[index] < ASYNC_IO_CHUNK;
+      break;
+    }
+
+    // a short read doesn't have to be the end of the file, ask for the rest
+    op->data   += got;
+    op->len    -= got;
+    op->offset += (int64_t) got;
+    async_io_submit(reader->io, op);
+  }
+
+  return true;
+}
+
+void reader_append (AsyncReader *reader, const char *data, size_t len) {
+  if (reader->line_len + len + 1 > reader->line_cap) {
+    reader->line_cap = 2 * (reader->line_len + len + 1);
+    reader->line     = (char *) realloc(reader->line, reader->line_cap);
+  }
+
+  memcpy(reader->line + reader->line_len, data, len);
+  reader->line_len += len;
+  reader->line[reader->line_len] = '\0';
+}
+
+const char *async_reader_line (AsyncReader *reader) {
+  reader->line_len = 0;
+
+  while (true) {
+    if (reader->failed || !reader_chunk(reader))
+      return NULL;
+
+    size_t index  = reader->chunk % ASYNC_IO_READS;
+    char  *buffer = reader->buffers[index];
+    size_t filled = reader->filled[index];
+    char  *start  = buffer + reader->pos;
+    size_t left   = filled - reader->pos;
+
+    char *newline = (char *) memchr(start, '\n', left);
+    if (newline) {
+      *newline = '\0';
+      reader->pos = (size_t) (newline - buffer) + 1;
+
+      if (!reader->line_len)
+        return start;
+
+      reader_append(reader, start, (size_t) (newline - start));
+      return reader->line;
+    }
+
+    // the last chunk of the file
+    if (filled < ASYNC_IO_CHUNK) {
+      reader->pos = filled;
+
+      if (!reader->line_len) {
+        buffer[filled] = '\0';
+        return left ? start : NULL;
+      }
+
+      reader_append(reader, start, left);
+      return reader->line;
+    }
+
+    // the line goes on in the next chunk, and this buffer can be reused
+    reader_append(reader, start, left);
+    reader->chunk++;
+    reader->pos = 0;
+    reader_request(reader);
+  }
+}
+
+void async_reader_close (AsyncReader *reader) {
+  for (size_t i = 0; i < ASYNC_IO_READS; i++) {
+    async_io_wait(reader->io, &reader->reads[i]);
+    free(reader->buffers[i]);
+  }
+
+  free(reader->line);
+  *reader = {};
+}
+
+// ------- WRITER -------
+
+void async_writer_open (AsyncWriter *writer, AsyncIo *io, int fd) {
+  *writer = {};
+  writer->io = io;
+  writer->fd = fd;
+
+  // appending ignores offsets, so several writes in flight could land out of order
+  off_t offset   = lseek(fd, 0, SEEK_CUR);
+  int   flags    = fcntl(fd, F_GETFL);
+  writer->offset = (offset < 0 || flags < 0 || (flags & O_APPEND)) ? -1 : offset;
+
+  for (size_t i = 0; i < ASYNC_IO_WRITES; i++)
+    writer->buffers[i] = (char *) malloc(ASYNC_IO_CHUNK);
+}
+
+void async_writer_write (AsyncWriter *writer, const char *data, size_t len) {
+  while (len) {
+    size_t part = ASYNC_IO_CHUNK - writer->filled;
+    if (part > len)
+      part = len;
+
+    memcpy(writer->buffers[writer->current] + writer->filled, data, part);
+    writer->filled += part;
+    data += part;
+    len  -= part;
+
+    if (writer->filled == ASYNC_IO_CHUNK)
+      writer_flush(writer);
+  }
+}
+
+/* submit the buffer that is being filled and move on to the next one */
+void writer_flush (AsyncWriter *writer) {
+  if (!writer->filled)
+    return;
+
+  // without offsets only one write may be in flight, or they could be reordered
+  if (writer->offset < 0)
+    writer_complete(writer, (writer->current + ASYNC_IO_WRITES - 1) % ASYNC_IO_WRITES);
+
+  AsyncOp *op = &writer->writes[writer->current];
+  op->fd     = writer->fd;
+  op->write  = true;
+  op->data   = writer->buffers[writer->current];
+  op->len    = writer->filled;
+  op->offset = writer->offset;
+
+  if (writer->offset >= 0)
+    writer->offset += (int64_t) writer->filled;
+
+  if (writer->failed)
+    op->len = 0;
+  else
+    async_io_submit(writer->io, op);
+
+  writer->current = (writer->current + 1) % ASYNC_IO_WRITES;
+  writer->filled  = 0;
+  writer_complete(writer, writer->current);
+}
+
+/* wait until a buffer is written out completely */
+void writer_complete (AsyncWriter *writer, size_t index) {
+  AsyncOp *op = &writer->writes[index];
+
+  while (op->len) {
+    async_io_wait(writer->io, op);
+
+    if (op->result <= 0) {
+      if (!writer->failed)
+        LOG_ERROR("Could not write the output: %s",
+                  op->result ? strerror((int) -op->result) : "nothing was written");
+      writer->failed = true;
+      op->len = 0;
+      break;
+    }
+
+    size_t written = (size_t) op->result;
+    op->data += written;
+    op->len  -= written;
+    if (op->offset >= 0)
+      op->offset += (int64_t) written;
+
+    if (op->len)
+      async_io_submit(writer->io, op);
+  }
+}
+
+bool async_writer_close (AsyncWriter *writer) {
+  writer_flush(writer);
+  for (size_t i = 0; i < ASYNC_IO_WRITES; i++)
+    writer_complete(writer, i);
+
+  // so that whatever writes to the file next doesn't overwrite the output
+  if (writer->offset >= 0)
+    lseek(writer->fd, writer->offset, SEEK_SET);
+
+  for (size_t i = 0; i < ASYNC_IO_WRITES; i++)
+    free(writer->buffers[i]);
+
+  bool ok = !writer->failed;
+  *writer = {};
+  return ok;
+}
+
+ssize_t stream_write (void *cookie, const char *data, size_t len) {
+  async_writer_write((AsyncWriter *) cookie, data, len);
+  return (ssize_t) len;
+}
+
+FILE *async_writer_stream (AsyncWriter *writer) {
+  cookie_io_functions_t functions = {};
+  functions.write = stream_write;
+  return fopencookie(writer, "w", functions);
+}
@@ -0,0 +1,199 @@
+/**
+ * @file
+ * @brief The kernels of batch_solve.c, for one precision
+ *
+ * Included by batch_solve.c once per precision, with these defined:
+ *  - BATCH_REAL, the type of a number
+ *  - BATCH_VECTOR, 1 if BATCH_REAL is packed into vectors, 0 if it is a
+ *    number that works like one on its own, like a #dd_t
+ *  - BATCH_MASK_INT, a signed integer as wide as a BATCH_REAL, for vectors
+ *  - BATCH_LANES, the numbers in a vector of 16 bytes, or 1
+ *  - BATCH_EPSILON, the machine epsilon of a BATCH_REAL
+ *  - BATCH_FROM_DOUBLE(x) and BATCH_TO_DOUBLE(x), conversions to and from a
+ *    BATCH_REAL
+ *  - BATCH_NAME(name), name with a suffix of the precision
+ *
+ * The vectors are GCC's vector extensions, which are SSE2 registers on
+ * x86-64 and whatever the CPU has elsewhere, so there is no scalar fallback
+ * for the float and double ones. Their masks only go through ?:, !, && and
+ * ||, which work the same on a bool, so the kernels are written once for
+ * both. Every lane is a problem of its own: nothing a lane computes depends
+ * on the others, so a root comes out the same whatever it was solved along
+ * with.
+ */
+
+#define lanes_t BATCH_NAME(lanes_t)
+#define mask_t  BATCH_NAME(mask_t)
+#define lanes_abs BATCH_NAME(lanes_abs)
+
+#if BATCH_VECTOR
+typedef BATCH_REAL     lanes_t __attribute__((vector_size(BATCH_LANES * sizeof(BATCH_REAL))));
+typedef BATCH_MASK_INT mask_t  __attribute__((vector_size(BATCH_LANES * sizeof(BATCH_REAL))));
+#define LANE(v, lane) (v)[lane]
+#else
+typedef BATCH_REAL lanes_t;
+typedef bool       mask_t;
+#define LANE(v, lane) (v)
+#endif
+
+lanes_t BATCH_NAME(lanes_abs) (lanes_t x);
+void BATCH_NAME(solve_lanes) (const complex_t monic[][POLY_COEFF_LEN], int deg,
+                              complex_t roots[][POLY_MAX_DEG]);
+#if BATCH_VECTOR
+void BATCH_NAME(eval_points) (const Polynomial *p, const BATCH_REAL *real, const BATCH_REAL *imag,
+                              BATCH_REAL *out_real, BATCH_REAL *out_imag, size_t count);
+#endif
+
+/* |x| */
+lanes_t BATCH_NAME(lanes_abs) (lanes_t x) {
+  return x < 0 ? -x : x;
+}
+
+/* the Durand-Kerner iteration of a lane of monic polynomials of degree deg */
+void BATCH_NAME(solve_lanes) (const complex_t monic[][POLY_COEFF_LEN], int deg,
+                              complex_t roots[][POLY_MAX_DEG]) {
+  const lanes_t zero = {}, one = zero + 1, nudge = zero + BATCH_FROM_DOUBLE(BATCH_NUDGE);
+  const lanes_t tolerance = zero + 4 * BATCH_EPSILON;
+  const lanes_t rounding  = zero + BATCH_EPSILON;
+
+  lanes_t cr[POLY_MAX_DEG] = {}, ci[POLY_MAX_DEG] = {};
+  lanes_t zr[POLY_MAX_DEG] = {}, zi[POLY_MAX_DEG] = {};
+
+  // the starting points of solve_polynomial_iterative, on a circle of
+  // radius one, that each lane scales to its own bound
+  complex_t start[POLY_MAX_DEG] = {};
+  complex_t seed = { 0.4 / 1.3, 0.9 / 1.3 };
+  start[0] = seed;
+  for (int k = 1; k < deg; k++)
+    start[k] = cmplx_mul(start[k - 1], cmplx_div(seed, {cmplx_mag(seed)}));
+
+  for (int lane = 0; lane < BATCH_LANES; lane++) {
+    double bound = 0;
+    for (int k = 0; k < deg; k++) {
+      LANE(cr[k], lane) = BATCH_FROM_DOUBLE(monic[lane][k].real);
+      LANE(ci[k], lane) = BATCH_FROM_DOUBLE(monic[lane][k].imag);
+      bound = fmax(bound, cmplx_mag(monic[lane][k]));
+    }
+    bound += 1;
+
+    for (int k = 0; k < deg; k++) {
+      LANE(zr[k], lane) = BATCH_FROM_DOUBLE(start[k].real * bound);
+      LANE(zi[k], lane) = BATCH_FROM_DOUBLE(start[k].imag * bound);
+    }
+  }
+
+  // lanes that are still moving, a lane stops once all of its roots settle
+  mask_t active = one > zero;
+
+  for (int iteration = 0; iteration < BATCH_ITERATIONS; iteration++) {
+    mask_t moving = {};
+
+    // every root moves at once, from where all of them were, so that the
+    // roots are independent of each other and the CPU works on all of them
+    // at the same time
+    lanes_t next_r[POLY_MAX_DEG] = {}, next_i[POLY_MAX_DEG] = {};
+
+    for (int i = 0; i < deg; i++) {
+      // p(z_i), and about how much of it is rounding errors: p with the
+      // absolute values of everything in it, sizes taken as |re| + |im|
+      lanes_t vr = one, vi = zero, noise = one, size = lanes_abs(zr[i]) + lanes_abs(zi[i]);
+      for (int k = deg - 1; k >= 0; k--) {
+        lanes_t real = vr * zr[i] - vi * zi[i] + cr[k];
+        vi    = vr * zi[i] + vi * zr[i] + ci[k];
+        vr    = real;
+        noise = noise * size + lanes_abs(cr[k]) + lanes_abs(ci[k]);
+      }
+      // the root is as good as this precision gets it
+      mask_t noisy = lanes_abs(vr) + lanes_abs(vi) <= noise * rounding;
+
+      // prod_{j != i} (z_i - z_j)
+      lanes_t qr = one, qi = zero;
+      for (int j = 0; j < deg; j++) {
+        if (j == i)
+          continue;
+
+        lanes_t dr = zr[i] - zr[j], di = zi[i] - zi[j];
+        lanes_t real = qr * dr - qi * di;
+        qi = qr * di + qi * dr;
+        qr = real;
+      }
+
+      // two approximations collided, nudge them apart
+      lanes_t denom = qr * qr + qi * qi;
+      mask_t  apart = denom > zero;
+      qr    = apart ? qr : nudge;
+      qi    = apart ? qi : zero;
+      denom = apart ? denom : nudge * nudge;
+
+      lanes_t step_r = (vr * qr + vi * qi) / denom;
+      lanes_t step_i = (vi * qr - vr * qi) / denom;
+      next_r[i] = active ? zr[i] - step_r : zr[i];
+      next_i[i] = active ? zi[i] - step_i : zi[i];
+
+      // sizes as |re| + |im| again, squares of steps that small would be
+      // subnormal in single precision, and those are slow
+      lanes_t step = lanes_abs(step_r) + lanes_abs(step_i);
+      moving = moving || (!noisy && step > tolerance * (one + lanes_abs(zr[i]) + lanes_abs(zi[i])));
+    }
+
+    for (int i = 0; i < deg; i++) {
+      zr[i] = next_r[i];
+      zi[i] = next_i[i];
+    }
+
+    active = active && moving;
+
+    bool any = false;
+    for (int lane = 0; lane < BATCH_LANES; lane++)
+      any = any || LANE(active, lane);
+
+    if (!any)
+      break;
+  }
+
+  for (int lane = 0; lane < BATCH_LANES; lane++) {
+    for (int k = 0; k < deg; k++)
+      roots[lane][k] = { BATCH_TO_DOUBLE(LANE(zr[k], lane)), BATCH_TO_DOUBLE(LANE(zi[k], lane)) };
+  }
+}
+
+#if BATCH_VECTOR
+/* Horner's method on a vector of points at a time */
+void BATCH_NAME(eval_points) (const Polynomial *p, const BATCH_REAL *real, const BATCH_REAL *imag,
+                              BATCH_REAL *out_real, BATCH_REAL *out_imag, size_t count) {
+  const lanes_t zero = {};
+
+  int deg = polynomial_deg(*p);
+  if (deg < 0)
+    deg = 0;
+
+  lanes_t ar[POLY_COEFF_LEN] = {}, ai[POLY_COEFF_LEN] = {};
+  for (int k = 0; k <= deg; k++) {
+    ar[k] = zero + BATCH_FROM_DOUBLE(p->coeffs[k].real);
+    ai[k] = zero + BATCH_FROM_DOUBLE(p->coeffs[k].imag);
+  }
+
+  for (size_t i = 0; i < count; i += BATCH_LANES) {
+    // the last vector is padded with zeros
+    size_t  lanes = count - i < BATCH_LANES ? count - i : BATCH_LANES;
+    lanes_t zr = {}, zi = {};
+    memcpy(&zr, real + i, lanes * sizeof(BATCH_REAL));
+    memcpy(&zi, imag + i, lanes * sizeof(BATCH_REAL));
+
+    lanes_t vr = ar[deg], vi = ai[deg];
+    for (int k = deg - 1; k >= 0; k--) {
+      lanes_t re = vr * zr - vi * zi + ar[k];
+      vi = vr * zi + vi * zr + ai[k];
+      vr = re;
+    }
+
+    memcpy(out_real + i, &vr, lanes * sizeof(BATCH_REAL));
+    memcpy(out_imag + i, &vi, lanes * sizeof(BATCH_REAL));
+  }
+}
+#endif
+
+#undef lanes_t
+#undef mask_t
+#undef lanes_abs
+#undef LANE
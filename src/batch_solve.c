@@ -0,0 +1,600 @@
+/**
+ * @file
+ * @brief Solving many polynomials and evaluating at many points at once
+ */
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "batch_solve.h"
+#include "arith.h"
+#include "complex.h"
+#include "double_double.h"
+#include "polynomial.h"
+#include "trace.h"
+
+/// Most sweeps over the roots of a vector of polynomials
+#define BATCH_ITERATIONS 100
+/// What two approximations that collided are nudged apart by, like in
+/// #solve_polynomial_iterative
+#define BATCH_NUDGE      1e-12
+/// Most polynomials in a vector, the number of single precision lanes
+#define BATCH_MAX_LANES  4
+
+#define BATCH_REAL           float
+#define BATCH_VECTOR         1
+#define BATCH_MASK_INT       int32_t
+#define BATCH_LANES          4
+#define BATCH_EPSILON        FLT_EPSILON
+#define BATCH_FROM_DOUBLE(x) ((float) (x))
+#define BATCH_TO_DOUBLE(x)   (x)
+#define BATCH_NAME(name)     name##_single
+#include "batch_kernel.h"
+#undef BATCH_REAL
+#undef BATCH_VECTOR
+#undef BATCH_MASK_INT
+#undef BATCH_LANES
+#undef BATCH_EPSILON
+#undef BATCH_FROM_DOUBLE
+#undef BATCH_TO_DOUBLE
+#undef BATCH_NAME
+
+#define BATCH_REAL           double
+#define BATCH_VECTOR         1
+#define BATCH_MASK_INT       int64_t
+#define BATCH_LANES          2
+#define BATCH_EPSILON        DBL_EPSILON
+#define BATCH_FROM_DOUBLE(x) (x)
+#define BATCH_TO_DOUBLE(x)   (x)
+#define BATCH_NAME(name)     name##_double
+#include "batch_kernel.h"
+#undef BATCH_REAL
+#undef BATCH_VECTOR
+#undef BATCH_MASK_INT
+#undef BATCH_LANES
+#undef BATCH_EPSILON
+#undef BATCH_FROM_DOUBLE
+#undef BATCH_TO_DOUBLE
+#undef BATCH_NAME
+
+// a double-double is two doubles that depend on each other, so one of them
+// is a lane of its own
+#define BATCH_REAL           dd_t
+#define BATCH_VECTOR         0
+#define BATCH_LANES          1
+#define BATCH_EPSILON        DD_EPSILON
+#define BATCH_FROM_DOUBLE(x) dd_from(x)
+#define BATCH_TO_DOUBLE(x)   dd_to_double(x)
+#define BATCH_NAME(name)     name##_dd
+#include "batch_kernel.h"
+#undef BATCH_REAL
+#undef BATCH_VECTOR
+#undef BATCH_LANES
+#undef BATCH_EPSILON
+#undef BATCH_FROM_DOUBLE
+#undef BATCH_TO_DOUBLE
+#undef BATCH_NAME
+
+size_t lane_count        (unsigned int digits);
+void   solve_group       (const Polynomial *polys, const size_t *group, size_t size, int deg,
+                          unsigned int digits, Solutions *sols, RootErrors *errors);
+double monic_scaled      (const Polynomial *p, int deg, complex_t *monic);
+void   tidy_root         (bool real, bool extended, complex_t *root, double *radius);
+void   bound_roots       (const Polynomial *p, const Solutions *sols, bool extended,
+                          RootErrors *errors);
+void   widen_clusters    (const Solutions *sols, RootErrors *errors);
+void   find_clusters     (const Solutions *sols, const RootErrors *errors, int *cluster);
+bool   root_fails        (const Polynomial *p, int deg, const double *sizes, complex_t x);
+int    root_multiplicity (const Polynomial *p, int deg, complex_t x);
+double cluster_radius    (const Polynomial *p, int deg, complex_t center,
+                          const complex_t *fixed, int fixed_count);
+void   polish_roots      (const Polynomial *p, int deg, complex_t *roots, int first);
+
+void batch_solve (const Polynomial *polys, size_t count, unsigned int digits,
+                  Solutions *sols, RootErrors *errors) {
+  size_t lanes = lane_count(digits);
+
+  TRACE_BEGIN(batch);
+
+  // a vector of polynomials of every degree that the closed-form solvers
+  // don't do, each solved once it fills up
+  size_t groups[POLY_MAX_DEG + 1][BATCH_MAX_LANES] = {};
+  size_t sizes[POLY_MAX_DEG + 1] = {};
+
+  for (size_t i = 0; i < count; i++) {
+    errors[i] = {};
+
+    int deg = polynomial_deg(polys[i]);
+    if (deg <= 1) {
+      solve_polynomial(polys[i], &sols[i]);
+      estimate_root_errors(&polys[i], &sols[i], &errors[i]);
+      continue;
+    }
+
+    groups[deg][sizes[deg]++] = i;
+    if (sizes[deg] == lanes) {
+      solve_group(polys, groups[deg], sizes[deg], deg, digits, sols, errors);
+      sizes[deg] = 0;
+    }
+  }
+
+  // the lanes that are left over in the last vector solve its last polynomial again
+  for (int deg = 2; deg <= POLY_MAX_DEG; deg++) {
+    if (sizes[deg])
+      solve_group(polys, groups[deg], sizes[deg], deg, digits, sols, errors);
+  }
+
+  TRACE_END_ARG(batch, "batch_solve", "precision",
+                lanes == 4 ? "single" : lanes == 2 ? "double" : "double-double");
+}
+
+/* the polynomials in a vector of the precision that digits asks for */
+size_t lane_count (unsigned int digits) {
+  if (digits <= PRECISION_SINGLE)
+    return 4;
+  return digits <= PRECISION_DOUBLE ? 2 : 1;
+}
+
+/* solve the polynomials of degree deg at indices group, one vector of them */
+void solve_group (const Polynomial *polys, const size_t *group, size_t size, int deg,
+                  unsigned int digits, Solutions *sols, RootErrors *errors) {
+  complex_t monic[BATCH_MAX_LANES][POLY_COEFF_LEN] = {};
+  complex_t roots[BATCH_MAX_LANES][POLY_MAX_DEG]   = {};
+  double    scale[BATCH_MAX_LANES]                 = {};
+
+  size_t lanes = lane_count(digits);
+  for (size_t lane = 0; lane < lanes; lane++)
+    scale[lane] = monic_scaled(&polys[group[lane < size ? lane : size - 1]], deg, monic[lane]);
+
+  if (lanes == 4)
+    solve_lanes_single(monic, deg, roots);
+  else if (lanes == 2)
+    solve_lanes_double(monic, deg, roots);
+  else
+    solve_lanes_dd(monic, deg, roots);
+
+  for (size_t lane = 0; lane < size; lane++) {
+    const Polynomial *p = &polys[group[lane]];
+    Solutions        *s = &sols[group[lane]];
+
+    s->count = deg;
+    for (int k = 0; k < deg; k++)
+      s->x[k] = cmplx_mul(roots[lane][k], {scale[lane]});
+
+    RootErrors *e = &errors[group[lane]];
+    bound_roots(p, s, lanes == 1, e);
+
+    bool real = polynomial_is_real(p);
+    for (int k = 0; k < deg; k++)
+      tidy_root(real, lanes == 1, &s->x[k], &e->radius[k]);
+  }
+}
+
+/*
+ * Make p monic and scale its roots down by a power of two, so that they are
+ * around one whatever p is, which single precision can't do without. Returns
+ * the scale to multiply the roots by.
+ */
+double monic_scaled (const Polynomial *p, int deg, complex_t *monic) {
+  // every root is within twice the largest |c_k|^(1 / (deg - k)) of zero,
+  // which is below 2^ceil(e / (deg - k)) for |c_k| below 2^e
+  int exponent = INT_MIN;
+  for (int k = 0; k < deg; k++) {
+    monic[k] = cmplx_div(p->coeffs[k], p->coeffs[deg]);
+
+    double size = cmplx_mag(monic[k]);
+    if (!(size > 0))
+      continue;
+
+    int power = 0;
+    frexp(size, &power);
+
+    int root = power > 0 ? (power + deg - k - 1) / (deg - k) : -(-power / (deg - k));
+    if (root > exponent)
+      exponent = root;
+  }
+
+  if (exponent == INT_MIN)
+    exponent = 0;
+
+  for (int k = 0; k < deg; k++) {
+    monic[k].real = ldexp(monic[k].real, -exponent * (deg - k));
+    monic[k].imag = ldexp(monic[k].imag, -exponent * (deg - k));
+  }
+
+  return ldexp(1, exponent);
+}
+
+/*
+ * clean a root up like the closed-form solvers do, and widen its bound by how
+ * far it moved. Roots found in double-double are only rounded to zero where
+ * their bound has zero in it.
+ */
+void tidy_root (bool real, bool extended, complex_t *root, double *radius) {
+  complex_t tidy = extended ? *root : cmplx_normalize_zero(*root);
+  if (extended && cmplx_mag(*root) <= *radius)
+    tidy = {};
+
+  // the roots of a real polynomial that can't be told from real ones are real
+  if (real && fabs(root->imag) <= *radius)
+    tidy.imag = 0;
+
+  *radius += cmplx_mag(cmplx_sub(tidy, *root));
+  *root = tidy;
+}
+
+void estimate_root_errors (const Polynomial *p, const Solutions *sols, RootErrors *errors) {
+  bound_roots(p, sols, false, errors);
+}
+
+/*
+ * estimate_root_errors, with p(x) computed in double-double if extended, which
+ * keeps the rounding errors of computing it well below those of the roots
+ */
+void bound_roots (const Polynomial *p, const Solutions *sols, bool extended, RootErrors *errors) {
+  int deg = polynomial_deg(*p);
+
+  for (int i = 0; i < sols->count; i++) {
+    complex_t x = sols->x[i];
+
+    // p(x), and a bound of the rounding error of computing it
+    complex_t value    = {};
+    dd_t      value_r  = {}, value_i = {};
+    double    rounding = 0;
+    for (int k = deg; k >= 0; k--) {
+      if (extended) {
+        dd_t real = value_r * x.real - value_i * x.imag + p->coeffs[k].real;
+        value_i   = value_r * x.imag + value_i * x.real + p->coeffs[k].imag;
+        value_r   = real;
+      } else {
+        value = cmplx_fma(value, x, p->coeffs[k]);
+      }
+      rounding = rounding * cmplx_mag(x) + cmplx_mag(p->coeffs[k]);
+    }
+    rounding *= 2 * deg * (extended ? DD_EPSILON : DBL_EPSILON);
+
+    if (extended)
+      value = { dd_to_double(value_r), dd_to_double(value_i) };
+
+    // deg times the Durand-Kerner step of x is the radius of a circle that
+    // has a root in it, as long as the circles of the roots don't overlap
+    double distance = cmplx_mag(p->coeffs[deg]);
+    for (int j = 0; j < sols->count; j++) {
+      if (j != i)
+        distance *= cmplx_mag(cmplx_sub(x, sols->x[j]));
+    }
+
+    errors->radius[i] = distance > 0 ? deg * (cmplx_mag(value) + rounding) / distance : INFINITY;
+  }
+
+  widen_clusters(sols, errors);
+}
+
+/*
+ * Circles that overlap only have as many roots in all of them together as
+ * there are circles, so a root in a cluster of them is only known to be
+ * within the width of the whole cluster of one
+ */
+void widen_clusters (const Solutions *sols, RootErrors *errors) {
+  int cluster[POLY_MAX_DEG] = {};
+  find_clusters(sols, errors, cluster);
+
+  double width[POLY_MAX_DEG] = {};
+  int    size[POLY_MAX_DEG]  = {};
+  for (int i = 0; i < sols->count; i++) {
+    width[cluster[i]] += 2 * errors->radius[i];
+    size[cluster[i]]++;
+  }
+
+  for (int i = 0; i < sols->count; i++) {
+    if (size[cluster[i]] > 1)
+      errors->radius[i] = width[cluster[i]];
+  }
+}
+
+/* label the roots so that the ones whose circles overlap, one through another, have the same label */
+void find_clusters (const Solutions *sols, const RootErrors *errors, int *cluster) {
+  for (int i = 0; i < sols->count; i++)
+    cluster[i] = i;
+
+  bool merged = true;
+  while (merged) {
+    merged = false;
+
+    for (int i = 0; i < sols->count; i++) {
+      for (int j = i + 1; j < sols->count; j++) {
+        double gap = cmplx_mag(cmplx_sub(sols->x[i], sols->x[j]));
+        if (cluster[i] == cluster[j] || gap > errors->radius[i] + errors->radius[j])
+          continue;
+
+        // the cluster of j joins that of i
+        int from = cluster[j];
+        for (int k = 0; k < sols->count; k++) {
+          if (cluster[k] == from)
+            cluster[k] = cluster[i];
+        }
+        merged = true;
+      }
+    }
+  }
+}
+
+int escalate_roots (const Polynomial *p, int deg, Solutions *sols) {
+  if (deg < 2 || sols->count <= 0)
+    return 0;
+
+  double sizes[POLY_COEFF_LEN] = {};
+  for (int k = 0; k <= deg; k++)
+    sizes[k] = fabs(p->coeffs[k].real) + fabs(p->coeffs[k].imag);
+
+  // the roots that are good enough go first and stay where they are, the
+  // rest are found again after them
+  Solutions found    = {};
+  bool      failed[POLY_MAX_DEG] = {};
+  int       failures = 0;
+  complex_t center   = {};
+
+  for (int i = 0; i < sols->count; i++) {
+    complex_t x = sols->x[i];
+    if (!root_fails(p, deg, sizes, x)) {
+      found.x[found.count++] = x;
+      continue;
+    }
+
+    failed[i] = true;
+    failures++;
+    center = cmplx_add(center, x);
+  }
+
+  if (!failures)
+    return 0;
+
+  // the multiple roots that the closed-form solvers found exactly, as far as
+  // double-double can tell, are as good as they get, as long as they make up
+  // all of the roots that are left
+  int  accounted = found.count;
+  bool exact     = true;
+  for (int i = 0; i < sols->count && exact; i++) {
+    if (!failed[i])
+      continue;
+
+    int multiplicity = root_multiplicity(p, deg, sols->x[i]);
+    exact      = multiplicity > 1;
+    accounted += multiplicity;
+  }
+
+  if (exact && accounted == deg)
+    return 0;
+
+  TRACE_BEGIN(escalate);
+
+  // the failing roots, and any that the closed-form solvers merged with
+  // them, start on a circle around them that has all of them in it
+  int fixed = found.count;
+  center = cmplx_div(center, {(double) failures});
+
+  double radius = cluster_radius(p, deg, center, found.x, fixed);
+  for (int i = 0; i < sols->count; i++) {
+    if (failed[i])
+      radius = fmax(radius, cmplx_mag(cmplx_sub(sols->x[i], center)));
+  }
+
+  complex_t seed = { 0.4 / 1.3, 0.9 / 1.3 }, turn = { radius };
+  seed = cmplx_div(seed, {cmplx_mag(seed)});
+  for (int k = fixed; k < deg; k++) {
+    found.x[k] = cmplx_add(center, turn);
+    turn = cmplx_mul(turn, seed);
+  }
+  found.count = deg;
+
+  polish_roots(p, deg, found.x, fixed);
+
+  // the roots that double-double can't tell apart either are one root, the
+  // way the closed-form solvers report a multiple root
+  RootErrors errors = {};
+  int        cluster[POLY_MAX_DEG] = {};
+  bound_roots(p, &found, true, &errors);
+  find_clusters(&found, &errors, cluster);
+
+  bool      real = polynomial_is_real(p);
+  complex_t merged[POLY_MAX_DEG] = {};
+  int       merged_count = 0;
+  for (int k = fixed; k < deg; k++) {
+    bool seen = false;
+    for (int j = fixed; j < k; j++)
+      seen = seen || cluster[j] == cluster[k];
+    if (seen)
+      continue;
+
+    complex_t sum  = {};
+    int       size = 0;
+    for (int j = k; j < deg; j++) {
+      if (cluster[j] == cluster[k]) {
+        sum = cmplx_add(sum, found.x[j]);
+        size++;
+      }
+    }
+
+    complex_t root = cmplx_div(sum, {(double) size});
+    tidy_root(real, true, &root, &errors.radius[k]);
+    merged[merged_count++] = root;
+  }
+
+  // the new roots take the place of the first one that failed
+  Solutions result = {};
+  bool      placed = false;
+  for (int i = 0; i < sols->count; i++) {
+    if (!failed[i]) {
+      result.x[result.count++] = sols->x[i];
+    } else if (!placed) {
+      for (int k = 0; k < merged_count; k++)
+        result.x[result.count++] = merged[k];
+      placed = true;
+    }
+  }
+  *sols = result;
+
+  TRACE_END(escalate, "escalate_roots");
+  return failures;
+}
+
+/*
+ * Whether a root x that was found in double may be further off than
+ * ESCALATE_TOLERANCE. Its first-order error is the bound of |p(x)| that
+ * estimate_root_errors uses over |p'(x)|: the condition number of x,
+ * sum |a_k x^k| / |x p'(x)|, times how far p is from one that x is an exact
+ * root of, |p(x)| / sum |a_k x^k|, times |x|. sizes are |a_k|, and all sizes
+ * are taken as |re| + |im|, which keeps square roots and divisions out of it.
+ */
+bool root_fails (const Polynomial *p, int deg, const double *sizes, complex_t x) {
+  complex_t value = {}, slope = {};
+  double    size = 0, x_size = fabs(x.real) + fabs(x.imag);
+  for (int k = deg; k >= 0; k--) {
+    slope = cmplx_fma(slope, x, value);
+    value = cmplx_fma(value, x, p->coeffs[k]);
+    size  = size * x_size + sizes[k];
+  }
+
+  double residual   = fabs(value.real) + fabs(value.imag) + 2 * deg * DBL_EPSILON * size;
+  double derivative = fabs(slope.real) + fabs(slope.imag);
+  return !(residual <= ESCALATE_TOLERANCE * (x_size > 1 ? x_size : 1) * derivative);
+}
+
+/*
+ * How many times x is a root of p, as far as double-double can tell: the
+ * number of the Taylor coefficients of p at x, from the lowest one up, that
+ * are no larger than their rounding errors
+ */
+int root_multiplicity (const Polynomial *p, int deg, complex_t x) {
+  dd_t   tr[POLY_COEFF_LEN] = {}, ti[POLY_COEFF_LEN] = {};
+  double size[POLY_COEFF_LEN] = {};
+  double x_size = fabs(x.real) + fabs(x.imag);
+  bool   real   = !(fabs(x.imag) > 0) && polynomial_is_real(p);
+  for (int k = 0; k <= deg; k++) {
+    tr[k]   = dd_from(p->coeffs[k].real);
+    ti[k]   = dd_from(p->coeffs[k].imag);
+    size[k] = fabs(p->coeffs[k].real) + fabs(p->coeffs[k].imag);
+  }
+
+  // Horner's method leaves p(x) in t[0] and p / (z - x) above it, so doing
+  // it again on what is above leaves the next coefficient, and so on. The
+  // multiple roots of real polynomials are real, and need a quarter of it
+  for (int j = 0; j < deg; j++) {
+    for (int k = deg - 1; k >= j; k--) {
+      if (real) {
+        tr[k] = tr[k + 1] * x.real + tr[k];
+      } else {
+        dd_t next = tr[k + 1] * x.real - ti[k + 1] * x.imag + tr[k];
+        ti[k] = tr[k + 1] * x.imag + ti[k + 1] * x.real + ti[k];
+        tr[k] = next;
+      }
+      size[k] = size[k + 1] * x_size + size[k];
+    }
+
+    if (fabs(tr[j].hi) + fabs(ti[j].hi) > 4 * deg * DD_EPSILON * size[j])
+      return j;
+  }
+
+  return deg;
+}
+
+/*
+ * How far from center the roots of p other than the fixed ones are: p(c) is
+ * a_n times the distances to every root, so the product of the distances to
+ * the ones that aren't fixed is the bound of |p(c)| over the rest
+ */
+double cluster_radius (const Polynomial *p, int deg, complex_t center,
+                       const complex_t *fixed, int fixed_count) {
+  complex_t value = {};
+  double    size  = 0;
+  for (int k = deg; k >= 0; k--) {
+    value = cmplx_fma(value, center, p->coeffs[k]);
+    size  = size * cmplx_mag(center) + cmplx_mag(p->coeffs[k]);
+  }
+
+  double rest = cmplx_mag(p->coeffs[deg]);
+  for (int j = 0; j < fixed_count; j++)
+    rest *= cmplx_mag(cmplx_sub(center, fixed[j]));
+
+  double residual = cmplx_mag(value) + 2 * deg * DBL_EPSILON * size;
+  double radius   = rest > 0 ? pow(residual / rest, 1.0 / (deg - fixed_count)) : 0;
+  return fmax(radius, DBL_EPSILON * (1 + cmplx_mag(center)));
+}
+
+/*
+ * The Durand-Kerner iteration of the kernels in double-double, that only
+ * moves the roots from first on, and takes the ones before them as exact
+ */
+void polish_roots (const Polynomial *p, int deg, complex_t *roots, int first) {
+  dd_t zr[POLY_MAX_DEG] = {}, zi[POLY_MAX_DEG] = {};
+  for (int k = 0; k < deg; k++) {
+    zr[k] = dd_from(roots[k].real);
+    zi[k] = dd_from(roots[k].imag);
+  }
+
+  for (int iteration = 0; iteration < BATCH_ITERATIONS; iteration++) {
+    bool moving = false;
+
+    for (int i = first; i < deg; i++) {
+      // p(z_i), and the size of its rounding errors
+      dd_t   vr = {}, vi = {};
+      double noise = 0, size = fabs(zr[i].hi) + fabs(zi[i].hi);
+      for (int k = deg; k >= 0; k--) {
+        dd_t real = vr * zr[i] - vi * zi[i] + p->coeffs[k].real;
+        vi    = vr * zi[i] + vi * zr[i] + p->coeffs[k].imag;
+        vr    = real;
+        noise = noise * size + fabs(p->coeffs[k].real) + fabs(p->coeffs[k].imag);
+      }
+
+      // the root is as good as double-double gets it
+      if (fabs(vr.hi) + fabs(vi.hi) <= 2 * deg * DD_EPSILON * noise)
+        continue;
+
+      // a_n prod_{j != i} (z_i - z_j)
+      dd_t qr = dd_from(p->coeffs[deg].real), qi = dd_from(p->coeffs[deg].imag);
+      for (int j = 0; j < deg; j++) {
+        if (j == i)
+          continue;
+
+        dd_t dr = zr[i] - zr[j], di = zi[i] - zi[j];
+        dd_t real = qr * dr - qi * di;
+        qi = qr * di + qi * dr;
+        qr = real;
+      }
+
+      // two approximations collided, nudge them apart
+      dd_t denom = qr * qr + qi * qi;
+      if (!(denom > 0)) {
+        qr    = dd_from(BATCH_NUDGE);
+        qi    = dd_from(0);
+        denom = qr * qr;
+      }
+
+      dd_t step_r = (vr * qr + vi * qi) / denom;
+      dd_t step_i = (vi * qr - vr * qi) / denom;
+      zr[i] = zr[i] - step_r;
+      zi[i] = zi[i] - step_i;
+
+      if (dd_abs(step_r) + dd_abs(step_i) > 4 * DD_EPSILON * (1 + dd_abs(zr[i]) + dd_abs(zi[i])))
+        moving = true;
+    }
+
+    if (!moving)
+      break;
+  }
+
+  for (int k = first; k < deg; k++)
+    roots[k] = { dd_to_double(zr[k]), dd_to_double(zi[k]) };
+}
+
+void batch_eval (const Polynomial *p, complex_array_t points, complex_array_t values, size_t count) {
+  eval_points_double(p, points.real, points.imag, values.real, values.imag, count);
+}
+
+void batch_eval_single (const Polynomial *p, complex_array_single_t points,
+                        complex_array_single_t values, size_t count) {
+  eval_points_single(p, points.real, points.imag, values.real, values.imag, count);
+}
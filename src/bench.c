@@ -0,0 +1,322 @@
+/**
+ * @file
+ * @brief Microbenchmark runner for the testing library
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "arg_parse.h"
+#include "timer.h"
+#include "log.h"
+
+/// Default number of samples collected per benchmark
+#define FL_DEFAULT_SAMPLES     100
+/// Default target duration of a single sample, in microseconds
+#define FL_DEFAULT_SAMPLE_US   1000
+/// How long a benchmark is run before measuring, in nanoseconds
+#define FL_WARMUP_NS           50000000.0
+/// Default median slowdown in percent that #fl_compare_bench_baseline reports
+#define FL_DEFAULT_THRESHOLD   5.0
+
+_FL_Bench *_fl_bench_data = {};
+size_t     _fl_bench_count = 0;
+size_t     _fl_bench_capacity = 0;
+
+/// Counters of #fl_set_bench_counters, and whether they were turned on
+const FL_BenchCounters *_fl_bench_counters = NULL;
+bool                    _fl_counting       = false;
+
+void fl_set_bench_counters (const FL_BenchCounters *counters) {
+  _fl_bench_counters = counters;
+}
+
+int    compare_doubles     (const void *a, const void *b);
+double sorted_percentile   (const double *sorted, size_t len, double percentile);
+void   compute_bench_stats (_FL_BenchResult *res);
+size_t calibrate_iterations (_FL_Bench *bench, double sample_ns);
+
+void   print_bench_result  (const _FL_Bench *bench);
+void   write_bench_json    (FILE *out);
+
+int _fl_add_bench (const char bench_name[], void (*bench)()) {
+  if (_fl_bench_count == _fl_bench_capacity) {
+    _fl_bench_capacity += 1024;
+    _fl_bench_data = (_FL_Bench *)realloc(_fl_bench_data, _fl_bench_capacity * sizeof(_FL_Bench));
+  }
+  _fl_bench_count++;
+  _fl_bench_data[_fl_bench_count - 1] = (_FL_Bench) {
+    .name = bench_name,
+    .func = bench,
+    .res = {},
+  };
+  return 0;
+}
+
+// ------- RUNNERS -------
+
+/*
+ * Warm the benchmark up for FL_WARMUP_NS and use the observed speed to pick
+ * how many iterations fit into one sample.
+ */
+size_t calibrate_iterations (_FL_Bench *bench, double sample_ns) {
+  size_t   batch = 1;
+  size_t   total = 0;
+  uint64_t start = fl_ticks();
+  double   elapsed = 0;
+
+  while (elapsed < FL_WARMUP_NS) {
+    for (size_t i = 0; i < batch; i++)
+      bench->func();
+
+    total  += batch;
+    batch  *= 2;
+    elapsed = fl_ticks_to_ns(fl_ticks() - start);
+  }
+
+  double per_iteration = elapsed / (double) total;
+  size_t iterations    = (size_t) (sample_ns / per_iteration);
+  return iterations ? iterations : 1;
+}
+
+void fl_bench_runner (_FL_Bench *bench, size_t sample_count, double sample_ns) {
+  _FL_BenchResult *res = &bench->res;
+
+  fl_logs_off();
+
+  res->iterations   = calibrate_iterations(bench, sample_ns);
+  res->sample_count = sample_count;
+  res->samples      = (double *) realloc(res->samples, sample_count * sizeof(double));
+
+  uint64_t counters_start[FL_MAX_BENCH_COUNTERS] = {};
+  if (_fl_counting)
+    _fl_bench_counters->read(counters_start);
+
+  for (size_t sample = 0; sample < sample_count; sample++) {
+    uint64_t start = fl_ticks();
+    for (size_t i = 0; i < res->iterations; i++)
+      bench->func();
+    uint64_t end = fl_ticks();
+
+    res->samples[sample] = fl_ticks_to_ns(end - start) / (double) res->iterations;
+  }
+
+  // counters cover all the samples, including the bits of runner in between
+  uint64_t counters_end[FL_MAX_BENCH_COUNTERS] = {};
+  if (_fl_counting)
+    _fl_bench_counters->read(counters_end);
+
+  double total_iterations = (double) (res->iterations * sample_count);
+
+  res->has_counters = _fl_counting;
+  for (size_t i = 0; _fl_counting && i < _fl_bench_counters->count; i++)
+    res->counters[i] = (double) (counters_end[i] - counters_start[i]) / total_iterations;
+
+  fl_logs_on();
+
+  compute_bench_stats(res);
+}
+
+[[noreturn]] void fl_run_benches (int argc, const char *argv[]) {
+  const ArgSpecItem bench_args[] = {
+    { .long_flag = "filter", .arg_type = FLAG, .short_flag = 'f',
+      .help = "Only run benchmarks whose name contains this string",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "samples", .arg_type = FLAG, .short_flag = 's',
+      .help = "Number of samples per benchmark. Default: 100",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "sample-time", .arg_type = FLAG, .short_flag = 't',
+      .help = "Target duration of one sample in microseconds. Default: 1000",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "json", .arg_type = FLAG, .short_flag = 'j',
+      .help = "Also write the results as JSON to this file",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "save-baseline", .arg_type = FLAG,
+      .help = "Save the samples to this file to compare against later",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "baseline", .arg_type = FLAG, .short_flag = 'b',
+      .help = "Compare against a saved baseline and fail on regressions",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "threshold", .arg_type = FLAG,
+      .help = "Median slowdown in percent that counts as a regression. Default: 5",
+      .value = REQUIRED_VALUE },
+    { .long_flag = "perf", .arg_type = FLAG, .short_flag = 'p',
+      .help = "Also report the counters the program plugged in, like hardware ones, per iteration",
+      .value = NO_VALUE },
+  };
+  const ArgSpec bench_spec = {
+    .len = sizeof(bench_args) / sizeof(bench_args[0]),
+    .data = bench_args,
+    .synopsis = "Run the registered microbenchmarks",
+  };
+
+  ParsedArg parsed[256] = {};
+  size_t    parsed_len = 0;
+  if (parse_args(argc, argv, bench_spec, parsed, &parsed_len) != PARSE_OK)
+    exit(-1);
+
+  const char *filter    = NULL;
+  const char *json_path = NULL;
+  const char *save_path = NULL;
+  const char *base_path = NULL;
+  double      threshold = FL_DEFAULT_THRESHOLD;
+  size_t      samples   = FL_DEFAULT_SAMPLES;
+  double      sample_us = FL_DEFAULT_SAMPLE_US;
+
+  for (size_t i = 0; i < parsed_len; i++) {
+    const char *flag  = parsed[i].long_flag;
+    const char *value = parsed[i].value.str_val;
+
+    if (!strcmp(flag, "filter"))
+      filter = value;
+    else if (!strcmp(flag, "samples"))
+      samples = strtoul(value, NULL, 10);
+    else if (!strcmp(flag, "sample-time"))
+      sample_us = strtod(value, NULL);
+    else if (!strcmp(flag, "json"))
+      json_path = value;
+    else if (!strcmp(flag, "save-baseline"))
+      save_path = value;
+    else if (!strcmp(flag, "baseline"))
+      base_path = value;
+    else if (!strcmp(flag, "threshold"))
+      threshold = strtod(value, NULL);
+    else if (!strcmp(flag, "perf"))
+      _fl_counting = _fl_bench_counters && _fl_bench_counters->enable();
+  }
+
+  if (!samples || sample_us <= 0) {
+    LOG_ERROR("Sample count and sample time have to be positive!");
+    exit(-1);
+  }
+
+  printf("Running benchmarks...\n");
+  printf("%-36s %12s %12s %12s %12s", "name", "iterations", "median ns", "p99 ns", "stddev ns");
+  for (size_t i = 0; _fl_counting && i < _fl_bench_counters->count; i++)
+    printf(" %14s", _fl_bench_counters->names[i]);
+  putchar('\n');
+
+  for (size_t i = 0; i < _fl_bench_count; i++) {
+    _FL_Bench *bench = &_fl_bench_data[i];
+    if (filter && !strstr(bench->name, filter))
+      continue;
+
+    fl_bench_runner(bench, samples, sample_us * 1000);
+    print_bench_result(bench);
+  }
+
+  if (json_path) {
+    FILE *out = fopen(json_path, "w");
+    if (!out) {
+      LOG_ERROR("Could not open `%s` for writing!", json_path);
+      exit(-1);
+    }
+
+    write_bench_json(out);
+    fclose(out);
+  }
+
+  if (save_path && !fl_save_bench_baseline(save_path))
+    exit(-1);
+
+  int regressions = 0;
+  if (base_path) {
+    regressions = fl_compare_bench_baseline(base_path, threshold);
+    if (regressions < 0)
+      exit(-1);
+  }
+
+  if (_fl_counting)
+    _fl_bench_counters->disable();
+
+  // the count is logged by the comparison, an exit code would wrap at 256
+  exit(regressions ? 1 : 0);
+}
+
+// ------- STATISTICS -------
+
+int compare_doubles (const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of an ascending array, percentile is in [0; 100] */
+double sorted_percentile (const double *sorted, size_t len, double percentile) {
+  size_t rank = (size_t) ceil(percentile / 100.0 * (double) len);
+  if (rank == 0)
+    rank = 1;
+  return sorted[rank - 1];
+}
+
+void compute_bench_stats (_FL_BenchResult *res) {
+  size_t len = res->sample_count;
+  qsort(res->samples, len, sizeof(double), compare_doubles);
+
+  double sum = 0;
+  for (size_t i = 0; i < len; i++)
+    sum += res->samples[i];
+  res->mean = sum / (double) len;
+
+  double squares = 0;
+  for (size_t i = 0; i < len; i++)
+    squares += (res->samples[i] - res->mean) * (res->samples[i] - res->mean);
+  res->stddev = len > 1 ? sqrt(squares / (double) (len - 1)) : 0;
+
+  res->median = sorted_percentile(res->samples, len, 50);
+  res->p99    = sorted_percentile(res->samples, len, 99);
+  res->min    = res->samples[0];
+  res->max    = res->samples[len - 1];
+}
+
+// ------- OUTPUT -------
+
+void print_bench_result (const _FL_Bench *bench) {
+  const _FL_BenchResult *res = &bench->res;
+  printf("%-36s %12zu %12.2lf %12.2lf %12.2lf",
+         bench->name, res->iterations, res->median, res->p99, res->stddev);
+
+  for (size_t i = 0; res->has_counters && i < _fl_bench_counters->count; i++) {
+    if (_fl_bench_counters->has(i))
+      printf(" %14.1lf", res->counters[i]);
+    else
+      printf(" %14s", "-");
+  }
+  putchar('\n');
+}
+
+void write_bench_json (FILE *out) {
+  fprintf(out, "{\n  \"benchmarks\": [");
+
+  bool first = true;
+  for (size_t i = 0; i < _fl_bench_count; i++) {
+    const _FL_Bench       *bench = &_fl_bench_data[i];
+    const _FL_BenchResult *res   = &bench->res;
+    if (!res->sample_count)
+      continue;
+
+    fprintf(out, "%s\n    {\n", first ? "" : ",");
+    fprintf(out, "      \"name\": \"%s\",\n",       bench->name);
+    fprintf(out, "      \"iterations\": %zu,\n",    res->iterations);
+    fprintf(out, "      \"samples\": %zu,\n",       res->sample_count);
+    fprintf(out, "      \"median_ns\": %.3lf,\n",   res->median);
+    fprintf(out, "      \"p99_ns\": %.3lf,\n",      res->p99);
+    fprintf(out, "      \"mean_ns\": %.3lf,\n",     res->mean);
+    fprintf(out, "      \"stddev_ns\": %.3lf,\n",   res->stddev);
+    fprintf(out, "      \"min_ns\": %.3lf,\n",      res->min);
+    fprintf(out, "      \"max_ns\": %.3lf",         res->max);
+
+    for (size_t j = 0; res->has_counters && j < _fl_bench_counters->count; j++) {
+      if (_fl_bench_counters->has(j))
+        fprintf(out, ",\n      \"%s\": %.3lf", _fl_bench_counters->names[j], res->counters[j]);
+    }
+
+    fprintf(out, "\n");
+    fprintf(out, "    }");
+    first = false;
+  }
+
+  fprintf(out, "\n  ]\n}\n");
+}
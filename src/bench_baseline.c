@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief Saving benchmark baselines and detecting regressions against them
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "log.h"
+
+/// Maximum length of a benchmark name in a baseline file
+#define FL_MAX_BENCH_NAME 256
+
+/// Samples of a single benchmark, loaded from a baseline file
+typedef struct {
+  char    name[FL_MAX_BENCH_NAME];
+  size_t  sample_count;
+  double *samples;
+} _FL_BaselineEntry;
+
+const _FL_Bench *find_bench_by_name (const char *name);
+int    read_baseline_entry (FILE *in, _FL_BaselineEntry *entry);
+double mann_whitney_p      (const double *baseline, size_t n_base,
+                            const double *current,  size_t n_curr);
+
+/*
+ * The format is a line per benchmark: `<name> <sample count> <samples>...`
+ */
+int fl_save_bench_baseline (const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    LOG_ERROR("Could not open baseline `%s` for writing!", path);
+    return 0;
+  }
+
+  for (size_t i = 0; i < _fl_bench_count; i++) {
+    const _FL_Bench *bench = &_fl_bench_data[i];
+    if (!bench->res.sample_count)
+      continue;
+
+    fprintf(out, "%s %zu", bench->name, bench->res.sample_count);
+    for (size_t j = 0; j < bench->res.sample_count; j++)
+      fprintf(out, " %.17lg", bench->res.samples[j]);
+    fputc('\n', out);
+  }
+
+  fclose(out);
+  printf("Saved baseline to %s\n", path);
+  return 1;
+}
+
+int fl_compare_bench_baseline (const char *path, double threshold) {
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    LOG_ERROR("Could not open baseline `%s`! Save one with --save-baseline first", path);
+    return -1;
+  }
+
+  printf("\nComparing against %s (threshold %lg%%, alpha %lg)...\n",
+         path, threshold, FL_BENCH_ALPHA);
+  printf("%-36s %12s %12s %9s %10s\n", "name", "base ns", "current ns", "change", "p-value");
+
+  int regressions = 0;
+  _FL_BaselineEntry entry = {};
+
+  while (read_baseline_entry(in, &entry)) {
+    const _FL_Bench *bench = find_bench_by_name(entry.name);
+    if (!bench || !bench->res.sample_count)
+      continue;
+
+    // baseline samples are saved sorted, so the median is just the middle one
+    double base_median = entry.samples[(entry.sample_count - 1) / 2];
+    double curr_median = bench->res.median;
+    double change      = (curr_median - base_median) / base_median * 100;
+
+    double p = mann_whitney_p(entry.samples, entry.sample_count,
+                              bench->res.samples, bench->res.sample_count);
+
+    bool regressed = p < FL_BENCH_ALPHA && change > threshold;
+    if (regressed)
+      regressions++;
+
+    printf("%-36s %12.2lf %12.2lf %+8.1lf%% %10.2lg %s\n", entry.name,
+           base_median, curr_median, change, p, regressed ? "REGRESSION" : "");
+  }
+
+  free(entry.samples);
+  fclose(in);
+
+  if (regressions)
+    LOG_ERROR("%d benchmark(s) regressed!", regressions);
+  else
+    LOG_INFO("No regressions");
+
+  return regressions;
+}
+
+const _FL_Bench *find_bench_by_name (const char *name) {
+  for (size_t i = 0; i < _fl_bench_count; i++) {
+    if (!strcmp(_fl_bench_data[i].name, name))
+      return &_fl_bench_data[i];
+  }
+
+  return NULL;
+}
+
+/* read one line of a baseline file into entry, reusing its samples buffer */
+int read_baseline_entry (FILE *in, _FL_BaselineEntry *entry) {
+  if (fscanf(in, "%255s %zu", entry->name, &entry->sample_count) != 2 || !entry->sample_count)
+    return 0;
+
+  entry->samples = (double *) realloc(entry->samples, entry->sample_count * sizeof(double));
+  for (size_t i = 0; i < entry->sample_count; i++) {
+    if (fscanf(in, "%lg", &entry->samples[i]) != 1) {
+      LOG_ERROR("Baseline entry `%s` is truncated!", entry->name);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+ * One-sided Mann-Whitney U test with the normal approximation and tie
+ * correction. Both arrays must be sorted ascending. Returns the p-value of
+ * the hypothesis that `current` is stochastically larger (slower) than `baseline`.
+ */
+double mann_whitney_p (const double *baseline, size_t n_base,
+                       const double *current,  size_t n_curr) {
+  size_t i = 0, j = 0;
+  double rank_sum_curr = 0;
+  double tie_term      = 0;
+  size_t rank          = 1;
+
+  // walk both sorted arrays like a merge, assigning average ranks to ties.
+  // `value` is the smallest unranked sample, so `<=` here means `==`
+  while (i < n_base || j < n_curr) {
+    double value = (j >= n_curr || (i < n_base && baseline[i] <= current[j])) ?
+                   baseline[i] : current[j];
+
+    size_t ties_base = 0, ties_curr = 0;
+    while (i < n_base && baseline[i] <= value) { i++; ties_base++; }
+    while (j < n_curr && current[j]  <= value) { j++; ties_curr++; }
+
+    double ties = (double) (ties_base + ties_curr);
+    double average_rank = (double) rank + (ties - 1) / 2;
+
+    rank_sum_curr += average_rank * (double) ties_curr;
+    tie_term      += ties * ties * ties - ties;
+    rank          += ties_base + ties_curr;
+  }
+
+  double n1 = (double) n_curr, n2 = (double) n_base, n = n1 + n2;
+  double u  = rank_sum_curr - n1 * (n1 + 1) / 2;
+
+  double mean     = n1 * n2 / 2;
+  double variance = n1 * n2 / 12 * ((n + 1) - tie_term / (n * (n - 1)));
+  if (variance <= 0)
+    return 1;
+
+  // continuity correction, then the upper tail of the standard normal
+  double z = (u - mean - 0.5) / sqrt(variance);
+  return 0.5 * erfc(z / sqrt(2.0));
+}
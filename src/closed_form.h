@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief The closed-form solvers of real polynomials in arith.c, for one precision
+ *
+ * Included by arith.c once per precision, with these defined:
+ *  - CF_REAL, the type of a number, double or #dd_t
+ *  - CF_NAME(name), name with a suffix of the precision
+ *  - CF_FROM_DOUBLE(x) and CF_TO_DOUBLE(x), conversions to and from a CF_REAL
+ *  - CF_SQRT, CF_CBRT, CF_ABS, CF_COPYSIGN and CF_SIGNBIT, the math.h
+ *    functions of a CF_REAL
+ *  - CF_REL_EPSILON, the relative tolerance for the special cases of the cubic
+ *  - CF_TIDY(x), what is done to a root of a quadratic before it is stored
+ *  - CF_STORE_PAIR(x1, x2, sols), how the roots of a quadratic are stored
+ *
+ * The coefficients are converted to a CF_REAL, all of the arithmetic is done
+ * in it, and the roots are rounded to doubles at the end.
+ */
+
+int     CF_NAME(solve_real_degree_2)        (Polynomial p, Solutions *sols);
+int     CF_NAME(solve_real_degree_3)        (Polynomial p, Solutions *sols);
+int     CF_NAME(solve_real_depressed_cubic) (Polynomial poly, CF_REAL p, CF_REAL q, Solutions *sols);
+void    CF_NAME(real_quadratic_roots)       (CF_REAL a, CF_REAL b, CF_REAL c, complex_t *x1, complex_t *x2);
+CF_REAL CF_NAME(real_unsubstitute)          (Polynomial poly, CF_REAL y);
+
+int CF_NAME(solve_real_degree_2) (Polynomial p, Solutions *sols) {
+  complex_t x1 = {}, x2 = {};
+  CF_NAME(real_quadratic_roots)(CF_FROM_DOUBLE(p.c.real), CF_FROM_DOUBLE(p.d.real),
+                                CF_FROM_DOUBLE(p.e.real), &x1, &x2);
+  return CF_STORE_PAIR(CF_TIDY(x1), CF_TIDY(x2), sols);
+}
+
+/* roots of ax^2 + bx + c with a != 0, in the order (-b - sqrt(disc)) / 2a, (-b + sqrt(disc)) / 2a */
+void CF_NAME(real_quadratic_roots) (CF_REAL a, CF_REAL b, CF_REAL c, complex_t *x1, complex_t *x2) {
+  CF_REAL disc = b * b - 4 * a * c;
+
+  if (disc < 0) {
+    // a conjugate pair, the only place that needs the imaginary part
+    CF_REAL real = -b / (2 * a);
+    CF_REAL imag = CF_SQRT(-disc) / (2 * a);
+    *x1 = { CF_TO_DOUBLE(real), -CF_TO_DOUBLE(imag) };
+    *x2 = { CF_TO_DOUBLE(real), CF_TO_DOUBLE(imag) };
+    return;
+  }
+
+  // -b and the root have the same sign here, so they don't cancel, and the
+  // other root comes from x1 * x2 = c / a
+  CF_REAL big = -0.5 * (b + CF_COPYSIGN(CF_SQRT(disc), b));
+  if (!(CF_ABS(big) > 0)) {
+    *x1 = *x2 = {};
+    return;
+  }
+
+  complex_t first = { CF_TO_DOUBLE(big / a) }, second = { CF_TO_DOUBLE(c / big) };
+  *x1 = CF_SIGNBIT(b) ? second : first;
+  *x2 = CF_SIGNBIT(b) ? first  : second;
+}
+
+int CF_NAME(solve_real_degree_3) (Polynomial poly, Solutions *sols) {
+  // ax^3 + bx^2 + cx + d = 0, the same depressed cubic as solve_degree_3
+  CF_REAL a = CF_FROM_DOUBLE(poly.b.real), b = CF_FROM_DOUBLE(poly.c.real);
+  CF_REAL c = CF_FROM_DOUBLE(poly.d.real), d = CF_FROM_DOUBLE(poly.e.real);
+
+  CF_REAL p = (3 * a * c - b * b) / (3 * a * a);
+  CF_REAL q = (2 * b * b * b - 9 * a * b * c + 27 * a * a * d) / (27 * a * a * a);
+
+  LOG_DEBUG("calculated real depressed cubic: p = %lg, q = %lg", CF_TO_DOUBLE(p), CF_TO_DOUBLE(q));
+
+  return CF_NAME(solve_real_depressed_cubic)(poly, p, q, sols);
+}
+
+/* solve_depressed_qubic for a real p and q, with the same cases */
+int CF_NAME(solve_real_depressed_cubic) (Polynomial poly, CF_REAL p, CF_REAL q, Solutions *sols) {
+  double scale = cubic_root_scale(poly);
+  bool   zero_p = CF_ABS(p) <= CF_REL_EPSILON * scale * scale;
+  bool   zero_q = CF_ABS(q) <= CF_REL_EPSILON * scale * scale * scale;
+
+  if (zero_p && zero_q) {
+    sols->count = 1;
+    sols->x1 = { CF_TO_DOUBLE(CF_NAME(real_unsubstitute)(poly, CF_FROM_DOUBLE(0))) };
+    return 1;
+  }
+
+  if (zero_p) {
+    // y^3 = -q: the real cube root, and it turned by the cube roots of unity,
+    // in the order cmplx_cbrt gives them
+    CF_REAL root  = CF_CBRT(-q);
+    CF_REAL shift = CF_NAME(real_unsubstitute)(poly, CF_FROM_DOUBLE(0));
+    CF_REAL turn  = root * CF_SQRT(CF_FROM_DOUBLE(3.0)) / 2;
+    complex_t real  = { CF_TO_DOUBLE(root + shift) };
+    complex_t upper = { CF_TO_DOUBLE(-root / 2 + shift),  CF_TO_DOUBLE(turn) };
+    complex_t lower = { CF_TO_DOUBLE(-root / 2 + shift), -CF_TO_DOUBLE(turn) };
+
+    sols->count = 3;
+    sols->x1 = root > 0 ? real  : upper;
+    sols->x2 = root > 0 ? upper : lower;
+    sols->x3 = root > 0 ? lower : real;
+    return 1;
+  }
+
+  CF_REAL half_q_squared = (q / 2) * (q / 2);
+  CF_REAL third_p_cubed  = (p / 3) * (p / 3) * (p / 3);
+
+  CF_REAL disc = half_q_squared + third_p_cubed;
+  LOG_DEBUG("real discriminant: %lg", CF_TO_DOUBLE(disc));
+
+  if (CF_ABS(disc) <= CF_REL_EPSILON * (CF_ABS(half_q_squared) + CF_ABS(third_p_cubed))) {
+    LOG_DEBUG("a simple and a double root!");
+
+    // y1 = 3q / p, y2 = y3 = -3q / 2p
+    CF_REAL y1 = 3 * q / p;
+
+    sols->count = 2;
+    sols->x1 = { CF_TO_DOUBLE(CF_NAME(real_unsubstitute)(poly, y1)) };
+    sols->x2 = { CF_TO_DOUBLE(CF_NAME(real_unsubstitute)(poly, -0.5 * y1)) };
+    return 1;
+  }
+
+  return 0;
+}
+
+CF_REAL CF_NAME(real_unsubstitute) (Polynomial poly, CF_REAL y) {
+  // y - b / (3 * a)
+  return y - CF_FROM_DOUBLE(poly.c.real) / (3 * CF_FROM_DOUBLE(poly.b.real));
+}
@@ -21,37 +21,19 @@ double cmplx_mag (const complex_t a) {
   return sqrt(a.imag * a.imag + a.real * a.real);
 }
 
-complex_t cmplx_add (const complex_t a, const complex_t b) {
-  return { a.real + b.real, a.imag + b.imag };
-}
-
-complex_t cmplx_sub (const complex_t a, const complex_t b) {
-  return { a.real - b.real, a.imag - b.imag };
-}
-
-complex_t cmplx_mul (const complex_t a, const complex_t b) {
- return {
-   a.real * b.real - a.imag * b.imag,
-   a.real * b.imag + a.imag * b.real,
- };
-}
-
-complex_t cmplx_div (const complex_t a, const complex_t b) {
-  double b_mag = cmplx_mag(b) * cmplx_mag(b);
-  assert(!is_zero(b_mag));
-
-  return {
-    (a.real * b.real + a.imag * b.imag) / b_mag,
-    (a.imag * b.real - a.real * b.imag) / b_mag
-  };
-}
-
 complex_t cmplx_pow (const complex_t a, const int b) {
   assert(b >= 0);
-  complex_t res = {1};
+  complex_t res    = {1};
+  complex_t square = a;
+
+  for (int power = b; power; power >>= 1) {
+    if (power & 1)
+      res = cmplx_mul(res, square);
+
+    if (power > 1)
+      square = cmplx_mul(square, square);
+  }
 
-  for (int i = 0; i < b; i++)
-    res = cmplx_mul(res, a);
   return res;
 }
 
@@ -64,7 +46,7 @@ complex_t cmplx_sqrt (const complex_t a) {
   } else {
     double mag   = cmplx_mag(a);
     double left  = sqrt((mag + a.real) / 2);
-    double right = sqrt((mag - a.imag) / 2);
+    double right = sqrt((mag - a.real) / 2);
     return {left, a.imag / fabs(a.imag) * right };
   }
 }
@@ -81,10 +63,6 @@ complex_t cmplx_cbrt (const complex_t a, int k) {
   return {length_cbrt * cos(angle), length_cbrt * sin(angle) };
 }
 
-complex_t cmplx_negate (const complex_t a) {
-  return { -a.real, -a.imag };
-}
-
 complex_t cmplx_normalize_zero (const complex_t a) {
   return {normalize_zero(a.real), normalize_zero(a.imag) };
 }
@@ -98,21 +76,25 @@ bool cmplx_is_zero (const complex_t a) {
 }
 
 void print_complex (const complex_t x) {
+  fprint_complex(stdout, x);
+}
+
+void fprint_complex (FILE *out, const complex_t x) {
   if (!is_zero(x.real) && !is_zero(x.imag)) {
-    printf("(%lg ", x.real);
+    fprintf(out, "(%lg ", x.real);
 
     if (x.imag > 0) {
-      putchar('+');
-      printf(" %lgi)", x.imag);
+      fputc('+', out);
+      fprintf(out, " %lgi)", x.imag);
     } else {
-      putchar('-');
-      printf(" %lgi)", fabs(x.imag));
+      fputc('-', out);
+      fprintf(out, " %lgi)", fabs(x.imag));
     }
   } else if (!is_zero(x.real))
-    printf("%lg", x.real);
+    fprintf(out, "%lg", x.real);
   else if (!is_zero(x.imag))
-    printf("%lgi", x.imag);
+    fprintf(out, "%lgi", x.imag);
   else
-    printf("0");
+    fprintf(out, "0");
 }
 
@@ -0,0 +1,193 @@
+/**
+ * @file
+ * @brief Arrays of complex numbers with the real and imaginary parts apart
+ *
+ * The kernels use SSE2, which every x86-64 CPU has, so they need no flags
+ * and no dispatch, two numbers at a time. Whatever doesn't fill a vector, and
+ * everything on other CPUs, goes through the scalar functions of complex.h.
+ */
+
+#include <math.h>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+#include "complex_array.h"
+#include "equation.h"
+#include "alloc.h"
+
+#if defined(__SSE2__)
+
+/// Numbers a kernel works on at once
+#define LANES 2
+
+typedef __m128d lanes_t;
+
+lanes_t lanes_select (lanes_t mask, lanes_t yes, lanes_t no);
+lanes_t lanes_abs    (lanes_t x);
+
+/* yes where mask is set, no elsewhere */
+lanes_t lanes_select (lanes_t mask, lanes_t yes, lanes_t no) {
+  return _mm_or_pd(_mm_and_pd(mask, yes), _mm_andnot_pd(mask, no));
+}
+
+/* |x|, by clearing the sign bit */
+lanes_t lanes_abs (lanes_t x) {
+  return _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+}
+
+#else
+
+#define LANES 1
+
+#endif
+
+complex_array_t complex_array_new (size_t count) {
+  double *block = (double *) counted_malloc(2 * count * sizeof(double));
+  return { block, block + count };
+}
+
+void complex_array_free (complex_array_t *array) {
+  counted_free(array->real);
+  *array = {};
+}
+
+complex_array_single_t complex_array_single_new (size_t count) {
+  float *block = (float *) counted_malloc(2 * count * sizeof(float));
+  return { block, block + count };
+}
+
+void complex_array_single_free (complex_array_single_t *array) {
+  counted_free(array->real);
+  *array = {};
+}
+
+void cmplx_array_add (complex_array_t out, complex_array_t a, complex_array_t b, size_t count) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + LANES <= count; i += LANES) {
+    _mm_storeu_pd(out.real + i, _mm_add_pd(_mm_loadu_pd(a.real + i), _mm_loadu_pd(b.real + i)));
+    _mm_storeu_pd(out.imag + i, _mm_add_pd(_mm_loadu_pd(a.imag + i), _mm_loadu_pd(b.imag + i)));
+  }
+#endif
+
+  for (; i < count; i++)
+    cmplx_array_set(out, i, cmplx_add(cmplx_array_get(a, i), cmplx_array_get(b, i)));
+}
+
+void cmplx_array_sub (complex_array_t out, complex_array_t a, complex_array_t b, size_t count) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + LANES <= count; i += LANES) {
+    _mm_storeu_pd(out.real + i, _mm_sub_pd(_mm_loadu_pd(a.real + i), _mm_loadu_pd(b.real + i)));
+    _mm_storeu_pd(out.imag + i, _mm_sub_pd(_mm_loadu_pd(a.imag + i), _mm_loadu_pd(b.imag + i)));
+  }
+#endif
+
+  for (; i < count; i++)
+    cmplx_array_set(out, i, cmplx_sub(cmplx_array_get(a, i), cmplx_array_get(b, i)));
+}
+
+void cmplx_array_mul (complex_array_t out, complex_array_t a, complex_array_t b, size_t count) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + LANES <= count; i += LANES) {
+    lanes_t ar = _mm_loadu_pd(a.real + i), ai = _mm_loadu_pd(a.imag + i);
+    lanes_t br = _mm_loadu_pd(b.real + i), bi = _mm_loadu_pd(b.imag + i);
+
+    _mm_storeu_pd(out.real + i, _mm_sub_pd(_mm_mul_pd(ar, br), _mm_mul_pd(ai, bi)));
+    _mm_storeu_pd(out.imag + i, _mm_add_pd(_mm_mul_pd(ar, bi), _mm_mul_pd(ai, br)));
+  }
+#endif
+
+  for (; i < count; i++)
+    cmplx_array_set(out, i, cmplx_mul(cmplx_array_get(a, i), cmplx_array_get(b, i)));
+}
+
+void cmplx_array_div (complex_array_t out, complex_array_t a, complex_array_t b, size_t count) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + LANES <= count; i += LANES) {
+    lanes_t ar = _mm_loadu_pd(a.real + i), ai = _mm_loadu_pd(a.imag + i);
+    lanes_t br = _mm_loadu_pd(b.real + i), bi = _mm_loadu_pd(b.imag + i);
+
+    // both branches of cmplx_div at once: the larger part of b is divided by
+    // first, and the parts of a swap places along with it
+    lanes_t real_first = _mm_cmpge_pd(lanes_abs(br), lanes_abs(bi));
+    lanes_t larger     = lanes_select(real_first, br, bi);
+    lanes_t smaller    = lanes_select(real_first, bi, br);
+    lanes_t first      = lanes_select(real_first, ar, ai);
+    lanes_t second     = lanes_select(real_first, ai, ar);
+
+    lanes_t ratio = _mm_div_pd(smaller, larger);
+    lanes_t denom = _mm_add_pd(larger, _mm_mul_pd(smaller, ratio));
+    lanes_t real  = _mm_div_pd(_mm_add_pd(first, _mm_mul_pd(second, ratio)), denom);
+    lanes_t imag  = _mm_div_pd(_mm_sub_pd(second, _mm_mul_pd(first, ratio)), denom);
+
+    _mm_storeu_pd(out.real + i, real);
+    _mm_storeu_pd(out.imag + i, _mm_xor_pd(imag, _mm_andnot_pd(real_first, _mm_set1_pd(-0.0))));
+  }
+#endif
+
+  for (; i < count; i++)
+    cmplx_array_set(out, i, cmplx_div(cmplx_array_get(a, i), cmplx_array_get(b, i)));
+}
+
+void cmplx_array_fma (complex_array_t out, complex_array_t a, complex_array_t b,
+                      complex_array_t c, size_t count) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + LANES <= count; i += LANES) {
+    lanes_t ar = _mm_loadu_pd(a.real + i), ai = _mm_loadu_pd(a.imag + i);
+    lanes_t br = _mm_loadu_pd(b.real + i), bi = _mm_loadu_pd(b.imag + i);
+
+    lanes_t real = _mm_sub_pd(_mm_mul_pd(ar, br), _mm_mul_pd(ai, bi));
+    lanes_t imag = _mm_add_pd(_mm_mul_pd(ar, bi), _mm_mul_pd(ai, br));
+    _mm_storeu_pd(out.real + i, _mm_add_pd(real, _mm_loadu_pd(c.real + i)));
+    _mm_storeu_pd(out.imag + i, _mm_add_pd(imag, _mm_loadu_pd(c.imag + i)));
+  }
+#endif
+
+  for (; i < count; i++) {
+    complex_t res = cmplx_fma(cmplx_array_get(a, i), cmplx_array_get(b, i), cmplx_array_get(c, i));
+    cmplx_array_set(out, i, res);
+  }
+}
+
+void cmplx_array_sqrt (complex_array_t out, complex_array_t a, size_t count) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const lanes_t half = _mm_set1_pd(0.5);
+
+  for (; i + LANES <= count; i += LANES) {
+    lanes_t re = _mm_loadu_pd(a.real + i), im = _mm_loadu_pd(a.imag + i);
+
+    // the root of a number near the real axis, like cmplx_sqrt takes it
+    lanes_t on_axis  = _mm_cmplt_pd(lanes_abs(im), _mm_set1_pd(EPSILON));
+    lanes_t positive = _mm_cmpgt_pd(re, _mm_setzero_pd());
+    lanes_t root     = _mm_sqrt_pd(lanes_abs(re));
+    lanes_t axis_re  = _mm_and_pd(positive, root);
+    lanes_t axis_im  = _mm_andnot_pd(positive, root);
+
+    lanes_t mag   = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(im, im), _mm_mul_pd(re, re)));
+    lanes_t left  = _mm_sqrt_pd(_mm_mul_pd(_mm_add_pd(mag, re), half));
+    lanes_t right = _mm_sqrt_pd(_mm_mul_pd(_mm_sub_pd(mag, re), half));
+    // the sign of im on right
+    lanes_t sign  = _mm_and_pd(im, _mm_set1_pd(-0.0));
+    right = _mm_or_pd(lanes_abs(right), sign);
+
+    _mm_storeu_pd(out.real + i, lanes_select(on_axis, axis_re, left));
+    _mm_storeu_pd(out.imag + i, lanes_select(on_axis, axis_im, right));
+  }
+#endif
+
+  for (; i < count; i++)
+    cmplx_array_set(out, i, cmplx_sqrt(cmplx_array_get(a, i)));
+}
@@ -0,0 +1,40 @@
+/**
+ * @file
+ * @brief Double-double numbers, about twice the digits of a double
+ */
+
+#include <math.h>
+
+#include "double_double.h"
+
+dd_t dd_div (const dd_t a, const dd_t b) {
+  // a quotient digit, and what is left of a once it is taken away, twice
+  double first = a.hi / b.hi;
+  dd_t   rest  = a - first * b;
+
+  double second = rest.hi / b.hi;
+  rest = rest - second * b;
+
+  double third = rest.hi / b.hi;
+  return dd_quick_two_sum(first, second) + third;
+}
+
+dd_t dd_sqrt (const dd_t a) {
+  if (!(a.hi > 0))
+    return dd_from(sqrt(a.hi));
+
+  // x + (a - x^2) / 2x, with the square exact
+  double root = sqrt(a.hi);
+  dd_t   rest = a - dd_two_prod(root, root);
+  return dd_quick_two_sum(root, rest.hi / (2 * root));
+}
+
+dd_t dd_cbrt (const dd_t a) {
+  if (!(fabs(a.hi) > 0))
+    return a;
+
+  // x + (a - x^3) / 3x^2
+  double root = cbrt(a.hi);
+  dd_t   rest = a - dd_two_prod(root, root) * root;
+  return dd_quick_two_sum(root, rest.hi / (3 * root * root));
+}
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include "evaluate.h"
@@ -14,17 +15,23 @@
 #include "parser.h"
 #include "equation.h"
 #include "log.h"
-
-EvalStatus handle_op_neg  (Env *env, Expr *target,            Value *output);
-EvalStatus handle_op_add  (Env *env, Expr *left, Expr *right, Value *output);
-EvalStatus handle_op_sub  (Env *env, Expr *left, Expr *right, Value *output);
-EvalStatus handle_op_mul  (Env *env, Expr *left, Expr *right, Value *output);
-EvalStatus handle_op_div  (Env *env, Expr *left, Expr *right, Value *output);
-EvalStatus handle_op_pow  (Env *env, Expr *left, Expr *right, Value *output);
-EvalStatus handle_op_call (Env *env, Expr *left, Expr *right, Value *output);
+#include "trace.h"
+#include "alloc.h"
+
+EvalStatus eval_node         (Env *env, Expr *expr,              Value *output);
+EvalStatus handle_op_neg     (Env *env, Expr *target,            Value *output);
+EvalStatus handle_op_add     (Env *env, Expr *left, Expr *right, Value *output);
+EvalStatus handle_op_add_mul (Env *env, Expr *left, Expr *mul,   Value *output);
+EvalStatus handle_op_sub     (Env *env, Expr *left, Expr *right, Value *output);
+EvalStatus handle_op_mul     (Env *env, Expr *left, Expr *right, Value *output);
+EvalStatus handle_op_div     (Env *env, Expr *left, Expr *right, Value *output);
+EvalStatus handle_op_pow     (Env *env, Expr *left, Expr *right, Value *output);
+EvalStatus handle_op_call    (Env *env, Expr *left, Expr *right, Value *output);
 
 /**
  * Handles some operation on two values, based on functions passed to it.
+ * The left operand is evaluated straight into \p output, and the functions
+ * that take a polynomial on the left change it there, see #apply_op_generic.
  *
  * @param num_num    A function that handles the operation on two numbers
  * @param num_poly   A function that handles the operation on a number and a polynomial
@@ -38,36 +45,88 @@ EvalStatus handle_op_call (Env *env, Expr *left, Expr *right, Value *output);
  * @param output     A place to write the resulting value to
  */
 EvalStatus handle_op_generic (
-    EvalStatus (*num_num)   (complex_t,  complex_t,  Value *),
-    EvalStatus (*num_poly)  (complex_t,  Polynomial, Value *),
-    EvalStatus (*poly_num)  (Polynomial, complex_t,  Value *),
-    EvalStatus (*poly_poly) (Polynomial, Polynomial, Value *),
+    EvalStatus (*num_num)   (complex_t, complex_t,          Value *),
+    EvalStatus (*num_poly)  (complex_t, const Polynomial *, Value *),
+    EvalStatus (*poly_num)  (Value *,   complex_t),
+    EvalStatus (*poly_poly) (Value *,   const Polynomial *),
     Env *env, Expr *left, Expr *right, Value *output);
 
-EvalStatus add_num_num   (complex_t a,  complex_t b,  Value *output);
-EvalStatus add_num_poly  (complex_t n,  Polynomial p, Value *output);
-EvalStatus add_poly_num  (Polynomial p, complex_t n,  Value *output);
-EvalStatus add_poly_poly (Polynomial a, Polynomial b, Value *output);
+/**
+ * Apply an operation to two values that are already evaluated, with the
+ * functions of #handle_op_generic.
+ *
+ * @param acc The left operand, which the result replaces
+ * @param b   The right operand
+ */
+EvalStatus apply_op_generic (
+    EvalStatus (*num_num)   (complex_t, complex_t,          Value *),
+    EvalStatus (*num_poly)  (complex_t, const Polynomial *, Value *),
+    EvalStatus (*poly_num)  (Value *,   complex_t),
+    EvalStatus (*poly_poly) (Value *,   const Polynomial *),
+    Value *acc, const Value *b);
 
-EvalStatus mul_num_num   (complex_t a,  complex_t b,  Value *output);
-EvalStatus mul_num_poly  (complex_t n,  Polynomial p, Value *output);
-EvalStatus mul_poly_num  (Polynomial p, complex_t n,  Value *output);
-EvalStatus mul_poly_poly (Polynomial a, Polynomial b, Value *output);
+EvalStatus add_num_num   (complex_t a,  complex_t b,          Value *output);
+EvalStatus add_num_poly  (complex_t n,  const Polynomial *p,  Value *output);
+EvalStatus add_poly_num  (Value *acc,   complex_t n);
+EvalStatus add_poly_poly (Value *acc,   const Polynomial *b);
 
-EvalStatus div_num_num   (complex_t a,  complex_t b,  Value *output);
-EvalStatus div_poly_num  (Polynomial p, complex_t n,  Value *output);
+EvalStatus mul_num_num   (complex_t a,  complex_t b,          Value *output);
+EvalStatus mul_num_poly  (complex_t n,  const Polynomial *p,  Value *output);
+EvalStatus mul_poly_num  (Value *acc,   complex_t n);
+EvalStatus mul_poly_poly (Value *acc,   const Polynomial *b);
 
-EvalStatus pow_num_num   (complex_t a,  complex_t b,  Value *output);
-EvalStatus pow_poly_num  (Polynomial p, complex_t n,  Value *output);
+EvalStatus div_num_num   (complex_t a,  complex_t b,          Value *output);
+EvalStatus div_poly_num  (Value *acc,   complex_t n);
 
-EvalStatus call_poly_num (Polynomial p, complex_t n,  Value *output);
+EvalStatus pow_num_num   (complex_t a,  complex_t b,          Value *output);
+EvalStatus pow_poly_num  (Value *acc,   complex_t n);
+
+EvalStatus call_poly_num (Value *acc,   complex_t n);
 
 Value mk_number (complex_t  n);
 Value mk_poly   (Polynomial p);
 
 EvalStatus handle_polynomial_error (PolynomialError err);
 
+bool fold_node (Expr *expr);
+
+bool is_unset (double x);
+
+uint64_t *var_mark        (Env *env, int var);
+bool      var_list_has    (const VarList *list, int var);
+void      var_list_add    (VarList *list, int var);
+void      var_list_remove (VarList *list, int var);
+void      collect_vars    (const Expr *expr, VarList *vars);
+bool      reaches         (Env *env, int from, const VarList *targets);
+void      mark_dirty      (Env *env, int var, VarList *changed);
+
+/// Variables an #Env makes room for in #Env.marks at first
+#define ENV_MIN_VARS 64
+
+/// Current #eval_expr recursion depth of this thread, only tracked while tracing
+thread_local int _eval_depth = 0;
+
 EvalStatus eval_expr (Env *env, Expr *expr, Value *output) {
+  if (!trace_enabled)
+    return eval_node(env, expr, output);
+
+  _eval_depth++;
+
+  TRACE_BEGIN(eval);
+  EvalStatus status = eval_node(env, expr, output);
+
+  if (_eval_depth <= TRACE_EVAL_MAX_DEPTH) {
+    char depth[16];
+    snprintf(depth, sizeof(depth), "%d", _eval_depth);
+    TRACE_END_ARG(eval, "eval_expr", "depth", depth);
+  }
+
+  _eval_depth--;
+  return status;
+}
+
+/* evaluate a single node, recursing through #eval_expr */
+EvalStatus eval_node (Env *env, Expr *expr, Value *output) {
   switch (expr->type) {
     case POLY_VAR:
       LOG_DEBUG("Evaluating POLY_VAR...");
@@ -82,7 +141,24 @@ EvalStatus eval_expr (Env *env, Expr *expr, Value *output) {
       return EVAL_OK;
     case IDENTIFIER:
       LOG_DEBUG("Evaluating IDENTIFIER...");
-      return env_get_value(env, expr->var_name, output);
+      return env_get_value(env, expr->symbol, output);
+    case PARAMETER:
+      LOG_DEBUG("Evaluating PARAMETER...");
+      // exec checks the number of values, so this is only reachable by a bug
+      if (expr->param > env->param_count)
+        return WTF_ERROR;
+
+      output->type = TP_NUMBER;
+      output->num  = env->params[expr->param - 1];
+      return EVAL_OK;
+    case SLOT:
+      LOG_DEBUG("Evaluating SLOT...");
+      return env_get_slot(env, expr->slot, output);
+    case CONSTANT_POLY:
+      LOG_DEBUG("Evaluating CONSTANT_POLY...");
+      output->type = TP_POLYNOMIAL;
+      output->poly = *expr->poly;
+      return EVAL_OK;
     case OPERATOR:
       LOG_DEBUG("Evaluating OPERATOR...");
       switch (expr->op) {
@@ -108,64 +184,546 @@ EvalStatus eval_expr (Env *env, Expr *expr, Value *output) {
   }
 }
 
-EvalStatus env_get_value (Env *env, char var_name, Value *output) {
-  VarDescription var = env->vars[(int) var_name];
-  if (var.used) {
-    *output = var.val;
+PackedValue pack_value (Value value) {
+  PackedValue packed = {};
+
+  if (value.type == TP_NUMBER) {
+    if (is_unset(value.num.imag)) {
+      packed.type = PACKED_REAL;
+      packed.real = value.num.real;
+    } else {
+      packed.type = PACKED_COMPLEX;
+      packed.num  = value.num;
+    }
+
+    return packed;
+  }
+
+  // only coefficients that are exactly zero are left out, so that it unpacks to the same value
+  int  degree = 0;
+  bool real   = true;
+  for (int i = 0; i < POLY_COEFF_LEN; i++) {
+    if (!is_unset(value.poly.coeffs[i].real) || !is_unset(value.poly.coeffs[i].imag))
+      degree = i;
+    real = real && is_unset(value.poly.coeffs[i].imag);
+  }
+
+  // the common small ones stay inline, so that reading them doesn't follow a pointer
+  if (degree <= 1 && real) {
+    packed.type      = PACKED_LINEAR;
+    packed.var       = value.poly.var;
+    packed.linear[0] = value.poly.coeffs[0].real;
+    packed.linear[1] = value.poly.coeffs[1].real;
+    return packed;
+  }
+
+  size_t size = sizeof(PackedPoly) + (size_t) (degree + 1) * sizeof(complex_t);
+  packed.type = PACKED_POLY;
+  packed.poly = (PackedPoly *) counted_malloc(size);
+  packed.poly->var    = value.poly.var;
+  packed.poly->degree = degree;
+  memcpy(packed.poly->coeffs, value.poly.coeffs, (size_t) (degree + 1) * sizeof(complex_t));
+
+  return packed;
+}
+
+Value unpack_value (const PackedValue *packed) {
+  // only what the type uses is written, zeroing all of a #Value costs more than the lookup
+  Value value;
+
+  switch (packed->type) {
+    case PACKED_REAL:
+      value.type = TP_NUMBER;
+      value.num  = { packed->real, 0 };
+      break;
+    case PACKED_COMPLEX:
+      value.type = TP_NUMBER;
+      value.num  = packed->num;
+      break;
+    case PACKED_LINEAR:
+      value.type           = TP_POLYNOMIAL;
+      value.poly.var       = packed->var;
+      value.poly.coeffs[0] = { packed->linear[0], 0 };
+      value.poly.coeffs[1] = { packed->linear[1], 0 };
+      for (int i = 2; i < POLY_COEFF_LEN; i++)
+        value.poly.coeffs[i] = {};
+      break;
+    case PACKED_POLY:
+      value.type     = TP_POLYNOMIAL;
+      value.poly.var = packed->poly->var;
+      for (int i = 0; i < POLY_COEFF_LEN; i++)
+        value.poly.coeffs[i] = i <= packed->poly->degree ? packed->poly->coeffs[i] : complex_t{};
+      break;
+    default:
+      assert(false);
+      value = {};
+  }
+
+  return value;
+}
+
+PackedValue copy_packed_value (const PackedValue *packed) {
+  PackedValue copy = *packed;
+  if (packed->type != PACKED_POLY)
+    return copy;
+
+  size_t size = sizeof(PackedPoly) + (size_t) (packed->poly->degree + 1) * sizeof(complex_t);
+  copy.poly = (PackedPoly *) counted_malloc(size);
+  memcpy(copy.poly, packed->poly, size);
+  return copy;
+}
+
+void destroy_packed_value (PackedValue *packed) {
+  if (packed->type == PACKED_POLY)
+    counted_free(packed->poly);
+
+  *packed = {};
+}
+
+/* whether x is a positive zero, which is what a zeroed value has */
+bool is_unset (double x) {
+  return fpclassify(x) == FP_ZERO && !signbit(x);
+}
+
+EvalStatus env_get_value (Env *env, int var, Value *output) {
+  const VarDescription *desc = var_tree_get(&env->vars, var);
+  if (!desc || !desc->used)
+    return NO_VARIABLE;
+
+  if (!desc->dirty) {
+    *output = unpack_value(&desc->val);
     return EVAL_OK;
-  } else {
+  }
+
+  // edited first, so that it stays where it is while the others are
+  VarDescription *edited = var_tree_edit(&env->vars, var);
+
+  // whatever it reads is brought up to date the same way along the way
+  Value value = {};
+  EvalStatus status = eval_expr(env, edited->expr, &value);
+  if (status)
+    return status;
+
+  destroy_packed_value(&edited->val);
+  edited->val   = pack_value(value);
+  edited->dirty = false;
+  env->recomputed++;
+
+  *output = value;
+  return EVAL_OK;
+}
+
+void env_set_value (Env *env, int var, Value value) {
+  VarDescription *desc = var_tree_edit(&env->vars, var);
+  destroy_packed_value(&desc->val);
+  desc->used = true;
+  desc->val  = pack_value(value);
+}
+
+void env_bind (Env *env, int var, Value value, const Expr *expr) {
+  // parameters are gone once the prepared statement is done, so it can't be
+  // computed again, and there is no need to if it doesn't read anything
+  VarList reads   = {};
+  Expr   *binding = NULL;
+  if (expr && !expr_max_param(expr)) {
+    collect_vars(expr, &reads);
+
+    env->mark++;
+    if (reads.count && !var_list_has(&reads, var) && !reaches(env, var, &reads))
+      binding = clone_expr(expr);
+    else
+      reads.count = 0;
+  }
+
+  // a variable that was edited isn't shared, so editing others doesn't move it
+  VarDescription *desc = var_tree_edit(&env->vars, var);
+  for (size_t i = 0; i < desc->reads.count; i++)
+    var_list_remove(&var_tree_edit(&env->vars, desc->reads.vars[i])->dependents, var);
+  for (size_t i = 0; i < reads.count; i++)
+    var_list_add(&var_tree_edit(&env->vars, reads.vars[i])->dependents, var);
+
+  counted_free(desc->reads.vars);
+  destroy_expr(desc->expr);
+  destroy_packed_value(&desc->val);
+  desc->used  = true;
+  desc->val   = pack_value(value);
+  desc->expr  = binding;
+  desc->reads = reads;
+  desc->dirty = false;
+
+  // everything that changed gets the same mark
+  VarList changed = {};
+  env->mark++;
+  *var_mark(env, var) = env->mark;
+  var_list_add(&changed, var);
+  mark_dirty(env, var, &changed);
+
+  for (size_t i = 0; i < env->watcher_count; i++) {
+    Watcher *watcher = &env->watchers[i];
+    for (size_t r = 0; r < watcher->reads.count && !watcher->stale; r++)
+      watcher->stale = *var_mark(env, watcher->reads.vars[r]) == env->mark;
+  }
+
+  // one that fails stays dirty, and reports the error once it's read
+  if (env->reactive == REACTIVE_EAGER) {
+    for (size_t i = 1; i < changed.count; i++) {
+      Value recomputed = {};
+      env_get_value(env, changed.vars[i], &recomputed);
+    }
+  }
+
+  counted_free(changed.vars);
+}
+
+size_t env_watch (Env *env, Statement *stmt) {
+  env->watchers = (Watcher *) counted_realloc(env->watchers, (env->watcher_count + 1) * sizeof(Watcher));
+
+  Watcher *watcher = &env->watchers[env->watcher_count++];
+  *watcher = { .stmt = stmt, .reads = {}, .stale = false };
+  collect_vars(stmt->expr, &watcher->reads);
+
+  return env->watcher_count;
+}
+
+VarTree env_snapshot (const Env *env) {
+  return var_tree_share(&env->vars);
+}
+
+void env_restore (Env *env, const VarTree *snapshot) {
+  VarTree vars = var_tree_share(snapshot);
+  var_tree_release(&env->vars);
+  env->vars = vars;
+
+  for (size_t i = 0; i < env->watcher_count; i++)
+    env->watchers[i].stale = true;
+}
+
+size_t env_push_snapshot (Env *env) {
+  if (env->snapshot_count == env->snapshot_cap) {
+    env->snapshot_cap = env->snapshot_cap ? env->snapshot_cap * 2 : 4;
+    env->snapshots    = (VarTree *) counted_realloc(env->snapshots, env->snapshot_cap * sizeof(VarTree));
+  }
+
+  env->snapshots[env->snapshot_count++] = env_snapshot(env);
+  return env->snapshot_count;
+}
+
+size_t env_rollback (Env *env) {
+  if (!env->snapshot_count)
+    return 0;
+
+  VarTree *snapshot = &env->snapshots[env->snapshot_count - 1];
+  env_restore(env, snapshot);
+  var_tree_release(snapshot);
+  return env->snapshot_count--;
+}
+
+void env_fork (const Env *env, Env *fork) {
+  fork->vars     = var_tree_share(&env->vars);
+  fork->reactive = env->reactive;
+}
+
+/* the mark of var, see #Env.marks, making room for it */
+uint64_t *var_mark (Env *env, int var) {
+  if ((size_t) var >= env->mark_count) {
+    size_t count = env->mark_count ? env->mark_count : ENV_MIN_VARS;
+    while (count <= (size_t) var)
+      count *= 2;
+
+    env->marks = (uint64_t *) counted_realloc(env->marks, count * sizeof(uint64_t));
+    memset(env->marks + env->mark_count, 0, (count - env->mark_count) * sizeof(uint64_t));
+    env->mark_count = count;
+  }
+
+  return &env->marks[var];
+}
+
+/* mark everything downstream of var dirty and add it to changed, which has the current mark */
+void mark_dirty (Env *env, int var, VarList *changed) {
+  // var was edited already, so it stays where it is while the others are
+  const VarDescription *desc = var_tree_get(&env->vars, var);
+  for (size_t i = 0; i < desc->dependents.count; i++) {
+    int next = desc->dependents.vars[i];
+    if (*var_mark(env, next) == env->mark)
+      continue;
+
+    *var_mark(env, next) = env->mark;
+    var_tree_edit(&env->vars, next)->dirty = true;
+    var_list_add(changed, next);
+    mark_dirty(env, next, changed);
+  }
+}
+
+/* whether any of targets is downstream of from, marking the visited variables with the current mark */
+bool reaches (Env *env, int from, const VarList *targets) {
+  const VarDescription *desc = var_tree_get(&env->vars, from);
+  if (!desc)
+    return false;
+
+  for (size_t i = 0; i < desc->dependents.count; i++) {
+    int next = desc->dependents.vars[i];
+    if (var_list_has(targets, next))
+      return true;
+
+    if (*var_mark(env, next) == env->mark)
+      continue;
+
+    *var_mark(env, next) = env->mark;
+    if (reaches(env, next, targets))
+      return true;
+  }
+
+  return false;
+}
+
+/* add the variables that expr reads to vars once each */
+void collect_vars (const Expr *expr, VarList *vars) {
+  if (!expr)
+    return;
+
+  switch (expr->type) {
+    case OPERATOR:
+      collect_vars(expr->left,  vars);
+      collect_vars(expr->right, vars);
+      break;
+    case IDENTIFIER:
+      if (!var_list_has(vars, expr->symbol))
+        var_list_add(vars, expr->symbol);
+      break;
+    case NUMBER:
+    case POLY_VAR:
+    case PARAMETER:
+    case CONSTANT_POLY:
+    case SLOT:
+    default:
+      break;
+  }
+}
+
+bool var_list_has (const VarList *list, int var) {
+  for (size_t i = 0; i < list->count; i++)
+    if (list->vars[i] == var)
+      return true;
+
+  return false;
+}
+
+void var_list_add (VarList *list, int var) {
+  if (list->count == list->cap) {
+    list->cap  = list->cap ? list->cap * 2 : 4;
+    list->vars = (int *) counted_realloc(list->vars, list->cap * sizeof(int));
+  }
+
+  list->vars[list->count++] = var;
+}
+
+void var_list_remove (VarList *list, int var) {
+  for (size_t i = 0; i < list->count; i++) {
+    if (list->vars[i] == var) {
+      list->vars[i] = list->vars[--list->count];
+      return;
+    }
+  }
+}
+
+EvalStatus env_get_slot (Env *env, int slot, Value *output) {
+  if (slot < 1 || (size_t) slot > env->slot_count || !env->slots[slot - 1].used)
     return NO_VARIABLE;
+
+  *output = unpack_value(&env->slots[slot - 1].val);
+  return EVAL_OK;
+}
+
+void env_set_slot (Env *env, int slot, Value value) {
+  assert(slot >= 1 && (size_t) slot <= env->slot_count);
+  VarDescription *desc = &env->slots[slot - 1];
+  destroy_packed_value(&desc->val);
+  desc->val  = pack_value(value);
+  desc->used = true;
+}
+
+void env_prepare (Env *env, const char *name, Statement *stmt, int param_count) {
+  PreparedStatement *prepared = NULL;
+
+  for (size_t i = 0; i < env->prepared_count; i++) {
+    if (!strcmp(env->prepared[i].name, name)) {
+      prepared = &env->prepared[i];
+      destory_stmt(prepared->stmt);
+      break;
+    }
+  }
+
+  if (!prepared) {
+    env->prepared = (PreparedStatement *) counted_realloc(
+      env->prepared, (env->prepared_count + 1) * sizeof(PreparedStatement));
+    prepared = &env->prepared[env->prepared_count++];
+    strncpy(prepared->name, name, STMT_NAME_LEN - 1);
+    prepared->name[STMT_NAME_LEN - 1] = '\0';
   }
+
+  prepared->stmt        = stmt;
+  prepared->param_count = param_count;
+}
+
+const PreparedStatement *env_get_prepared (const Env *env, const char *name) {
+  for (size_t i = 0; i < env->prepared_count; i++)
+    if (!strcmp(env->prepared[i].name, name))
+      return &env->prepared[i];
+
+  return NULL;
 }
 
-void env_set_value (Env *env, char var_name, Value value) {
-  VarDescription var = { .used = true, .val = value };
-  env->vars[(int) var_name] = var;
+void env_destroy (Env *env) {
+  for (size_t i = 0; i < env->prepared_count; i++)
+    destory_stmt(env->prepared[i].stmt);
+
+  counted_free(env->prepared);
+  env->prepared       = NULL;
+  env->prepared_count = 0;
+
+  for (size_t i = 0; i < env->watcher_count; i++) {
+    destory_stmt(env->watchers[i].stmt);
+    counted_free(env->watchers[i].reads.vars);
+  }
+
+  counted_free(env->watchers);
+  env->watchers      = NULL;
+  env->watcher_count = 0;
+
+  for (size_t i = 0; i < env->snapshot_count; i++)
+    var_tree_release(&env->snapshots[i]);
+
+  counted_free(env->snapshots);
+  env->snapshots      = NULL;
+  env->snapshot_count = 0;
+  env->snapshot_cap   = 0;
+
+  var_tree_release(&env->vars);
+
+  counted_free(env->marks);
+  env->marks      = NULL;
+  env->mark_count = 0;
+}
+
+void fold_constants (Expr *expr) {
+  if (expr)
+    fold_node(expr);
+}
+
+/* fold the children of expr, and then expr itself if they are constant. Returns whether expr is */
+bool fold_node (Expr *expr) {
+  switch (expr->type) {
+    case NUMBER:
+    case POLY_VAR:
+    case CONSTANT_POLY:
+      return true;
+    case IDENTIFIER:
+    case PARAMETER:
+    case SLOT:
+      return false;
+    case OPERATOR:
+      break;
+    default:
+      return false;
+  }
+
+  // both have to be folded, even if one of them turns out not to be constant
+  bool left_constant  = fold_node(expr->left);
+  bool right_constant = !expr->right || fold_node(expr->right);
+  if (!left_constant || !right_constant)
+    return false;
+
+  // nothing constant looks at the env
+  Value value = {};
+  if (eval_node(NULL, expr, &value))
+    return false;
+
+  destroy_expr(expr->left);
+  destroy_expr(expr->right);
+
+  if (value.type == TP_NUMBER) {
+    expr->type = NUMBER;
+    expr->val  = value.num;
+  } else {
+    expr->type  = CONSTANT_POLY;
+    expr->poly  = (Polynomial *) counted_malloc(sizeof(Polynomial));
+    *expr->poly = value.poly;
+  }
+
+  return true;
 }
 
 void print_value (Value val) {
+  fprint_value(stdout, val);
+}
+
+void fprint_value (FILE *out, Value val) {
   switch (val.type) {
     case TP_NUMBER:
-      print_complex(val.num);
+      fprint_complex(out, val.num);
       break;
     case TP_POLYNOMIAL:
-      print_polynomial(val.poly);
+      fprint_polynomial(out, val.poly);
       break;
     default:
       assert(false);
   }
-  putchar('\n');
+  fputc('\n', out);
 }
 
 EvalStatus handle_op_neg (Env *env, Expr *target, Value *output) {
-  Value target_val;
-
-  EvalStatus res = eval_expr(env, target, &target_val);
+  EvalStatus res = eval_expr(env, target, output);
   if (res)
     return res;
 
-  if (target_val.type == TP_NUMBER)
-    *output = mk_number(cmplx_negate(target_val.num));
-  else {
-    Polynomial negated = {};
-
-    PolynomialError err = polynomial_negate(target_val.poly, &negated);
-    if (err)
-      return handle_polynomial_error(err);
-
-    *output = mk_poly(negated);
-  }
+  if (output->type == TP_NUMBER)
+    output->num = cmplx_negate(output->num);
+  else
+    polynomial_negate_inplace(&output->poly);
 
   return EVAL_OK;
 }
 
 EvalStatus handle_op_add (Env *env, Expr *left, Expr *right, Value *output) {
+  // the trace shows every node, so the product is only skipped when there is none
+  if (!trace_enabled && right->type == OPERATOR && right->op == OP_MUL)
+    return handle_op_add_mul(env, left, right, output);
+
   return handle_op_generic(
     add_num_num, add_num_poly, add_poly_num, add_poly_poly,
     env, left, right, output
   );
 }
 
+EvalStatus handle_op_add_mul (Env *env, Expr *left, Expr *mul, Value *output) {
+  Value k, p;
+  EvalStatus res;
+
+  res = eval_expr(env, left, output);
+  if (res)
+    return res;
+
+  res = eval_expr(env, mul->left, &k);
+  if (res)
+    return res;
+
+  res = eval_expr(env, mul->right, &p);
+  if (res)
+    return res;
+
+  if (output->type == TP_POLYNOMIAL && k.type != p.type) {
+    const Value *num  = k.type == TP_NUMBER ? &k : &p;
+    const Value *poly = k.type == TP_NUMBER ? &p : &k;
+    return handle_polynomial_error(polynomial_fma_inplace(&output->poly, &poly->poly, num->num));
+  }
+
+  res = apply_op_generic(mul_num_num, mul_num_poly, mul_poly_num, mul_poly_poly, &k, &p);
+  if (res)
+    return res;
+
+  return apply_op_generic(add_num_num, add_num_poly, add_poly_num, add_poly_poly, output, &k);
+}
+
 EvalStatus handle_op_sub (Env *env, Expr *left, Expr *right, Value *output) {
   // a - b = a + (-b), at least in this language
   Expr neg_right = {
@@ -205,41 +763,52 @@ EvalStatus handle_op_call (Env *env, Expr *left, Expr *right, Value *output) {
 }
 
 EvalStatus handle_op_generic (
-    EvalStatus (*num_num)   (complex_t,  complex_t,  Value *),
-    EvalStatus (*num_poly)  (complex_t,  Polynomial, Value *),
-    EvalStatus (*poly_num)  (Polynomial, complex_t,  Value *),
-    EvalStatus (*poly_poly) (Polynomial, Polynomial, Value *),
+    EvalStatus (*num_num)   (complex_t, complex_t,          Value *),
+    EvalStatus (*num_poly)  (complex_t, const Polynomial *, Value *),
+    EvalStatus (*poly_num)  (Value *,   complex_t),
+    EvalStatus (*poly_poly) (Value *,   const Polynomial *),
     Env *env, Expr *left, Expr *right, Value *output) {
-  Value a, b;
+  Value b;
   EvalStatus res;
 
-  res = eval_expr(env, left, &a);
+  res = eval_expr(env, left, output);
   if (res)
     return res;
 
   res = eval_expr(env, right, &b);
   if (res)
     return res;
-  
-  if (a.type == TP_NUMBER && b.type == TP_NUMBER) {
+
+  return apply_op_generic(num_num, num_poly, poly_num, poly_poly, output, &b);
+}
+
+EvalStatus apply_op_generic (
+    EvalStatus (*num_num)   (complex_t, complex_t,          Value *),
+    EvalStatus (*num_poly)  (complex_t, const Polynomial *, Value *),
+    EvalStatus (*poly_num)  (Value *,   complex_t),
+    EvalStatus (*poly_poly) (Value *,   const Polynomial *),
+    Value *acc, const Value *b) {
+  EvalStatus res = WTF_ERROR;
+
+  if (acc->type == TP_NUMBER && b->type == TP_NUMBER) {
     if (num_num)
-      res = num_num(a.num, b.num, output);
+      res = num_num(acc->num, b->num, acc);
     else
       return TYPE_ERROR;
-  } else if (a.type == TP_NUMBER && b.type == TP_POLYNOMIAL) {
+  } else if (acc->type == TP_NUMBER && b->type == TP_POLYNOMIAL) {
     if (num_poly)
-      res = num_poly(a.num, b.poly, output);
+      res = num_poly(acc->num, &b->poly, acc);
     else
       return TYPE_ERROR;
-  } else if (a.type == TP_POLYNOMIAL && b.type == TP_NUMBER) {
+  } else if (acc->type == TP_POLYNOMIAL && b->type == TP_NUMBER) {
     if (poly_num)
-      res = poly_num(a.poly, b.num, output);
+      res = poly_num(acc, b->num);
     else
       return TYPE_ERROR;
   }
-  else if (a.type == TP_POLYNOMIAL && b.type == TP_POLYNOMIAL) {
+  else if (acc->type == TP_POLYNOMIAL && b->type == TP_POLYNOMIAL) {
     if (poly_poly)
-      res = poly_poly(a.poly, b.poly, output);
+      res = poly_poly(acc, &b->poly);
     else
       return TYPE_ERROR;
   } else
@@ -280,32 +849,20 @@ EvalStatus add_num_num (complex_t a, complex_t b, Value *output) {
   return EVAL_OK;
 }
 
-EvalStatus add_num_poly (complex_t n, Polynomial p, Value *output) {
+EvalStatus add_num_poly (complex_t n, const Polynomial *p, Value *output) {
   // add to last coefficient
-  p.e = cmplx_add(p.e, n);
-  *output = mk_poly(p);
+  *output = mk_poly(*p);
+  output->poly.e = cmplx_add(output->poly.e, n);
   return EVAL_OK;
 }
 
-EvalStatus add_poly_num (Polynomial p, complex_t n, Value *output) {
-  return add_num_poly(n, p, output);
+EvalStatus add_poly_num (Value *acc, complex_t n) {
+  acc->poly.e = cmplx_add(acc->poly.e, n);
+  return EVAL_OK;
 }
 
-EvalStatus add_poly_poly (Polynomial a, Polynomial b, Value *output) {
-  if (a.var != b.var) {
-    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", a.var, b.var);
-    return DIFFERENT_POLY_VAR;
-  }
-
-  Polynomial res = {};
-  PolynomialError err = polynomial_add(a, b, &res);
-  EvalStatus res_status = handle_polynomial_error(err);
-
-  if (res_status)
-    return res_status;
-
-  *output = mk_poly(res);
-  return EVAL_OK;
+EvalStatus add_poly_poly (Value *acc, const Polynomial *b) {
+  return handle_polynomial_error(polynomial_add_inplace(&acc->poly, b));
 }
 
 EvalStatus mul_num_num (complex_t a, complex_t b, Value *output) {
@@ -313,33 +870,19 @@ EvalStatus mul_num_num (complex_t a, complex_t b, Value *output) {
   return EVAL_OK;
 }
 
-EvalStatus mul_num_poly (complex_t n, Polynomial p, Value *output) {
-  for (int i = 0; i < POLY_COEFF_LEN; i++)
-    p.coeffs[i] = cmplx_mul(p.coeffs[i], n);
-
-  *output = mk_poly(p);
+EvalStatus mul_num_poly (complex_t n, const Polynomial *p, Value *output) {
+  *output = mk_poly(*p);
+  polynomial_scale_inplace(&output->poly, n);
   return EVAL_OK;
 }
 
-EvalStatus mul_poly_num (Polynomial p, complex_t n, Value *output) {
-  return mul_num_poly(n, p, output);
+EvalStatus mul_poly_num (Value *acc, complex_t n) {
+  polynomial_scale_inplace(&acc->poly, n);
+  return EVAL_OK;
 }
 
-EvalStatus mul_poly_poly (Polynomial a, Polynomial b, Value *output) {
-  if (a.var != b.var) {
-    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", a.var, b.var);
-    return DIFFERENT_POLY_VAR;
-  }
-
-  Polynomial res = {};
-  PolynomialError err = polynomial_mul(a, b, &res);
-  EvalStatus res_status = handle_polynomial_error(err);
-
-  if (res_status)
-    return res_status;
-
-  *output = mk_poly(res);
-  return EVAL_OK;
+EvalStatus mul_poly_poly (Value *acc, const Polynomial *b) {
+  return handle_polynomial_error(polynomial_mul_inplace(&acc->poly, b));
 }
 
 EvalStatus div_num_num (complex_t a,  complex_t b,  Value *output) {
@@ -350,14 +893,13 @@ EvalStatus div_num_num (complex_t a,  complex_t b,  Value *output) {
   return EVAL_OK;
 }
 
-EvalStatus div_poly_num (Polynomial p, complex_t n,  Value *output) {
+EvalStatus div_poly_num (Value *acc, complex_t n) {
   if (cmplx_is_zero(n))
     return ZERO_DIVISION;
-  
+
   for (int i = 0; i < POLY_COEFF_LEN; i++)
-    p.coeffs[i] = cmplx_div(p.coeffs[i], n);
+    acc->poly.coeffs[i] = cmplx_div(acc->poly.coeffs[i], n);
 
-  *output = mk_poly(p);
   return EVAL_OK;
 }
 
@@ -383,31 +925,31 @@ EvalStatus pow_num_num (complex_t a,  complex_t b,  Value *output) {
   return EVAL_OK;
 }
 
-EvalStatus pow_poly_num (Polynomial p, complex_t n,  Value *output) {
+EvalStatus pow_poly_num (Value *acc, complex_t n) {
   if (!is_zero(n.imag))
     return COMPLEX_POWER;
 
   if (is_zero(n.real)) {
-    *output = mk_number({0});
+    *acc = mk_number({0});
     return EVAL_OK;
   }
 
   if (!is_zero(fmod(n.real, 1.0)))
     return COMPLEX_POWER;
 
-  Polynomial res = { p.var, {.e = {1}} };
+  Polynomial base = acc->poly;
+  acc->poly = { base.var, {.e = {1}} };
 
   for (int i = 0; i < n.real; i++) {
-    PolynomialError status = polynomial_mul(res, p, &res);
+    PolynomialError status = polynomial_mul_inplace(&acc->poly, &base);
     if (status)
       return handle_polynomial_error(status);
   }
 
-  *output = mk_poly(res);
   return EVAL_OK;
 }
 
-EvalStatus call_poly_num (Polynomial p, complex_t n,  Value *output) {
-  *output = mk_number(polynomial_eval(p, n));
+EvalStatus call_poly_num (Value *acc, complex_t n) {
+  *acc = mk_number(polynomial_eval(acc->poly, n));
   return EVAL_OK;
 }
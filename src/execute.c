@@ -0,0 +1,408 @@
+/**
+ * @file
+ * @brief Execution of shell commands, shared by the REPL and the server
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "execute.h"
+#include "evaluate.h"
+#include "parser.h"
+#include "arith.h"
+#include "log.h"
+#include "polynomial.h"
+#include "session.h"
+#include "stats.h"
+#include "trace.h"
+#include "alloc.h"
+
+#define POLTORASHKA_URL "https://ded32.synology.me/~mipt-photo/photo/#!Search/album_323032323031303120d09fd0bed0bbd182d0bed180d0b0d188d0bad0b02f323032313034313320d09fd0bed0bbd182d0bed180d0b0d188d0bad0b0"
+#define PORNO_URL "https://vk.com/video63300907_456239570"
+
+const char PARSE_ERROR[] = "Could not parse command!";
+
+void        open_url           (const char *url, FILE *out);
+const char *eval_error_message (EvalStatus status);
+EvalStatus  run_prepared       (Env *env, Statement *command, CommandResult *result);
+
+int execute_command (Env *env, const char *source, FILE *out) {
+  STATS_BEGIN(command);
+  TRACE_BEGIN(command);
+
+  int status = 0;
+
+  Statement *command = parse_command(source, out);
+  if (command) {
+    status = execute_statement(env, command, out);
+    destory_stmt(command);
+  }
+
+  TRACE_END_ARG(command, "execute_command", "source", source);
+  STATS_END(command, PHASE_COMMAND);
+  return status;
+}
+
+Statement *parse_command (const char *source, FILE *out) {
+  Statement *command = (Statement *) counted_calloc(1, sizeof(Statement));
+
+  STATS_BEGIN(parse);
+  TRACE_BEGIN(parse);
+  int res = parse_stmt(source, command);
+  TRACE_END(parse, "parse_stmt");
+  STATS_END(parse, PHASE_PARSE);
+
+  if (!res) {
+    if (out)
+      REPORT_ERROR(out, PARSE_ERROR);
+    counted_free(command);
+    return NULL;
+  }
+
+  return command;
+}
+
+int execute_statement (Env *env, Statement *command, FILE *out) {
+  CommandResult result = {};
+  EvalStatus status = run_statement(env, command, &result);
+  print_result(&result, out);
+
+  if (env && env->reactive)
+    run_watchers(env, out);
+
+  return status;
+}
+
+EvalStatus run_statement (Env *env, Statement *command, CommandResult *result) {
+  *result = {};
+  result->cmd = command->cmd;
+
+  EvalStatus status = EVAL_OK;
+
+  switch (command->cmd) {
+    case CMD_LET:
+      status = eval_statement(env, command, &result->value, &result->error);
+      if (status)
+        break;
+
+      if (command->slot)
+        env_set_slot(env, command->slot, result->value);
+      else if (env->reactive)
+        env_bind(env, command->var, result->value, command->expr);
+      else
+        env_set_value(env, command->var, result->value);
+
+      if (!command->slot && env->session)
+        session_record_let(env->session, command->var, result->value, command->expr, false);
+      break;
+    case CMD_SOLVE:
+      status = eval_statement(env, command, &result->value, &result->error);
+      if (status)
+        break;
+
+      if (result->value.type != TP_POLYNOMIAL) {
+        result->error = "Expected a polynomial as an argument to solve, but got a number!";
+        break;
+      }
+
+      result->poly = result->value.poly;
+      if (env && env->defer_solve)
+        break;
+
+      if (env && env->precision)
+        solve_results(&result, 1, env->precision);
+      else
+        solve_result(result);
+      break;
+    case CMD_EXPR:
+      status = eval_statement(env, command, &result->value, &result->error);
+      break;
+    case CMD_PREPARE:
+      if (command->prepared->expr)
+        fold_constants(command->prepared->expr);
+
+      env_prepare(env, command->name, command->prepared, command->param_count);
+      // the env owns it now
+      command->prepared = NULL;
+      break;
+    case CMD_EXEC:
+      status = run_prepared(env, command, result);
+      break;
+    case CMD_WATCH: {
+      if (!env || !env->reactive) {
+        result->error = "Watchers only work in reactive mode, see --reactive";
+        break;
+      }
+
+      // the env keeps the expression as a solve of its own
+      Statement *solve = (Statement *) counted_calloc(1, sizeof(Statement));
+      solve->cmd    = CMD_SOLVE;
+      solve->expr   = command->expr;
+      command->expr = NULL;
+
+      size_t watcher = env_watch(env, solve);
+      status = run_statement(env, solve, result);
+      result->cmd     = CMD_WATCH;
+      result->watcher = watcher;
+      break;
+    }
+    case CMD_SNAPSHOT:
+      if (!env) {
+        result->error = "There is no session to take a snapshot of!";
+        break;
+      }
+
+      result->snapshot = env_push_snapshot(env);
+      if (env->session)
+        session_record(env->session, SESSION_SNAPSHOT);
+      break;
+    case CMD_ROLLBACK:
+      if (!env || !env->snapshot_count) {
+        result->error = "There is no snapshot to roll back to!";
+        break;
+      }
+
+      result->snapshot = env_rollback(env);
+      if (env->session)
+        session_record(env->session, SESSION_ROLLBACK);
+      break;
+    case CMD_POLTORASHKA:
+    case CMD_PORNO:
+    case CMD_STATS:
+      // nothing to compute, these only do something when printed
+      break;
+    default:
+      result->error = "Unknown command";
+  }
+
+  return status;
+}
+
+/* bind the values of an exec command and run the statement it names */
+EvalStatus run_prepared (Env *env, Statement *command, CommandResult *result) {
+  const PreparedStatement *prepared = env_get_prepared(env, command->name);
+  if (!prepared) {
+    result->error = "No statement was prepared with this name!";
+    return EVAL_OK;
+  }
+
+  if (command->arg_count != prepared->param_count) {
+    result->error = "The number of values doesn't match the parameters of the prepared statement!";
+    return EVAL_OK;
+  }
+
+  const complex_t *params      = env->params;
+  int              param_count = env->param_count;
+  env->params      = command->args;
+  env->param_count = command->arg_count;
+
+  EvalStatus status = run_statement(env, prepared->stmt, result);
+
+  env->params      = params;
+  env->param_count = param_count;
+  return status;
+}
+
+void run_watchers (Env *env, FILE *out) {
+  for (size_t i = 0; i < env->watcher_count; i++) {
+    Watcher *watcher = &env->watchers[i];
+    if (!watcher->stale)
+      continue;
+
+    watcher->stale = false;
+
+    CommandResult result = {};
+    run_statement(env, watcher->stmt, &result);
+    result.cmd     = CMD_WATCH;
+    result.watcher = i + 1;
+    print_result(&result, out);
+  }
+}
+
+void solve_result (CommandResult *result) {
+  STATS_BEGIN(solve);
+  int solved = solve_polynomial(result->poly, &result->sols);
+  STATS_END(solve, PHASE_SOLVE);
+
+  if (!solved)
+    result->error = "Could not solve this polynomial! Deg-4 and some deg-3 polys are not yet supported :(";
+}
+
+void solve_results (CommandResult *const *results, size_t count, unsigned int precision) {
+  if (!precision) {
+    for (size_t i = 0; i < count; i++)
+      solve_result(results[i]);
+    return;
+  }
+
+  STATS_BEGIN(solve);
+  Polynomial *polys  = (Polynomial *) counted_malloc(count * sizeof(Polynomial));
+  Solutions  *sols   = (Solutions *)  counted_malloc(count * sizeof(Solutions));
+  RootErrors *errors = (RootErrors *) counted_malloc(count * sizeof(RootErrors));
+
+  for (size_t i = 0; i < count; i++)
+    polys[i] = results[i]->poly;
+
+  batch_solve(polys, count, precision, sols, errors);
+
+  for (size_t i = 0; i < count; i++) {
+    results[i]->sols      = sols[i];
+    results[i]->precision = precision;
+    results[i]->errors    = errors[i];
+  }
+
+  counted_free(polys);
+  counted_free(sols);
+  counted_free(errors);
+  STATS_END(solve, PHASE_SOLVE);
+}
+
+void print_result (const CommandResult *result, FILE *out) {
+  if (result->error) {
+    REPORT_ERROR(out, "%s", result->error);
+    return;
+  }
+
+  switch (result->cmd) {
+    case CMD_LET:
+      break;
+    case CMD_WATCH:
+      fprintf(out, "-> watch #%zu\n", result->watcher);
+      [[fallthrough]];
+    case CMD_SOLVE: {
+      STATS_BEGIN(print);
+      fprintf(out, "-> ");
+      fprint_polynomial(out, result->poly);
+      fputc('\n', out);
+
+      fprintf(out, "-> ");
+      const double *errors = result->precision ? result->errors.radius : NULL;
+      fprint_solutions_with_errors(out, result->sols, errors);
+      STATS_END(print, PHASE_PRINT);
+      break;
+    }
+    case CMD_POLTORASHKA:
+      open_url(POLTORASHKA_URL, out);
+      break;
+    case CMD_PORNO:
+      open_url(PORNO_URL, out);
+      break;
+    case CMD_EXPR: {
+      STATS_BEGIN(print);
+      fprintf(out, "-> ");
+      fprint_value(out, result->value);
+      STATS_END(print, PHASE_PRINT);
+      break;
+    }
+    case CMD_STATS:
+      if (stats_are_enabled()) {
+        stats_print(out);
+      } else {
+        LOG_INFO("Stats were off, recording them from now on");
+        stats_enable(true);
+      }
+      break;
+    case CMD_SNAPSHOT:
+      fprintf(out, "-> snapshot #%zu\n", result->snapshot);
+      break;
+    case CMD_ROLLBACK:
+      fprintf(out, "-> rolled back to snapshot #%zu\n", result->snapshot);
+      break;
+    case CMD_PREPARE:
+    case CMD_EXEC:
+    default:
+      break;
+  }
+}
+
+bool eval_solve_argument (Env *env, Statement *command, Polynomial *poly, FILE *out) {
+  Value val = {};
+  if (eval_and_handle_errors(env, command, &val, out))
+    return false;
+
+  if (val.type != TP_POLYNOMIAL) {
+    REPORT_ERROR(out, "Expected a polynomial as an argument to solve, but got a number!");
+    return false;
+  }
+
+  *poly = val.poly;
+  return true;
+}
+
+bool solve_and_print (Polynomial poly, unsigned int precision, FILE *out) {
+  CommandResult result = {};
+  result.cmd  = CMD_SOLVE;
+  result.poly = poly;
+
+  CommandResult *results = &result;
+  if (precision)
+    solve_results(&results, 1, precision);
+  else
+    solve_result(&result);
+  print_result(&result, out);
+  return !result.error;
+}
+
+EvalStatus eval_and_handle_errors (Env *env, Statement *command, Value *val, FILE *out) {
+  const char *error = NULL;
+  EvalStatus status = eval_statement(env, command, val, &error);
+
+  if (status)
+    REPORT_ERROR(out, "%s", error);
+
+  return status;
+}
+
+EvalStatus eval_statement (Env *env, Statement *command, Value *val, const char **error) {
+  STATS_BEGIN(eval);
+  EvalStatus status = eval_expr(env, command->expr, val);
+  STATS_END(eval, PHASE_EVAL);
+
+  if (status)
+    *error = eval_error_message(status);
+
+  return status;
+}
+
+const char *eval_error_message (EvalStatus status) {
+  switch (status) {
+    case EVAL_OK:
+      return NULL;
+    case TOO_LARGE_DEGREE:
+      return "Encountered a polynomial of degree larger than 4, which is currently not supported";
+    case ZERO_DIVISION:
+      return "Encountered division by zero!";
+    case NO_VARIABLE:
+      return "An unknown variable was referenced!";
+    case DIFFERENT_POLY_VAR:
+      return "Multivariable polynomials are not yet supported!";
+    case TYPE_ERROR:
+      return "Encountered type error!";
+    case COMPLEX_POWER:
+      return "Invalid power operation! Currently, you can only raise a rational number to a"
+             "rational power, a complex number to an integer power, or a polynomial to an integer power";
+    case WTF_ERROR:
+    default:
+      return "My brain exploded! Something went really wrong...";
+  }
+}
+
+void open_url (const char *url, FILE *out) {
+  // nobody's browser is going to open on the server
+  if (out != stdout) {
+    REPORT_ERROR(out, "Only available in the shell, visit %s yourself", url);
+    return;
+  }
+
+  char command[1024];
+  sprintf(command, "firefox --new-tab %s", url);
+  int status = system(command);
+
+  if (status)
+    printf("Check your browser!\n");
+  else {
+    LOG_ERROR("Failed to open a browser tab :(");
+    LOG_ERROR("You can try to visit %s yourself though", url);
+  }
+}
@@ -9,6 +9,7 @@
 #include "log.h"
 
 FL_LogFormat _fl_log_format = _fl_get_log_format();
+FILE        *_fl_log_stream = NULL;
 
 FL_LogFormat _fl_get_log_format (void) {
   if (isatty(fileno(stdout)))
@@ -21,84 +22,94 @@ void fl_set_log_format (FL_LogFormat format) {
   _fl_log_format = format;
 }
 
-int _fl_write_log_color (FL_LogLevel level, _FL_LogContext ctx,
+void fl_set_log_stream (FILE *stream) {
+  __atomic_store_n(&_fl_log_stream, stream, __ATOMIC_RELEASE);
+}
+
+int _fl_write_log_color (FILE *out, FL_LogLevel level, _FL_LogContext ctx,
                          const char *fmt, va_list args);
-int _fl_write_log_txt (FL_LogLevel level, _FL_LogContext ctx,
+int _fl_write_log_txt (FILE *out, FL_LogLevel level, _FL_LogContext ctx,
                        const char *fmt, va_list args);
 
 int _fl_write_log (FL_LogLevel level, _FL_LogContext ctx, const char *fmt, ...) {
   if (!_fl_do_logs)
     return 0;
 
+  FILE *out = __atomic_load_n(&_fl_log_stream, __ATOMIC_ACQUIRE);
+  if (!out)
+    out = stdout;
+
   va_list args;
   va_start(args, fmt);
 
   int result = 0;
+  flockfile(out);
 
   switch (_fl_log_format) {
     case FL_TXT:
-      result = _fl_write_log_txt   (level, ctx, fmt, args);
+      result = _fl_write_log_txt   (out, level, ctx, fmt, args);
       break;
     case FL_COLOR:
-      result = _fl_write_log_color (level, ctx, fmt, args);
+      result = _fl_write_log_color (out, level, ctx, fmt, args);
       break;
     default:
-      result = printf("Uknown log format value: %d\n", _fl_log_format);
+      result = fprintf(out, "Uknown log format value: %d\n", _fl_log_format);
       break;
   }
 
-  putchar('\n');
+  fputc('\n', out);
+  funlockfile(out);
 
   va_end(args);
 
   return result;
 }
 
-int _fl_write_log_txt (FL_LogLevel level, _FL_LogContext ctx,
+int _fl_write_log_txt (FILE *out, FL_LogLevel level, _FL_LogContext ctx,
                        const char *fmt, va_list args) {
   switch(level) {
    case FL_DEBUG:
-      printf("[debug][%s:%d] ", ctx.func, ctx.line);
+      fprintf(out, "[debug][%s:%d] ", ctx.func, ctx.line);
       break;
     case FL_INFO:
-      printf("[info][%s:%d] ", ctx.func, ctx.line);
+      fprintf(out, "[info][%s:%d] ", ctx.func, ctx.line);
       break;
     case FL_WARN:
-      printf("[warn][%s:%d] ", ctx.func, ctx.line);
+      fprintf(out, "[warn][%s:%d] ", ctx.func, ctx.line);
       break;
     case FL_ERROR:
-      printf("[error][%s:%d] ", ctx.func, ctx.line);
+      fprintf(out, "[error][%s:%d] ", ctx.func, ctx.line);
       break;
     default:
-      printf("[unknown(level = %d)][%s:%d] ", level, ctx.func, ctx.line);
+      fprintf(out, "[unknown(level = %d)][%s:%d] ", level, ctx.func, ctx.line);
       break;
   }
 
-  return vprintf(fmt, args);
+  return vfprintf(out, fmt, args);
 }
 
-int _fl_write_log_color (FL_LogLevel level, _FL_LogContext ctx,
+int _fl_write_log_color (FILE *out, FL_LogLevel level, _FL_LogContext ctx,
                          const char *fmt, va_list args) {
   switch(level) {
     case FL_DEBUG:
-      printf(COLOR_WHITE);
+      fprintf(out, COLOR_WHITE);
       break;
     case FL_INFO:
-      // printf(COLOR_GREEN);
+      // fprintf(out, COLOR_GREEN);
       break;
     case FL_WARN:
-      printf(COLOR_YELLOW);
+      fprintf(out, COLOR_YELLOW);
       break;
     case FL_ERROR:
-      printf(COLOR_RED);
+      fprintf(out, COLOR_RED);
       break;
     default:
       break;
   }
 
-  int result = _fl_write_log_txt(level, ctx, fmt, args);
+  int result = _fl_write_log_txt(out, level, ctx, fmt, args);
 
-  printf(COLOR_RESET);
+  fprintf(out, COLOR_RESET);
 
   return result;
 }
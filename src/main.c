@@ -2,41 +2,93 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include "app_args.h"
+#include "async_io.h"
+#include "perf.h"
+#include "pipeline.h"
 #include "evaluate.h"
-#include "parser.h"
-#include "arith.h"
+#include "execute.h"
+#include "script.h"
+#include "server.h"
+#include "session.h"
+#include "shm_server.h"
+#include "stats.h"
+#include "trace.h"
 #include "log.h"
-#include "polynomial.h"
 
-#define POLTORASHKA_URL "https://ded32.synology.me/~mipt-photo/photo/#!Search/album_323032323031303120d09fd0bed0bbd182d0bed180d0b0d188d0bad0b02f323032313034313320d09fd0bed0bbd182d0bed180d0b0d188d0bad0b0"
-#define PORNO_URL "https://vk.com/video63300907_456239570"
-
-void shell (Args args);
-EvalStatus eval_and_handle_errors (Env *env, Statement *command, Value *value);
-int execute_command (Env *env, const char *source);
-void open_url (const char *url);
+bool shell     (Args args);
+bool run_batch (Args args);
 const int MAX_SOURCE_LEN = 1024;
 
 
 int main (int argc, const char *argv[]) {
   Args args = get_args(argc, argv);
+  stats_enable(args.stats);
+  if (args.perf)
+    stats_enable_perf();
+  if (args.trace && !trace_enable(args.trace))
+    return 1;
 
   if (args.equation) {
     char solve_cmd[MAX_SOURCE_LEN + strlen("solve ")] = {};
     strcpy(solve_cmd, "solve ");
     strcat(solve_cmd, args.equation);
 
-    execute_command({}, solve_cmd);
-  } else
-    shell(args);
+    Env env = {};
+    env.precision = args.precision;
+
+    execute_command(&env, solve_cmd, stdout);
+    env_destroy(&env);
+  } else if (args.serve) {
+    ServerConfig config = {
+      .path            = args.serve,
+      .workers         = args.workers,
+      .max_connections = args.max_connections,
+      .max_buffer      = args.max_buffer,
+      .precision       = args.precision,
+    };
+
+    if (!serve(config))
+      return 1;
+  } else if (args.serve_shm) {
+    if (!serve_shm(args.serve_shm))
+      return 1;
+  } else if (args.script) {
+    if (!run_script_file(args.file, args.jobs, args.precision, stdout))
+      return 1;
+  } else {
+    struct stat input = {};
+    // watchers print between the lines and sessions follow the variables
+    // along, which only the shell does
+    if (fstat(fileno(args.file), &input) || !S_ISREG(input.st_mode) || args.reactive || args.session) {
+      if (!shell(args))
+        return 1;
+    } else if (!run_batch(args)) {
+      return 1;
+    }
+  }
+
+  if (args.stats)
+    stats_print(stdout);
+  if (args.perf)
+    perf_disable();
 
   return 0;
 }
 
-void shell (Args args) {
+/* run commands one by one, returns false if the session couldn't be opened */
+bool shell (Args args) {
   Env env = {};
+  env.reactive  = args.reactive;
+  env.precision = args.precision;
+
+  Session session = {};
+  if (args.session && !session_open(&session, args.session, &env)) {
+    env_destroy(&env);
+    return false;
+  }
 
   while (true) {
     if (fileno(args.file) == STDIN_FILENO)
@@ -46,124 +98,44 @@ void shell (Args args) {
 
     char *line = fgets(source, MAX_SOURCE_LEN, args.file);
     if (!line)
-      return;
+      break;
 
     source[strcspn(source, "\n")] = '\0';
     if (strlen(source) == 0)
       continue;
 
-    execute_command(&env, source);
+    execute_command(&env, source, stdout);
   }
-}
 
-int execute_command (Env *env, const char *source) {
-  Statement *command = (Statement *) calloc(1, sizeof(Statement));
-  int res = parse_stmt(source, command);
-
-  if (!res) {
-    LOG_ERROR("Could not parse command!");
-    return 0;
-  }
+  if (args.session)
+    session_close(&session);
 
-  int status = EVAL_OK;
-  Value val = {};
-  Solutions sols = {};
-
-  switch (command->cmd) {
-    case CMD_LET:
-      status = eval_and_handle_errors(env, command, &val);
-      if (status)
-        break;
-
-      env_set_value(env, command->var, val);
-      break;
-    case CMD_SOLVE:
-      status = eval_and_handle_errors(env, command, &val);
-      if (status)
-        break;
-
-      if (val.type != TP_POLYNOMIAL) {
-        LOG_ERROR("Expected a polynomial as an argument to solve, but got a number!");
-        break;
-      }
-
-      status = solve_polynomial(val.poly, &sols);
-      if (!status) {
-        LOG_ERROR("Could not solve this polynomial! Deg-4 and some deg-3 polys are not yet supported :(");
-        break;
-      }
-
-      printf("-> ");
-      print_polynomial(val.poly);
-      putchar('\n');
-
-      printf("-> ");
-      print_solutions(sols);
-      break;
-    case CMD_POLTORASHKA:
-      open_url(POLTORASHKA_URL);
-      break;
-    case CMD_PORNO:
-      open_url(PORNO_URL);
-      break;
-    case CMD_EXPR:
-      status = eval_and_handle_errors(env, command, &val);
-      if (status)
-        break;
-
-      printf("-> ");
-      print_value(val);
-      break;
-    default:
-      LOG_ERROR("Unknown command");
-  }
-
-  destory_stmt(command);
-  return status;
-}
-
-EvalStatus eval_and_handle_errors (Env *env, Statement *command, Value *val) {
-  EvalStatus status = eval_expr(env, command->expr, val);
-  switch (status) {
-    case EVAL_OK:
-      break;
-    case TOO_LARGE_DEGREE:
-      LOG_ERROR("Encountered a polynomial of degree larger than 4, which is currently not supported");
-      break;
-    case ZERO_DIVISION:
-      LOG_ERROR("Encountered division by zero!");
-      break;
-    case NO_VARIABLE:
-      LOG_ERROR("An unknown variable was referenced!");
-      break;
-    case DIFFERENT_POLY_VAR:
-      LOG_ERROR("Multivariable polynomials are not yet supported!");
-      break;
-    case TYPE_ERROR:
-      LOG_ERROR("Encountered type error!");
-      break;
-    case COMPLEX_POWER:
-      LOG_ERROR("Invalid power operation! Currently, you can only raise a rational number to a"
-                "rational power, a complex number to an integer power, or a polynomial to an integer power");
-      break;
-    case WTF_ERROR:
-    default:
-      LOG_ERROR("My brain exploded! Something went really wrong...");
-      break;
-  }
-
-  return status;
+  env_destroy(&env);
+  return true;
 }
 
-void open_url (const char *url) {
-  char command[1024];
-  sprintf(command, "firefox --new-tab %s", url);
-  int status = system(command);
-
-  if (status)
-    printf("Check your browser!\n");
-  else {
-    LOG_ERROR("Failed to open a browser tab :(");
-    LOG_ERROR("You can try to visit %s yourself though", url);
-  }
+/* execute a whole file in a pipeline, so that reading, solving and writing overlap */
+bool run_batch (Args args) {
+  // anything printed so far goes before the output
+  fflush(stdout);
+  // the output is written to the fd directly, logs of the stages would
+  // end up in the middle of its lines
+  fl_set_log_stream(stderr);
+
+  PipelineConfig config = {
+    .in_fd      = fileno(args.file),
+    .out_fd     = STDOUT_FILENO,
+    .batch_size = args.batch_size,
+    .backend    = args.io_thread ? ASYNC_IO_THREAD : ASYNC_IO_URING,
+    .precision  = args.precision,
+  };
+
+  PipelineReport report = {};
+  bool written = run_pipeline(config, &report);
+  fl_set_log_stream(NULL);
+
+  if (args.stats)
+    pipeline_print_report(stdout, &report);
+
+  return written;
 }
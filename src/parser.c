@@ -12,6 +12,8 @@
 
 #include "parser.h"
 #include "log.h"
+#include "alloc.h"
+#include "symbols.h"
 
 /*
  * V double_literal = #%lg;
@@ -19,23 +21,32 @@
  *
  *
  * V poly_var_literal = [a-z];
- *  identifier = [A-Z];
+ *  identifier = [A-Z] [A-Za-z0-9_]*;
+ *  parameter = '?' [1-9][0-9]*;
  *
  * V term    = factor ( ('+' | '-') factor )*;
  * V factor  = unary ( ('*' | '/') unary )*;
  * V unary   = '-'* call;
  *   call    = power ("(" expression ")")*;
  * V power   = primary ('^' primary)*;
- * V primary = num_literal | var_literal | poly_var_literal | "(" expression ")";
+ * V primary = num_literal | var_literal | poly_var_literal | parameter | "(" expression ")";
  *
  * V expression = term;
  *
- *  command = let_cmd | solve_cmd | poltorashka_cmd | porno_cmd | expression;
+ *  command = let_cmd | solve_cmd | poltorashka_cmd | porno_cmd | stats_cmd | prepare_cmd | exec_cmd | watch_cmd | expression;
  *
  *  let_cmd = "let" identifier "=" expression;
  *  solve_cmd = "solve" expression;
  *  poltorashka_cmd = "poltoraska";
  *  porno_cmd = "porno";
+ *  stats_cmd = "stats";
+ *  prepare_cmd = "prepare" name "=" (let_cmd | solve_cmd | expression);
+ *  exec_cmd = "exec" name num_literal*;
+ *  watch_cmd = "watch" expression;
+ *  name = [A-Za-z0-9_]+;
+ *
+ * Parameters are only allowed in a prepared statement, and the values of
+ * exec are read directly, without going through the expression parser.
  */
 
 int expression  (const char *str, int *current_index, Expr *output);
@@ -48,6 +59,9 @@ int primary     (const char *str, int *current_index, Expr *output);
 int num_literal (const char *str, int *current_index, Expr *output);
 int poly_var    (const char *str, int *current_index, Expr *output);
 int identifier  (const char *str, int *current_index, Expr *output);
+int parameter   (const char *str, int *current_index, Expr *output);
+
+size_t identifier_len (const char *str);
 
 int add_or_sub_consumer (const char *str, int *current_index, Operator *output);
 int div_or_mul_consumer (const char *str, int *current_index, Operator *output);
@@ -68,15 +82,20 @@ int a_consumer (char a, Operator op,
 
 void skip_spaces (const char *from, char *to);
 
+int   parse_stmt_params (const char *source, Statement *output, bool allow_params);
+Expr *parse_stmt_expr   (const char *source, bool allow_params);
+int   parse_prepare     (const char *source, Statement *output);
+int   parse_exec        (const char *source, Statement *output);
+
 int parse_expr (const char *source, Expr *output) {
-  char *compressed_source = (char *) calloc(strlen(source) + 5, sizeof(char));
+  char *compressed_source = (char *) counted_calloc(strlen(source) + 5, sizeof(char));
   skip_spaces(source, compressed_source);
 
   int current_index = 0;
   
   LOG_DEBUG("Compressed source: <%s>", compressed_source);
   int result = expression(compressed_source, &current_index, output);
-  free(compressed_source);
+  counted_free(compressed_source);
   return result;
 }
 
@@ -90,13 +109,46 @@ void destroy_expr (Expr *tree) {
       destroy_expr(tree->left );
       destroy_expr(tree->right);
       break;
+    case CONSTANT_POLY:
+      counted_free(tree->poly);
+      break;
+    case NUMBER:
+    case POLY_VAR:
+    case IDENTIFIER:
+    case PARAMETER:
+    case SLOT:
+    default:
+      break;
+  }
+  counted_free(tree);
+}
+
+Expr *clone_expr (const Expr *ast) {
+  if (!ast)
+    return NULL;
+
+  Expr *clone = (Expr *) counted_calloc(1, sizeof(Expr));
+  *clone = *ast;
+
+  switch (ast->type) {
+    case OPERATOR:
+      clone->left  = clone_expr(ast->left);
+      clone->right = clone_expr(ast->right);
+      break;
+    case CONSTANT_POLY:
+      clone->poly  = (Polynomial *) counted_malloc(sizeof(Polynomial));
+      *clone->poly = *ast->poly;
+      break;
     case NUMBER:
     case POLY_VAR:
     case IDENTIFIER:
+    case PARAMETER:
+    case SLOT:
     default:
       break;
   }
-  free(tree);
+
+  return clone;
 }
 
 void print_expr (const Expr *ast) {
@@ -137,13 +189,46 @@ void print_expr (const Expr *ast) {
       break;
     case IDENTIFIER:
       // LOG_DEBUG("Identifier!");
-      putchar(ast->var_name);
+      printf("%s", symbol_name(ast->symbol));
+      break;
+    case PARAMETER:
+      printf("?%d", ast->param);
+      break;
+    case CONSTANT_POLY:
+      putchar('(');
+      fprint_polynomial(stdout, *ast->poly);
+      putchar(')');
+      break;
+    case SLOT:
+      printf("%s", symbol_name(ast->slot_symbol));
       break;
     default:
       break;
   }
 }
 
+int expr_max_param (const Expr *ast) {
+  if (!ast)
+    return 0;
+
+  switch (ast->type) {
+    case OPERATOR: {
+      int left  = expr_max_param(ast->left);
+      int right = expr_max_param(ast->right);
+      return left > right ? left : right;
+    }
+    case PARAMETER:
+      return ast->param;
+    case NUMBER:
+    case POLY_VAR:
+    case IDENTIFIER:
+    case CONSTANT_POLY:
+    case SLOT:
+    default:
+      return 0;
+  }
+}
+
 int expression (const char *str, int *current_index, Expr *output) {
   int res = term(str, current_index, output);
   if (!res)
@@ -196,10 +281,10 @@ int unary (const char *str, int *current_index, Expr *output) {
   while (consume(str, current_index, '-'))
     flip = !flip;
   
-  Expr *left = (Expr *) calloc(1, sizeof(Expr));
+  Expr *left = (Expr *) counted_calloc(1, sizeof(Expr));
   if (!call(str, current_index, left)) {
     LOG_DEBUG("Failed to parse! Left <%s>", str + *current_index);
-    free(left);
+    counted_free(left);
     return 0;
   }
   
@@ -209,7 +294,7 @@ int unary (const char *str, int *current_index, Expr *output) {
     output->op   = OP_NEG;
   } else {
     *output = *left;
-    free(left);
+    counted_free(left);
   }
 
   LOG_DEBUG("Parsed! Left <%s>", str + *current_index);
@@ -217,11 +302,11 @@ int unary (const char *str, int *current_index, Expr *output) {
 }
 
 int call (const char *str, int *current_index, Expr *output) {
-  Expr *lhs = (Expr *) calloc(1, sizeof(Expr));
+  Expr *lhs = (Expr *) counted_calloc(1, sizeof(Expr));
 
   if (!power(str, current_index, lhs)) {
     LOG_DEBUG("Failed to parse! Left <%s>", str + *current_index);
-    free(lhs);
+    counted_free(lhs);
     return 0;
   }
   
@@ -232,12 +317,12 @@ int call (const char *str, int *current_index, Expr *output) {
   
   while ( consume    (str, current_index, '(')
        && (++call_chain)
-       && (rhs = (Expr *) calloc(1, sizeof(Expr)))
+       && (rhs = (Expr *) counted_calloc(1, sizeof(Expr)))
        && expression (str, current_index, rhs)
        && consume    (str, current_index, ')')) {
     call_chain++;
     
-    Expr *assembled  = (Expr *) calloc(1, sizeof(Expr));
+    Expr *assembled  = (Expr *) counted_calloc(1, sizeof(Expr));
     assembled->type  = OPERATOR;
     assembled->op    = OP_CALL;
     assembled->left  = lhs;
@@ -247,13 +332,13 @@ int call (const char *str, int *current_index, Expr *output) {
   }
 
   if (call_chain % 2) // odd - allocated rhs but didn't get to the cycle body
-    free(rhs);
+    counted_free(rhs);
 
   LOG_DEBUG("Parsed! Left <%s>", str + *current_index);
 
   *output = *lhs;
   LOG_DEBUG("Freed %p", lhs);
-  free(lhs);
+  counted_free(lhs);
   return 1;
 }
 
@@ -281,16 +366,26 @@ int primary (const char *str, int *current_index, Expr *output) {
   if (res)
     return res;
   res = identifier(str, current_index, output);
+  if (res)
+    return res;
+  res = parameter(str, current_index, output);
   if (res)
     return res;
   
   LOG_DEBUG("Trying to parse (<expr>)! Left: <%s>", str + *current_index);
 
-  if (consume    (str, current_index, '(')  && 
-      expression (str, current_index, output)  && 
-      consume    (str, current_index, ')'))
+  if (!consume    (str, current_index, '(') ||
+      !expression (str, current_index, output))
+    return 0;
+
+  if (consume(str, current_index, ')'))
     return 1;
 
+  // the parenthesis isn't closed, so the expression inside is thrown away
+  if (output->type == OPERATOR) {
+    destroy_expr(output->left);
+    destroy_expr(output->right);
+  }
   return 0;
 }
 
@@ -333,17 +428,50 @@ int poly_var (const char *str, int *current_index, Expr *output) {
 }
 
 int identifier (const char *str, int *current_index, Expr *output) {
-  char res = str[*current_index];
-  if ('A' <= res && res <= 'Z') {
-    (*current_index)++;
-    output->type = IDENTIFIER;
-    output->var_name = res;
-    LOG_DEBUG("Parsed %c! Left <%s>", res, str + *current_index);
-    return 1;
+  const char *start = str + *current_index;
+  if (!('A' <= *start && *start <= 'Z')) {
+    LOG_DEBUG("Failed %c! Left <%s>", *start, start);
+    return 0;
   }
 
-  LOG_DEBUG("Failed %c! Left <%s>", res, str + *current_index);
-  return 0;
+  size_t len = identifier_len(start);
+  if (len >= SYMBOL_MAX_LEN) {
+    LOG_DEBUG("Identifier is too long! Left <%s>", start);
+    return 0;
+  }
+
+  *current_index += (int) len;
+  output->type   = IDENTIFIER;
+  output->symbol = symbol_intern(start, len);
+  LOG_DEBUG("Parsed %s! Left <%s>", symbol_name(output->symbol), str + *current_index);
+  return 1;
+}
+
+/* length of the identifier that str starts with, if it starts with one */
+size_t identifier_len (const char *str) {
+  size_t len = 0;
+  while (isalnum(str[len]) || str[len] == '_')
+    len++;
+  return len;
+}
+
+int parameter (const char *str, int *current_index, Expr *output) {
+  const char *start = str + *current_index;
+  if (start[0] != '?' || start[1] < '1' || start[1] > '9')
+    return 0;
+
+  char *end = NULL;
+  long param = strtol(start + 1, &end, 10);
+  if (param > STMT_MAX_PARAMS) {
+    LOG_DEBUG("Too many parameters! Left <%s>", start);
+    return 0;
+  }
+
+  *current_index += (int) (end - start);
+  output->type  = PARAMETER;
+  output->param = (int) param;
+  LOG_DEBUG("Parsed ?%ld! Left <%s>", param, str + *current_index);
+  return 1;
 }
 
 void skip_spaces (const char *in, char *out) {
@@ -391,22 +519,23 @@ int binary_level (
     int (*op_consumer)(const char *, int *, Operator *),
     const char *str, int *current_index, Expr *output) {
   
-  Expr *lhs = (Expr *) calloc(1, sizeof(Expr));
+  Expr *lhs = (Expr *) counted_calloc(1, sizeof(Expr));
   if (lower && !lower(str, current_index, lhs)) {
-    free(lhs);
+    counted_free(lhs);
     return 0;
   }
   
   Operator op = {};
   while (op_consumer(str, current_index, &op)) {
-    Expr *rhs = (Expr *) calloc(1, sizeof(Expr));
+    Expr *rhs = (Expr *) counted_calloc(1, sizeof(Expr));
     if (lower && !lower(str, current_index, rhs)) {
-      free(lhs);
+      counted_free(rhs);
+      destroy_expr(lhs);
       return 0;
     }
     
 
-    Expr *assembled  = (Expr *) calloc(1, sizeof(Expr));
+    Expr *assembled  = (Expr *) counted_calloc(1, sizeof(Expr));
     assembled->type  = OPERATOR;
     assembled->left  = lhs;
     assembled->right = rhs;
@@ -417,25 +546,28 @@ int binary_level (
 
   *output = *lhs;
   LOG_DEBUG("Freed %p", lhs);
-  free(lhs);
+  counted_free(lhs);
 
   return 1;
 }
 
 int parse_stmt (const char *source, Statement *output) {
+  return parse_stmt_params(source, output, false);
+}
+
+/* parse_stmt, which only takes parameters in the expression if allow_params is set */
+int parse_stmt_params (const char *source, Statement *output, bool allow_params) {
   int current_index = 0;
-  char var_name[2];
+  char var_name[SYMBOL_MAX_LEN];
 
-  if (sscanf(source, " let %1[A-Z] =%n", var_name, &current_index) == 1) {
-    Expr *expr = (Expr *) calloc(1, sizeof(Expr));
-    if (!parse_expr(source + current_index, expr)) {
-      free(expr);
-      LOG_DEBUG("Failed to parse expression!");
+  if (sscanf(source, " let %63[A-Za-z0-9_] =%n", var_name, &current_index) == 1 && current_index &&
+      'A' <= var_name[0] && var_name[0] <= 'Z') {
+    Expr *expr = parse_stmt_expr(source + current_index, allow_params);
+    if (!expr)
       return 0;
-    }
 
     output->cmd = CMD_LET;
-    output->var = var_name[0];
+    output->var = symbol_intern(var_name, strlen(var_name));
     output->expr = expr;
     return 1;
   }
@@ -455,34 +587,145 @@ int parse_stmt (const char *source, Statement *output) {
     return 1;
   }
 
+  if (!strcmp(cmd, "stats")) {
+    output->cmd = CMD_STATS;
+    return 1;
+  }
+
+  if (!strcmp(cmd, "snapshot")) {
+    output->cmd = CMD_SNAPSHOT;
+    return !allow_params;
+  }
+
+  if (!strcmp(cmd, "rollback")) {
+    output->cmd = CMD_ROLLBACK;
+    return !allow_params;
+  }
+
+  // prepared statements can't be nested
+  if (!strcmp(cmd, "prepare"))
+    return !allow_params && parse_prepare(source + current_index, output);
+
+  if (!strcmp(cmd, "exec"))
+    return !allow_params && parse_exec(source + current_index, output);
+
   if (!strcmp(cmd, "solve")) {
-    Expr *expr = (Expr *) calloc(1, sizeof(Expr));
-    if (!parse_expr(source + current_index, expr)) {
-      free(expr);
-      LOG_DEBUG("Failed to parse expression!");
+    Expr *expr = parse_stmt_expr(source + current_index, allow_params);
+    if (!expr)
       return 0;
-    }
 
     output->cmd = CMD_SOLVE;
     output->expr = expr;
     return 1;
   }
 
-  Expr *expr = (Expr *) calloc(1, sizeof(Expr));
+  // a watcher outlives the statement, so it can't have parameters
+  if (!strcmp(cmd, "watch")) {
+    Expr *expr = allow_params ? NULL : parse_stmt_expr(source + current_index, false);
+    if (!expr)
+      return 0;
+
+    output->cmd = CMD_WATCH;
+    output->expr = expr;
+    return 1;
+  }
+
+  Expr *expr = parse_stmt_expr(source, allow_params);
+  if (!expr)
+    return 0;
+
+  output->cmd = CMD_EXPR;
+  output->expr = expr;
+  return 1;
+}
+
+/* parse the expression of a statement, returns NULL if that fails */
+Expr *parse_stmt_expr (const char *source, bool allow_params) {
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
   if (!parse_expr(source, expr)) {
-    free(expr);
+    counted_free(expr);
     LOG_DEBUG("Failed to parse expression!");
+    return NULL;
+  }
+
+  if (!allow_params && expr_max_param(expr)) {
+    destroy_expr(expr);
+    LOG_DEBUG("Parameters are only allowed in prepared statements!");
+    return NULL;
+  }
+
+  return expr;
+}
+
+int parse_prepare (const char *source, Statement *output) {
+  int current_index = 0;
+  if (sscanf(source, " %31[A-Za-z0-9_] =%n", output->name, &current_index) != 1 || !current_index) {
+    LOG_DEBUG("Expected a name and '='! Left <%s>", source);
     return 0;
   }
 
-  output->cmd = CMD_EXPR;
-  output->expr = expr;
+  Statement *prepared = (Statement *) counted_calloc(1, sizeof(Statement));
+  if (!parse_stmt_params(source + current_index, prepared, true)) {
+    counted_free(prepared);
+    return 0;
+  }
+
+  output->cmd         = CMD_PREPARE;
+  output->prepared    = prepared;
+  output->param_count = expr_max_param(prepared->expr);
+  return 1;
+}
+
+int parse_exec (const char *source, Statement *output) {
+  int current_index = 0;
+  if (sscanf(source, " %31[A-Za-z0-9_]%n", output->name, &current_index) != 1) {
+    LOG_DEBUG("Expected a name! Left <%s>", source);
+    return 0;
+  }
+
+  complex_t args[STMT_MAX_PARAMS] = {};
+  int arg_count = 0;
+  const char *current = source + current_index;
+
+  while (true) {
+    while (isspace(*current))
+      current++;
+    if (!*current)
+      break;
+
+    char *end = NULL;
+    double value = strtod(current, &end);
+    if (end == current || arg_count == STMT_MAX_PARAMS) {
+      LOG_DEBUG("Expected a number! Left <%s>", current);
+      return 0;
+    }
+
+    if (*end == 'i') {
+      args[arg_count++] = {0, value};
+      end++;
+    } else {
+      args[arg_count++] = {value};
+    }
+
+    current = end;
+  }
+
+  output->cmd       = CMD_EXEC;
+  output->arg_count = arg_count;
+  if (arg_count) {
+    output->args = (complex_t *) counted_calloc((size_t) arg_count, sizeof(complex_t));
+    memcpy(output->args, args, (size_t) arg_count * sizeof(complex_t));
+  }
+
   return 1;
 }
 
 void destory_stmt (Statement *stmt) {
   destroy_expr(stmt->expr);
-  free(stmt);
+  if (stmt->prepared)
+    destory_stmt(stmt->prepared);
+  counted_free(stmt->args);
+  counted_free(stmt);
 }
 
 void print_stmt (const Statement *stmt) {
@@ -493,17 +736,41 @@ void print_stmt (const Statement *stmt) {
     case CMD_PORNO:
       printf("porno");
       break;
+    case CMD_STATS:
+      printf("stats");
+      break;
+    case CMD_SNAPSHOT:
+      printf("snapshot");
+      break;
+    case CMD_ROLLBACK:
+      printf("rollback");
+      break;
     case CMD_LET:
-      printf("left %c = ", stmt->var);
+      printf("left %s = ", symbol_name(stmt->var));
       print_expr(stmt->expr);
       break;
     case CMD_SOLVE:
       printf("solve ");
       print_expr(stmt->expr);
       break;
+    case CMD_WATCH:
+      printf("watch ");
+      print_expr(stmt->expr);
+      break;
     case CMD_EXPR:
       print_expr(stmt->expr);
       break;
+    case CMD_PREPARE:
+      printf("prepare %s = ", stmt->name);
+      print_stmt(stmt->prepared);
+      return;
+    case CMD_EXEC:
+      printf("exec %s", stmt->name);
+      for (int i = 0; i < stmt->arg_count; i++) {
+        putchar(' ');
+        print_complex(stmt->args[i]);
+      }
+      break;
     default:
       break;
   }
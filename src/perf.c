@@ -0,0 +1,201 @@
+/**
+ * @file
+ * @brief Hardware performance counters through Linux `perf_event_open`
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+#endif
+
+#include "perf.h"
+#include "log.h"
+
+const char *PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] = {
+  "cycles",
+  "instructions",
+  "branch-misses",
+  "cache-misses",
+};
+
+/// The counter group of a single thread
+typedef struct {
+  /// Whether opening was attempted in this thread
+  bool opened;
+  /// Group leader, or -1 if counters are unavailable
+  int  leader;
+  /// The other counters of the group, or -1 for the ones that are missing
+  int  members[PERF_COUNTER_COUNT];
+  /// Position of each counter in the group read buffer, or -1 if it's missing
+  int  slot[PERF_COUNTER_COUNT];
+  /// Number of counters in the group
+  int  count;
+} PerfGroup;
+
+bool _perf_available = false;
+bool _perf_has[PERF_COUNTER_COUNT] = {};
+
+thread_local PerfGroup _perf_group = {};
+
+// closes the group of a thread when it exits
+pthread_key_t  _perf_group_key  = {};
+pthread_once_t _perf_group_once = PTHREAD_ONCE_INIT;
+
+bool perf_open_group  (PerfGroup *group);
+void perf_close_group (void *group);
+void perf_create_key  (void);
+
+#ifdef __linux__
+
+int open_counter (uint64_t config, int group_fd);
+
+int open_counter (uint64_t config, int group_fd) {
+  struct perf_event_attr attr = {};
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.config         = config;
+  attr.disabled       = group_fd == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // this thread, any cpu
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+bool perf_open_group (PerfGroup *group) {
+  const uint64_t configs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+  };
+
+  group->opened = true;
+  group->count  = 0;
+  group->leader = open_counter(configs[PERF_CYCLES], -1);
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    group->slot[i]    = -1;
+    group->members[i] = -1;
+  }
+
+  if (group->leader < 0)
+    return false;
+
+  pthread_once(&_perf_group_once, perf_create_key);
+  pthread_setspecific(_perf_group_key, group);
+
+  group->slot[PERF_CYCLES] = group->count++;
+
+  for (int i = PERF_CYCLES + 1; i < PERF_COUNTER_COUNT; i++) {
+    // a missing event only loses it's column, the rest of the group still works
+    group->members[i] = open_counter(configs[i], group->leader);
+    if (group->members[i] >= 0)
+      group->slot[i] = group->count++;
+  }
+
+  ioctl(group->leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+  ioctl(group->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+void perf_read (PerfSample *sample) {
+  *sample = {};
+  if (!_perf_available)
+    return;
+
+  if (!_perf_group.opened)
+    perf_open_group(&_perf_group);
+  if (_perf_group.leader < 0)
+    return;
+
+  // nr, time_enabled, time_running, values[nr]
+  uint64_t buffer[3 + PERF_COUNTER_COUNT] = {};
+  if (read(_perf_group.leader, buffer, sizeof(buffer)) < (ssize_t) (3 * sizeof(uint64_t)))
+    return;
+
+  // the group could have been multiplexed with other events, extrapolate
+  double scale = buffer[2] ? (double) buffer[1] / (double) buffer[2] : 1;
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (_perf_group.slot[i] >= 0)
+      sample->values[i] = (uint64_t) ((double) buffer[3 + _perf_group.slot[i]] * scale);
+  }
+}
+
+void perf_create_key (void) {
+  pthread_key_create(&_perf_group_key, perf_close_group);
+}
+
+#else
+
+bool perf_open_group (PerfGroup *group) {
+  group->opened = true;
+  group->leader = -1;
+  return false;
+}
+
+void perf_read (PerfSample *sample) {
+  *sample = {};
+}
+
+#endif
+
+bool perf_enable (void) {
+  if (!_perf_group.opened)
+    perf_open_group(&_perf_group);
+
+  if (_perf_group.leader < 0) {
+    LOG_WARN("Hardware performance counters are unavailable, falling back to timers only");
+    _perf_available = false;
+    return false;
+  }
+
+  _perf_available = true;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    _perf_has[i] = _perf_group.slot[i] >= 0;
+
+  return true;
+}
+
+void perf_disable (void) {
+  _perf_available = false;
+  perf_close_group(&_perf_group);
+}
+
+/* close every counter of a group, which is opened again on the next perf_read */
+void perf_close_group (void *group) {
+  PerfGroup *perf_group = (PerfGroup *) group;
+  if (!perf_group->opened || perf_group->leader < 0)
+    return;
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (perf_group->members[i] >= 0)
+      close(perf_group->members[i]);
+  }
+  close(perf_group->leader);
+
+  *perf_group = {};
+}
+
+bool perf_enabled (void) {
+  return _perf_available;
+}
+
+bool perf_has_counter (PerfCounter counter) {
+  return _perf_available && _perf_has[counter];
+}
+
+PerfSample perf_diff (PerfSample start, PerfSample end) {
+  PerfSample diff = {};
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    diff.values[i] = end.values[i] - start.values[i];
+  return diff;
+}
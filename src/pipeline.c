@@ -0,0 +1,442 @@
+/**
+ * @file
+ * @brief Batch execution as a pipeline of three threads
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+  #include <linux/futex.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+#endif
+
+#include "pipeline.h"
+#include "execute.h"
+#include "evaluate.h"
+#include "parser.h"
+#include "timer.h"
+#include "trace.h"
+#include "log.h"
+
+/// Polls of a queue before going to sleep on it
+#define QUEUE_SPIN_LIMIT 64
+
+/// Keeps the fields that different threads write on different cache lines
+#define QUEUE_CACHE_LINE __attribute__((aligned(64)))
+
+/// A line and what became of it
+typedef struct {
+  /// NULL if the line didn't parse
+  Statement    *stmt;
+  /// What #parse_command reported about a line that didn't parse
+  char         *error;
+  CommandResult result;
+} Record;
+
+typedef struct {
+  Record *records;
+  size_t  count;
+  /// The input ended, no batches come after this one
+  bool    last;
+} Batch;
+
+/// A single-producer single-consumer ring of batches
+typedef struct {
+  /// Next batch to pop, only written by the consumer
+  QUEUE_CACHE_LINE uint64_t head;
+  /// Next batch to push, only written by the producer
+  QUEUE_CACHE_LINE uint64_t tail;
+
+  /// Futex words bumped on every push and pop, a side that can't go on
+  /// sleeps on the one of the other side
+  QUEUE_CACHE_LINE uint32_t pushes;
+  uint32_t consumer_sleeping;
+  QUEUE_CACHE_LINE uint32_t pops;
+  uint32_t producer_sleeping;
+
+  /// Most batches in the queue at once
+  size_t   capacity;
+  Batch   *items[PIPELINE_BATCHES];
+} BatchQueue;
+
+typedef struct {
+  PipelineConfig  config;
+  /// Each I/O stage has its own, as they can't be shared between threads
+  AsyncIo        *read_io;
+  AsyncIo        *write_io;
+  Batch           batches[PIPELINE_BATCHES];
+  /// Written batches, back to the parse stage
+  BatchQueue      free_batches;
+  BatchQueue      parsed;
+  BatchQueue      solved;
+  PipelineReport *report;
+  /// Whether all of the output was written
+  bool            written;
+} Pipeline;
+
+const char *STAGE_NAMES[STAGE_COUNT] = {
+  "parse",
+  "solve",
+  "write",
+};
+
+bool   queue_try_push (BatchQueue *queue, Batch *batch);
+Batch *queue_try_pop  (BatchQueue *queue);
+void   queue_push     (BatchQueue *queue, Batch *batch, uint64_t *waited_ns);
+Batch *queue_pop      (BatchQueue *queue, uint64_t *waited_ns);
+void   queue_wait     (uint32_t *word, uint32_t *sleeping, uint32_t seen, unsigned int *spins);
+void   queue_wake     (uint32_t *word, uint32_t *sleeping);
+void   release_batch  (Batch *batch);
+void  *parse_stage    (void *arg);
+void  *solve_stage    (void *arg);
+void  *write_stage    (void *arg);
+
+bool run_pipeline (PipelineConfig config, PipelineReport *report) {
+  Pipeline *pipeline = (Pipeline *) calloc(1, sizeof(Pipeline));
+  pipeline->config = config;
+  pipeline->report = report;
+  *report = {};
+
+  pipeline->read_io  = async_io_create(config.backend);
+  pipeline->write_io = pipeline->read_io ? async_io_create(config.backend) : NULL;
+  if (!pipeline->write_io) {
+    if (pipeline->read_io)
+      async_io_destroy(pipeline->read_io);
+    free(pipeline);
+    return false;
+  }
+
+  pipeline->free_batches.capacity = PIPELINE_BATCHES;
+  pipeline->parsed.capacity       = PIPELINE_QUEUE_LEN;
+  pipeline->solved.capacity       = PIPELINE_QUEUE_LEN;
+
+  for (size_t i = 0; i < PIPELINE_BATCHES; i++) {
+    Batch *batch = &pipeline->batches[i];
+    batch->records = (Record *) calloc(config.batch_size, sizeof(Record));
+    queue_try_push(&pipeline->free_batches, batch);
+  }
+
+  void *(*stages[STAGE_COUNT])(void *) = { parse_stage, solve_stage, write_stage };
+  pthread_t threads[STAGE_COUNT] = {};
+  uint64_t  start = fl_now_ns();
+
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    int error = pthread_create(&threads[stage], NULL, stages[stage], pipeline);
+    if (error) {
+      // the stages wait for each other, so there is no way to go on without this one
+      LOG_ERROR("Could not start the %s stage: %s", STAGE_NAMES[stage], strerror(error));
+      exit(1);
+    }
+  }
+
+  for (int stage = 0; stage < STAGE_COUNT; stage++)
+    pthread_join(threads[stage], NULL);
+
+  report->wall_ns = fl_now_ns() - start;
+  bool written = pipeline->written;
+
+  for (size_t i = 0; i < PIPELINE_BATCHES; i++)
+    free(pipeline->batches[i].records);
+  async_io_destroy(pipeline->read_io);
+  async_io_destroy(pipeline->write_io);
+  free(pipeline);
+
+  return written;
+}
+
+void pipeline_print_report (FILE *out, const PipelineReport *report) {
+  // a run too short to measure is reported as all zeros
+  double wall = report->wall_ns ? (double) report->wall_ns : 1;
+
+  fprintf(out, "%-10s %10s %10s %10s %10s %12s\n",
+          "stage", "records", "busy %", "starved %", "blocked %", "records/s");
+
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    const StageReport *stats = &report->stages[stage];
+    double busy = (double) stats->busy_ns;
+
+    fprintf(out, "%-10s %10llu %10.1lf %10.1lf %10.1lf %12.0lf\n",
+            STAGE_NAMES[stage], (unsigned long long) stats->records,
+            100 * busy / wall,
+            100 * (double) stats->starved_ns / wall,
+            100 * (double) stats->blocked_ns / wall,
+            stats->busy_ns ? (double) stats->records / busy * 1e9 : 0);
+  }
+
+  fprintf(out, "wall time: %.3lf ms\n", (double) report->wall_ns / 1e6);
+}
+
+// ------- QUEUES -------
+
+bool queue_try_push (BatchQueue *queue, Batch *batch) {
+  uint64_t tail = queue->tail;
+  if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == queue->capacity)
+    return false;
+
+  queue->items[tail % PIPELINE_BATCHES] = batch;
+  __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+Batch *queue_try_pop (BatchQueue *queue) {
+  uint64_t head = queue->head;
+  if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  Batch *batch = queue->items[head % PIPELINE_BATCHES];
+  __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+  return batch;
+}
+
+/* push, waiting for room if the queue is full, the time that takes is added to waited_ns */
+void queue_push (BatchQueue *queue, Batch *batch, uint64_t *waited_ns) {
+  unsigned int spins = 0;
+  uint64_t     start = 0;
+
+  while (true) {
+    uint32_t pops = __atomic_load_n(&queue->pops, __ATOMIC_ACQUIRE);
+    if (queue_try_push(queue, batch))
+      break;
+
+    if (!start)
+      start = fl_now_ns();
+    queue_wait(&queue->pops, &queue->producer_sleeping, pops, &spins);
+  }
+
+  if (start)
+    *waited_ns += fl_now_ns() - start;
+
+  __atomic_fetch_add(&queue->pushes, 1, __ATOMIC_RELEASE);
+  queue_wake(&queue->pushes, &queue->consumer_sleeping);
+}
+
+/* pop, waiting for a batch if the queue is empty, the time that takes is added to waited_ns */
+Batch *queue_pop (BatchQueue *queue, uint64_t *waited_ns) {
+  unsigned int spins = 0;
+  uint64_t     start = 0;
+  Batch       *batch = NULL;
+
+  while (true) {
+    uint32_t pushes = __atomic_load_n(&queue->pushes, __ATOMIC_ACQUIRE);
+    if ((batch = queue_try_pop(queue)))
+      break;
+
+    if (!start)
+      start = fl_now_ns();
+    queue_wait(&queue->pushes, &queue->consumer_sleeping, pushes, &spins);
+  }
+
+  if (start)
+    *waited_ns += fl_now_ns() - start;
+
+  __atomic_fetch_add(&queue->pops, 1, __ATOMIC_RELEASE);
+  queue_wake(&queue->pops, &queue->producer_sleeping);
+  return batch;
+}
+
+/* spin for a while, then sleep until word changes from seen */
+void queue_wait (uint32_t *word, uint32_t *sleeping, uint32_t seen, unsigned int *spins) {
+  if (++*spins < QUEUE_SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+    return;
+  }
+
+  __atomic_store_n(sleeping, 1, __ATOMIC_RELAXED);
+
+  // pairs with the fence in queue_wake: either the other side sees us
+  // sleeping, or we see its update here
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(word, __ATOMIC_RELAXED) == seen) {
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+    sched_yield();
+#endif
+  }
+
+  __atomic_store_n(sleeping, 0, __ATOMIC_RELAXED);
+}
+
+void queue_wake (uint32_t *word, uint32_t *sleeping) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+#ifdef __linux__
+  if (__atomic_load_n(sleeping, __ATOMIC_RELAXED))
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+  (void) word;
+  (void) sleeping;
+#endif
+}
+
+// ------- STAGES -------
+
+/* free the statements of a batch that came back, in the thread that parsed them */
+void release_batch (Batch *batch) {
+  for (size_t i = 0; i < batch->count; i++) {
+    Record *record = &batch->records[i];
+    if (record->stmt)
+      destory_stmt(record->stmt);
+
+    free(record->error);
+    record->error = NULL;
+  }
+
+  batch->count = 0;
+  batch->last  = false;
+}
+
+void *parse_stage (void *arg) {
+  Pipeline    *pipeline = (Pipeline *) arg;
+  StageReport *report   = &pipeline->report->stages[STAGE_PARSE];
+  uint64_t     start    = fl_now_ns();
+
+  AsyncReader reader = {};
+  async_reader_open(&reader, pipeline->read_io, pipeline->config.in_fd);
+
+  // parse errors are reported here and go along with their records, so that
+  // they are written in order with the rest of the output
+  char  *errors     = NULL;
+  size_t errors_len = 0;
+  FILE  *error_sink = open_memstream(&errors, &errors_len);
+
+  bool last = false;
+
+  while (!last) {
+    Batch *batch = queue_pop(&pipeline->free_batches, &report->blocked_ns);
+    release_batch(batch);
+
+    TRACE_BEGIN(parse);
+    const char *source = NULL;
+    while (batch->count < pipeline->config.batch_size && (source = async_reader_line(&reader))) {
+      if (!*source)
+        continue;
+
+      Record *record = &batch->records[batch->count++];
+      record->stmt = parse_command(source, error_sink);
+
+      if (!record->stmt && error_sink) {
+        fflush(error_sink);
+        record->error = strndup(errors, (size_t) ftell(error_sink));
+        rewind(error_sink);
+      }
+    }
+    TRACE_END(parse, "parse_batch");
+
+    last = batch->count < pipeline->config.batch_size;
+    batch->last = last;
+    report->records += batch->count;
+
+    queue_push(&pipeline->parsed, batch, &report->blocked_ns);
+  }
+
+  report->busy_ns = fl_now_ns() - start - report->starved_ns - report->blocked_ns;
+  async_reader_close(&reader);
+
+  if (error_sink)
+    fclose(error_sink);
+  free(errors);
+
+  // every batch comes back once it's written, wait for all of them to free
+  // the statements that are left
+  uint64_t waited = 0;
+  for (size_t i = 0; i < PIPELINE_BATCHES; i++)
+    release_batch(queue_pop(&pipeline->free_batches, &waited));
+
+  return NULL;
+}
+
+void *solve_stage (void *arg) {
+  Pipeline    *pipeline = (Pipeline *) arg;
+  StageReport *report   = &pipeline->report->stages[STAGE_SOLVE];
+  uint64_t     start    = fl_now_ns();
+
+  // the polynomials of a batch are solved together, once all of it is evaluated
+  Env env = {};
+  env.precision   = pipeline->config.precision;
+  env.defer_solve = true;
+
+  CommandResult **unsolved = (CommandResult **) calloc(pipeline->config.batch_size, sizeof(CommandResult *));
+  bool            last     = false;
+
+  while (!last) {
+    Batch *batch = queue_pop(&pipeline->parsed, &report->starved_ns);
+
+    TRACE_BEGIN(solve);
+    size_t unsolved_count = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+      Record *record = &batch->records[i];
+
+      if (record->stmt) {
+        run_statement(&env, record->stmt, &record->result);
+      } else {
+        record->result = {};
+        record->result.error = PARSE_ERROR;
+      }
+
+      if (record->result.cmd == CMD_SOLVE && !record->result.error)
+        unsolved[unsolved_count++] = &record->result;
+    }
+
+    solve_results(unsolved, unsolved_count, env.precision);
+    TRACE_END(solve, "solve_batch");
+
+    last = batch->last;
+    report->records += batch->count;
+    queue_push(&pipeline->solved, batch, &report->blocked_ns);
+  }
+
+  report->busy_ns = fl_now_ns() - start - report->starved_ns - report->blocked_ns;
+  free(unsolved);
+  env_destroy(&env);
+  return NULL;
+}
+
+void *write_stage (void *arg) {
+  Pipeline    *pipeline = (Pipeline *) arg;
+  StageReport *report   = &pipeline->report->stages[STAGE_WRITE];
+  uint64_t     start    = fl_now_ns();
+
+  AsyncWriter writer = {};
+  async_writer_open(&writer, pipeline->write_io, pipeline->config.out_fd);
+  FILE *out = async_writer_stream(&writer);
+
+  bool last = false;
+
+  while (!last) {
+    Batch *batch = queue_pop(&pipeline->solved, &report->starved_ns);
+
+    TRACE_BEGIN(write);
+    for (size_t i = 0; i < batch->count; i++) {
+      const Record *record = &batch->records[i];
+      if (record->error)
+        fputs(record->error, out);
+      else
+        print_result(&record->result, out);
+    }
+    TRACE_END(write, "write_batch");
+
+    last = batch->last;
+    report->records += batch->count;
+    queue_push(&pipeline->free_batches, batch, &report->blocked_ns);
+  }
+
+  fclose(out);
+  pipeline->written = async_writer_close(&writer);
+
+  report->busy_ns = fl_now_ns() - start - report->starved_ns - report->blocked_ns;
+  return NULL;
+}
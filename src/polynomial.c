@@ -4,7 +4,9 @@
  */
 
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "polynomial.h"
 #include "complex.h"
@@ -12,6 +14,9 @@
 
 const int INFINITE_SOLUTIONS = -1;
 
+/// Room for the text of a root, see #fprint_complex
+#define ROOT_TEXT_LEN 64
+
 int polynomial_deg (Polynomial p) {
   int res = -1;
   for (int i = 0; i < POLY_COEFF_LEN; i++)
@@ -21,68 +26,115 @@ int polynomial_deg (Polynomial p) {
   return res;
 }
 
-PolynomialError polynomial_negate (Polynomial a, Polynomial *output) {
-  *output = a;
+bool polynomial_is_real (const Polynomial *p) {
   for (int i = 0; i < POLY_COEFF_LEN; i++)
-    output->coeffs[i] = cmplx_negate(output->coeffs[i]);
+    if (fabs(p->coeffs[i].imag) > 0)
+      return false;
 
+  return true;
+}
+
+PolynomialError polynomial_negate (Polynomial a, Polynomial *output) {
+  polynomial_negate_inplace(&a);
+  *output = a;
   return POLY_OK;
 }
 
 PolynomialError polynomial_add (Polynomial a, Polynomial b, Polynomial *output) {
-  if (a.var != b.var) {
-    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", a.var, b.var);
+  PolynomialError err = polynomial_add_inplace(&a, &b);
+  if (!err)
+    *output = a;
+
+  return err;
+}
+
+PolynomialError polynomial_sub (Polynomial a, Polynomial b, Polynomial *output) {
+  PolynomialError err = polynomial_sub_inplace(&a, &b);
+  if (!err)
+    *output = a;
+
+  return err;
+}
+
+PolynomialError polynomial_mul (Polynomial a, Polynomial b, Polynomial *output) {
+  PolynomialError err = polynomial_mul_inplace(&a, &b);
+  if (!err)
+    *output = a;
+
+  return err;
+}
+
+void polynomial_negate_inplace (Polynomial *acc) {
+  for (int i = 0; i < POLY_COEFF_LEN; i++)
+    acc->coeffs[i] = cmplx_negate(acc->coeffs[i]);
+}
+
+PolynomialError polynomial_add_inplace (Polynomial *acc, const Polynomial *b) {
+  if (acc->var != b->var) {
+    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", acc->var, b->var);
     return POLY_DIFFERENT_VAR;
   }
 
-  Polynomial res = { .var = a.var };
-
   for (int i = 0; i < POLY_COEFF_LEN; i++)
-    res.coeffs[i] = cmplx_add(a.coeffs[i], b.coeffs[i]);
+    acc->coeffs[i] = cmplx_add(acc->coeffs[i], b->coeffs[i]);
 
-  *output = res;
   return POLY_OK;
 }
 
-PolynomialError polynomial_sub (Polynomial a, Polynomial b, Polynomial *output) {
-  if (a.var != b.var) {
-    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", a.var, b.var);
+PolynomialError polynomial_sub_inplace (Polynomial *acc, const Polynomial *b) {
+  if (acc->var != b->var) {
+    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", acc->var, b->var);
     return POLY_DIFFERENT_VAR;
   }
 
-  Polynomial res = { .var = a.var };
+  for (int i = 0; i < POLY_COEFF_LEN; i++)
+    acc->coeffs[i] = cmplx_sub(acc->coeffs[i], b->coeffs[i]);
+
+  return POLY_OK;
+}
+
+void polynomial_scale_inplace (Polynomial *acc, complex_t k) {
+  for (int i = 0; i < POLY_COEFF_LEN; i++)
+    acc->coeffs[i] = cmplx_mul(acc->coeffs[i], k);
+}
+
+PolynomialError polynomial_fma_inplace (Polynomial *acc, const Polynomial *b, complex_t k) {
+  if (acc->var != b->var) {
+    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", acc->var, b->var);
+    return POLY_DIFFERENT_VAR;
+  }
 
   for (int i = 0; i < POLY_COEFF_LEN; i++)
-    res.coeffs[i] = cmplx_sub(a.coeffs[i], b.coeffs[i]);
+    acc->coeffs[i] = cmplx_add(acc->coeffs[i], cmplx_mul(b->coeffs[i], k));
 
-  *output = res;
   return POLY_OK;
 }
 
-PolynomialError polynomial_mul (Polynomial a, Polynomial b, Polynomial *output) {
-  if (a.var != b.var) {
-    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", a.var, b.var);
+PolynomialError polynomial_mul_inplace (Polynomial *acc, const Polynomial *b) {
+  if (acc->var != b->var) {
+    LOG_DEBUG("Encountered polynomials with different variables - %c and %c", acc->var, b->var);
     return POLY_DIFFERENT_VAR;
   }
 
-  if (polynomial_deg(a) + polynomial_deg(b) > POLY_MAX_DEG)
+  int deg_a = polynomial_deg(*acc);
+  int deg_b = polynomial_deg(*b);
+  if (deg_a + deg_b > POLY_MAX_DEG)
     return POLY_TOO_LARGE;
-  
-  Polynomial res = { .var = a.var };
 
-  for (int i = 0; i < POLY_COEFF_LEN; i++) {
-    for (int j = 0; j < POLY_COEFF_LEN; j++) {
-      if (i + j > POLY_MAX_DEG)
-        continue;
-
-      res.coeffs[i + j] = cmplx_add(
-        cmplx_mul(a.coeffs[i], b.coeffs[j]), 
-        res.coeffs[i + j]
-      );
-    }
+  if (acc == b) {
+    Polynomial copy = *b;
+    return polynomial_mul_inplace(acc, &copy);
+  }
+
+  // from the top down, coefficient k only needs the ones of acc below and at it
+  for (int k = POLY_MAX_DEG; k >= 0; k--) {
+    complex_t sum = {};
+    for (int i = 0; i <= k; i++)
+      sum = cmplx_add(cmplx_mul(acc->coeffs[i], b->coeffs[k - i]), sum);
+
+    acc->coeffs[k] = sum;
   }
 
-  *output = res;
   return POLY_OK;
 }
 
@@ -101,6 +153,10 @@ complex_t polynomial_eval (Polynomial p, complex_t v) {
 }
 
 void print_polynomial (Polynomial p) {
+  fprint_polynomial(stdout, p);
+}
+
+void fprint_polynomial (FILE *out, Polynomial p) {
   int nonzero_cnt = 0;
   for (int i = 0; i < POLY_COEFF_LEN; i++)
     if (!cmplx_is_zero(p.coeffs[i]))
@@ -109,40 +165,74 @@ void print_polynomial (Polynomial p) {
   for (int i = POLY_COEFF_LEN - 1; i >= 0; i--) {
     if (!cmplx_is_zero(p.coeffs[i])) {
       if (!i || !cmplx_eq(p.coeffs[i], {1})) { // always print a nonzero last coeff
-        print_complex(p.coeffs[i]);
+        fprint_complex(out, p.coeffs[i]);
         if (i)
-          printf("*");
+          fputc('*', out);
       }
       
       if (i != 0) {
-        printf("%c", p.var);
+        fputc(p.var, out);
         if (i != 1)
-          printf("^%d", i);
+          fprintf(out, "^%d", i);
       }
 
       nonzero_cnt--;
       if (nonzero_cnt)
-        printf(" + ");
+        fputs(" + ", out);
     }
   }
 }
 
 void print_solutions (Solutions sols) {
+  fprint_solutions(stdout, sols);
+}
+
+void fprint_solutions (FILE *out, Solutions sols) {
+  fprint_solutions_with_errors(out, sols, NULL);
+}
+
+void fprint_solutions_with_errors (FILE *out, Solutions sols, const double *errors) {
   if (sols.count == INFINITE_SOLUTIONS) {
-    printf("Infinite solutions\n");
+    fprintf(out, "Infinite solutions\n");
     return;
   } 
 
   if (sols.count == 0) {
-    printf("No solutions!\n");
+    fprintf(out, "No solutions!\n");
     return;
   }
   
-  printf("%d solutions!\n", sols.count);
+  // roots that print the same are one root to whoever reads them, like the
+  // close roots that escalate_roots tells apart, so they are printed once
+  // with the largest of their errors
+  char   texts[4][ROOT_TEXT_LEN] = {};
+  double merged[4] = {};
+  int    shown     = 0;
+
   for (int i = 0; i < sols.count; i++) {
-    printf("  - ");
-    print_complex(sols.x[i]);
-    putchar('\n');
+    char  text[ROOT_TEXT_LEN] = {};
+    FILE *buffer = fmemopen(text, sizeof(text) - 1, "w");
+    if (buffer) {
+      fprint_complex(buffer, sols.x[i]);
+      fclose(buffer);
+    }
+
+    int same = 0;
+    while (same < shown && strcmp(texts[same], text))
+      same++;
+
+    if (same == shown)
+      strcpy(texts[shown++], text);
+    if (errors)
+      merged[same] = fmax(merged[same], errors[i]);
+  }
+
+  fprintf(out, "%d solutions!\n", shown);
+  for (int i = 0; i < shown; i++) {
+    fprintf(out, "  - %s", texts[i]);
+    if (errors)
+      fprintf(out, " +- %.2lg", merged[i]);
+    fputc('\n', out);
   }
 }
 
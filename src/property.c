@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Randomized property testing with shrinking and reproducible seeds
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+/// Upper bound on successful shrink steps, in case a shrinker never converges
+#define FL_MAX_SHRINK_STEPS 10000
+
+uint64_t splitmix64       (uint64_t *state);
+uint64_t hash_name        (const char *name);
+uint64_t env_or_default   (const char *var, uint64_t fallback);
+size_t   shrink_case      (const FL_Property *prop, void *test_case, void *candidate);
+
+uint64_t splitmix64 (uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+uint64_t fl_rng_next (FL_Rng *rng) {
+  return splitmix64(&rng->state);
+}
+
+double fl_rng_uniform (FL_Rng *rng, double lo, double hi) {
+  // top 53 bits make a uniformly distributed double in [0; 1)
+  double unit = (double) (fl_rng_next(rng) >> 11) * 0x1.0p-53;
+  return lo + (hi - lo) * unit;
+}
+
+size_t fl_rng_below (FL_Rng *rng, size_t n) {
+  return n ? fl_rng_next(rng) % n : 0;
+}
+
+/* FNV-1a, so that every test gets it's own default seed */
+uint64_t hash_name (const char *name) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (; *name; name++)
+    hash = (hash ^ (uint64_t) (unsigned char) *name) * 0x100000001b3ull;
+  return hash;
+}
+
+uint64_t env_or_default (const char *var, uint64_t fallback) {
+  const char *value = getenv(var);
+  if (!value || !*value)
+    return fallback;
+  return strtoull(value, NULL, 0);
+}
+
+/*
+ * Replace test_case with the first candidate that still fails, until none do.
+ * Returns the number of successful shrink steps.
+ */
+size_t shrink_case (const FL_Property *prop, void *test_case, void *candidate) {
+  char   ignored[FL_MAX_MSG] = {};
+  size_t steps = 0;
+
+  if (!prop->shrink)
+    return 0;
+
+  size_t attempt = 0;
+  while (steps < FL_MAX_SHRINK_STEPS && prop->shrink(prop->context, test_case, attempt, candidate)) {
+    if (!prop->check(prop->context, candidate, ignored)) {
+      memcpy(test_case, candidate, prop->case_size);
+      steps++;
+      attempt = 0;
+    } else {
+      attempt++;
+    }
+  }
+
+  return steps;
+}
+
+int fl_check_property (const char *name, const FL_Property *prop, size_t iterations, char *msg) {
+  iterations = env_or_default("FL_ITERATIONS", iterations);
+
+  // case seeds are a chain: each one is derived from the previous one
+  uint64_t seed_state = hash_name(name);
+  uint64_t case_seed  = env_or_default("FL_SEED", splitmix64(&seed_state));
+
+  char *test_case = (char *) calloc(2, prop->case_size);
+  char *candidate = test_case + prop->case_size;
+  int   result    = 1;
+
+  for (size_t i = 0; i < iterations; i++) {
+    FL_Rng rng = { case_seed };
+    prop->generate(prop->context, &rng, test_case);
+
+    if (!prop->check(prop->context, test_case, msg)) {
+      size_t steps = shrink_case(prop, test_case, candidate);
+
+      // rerun the shrunk case to get it's message
+      char case_msg[FL_MAX_MSG] = {};
+      prop->check(prop->context, test_case, case_msg);
+
+      snprintf(msg, FL_MAX_MSG,
+               "case %zu failed, reproduce with FL_SEED=0x%016llx (shrunk %zu times): %.900s",
+               i, (unsigned long long) case_seed, steps, case_msg);
+      result = 0;
+      break;
+    }
+
+    seed_state = case_seed;
+    case_seed  = splitmix64(&seed_state);
+  }
+
+  free(test_case);
+  return result;
+}
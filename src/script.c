@@ -0,0 +1,610 @@
+/**
+ * @file
+ * @brief Scripts that are compiled as a whole before they run
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "script.h"
+#include "alloc.h"
+#include "evaluate.h"
+#include "execute.h"
+#include "parser.h"
+#include "log.h"
+#include "stats.h"
+#include "symbols.h"
+
+/// Bytes read from a script file at once
+#define SCRIPT_READ_CHUNK 65536
+/// #ScriptStatement that there is none of, like a slot that wasn't written yet
+#define NO_STATEMENT SIZE_MAX
+
+/// A dependency of one statement on an earlier one
+typedef struct {
+  size_t before;
+  size_t after;
+} ScriptEdge;
+
+/// A growing list of statements or slots
+typedef struct {
+  size_t *items;
+  size_t  count;
+  size_t  cap;
+} IndexList;
+
+/// A #run_script that is going on in a pool of threads
+typedef struct {
+  Script         *script;
+  Env            *env;
+  /// Result of every statement, printed by the main thread in order
+  CommandResult  *results;
+  /// Dependencies of every statement that aren't done yet
+  size_t         *remaining;
+  bool           *done;
+  /// Statements that can run, every statement goes in here once at most
+  size_t         *ready;
+  size_t          ready_head;
+  size_t          ready_tail;
+  bool            stopping;
+
+  pthread_mutex_t lock;
+  /// Signalled when a statement is ready, waited on by the workers
+  pthread_cond_t  wakeup;
+  /// Signalled when a statement is done, waited on by the main thread
+  pthread_cond_t  finished;
+} ScriptRun;
+
+void       assign_slots (const Statement *stmt, int *slots, size_t *slot_count);
+void       resolve_stmt (Statement *stmt, const int *slots);
+void       resolve_expr (Expr *expr, const int *slots);
+Statement *copy_stmt    (Arena *arena, const Statement *stmt);
+Expr      *copy_expr    (Arena *arena, const Expr *expr);
+char      *read_script  (FILE *file);
+
+void  link_statements (Script *script);
+bool  is_barrier      (Command cmd);
+void  collect_reads   (const Expr *expr, size_t stmt, size_t *read_by, IndexList *reads);
+void  add_edge        (ScriptEdge **edges, size_t *count, size_t *cap, size_t before, size_t after, size_t *linked);
+void  add_index       (IndexList *list, size_t index);
+void  run_in_order    (Script *script, Env *env, FILE *out);
+void  run_in_parallel (Script *script, Env *env, unsigned int threads, FILE *out);
+void  push_ready      (ScriptRun *run, size_t stmt);
+void *script_worker   (void *arg);
+
+size_t compile_script (const char *source, Script *script, FILE *out) {
+  *script = {};
+
+  size_t max_lines = 1;
+  for (const char *c = source; *c; c++)
+    max_lines += *c == '\n';
+
+  ScriptStatement *parsed = (ScriptStatement *) counted_calloc(max_lines, sizeof(ScriptStatement));
+  size_t parsed_count = 0;
+  size_t errors       = 0;
+
+  // parse everything first, so that all the errors are found before anything runs
+  const char *line = source;
+  for (int line_number = 1; *line; line_number++) {
+    size_t len = strcspn(line, "\n");
+
+    if (len) {
+      char *text = (char *) counted_calloc(len + 1, sizeof(char));
+      memcpy(text, line, len);
+
+      Statement *stmt = parse_command(text, NULL);
+      counted_free(text);
+
+      if (stmt) {
+        parsed[parsed_count++] = { .line = line_number, .stmt = stmt };
+      } else {
+        REPORT_ERROR(out, "line %d: %s", line_number, PARSE_ERROR);
+        errors++;
+      }
+    }
+
+    line += len + (line[len] == '\n');
+  }
+
+  for (size_t i = 0; i < parsed_count; i++) {
+    Command cmd = parsed[i].stmt->cmd;
+    script->by_name |= cmd == CMD_SNAPSHOT || cmd == CMD_ROLLBACK;
+  }
+
+  // a variable gets a slot if any statement assigns it, even a later one, so
+  // that prepared statements see the variables they are executed with
+  int *slots = (int *) counted_calloc((size_t) symbol_count(), sizeof(int));
+  for (size_t i = 0; !errors && !script->by_name && i < parsed_count; i++)
+    assign_slots(parsed[i].stmt, slots, &script->slot_count);
+
+  if (!errors) {
+    script->stmts      = (ScriptStatement *) arena_alloc(&script->arena, parsed_count * sizeof(ScriptStatement));
+    script->stmt_count = parsed_count;
+  }
+
+  for (size_t i = 0; i < parsed_count; i++) {
+    Statement *stmt = parsed[i].stmt;
+
+    if (!errors) {
+      if (stmt->expr)
+        fold_constants(stmt->expr);
+
+      Statement *compiled = copy_stmt(&script->arena, stmt);
+      resolve_stmt(compiled, slots);
+      script->stmts[i] = { .line = parsed[i].line, .stmt = compiled };
+
+      // the prepared statement moved along to the compiled one
+      stmt->prepared = NULL;
+    }
+
+    destory_stmt(stmt);
+  }
+
+  counted_free(slots);
+  counted_free(parsed);
+
+  if (!errors)
+    link_statements(script);
+
+  return errors;
+}
+
+void run_script (Script *script, unsigned int threads, unsigned int precision, FILE *out) {
+  Env env = {};
+  env.precision  = precision;
+  env.slot_count = script->slot_count;
+  env.slots      = (VarDescription *) counted_calloc(script->slot_count, sizeof(VarDescription));
+
+  if (threads > 1 && !script->by_name)
+    run_in_parallel(script, &env, threads, out);
+  else
+    run_in_order(script, &env, out);
+
+  for (size_t slot = 0; slot < script->slot_count; slot++)
+    destroy_packed_value(&env.slots[slot].val);
+
+  counted_free(env.slots);
+  env_destroy(&env);
+}
+
+void destroy_script (Script *script) {
+  // everything else is in the arena
+  for (size_t i = 0; i < script->stmt_count; i++)
+    if (script->stmts[i].stmt->prepared)
+      destory_stmt(script->stmts[i].stmt->prepared);
+
+  arena_destroy(&script->arena);
+  *script = {};
+}
+
+bool run_script_file (FILE *file, unsigned int threads, unsigned int precision, FILE *out) {
+  char *source = read_script(file);
+  if (!source) {
+    REPORT_ERROR(out, "Could not read the script!");
+    return false;
+  }
+
+  Script script = {};
+  size_t errors = compile_script(source, &script, out);
+  free(source);
+
+  if (errors) {
+    REPORT_ERROR(out, "Not running the script, since some of it could not be parsed");
+    return false;
+  }
+
+  run_script(&script, threads, precision, out);
+  destroy_script(&script);
+  return true;
+}
+
+/* find the statements that every statement has to wait for */
+void link_statements (Script *script) {
+  size_t edge_count = 0;
+  size_t edge_cap   = 0;
+  ScriptEdge *edges = NULL;
+
+  // the last statement that every statement got an edge to, so that there are no duplicates
+  size_t *linked = (size_t *) counted_malloc(script->stmt_count * sizeof(size_t));
+
+  // what is known about every slot since the last barrier: the statement
+  // that last wrote it, and the ones that read it since then
+  size_t     slots       = script->slot_count + 1;
+  size_t    *last_writer = (size_t *)    counted_malloc(slots * sizeof(size_t));
+  IndexList *readers     = (IndexList *) counted_calloc(slots, sizeof(IndexList));
+  // the statement that last read every slot plus one, so that reading it twice counts once
+  size_t    *read_by     = (size_t *)    counted_calloc(slots, sizeof(size_t));
+  IndexList  reads       = {};
+
+  for (size_t slot = 0; slot < slots; slot++)
+    last_writer[slot] = NO_STATEMENT;
+
+  // nothing depends on anything across a barrier, anything older is ignored
+  size_t stretch = 0;
+
+  for (size_t i = 0; i < script->stmt_count; i++) {
+    ScriptStatement *current = &script->stmts[i];
+    const Statement *stmt    = current->stmt;
+    linked[i] = NO_STATEMENT;
+
+    current->barrier = is_barrier(stmt->cmd);
+    if (current->barrier) {
+      stretch = i + 1;
+      continue;
+    }
+
+    reads.count = 0;
+    collect_reads(stmt->expr, i, read_by, &reads);
+
+    // a statement waits for the values it reads...
+    for (size_t r = 0; r < reads.count; r++) {
+      size_t slot = reads.items[r];
+
+      if (last_writer[slot] != NO_STATEMENT && last_writer[slot] >= stretch)
+        add_edge(&edges, &edge_count, &edge_cap, last_writer[slot], i, linked);
+
+      // readers are added in order, so if the last one is old, all of them are
+      if (readers[slot].count && readers[slot].items[readers[slot].count - 1] < stretch)
+        readers[slot].count = 0;
+      add_index(&readers[slot], i);
+    }
+
+    // ...and doesn't overwrite a value before everyone got to read it
+    size_t slot = (size_t) stmt->slot;
+    if (stmt->cmd == CMD_LET && slot) {
+      if (last_writer[slot] != NO_STATEMENT && last_writer[slot] >= stretch)
+        add_edge(&edges, &edge_count, &edge_cap, last_writer[slot], i, linked);
+
+      for (size_t r = 0; r < readers[slot].count; r++) {
+        size_t reader = readers[slot].items[r];
+        if (reader != i && reader >= stretch)
+          add_edge(&edges, &edge_count, &edge_cap, reader, i, linked);
+      }
+
+      last_writer[slot]   = i;
+      readers[slot].count = 0;
+    }
+  }
+
+  for (size_t e = 0; e < edge_count; e++) {
+    script->stmts[edges[e].before].dependent_count++;
+    script->stmts[edges[e].after].dependency_count++;
+  }
+
+  for (size_t i = 0; i < script->stmt_count; i++) {
+    ScriptStatement *current = &script->stmts[i];
+    current->dependents = (size_t *) arena_alloc(&script->arena, current->dependent_count * sizeof(size_t));
+    current->dependent_count = 0;
+  }
+
+  for (size_t e = 0; e < edge_count; e++) {
+    ScriptStatement *before = &script->stmts[edges[e].before];
+    before->dependents[before->dependent_count++] = edges[e].after;
+  }
+
+  for (size_t slot = 0; slot < slots; slot++)
+    counted_free(readers[slot].items);
+  counted_free(reads.items);
+  counted_free(read_by);
+  counted_free(readers);
+  counted_free(last_writer);
+  counted_free(linked);
+  counted_free(edges);
+}
+
+/* whether a command does more than read and write slots, so that it can't run alongside others */
+bool is_barrier (Command cmd) {
+  switch (cmd) {
+    case CMD_LET:
+    case CMD_SOLVE:
+    case CMD_EXPR:
+      return false;
+    case CMD_POLTORASHKA:
+    case CMD_PORNO:
+    case CMD_STATS:
+    case CMD_PREPARE:
+    case CMD_EXEC:
+    case CMD_WATCH:
+    case CMD_SNAPSHOT:
+    case CMD_ROLLBACK:
+    default:
+      return true;
+  }
+}
+
+/* add the slots that expr reads to reads, the ones read_by says stmt read already are skipped */
+void collect_reads (const Expr *expr, size_t stmt, size_t *read_by, IndexList *reads) {
+  if (!expr)
+    return;
+
+  switch (expr->type) {
+    case OPERATOR:
+      collect_reads(expr->left,  stmt, read_by, reads);
+      collect_reads(expr->right, stmt, read_by, reads);
+      break;
+    case SLOT:
+      if (read_by[expr->slot] != stmt + 1) {
+        read_by[expr->slot] = stmt + 1;
+        add_index(reads, (size_t) expr->slot);
+      }
+      break;
+    case NUMBER:
+    case POLY_VAR:
+    case IDENTIFIER:
+    case PARAMETER:
+    case CONSTANT_POLY:
+    default:
+      break;
+  }
+}
+
+/* make after wait for before, unless it already does */
+void add_edge (ScriptEdge **edges, size_t *count, size_t *cap, size_t before, size_t after, size_t *linked) {
+  if (linked[before] == after)
+    return;
+  linked[before] = after;
+
+  if (*count == *cap) {
+    *cap   = *cap ? *cap * 2 : 64;
+    *edges = (ScriptEdge *) counted_realloc(*edges, *cap * sizeof(ScriptEdge));
+  }
+
+  (*edges)[(*count)++] = { .before = before, .after = after };
+}
+
+void add_index (IndexList *list, size_t index) {
+  if (list->count == list->cap) {
+    list->cap   = list->cap ? list->cap * 2 : 8;
+    list->items = (size_t *) counted_realloc(list->items, list->cap * sizeof(size_t));
+  }
+
+  list->items[list->count++] = index;
+}
+
+void run_in_order (Script *script, Env *env, FILE *out) {
+  for (size_t i = 0; i < script->stmt_count; i++) {
+    STATS_BEGIN(command);
+    execute_statement(env, script->stmts[i].stmt, out);
+    STATS_END(command, PHASE_COMMAND);
+  }
+}
+
+/* run the statements between barriers on a pool, and the barriers themselves on this thread */
+void run_in_parallel (Script *script, Env *env, unsigned int threads, FILE *out) {
+  size_t count = script->stmt_count;
+
+  ScriptRun run = {};
+  run.script    = script;
+  run.env       = env;
+  run.results   = (CommandResult *) counted_calloc(count, sizeof(CommandResult));
+  run.remaining = (size_t *)        counted_calloc(count, sizeof(size_t));
+  run.done      = (bool *)          counted_calloc(count, sizeof(bool));
+  run.ready     = (size_t *)        counted_calloc(count, sizeof(size_t));
+
+  for (size_t i = 0; i < count; i++)
+    run.remaining[i] = script->stmts[i].dependency_count;
+
+  pthread_mutex_init(&run.lock, NULL);
+  pthread_cond_init(&run.wakeup, NULL);
+  pthread_cond_init(&run.finished, NULL);
+
+  pthread_t *workers = (pthread_t *) calloc(threads, sizeof(pthread_t));
+  unsigned int started = 0;
+  for (; started < threads; started++)
+    if (pthread_create(&workers[started], NULL, script_worker, &run))
+      break;
+
+  if (!started) {
+    LOG_WARN("Could not start any threads, running the script in order");
+    run_in_order(script, env, out);
+  }
+
+  for (size_t start = 0; started && start < count;) {
+    size_t end = start;
+    while (end < count && !script->stmts[end].barrier)
+      end++;
+
+    pthread_mutex_lock(&run.lock);
+    for (size_t i = start; i < end; i++)
+      if (!run.remaining[i])
+        push_ready(&run, i);
+    pthread_mutex_unlock(&run.lock);
+
+    for (size_t i = start; i < end; i++) {
+      pthread_mutex_lock(&run.lock);
+      while (!run.done[i])
+        pthread_cond_wait(&run.finished, &run.lock);
+      pthread_mutex_unlock(&run.lock);
+
+      print_result(&run.results[i], out);
+    }
+
+    // everything before the barrier is done and printed, and nothing after it started
+    if (end < count) {
+      STATS_BEGIN(command);
+      execute_statement(env, script->stmts[end].stmt, out);
+      STATS_END(command, PHASE_COMMAND);
+      end++;
+    }
+
+    start = end;
+  }
+
+  pthread_mutex_lock(&run.lock);
+  run.stopping = true;
+  pthread_cond_broadcast(&run.wakeup);
+  pthread_mutex_unlock(&run.lock);
+
+  for (unsigned int i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+
+  free(workers);
+  pthread_cond_destroy(&run.finished);
+  pthread_cond_destroy(&run.wakeup);
+  pthread_mutex_destroy(&run.lock);
+  counted_free(run.ready);
+  counted_free(run.done);
+  counted_free(run.remaining);
+  counted_free(run.results);
+}
+
+/* queue a statement for the workers, with run->lock held */
+void push_ready (ScriptRun *run, size_t stmt) {
+  run->ready[run->ready_tail++] = stmt;
+  pthread_cond_signal(&run->wakeup);
+}
+
+void *script_worker (void *arg) {
+  ScriptRun *run = (ScriptRun *) arg;
+
+  pthread_mutex_lock(&run->lock);
+  while (true) {
+    while (run->ready_head == run->ready_tail && !run->stopping)
+      pthread_cond_wait(&run->wakeup, &run->lock);
+
+    if (run->stopping)
+      break;
+
+    size_t i = run->ready[run->ready_head++];
+    pthread_mutex_unlock(&run->lock);
+
+    STATS_BEGIN(command);
+    run_statement(run->env, run->script->stmts[i].stmt, &run->results[i]);
+    STATS_END(command, PHASE_COMMAND);
+
+    pthread_mutex_lock(&run->lock);
+    run->done[i] = true;
+    pthread_cond_signal(&run->finished);
+
+    const ScriptStatement *done = &run->script->stmts[i];
+    for (size_t d = 0; d < done->dependent_count; d++)
+      if (!--run->remaining[done->dependents[d]])
+        push_ready(run, done->dependents[d]);
+  }
+  pthread_mutex_unlock(&run->lock);
+
+  return NULL;
+}
+
+/* give a slot to every variable that stmt assigns and doesn't have one yet */
+void assign_slots (const Statement *stmt, int *slots, size_t *slot_count) {
+  if (stmt->cmd == CMD_LET && !slots[stmt->var])
+    slots[stmt->var] = (int) ++*slot_count;
+
+  if (stmt->prepared)
+    assign_slots(stmt->prepared, slots, slot_count);
+}
+
+/* point stmt and its expressions at the slots of their variables */
+void resolve_stmt (Statement *stmt, const int *slots) {
+  if (stmt->cmd == CMD_LET)
+    stmt->slot = slots[stmt->var];
+
+  resolve_expr(stmt->expr, slots);
+
+  if (stmt->prepared)
+    resolve_stmt(stmt->prepared, slots);
+}
+
+/* turn identifiers that have a slot into SLOT nodes, the rest can't ever be set */
+void resolve_expr (Expr *expr, const int *slots) {
+  if (!expr)
+    return;
+
+  switch (expr->type) {
+    case OPERATOR:
+      resolve_expr(expr->left,  slots);
+      resolve_expr(expr->right, slots);
+      break;
+    case IDENTIFIER: {
+      int symbol = expr->symbol;
+      if (slots[symbol]) {
+        expr->type        = SLOT;
+        expr->slot_symbol = symbol;
+        expr->slot        = slots[symbol];
+      }
+      break;
+    }
+    case NUMBER:
+    case POLY_VAR:
+    case PARAMETER:
+    case CONSTANT_POLY:
+    case SLOT:
+    default:
+      break;
+  }
+}
+
+/* copy a statement into the arena, except for the prepared statement which is only moved */
+Statement *copy_stmt (Arena *arena, const Statement *stmt) {
+  Statement *copy = (Statement *) arena_alloc(arena, sizeof(Statement));
+  *copy = *stmt;
+  copy->expr = copy_expr(arena, stmt->expr);
+
+  if (stmt->args) {
+    size_t size = (size_t) stmt->arg_count * sizeof(complex_t);
+    copy->args = (complex_t *) arena_alloc(arena, size);
+    memcpy(copy->args, stmt->args, size);
+  }
+
+  return copy;
+}
+
+/* copy an expression tree into the arena */
+Expr *copy_expr (Arena *arena, const Expr *expr) {
+  if (!expr)
+    return NULL;
+
+  Expr *copy = (Expr *) arena_alloc(arena, sizeof(Expr));
+  *copy = *expr;
+
+  switch (expr->type) {
+    case OPERATOR:
+      copy->left  = copy_expr(arena, expr->left);
+      copy->right = copy_expr(arena, expr->right);
+      break;
+    case CONSTANT_POLY:
+      copy->poly  = (Polynomial *) arena_alloc(arena, sizeof(Polynomial));
+      *copy->poly = *expr->poly;
+      break;
+    case NUMBER:
+    case POLY_VAR:
+    case IDENTIFIER:
+    case PARAMETER:
+    case SLOT:
+    default:
+      break;
+  }
+
+  return copy;
+}
+
+/* read all of file into a string, returns NULL on an error */
+char *read_script (FILE *file) {
+  size_t len = 0;
+  size_t cap = SCRIPT_READ_CHUNK;
+  char *source = (char *) malloc(cap + 1);
+
+  while (source) {
+    len += fread(source + len, 1, cap - len, file);
+    if (len < cap)
+      break;
+
+    cap *= 2;
+    char *grown = (char *) realloc(source, cap + 1);
+    if (!grown)
+      free(source);
+    source = grown;
+  }
+
+  if (!source || ferror(file)) {
+    free(source);
+    return NULL;
+  }
+
+  source[len] = '\0';
+  return source;
+}
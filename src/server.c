@@ -0,0 +1,671 @@
+/**
+ * @file
+ * @brief A Unix socket server that executes statements for many clients at once
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "execute.h"
+#include "evaluate.h"
+#include "parser.h"
+#include "log.h"
+
+/// Events handled by one `epoll_wait`
+#define SERVER_MAX_EVENTS 64
+
+/// A client and everything it has sent or is yet to receive
+typedef struct Connection {
+  int    fd;
+  /// Variables of this client
+  Env    env;
+
+  /// Received bytes that don't make a whole line yet
+  char   in[SERVER_MAX_LINE];
+  size_t in_len;
+
+  /// Output that wasn't sent yet starts at out + out_sent
+  char  *out;
+  size_t out_len;
+  size_t out_sent;
+  size_t out_cap;
+
+  /// A worker is solving for this connection. Lines after it wait, so that
+  /// answers come in order and see the variables they should
+  bool   solving;
+  /// Something went wrong, close the connection without answering the rest
+  bool   closing;
+  /// The client won't send anything else, close after answering what it sent
+  bool   eof;
+  /// The current line was too long and was already answered, drop the rest of it
+  bool   skipping;
+  /// Events currently requested from epoll
+  uint32_t events;
+
+  struct Connection *prev;
+  struct Connection *next;
+} Connection;
+
+/// A `solve` handed to a worker, and its output once solved
+typedef struct Job {
+  Connection  *conn;
+  Polynomial   poly;
+  /// #Env.precision of the connection
+  unsigned int precision;
+  char        *output;
+  size_t       output_len;
+  struct Job  *next;
+} Job;
+
+/// Solver threads with a queue of jobs for them and a queue of finished ones
+typedef struct {
+  pthread_t      *threads;
+  unsigned int    count;
+
+  pthread_mutex_t lock;
+  pthread_cond_t  wakeup;
+  Job            *todo_head;
+  Job            *todo_tail;
+  Job            *done;
+  bool            stopping;
+
+  /// Signalled whenever a job is done, polled by the event loop
+  int             done_fd;
+} WorkerPool;
+
+typedef struct {
+  ServerConfig config;
+  int          epoll_fd;
+  int          listen_fd;
+  /// Whether the listening socket is polled, it isn't while at #ServerConfig.max_connections
+  bool         accepting;
+  unsigned int connection_count;
+  /// Open connections, and closed ones that weren't freed yet
+  Connection  *connections;
+  /// Whether some connections were closed since the last #reap_connections
+  bool         reap;
+  WorkerPool   pool;
+} Server;
+
+volatile sig_atomic_t _server_stop = 0;
+
+void  server_signal_handler (int signal);
+int   open_listen_socket    (const char *path);
+bool  server_loop           (Server *server, const sigset_t *wait_mask);
+void  accept_connections    (Server *server);
+void  set_accepting         (Server *server, bool accepting);
+void  handle_connection     (Server *server, Connection *conn, uint32_t events);
+void  read_connection       (Connection *conn);
+void  write_connection      (Connection *conn);
+void  process_lines         (Server *server, Connection *conn);
+void  execute_line          (Server *server, Connection *conn, const char *line);
+void  update_connection     (Server *server, Connection *conn);
+void  close_connection      (Server *server, Connection *conn);
+void  free_connection       (Server *server, Connection *conn);
+void  reap_connections      (Server *server);
+void  append_output         (Connection *conn, const char *data, size_t len);
+bool  would_block           (void);
+void  collect_jobs          (Server *server);
+
+bool  pool_start            (WorkerPool *pool, unsigned int count);
+void  pool_stop             (WorkerPool *pool);
+void  pool_submit           (WorkerPool *pool, Job *job);
+void *pool_worker           (void *arg);
+
+bool serve (ServerConfig config) {
+  Server server = {};
+  server.config = config;
+  // a stop request of an earlier run is not one for this one
+  _server_stop  = 0;
+
+  server.listen_fd = open_listen_socket(config.path);
+  if (server.listen_fd < 0)
+    return false;
+
+  server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (server.epoll_fd < 0) {
+    LOG_ERROR("Could not create an epoll instance: %s", strerror(errno));
+    close(server.listen_fd);
+    return false;
+  }
+
+  // signals are only let through while waiting for events, so a stop
+  // request can't slip in between checking the flag and going to sleep.
+  // Workers inherit the blocked mask and never see them
+  sigset_t stop_signals = {}, wait_mask = {};
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, &wait_mask);
+
+  struct sigaction action = {};
+  action.sa_handler = server_signal_handler;
+  sigaction(SIGINT,  &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  bool ok = pool_start(&server.pool, config.workers);
+  if (ok) {
+    struct epoll_event event = {};
+    event.events   = EPOLLIN;
+    event.data.ptr = &server.pool;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.pool.done_fd, &event);
+
+    event.data.ptr = &server;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event);
+    server.accepting = true;
+
+    LOG_INFO("Serving on %s", config.path);
+    ok = server_loop(&server, &wait_mask);
+    LOG_INFO("Shutting down");
+
+    // the workers are joined before connections go away, as jobs point to them
+    pool_stop(&server.pool);
+    while (server.connections)
+      free_connection(&server, server.connections);
+  }
+
+  close(server.epoll_fd);
+  close(server.listen_fd);
+  unlink(config.path);
+  pthread_sigmask(SIG_SETMASK, &wait_mask, NULL);
+  return ok;
+}
+
+void server_signal_handler (int) {
+  _server_stop = 1;
+}
+
+int open_listen_socket (const char *path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    LOG_ERROR("Socket path %s is too long", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  // a socket left over from a previous run would fail the bind
+  struct stat info = {};
+  if (!stat(path, &info) && S_ISSOCK(info.st_mode))
+    unlink(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_ERROR("Could not create a socket: %s", strerror(errno));
+    return -1;
+  }
+
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, SOMAXCONN)) {
+    LOG_ERROR("Could not listen on %s: %s", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+bool server_loop (Server *server, const sigset_t *wait_mask) {
+  struct epoll_event events[SERVER_MAX_EVENTS] = {};
+
+  while (!_server_stop) {
+    int count = epoll_pwait(server->epoll_fd, events, SERVER_MAX_EVENTS, -1, wait_mask);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+
+      LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+      return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.ptr == server)
+        accept_connections(server);
+      else if (events[i].data.ptr == &server->pool)
+        collect_jobs(server);
+      else
+        handle_connection(server, (Connection *) events[i].data.ptr, events[i].events);
+    }
+
+    // only now, as later events of the batch could still point to them
+    if (server->reap)
+      reap_connections(server);
+  }
+
+  return true;
+}
+
+// ------- CONNECTIONS -------
+
+void accept_connections (Server *server) {
+  while (server->connection_count < server->config.max_connections) {
+    int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (!would_block())
+        LOG_WARN("Could not accept a connection: %s", strerror(errno));
+      return;
+    }
+
+    Connection *conn = (Connection *) calloc(1, sizeof(Connection));
+    conn->fd     = fd;
+    conn->events = EPOLLIN;
+    conn->env.precision = server->config.precision;
+
+    struct epoll_event event = {};
+    event.events   = conn->events;
+    event.data.ptr = conn;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+    conn->next = server->connections;
+    if (server->connections)
+      server->connections->prev = conn;
+    server->connections = conn;
+    server->connection_count++;
+  }
+
+  // the rest wait in the kernel's backlog until someone leaves
+  set_accepting(server, false);
+}
+
+void set_accepting (Server *server, bool accepting) {
+  if (server->accepting == accepting)
+    return;
+
+  struct epoll_event event = {};
+  event.events   = accepting ? (uint32_t) EPOLLIN : 0;
+  event.data.ptr = server;
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, server->listen_fd, &event);
+  server->accepting = accepting;
+}
+
+void handle_connection (Server *server, Connection *conn, uint32_t events) {
+  // closed by an earlier event of the same batch
+  if (conn->fd < 0)
+    return;
+
+  if (events & EPOLLERR)
+    conn->closing = true;
+
+  if (!conn->closing && (events & EPOLLIN))
+    read_connection(conn);
+
+  // a hang up can still leave unread data, which the read above got
+  if (events & EPOLLHUP)
+    conn->eof = true;
+
+  if (!conn->closing && (events & EPOLLOUT))
+    write_connection(conn);
+
+  update_connection(server, conn);
+}
+
+void read_connection (Connection *conn) {
+  while (conn->in_len < SERVER_MAX_LINE) {
+    ssize_t len = read(conn->fd, conn->in + conn->in_len, SERVER_MAX_LINE - conn->in_len);
+
+    if (len > 0) {
+      conn->in_len += (size_t) len;
+    } else if (len == 0) {
+      conn->eof = true;
+      return;
+    } else {
+      if (!would_block())
+        conn->closing = true;
+      return;
+    }
+  }
+}
+
+void write_connection (Connection *conn) {
+  while (conn->out_sent < conn->out_len) {
+    ssize_t len = send(conn->fd, conn->out + conn->out_sent,
+                       conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+    if (len < 0) {
+      if (!would_block())
+        conn->closing = true;
+      return;
+    }
+
+    conn->out_sent += (size_t) len;
+  }
+
+  conn->out_len  = 0;
+  conn->out_sent = 0;
+}
+
+/* whether a failed non-blocking call just has to be retried later */
+bool would_block (void) {
+  // EWOULDBLOCK is the same as EAGAIN on Linux
+  return errno == EAGAIN || errno == EINTR;
+}
+
+/* run the complete lines that are buffered, as long as the client keeps up with reading */
+void process_lines (Server *server, Connection *conn) {
+  while (!conn->solving && !conn->closing &&
+         conn->out_len - conn->out_sent <= server->config.max_buffer) {
+    char *newline = (char *) memchr(conn->in, '\n', conn->in_len);
+
+    if (!newline) {
+      if (conn->in_len == SERVER_MAX_LINE || (conn->skipping && conn->in_len)) {
+        if (!conn->skipping) {
+          const char *error = "error: Line is too long\n.\n";
+          append_output(conn, error, strlen(error));
+        }
+
+        conn->in_len   = 0;
+        conn->skipping = true;
+        return;
+      }
+
+      // the last line doesn't need a newline
+      if (!conn->eof || !conn->in_len)
+        return;
+
+      newline = conn->in + conn->in_len;
+      conn->in_len++;
+    }
+
+    *newline = '\0';
+    if (newline > conn->in && newline[-1] == '\r')
+      newline[-1] = '\0';
+
+    if (conn->skipping)
+      conn->skipping = false;
+    else
+      execute_line(server, conn, conn->in);
+
+    size_t consumed = (size_t) (newline - conn->in) + 1;
+    memmove(conn->in, conn->in + consumed, conn->in_len - consumed);
+    conn->in_len -= consumed;
+  }
+}
+
+void execute_line (Server *server, Connection *conn, const char *line) {
+  if (!*line)
+    return;
+
+  char  *output     = NULL;
+  size_t output_len = 0;
+  FILE  *out        = open_memstream(&output, &output_len);
+  if (!out) {
+    conn->closing = true;
+    return;
+  }
+
+  Statement *command = parse_command(line, out);
+  if (command) {
+    Polynomial poly = {};
+
+    if (command->cmd != CMD_SOLVE)
+      execute_statement(&conn->env, command, out);
+    else if (eval_solve_argument(&conn->env, command, &poly, out)) {
+      Job *job = (Job *) calloc(1, sizeof(Job));
+      job->conn      = conn;
+      job->poly      = poly;
+      job->precision = conn->env.precision;
+
+      conn->solving = true;
+      pool_submit(&server->pool, job);
+    }
+
+    destory_stmt(command);
+  }
+
+  fclose(out);
+  append_output(conn, output, output_len);
+  free(output);
+
+  // a solve is terminated when it's collected
+  if (!conn->solving)
+    append_output(conn, ".\n", 2);
+}
+
+/* pick the events to wait for, or close the connection if there is nothing left to do */
+void update_connection (Server *server, Connection *conn) {
+  size_t pending = 0;
+  while (true) {
+    process_lines(server, conn);
+
+    pending = conn->out_len - conn->out_sent;
+    bool held_back = pending > server->config.max_buffer;
+    if (pending && !conn->closing)
+      write_connection(conn);
+    pending = conn->out_len - conn->out_sent;
+
+    // lines that waited for the client to catch up are already buffered,
+    // and no new input would wake the connection up for them
+    if (!held_back || conn->closing || pending > server->config.max_buffer)
+      break;
+  }
+
+  bool finished = conn->closing || (conn->eof && !conn->solving && !pending);
+  if (finished) {
+    close_connection(server, conn);
+    return;
+  }
+
+  uint32_t events = 0;
+  if (!conn->eof && !conn->solving && pending <= server->config.max_buffer &&
+      conn->in_len < SERVER_MAX_LINE)
+    events |= EPOLLIN;
+  if (pending)
+    events |= EPOLLOUT;
+
+  if (events != conn->events) {
+    struct epoll_event event = {};
+    event.events   = events;
+    event.data.ptr = conn;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->events = events;
+  }
+}
+
+/* the connection is freed by #reap_connections, once no worker holds it */
+void close_connection (Server *server, Connection *conn) {
+  conn->closing = true;
+  server->reap  = true;
+
+  if (conn->fd >= 0) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+  }
+}
+
+void reap_connections (Server *server) {
+  server->reap = false;
+
+  for (Connection *conn = server->connections; conn;) {
+    Connection *next = conn->next;
+    if (conn->fd < 0 && !conn->solving)
+      free_connection(server, conn);
+    conn = next;
+  }
+}
+
+void free_connection (Server *server, Connection *conn) {
+  if (conn->fd >= 0)
+    close(conn->fd);
+
+  if (conn->prev)
+    conn->prev->next = conn->next;
+  else
+    server->connections = conn->next;
+  if (conn->next)
+    conn->next->prev = conn->prev;
+
+  env_destroy(&conn->env);
+  free(conn->out);
+  free(conn);
+
+  server->connection_count--;
+  if (server->connection_count < server->config.max_connections)
+    set_accepting(server, true);
+}
+
+void append_output (Connection *conn, const char *data, size_t len) {
+  // a let prints nothing, and the buffer may not be there yet
+  if (!len)
+    return;
+
+  if (conn->out_len + len > conn->out_cap) {
+    size_t capacity = conn->out_cap ? conn->out_cap : 256;
+    while (capacity < conn->out_len + len)
+      capacity *= 2;
+
+    char *out = (char *) realloc(conn->out, capacity);
+    if (!out) {
+      conn->closing = true;
+      return;
+    }
+
+    conn->out     = out;
+    conn->out_cap = capacity;
+  }
+
+  memcpy(conn->out + conn->out_len, data, len);
+  conn->out_len += len;
+}
+
+/* hand the output of finished solves to their connections */
+void collect_jobs (Server *server) {
+  uint64_t signalled = 0;
+  if (read(server->pool.done_fd, &signalled, sizeof(signalled)) < 0)
+    return;
+
+  pthread_mutex_lock(&server->pool.lock);
+  Job *done = server->pool.done;
+  server->pool.done = NULL;
+  pthread_mutex_unlock(&server->pool.lock);
+
+  while (done) {
+    Job *job = done;
+    done = job->next;
+
+    Connection *conn = job->conn;
+    conn->solving = false;
+
+    if (conn->fd < 0) {
+      server->reap = true;
+    } else {
+      append_output(conn, job->output, job->output_len);
+      append_output(conn, ".\n", 2);
+      update_connection(server, conn);
+    }
+
+    free(job->output);
+    free(job);
+  }
+}
+
+// ------- WORKERS -------
+
+bool pool_start (WorkerPool *pool, unsigned int count) {
+  pool->done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (pool->done_fd < 0) {
+    LOG_ERROR("Could not create an eventfd: %s", strerror(errno));
+    return false;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wakeup, NULL);
+
+  pool->threads = (pthread_t *) calloc(count, sizeof(pthread_t));
+  for (; pool->count < count; pool->count++) {
+    if (pthread_create(&pool->threads[pool->count], NULL, pool_worker, pool)) {
+      LOG_ERROR("Could not start a worker thread");
+      pool_stop(pool);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void pool_stop (WorkerPool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (unsigned int i = 0; i < pool->count; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  Job *lists[] = { pool->todo_head, pool->done };
+  for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+    while (lists[i]) {
+      Job *next = lists[i]->next;
+      lists[i]->conn->solving = false;
+      free(lists[i]->output);
+      free(lists[i]);
+      lists[i] = next;
+    }
+  }
+
+  free(pool->threads);
+  close(pool->done_fd);
+  pthread_cond_destroy(&pool->wakeup);
+  pthread_mutex_destroy(&pool->lock);
+  *pool = {};
+}
+
+void pool_submit (WorkerPool *pool, Job *job) {
+  pthread_mutex_lock(&pool->lock);
+
+  if (pool->todo_tail)
+    pool->todo_tail->next = job;
+  else
+    pool->todo_head = job;
+  pool->todo_tail = job;
+
+  pthread_cond_signal(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void *pool_worker (void *arg) {
+  WorkerPool *pool = (WorkerPool *) arg;
+
+  pthread_mutex_lock(&pool->lock);
+  while (true) {
+    while (!pool->todo_head && !pool->stopping)
+      pthread_cond_wait(&pool->wakeup, &pool->lock);
+
+    if (pool->stopping)
+      break;
+
+    Job *job = pool->todo_head;
+    pool->todo_head = job->next;
+    if (!pool->todo_head)
+      pool->todo_tail = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    FILE *out = open_memstream(&job->output, &job->output_len);
+    if (out) {
+      solve_and_print(job->poly, job->precision, out);
+      fclose(out);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    job->next = pool->done;
+    pool->done = job;
+
+    uint64_t one = 1;
+    if (write(pool->done_fd, &one, sizeof(one)) < 0)
+      LOG_WARN("Could not wake up the event loop");
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
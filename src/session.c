@@ -0,0 +1,560 @@
+/**
+ * @file
+ * @brief Variables of the shell kept in a memory-mapped file across restarts
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "session.h"
+#include "alloc.h"
+#include "evaluate.h"
+#include "log.h"
+#include "parser.h"
+#include "symbols.h"
+
+/// Which children an operator in a file has
+#define SESSION_LEFT  1
+#define SESSION_RIGHT 2
+
+uint64_t       checksum       (const void *data, size_t len);
+SessionHeader *get_header     (Session *session);
+uint64_t       header_sum     (const SessionHeader *header);
+void           seal_header    (Session *session);
+bool           map_session    (Session *session, size_t size);
+bool           create_file    (Session *session);
+bool           check_header   (Session *session);
+void           unmap_session  (Session *session);
+SessionRecord *begin_record   (Session *session, SessionRecordType type, size_t len);
+void           end_record     (Session *session, SessionRecord *record);
+uint64_t       replay         (Session *session, Env *env);
+bool           replay_record  (const SessionRecord *record, Env *env);
+void           compact        (Session *session, Env *env);
+void           write_var      (Session *session, Env *env, int var, bool *written);
+size_t         expr_size      (const Expr *expr);
+char          *write_expr     (char *at, const Expr *expr);
+Expr          *read_expr      (const char **at, const char *end);
+void           store_value    (SessionValue *stored, Value value);
+Value          load_value     (const SessionValue *stored);
+
+bool session_open (Session *session, const char *path, Env *env) {
+  *session = { .fd = -1, .map = NULL, .size = 0, .path = NULL, .failed = false };
+
+  session->path = (char *) counted_malloc(strlen(path) + 1);
+  strcpy(session->path, path);
+
+  session->fd = open(path, O_RDWR | O_CREAT, 0600);
+  struct stat file = {};
+  if (session->fd < 0 || fstat(session->fd, &file)) {
+    LOG_ERROR("Could not open the session %s: %s", path, strerror(errno));
+    session_close(session);
+    return false;
+  }
+
+  if (!file.st_size) {
+    if (!create_file(session)) {
+      session_close(session);
+      return false;
+    }
+  } else if ((size_t) file.st_size < sizeof(SessionHeader)) {
+    LOG_ERROR("%s is not a session file!", path);
+    session_close(session);
+    return false;
+  } else if (!map_session(session, (size_t) file.st_size) || !check_header(session)) {
+    session_close(session);
+    return false;
+  }
+
+  uint64_t records = replay(session, env);
+
+  // most of what it replayed was overwritten later, so start over from what is left
+  if (records > SESSION_MIN_COMPACT && !env->snapshot_count) {
+    uint64_t live = 0;
+    for (int var = 0; var < symbol_count(); var++) {
+      const VarDescription *desc = var_tree_get(&env->vars, var);
+      live += desc && desc->used;
+    }
+
+    if (records > 2 * live)
+      compact(session, env);
+  }
+
+  env->session = session;
+  return true;
+}
+
+void session_record_let (Session *session, int var, Value value, const Expr *expr, bool dirty) {
+  // parameters are gone by the time it's replayed
+  if (expr && expr_max_param(expr))
+    expr = NULL;
+
+  const char *name     = symbol_name(var);
+  size_t      name_len = strlen(name);
+  size_t      expr_len = expr ? expr_size(expr) : 0;
+
+  SessionRecord *record = begin_record(session, SESSION_LET, name_len + expr_len);
+  if (!record)
+    return;
+
+  record->dirty    = dirty;
+  record->name_len = (uint16_t) name_len;
+  record->expr_len = (uint32_t) expr_len;
+  store_value(&record->value, value);
+
+  char *data = (char *) (record + 1);
+  memcpy(data, name, name_len);
+  if (expr)
+    write_expr(data + name_len, expr);
+
+  end_record(session, record);
+}
+
+void session_record (Session *session, SessionRecordType type) {
+  SessionRecord *record = begin_record(session, type, 0);
+  if (record)
+    end_record(session, record);
+}
+
+void session_close (Session *session) {
+  unmap_session(session);
+
+  if (session->fd >= 0)
+    close(session->fd);
+
+  counted_free(session->path);
+  *session = { .fd = -1, .map = NULL, .size = 0, .path = NULL, .failed = false };
+}
+
+/* FNV-1a of the bytes */
+uint64_t checksum (const void *data, size_t len) {
+  const unsigned char *bytes = (const unsigned char *) data;
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < len; i++)
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+  return hash;
+}
+
+/* the header at the start of the mapping */
+SessionHeader *get_header (Session *session) {
+  return (SessionHeader *) session->map;
+}
+
+/* checksum of the fields of the header after its checksum */
+uint64_t header_sum (const SessionHeader *header) {
+  return checksum(&header->used, sizeof(SessionHeader) - offsetof(SessionHeader, used));
+}
+
+/* set the checksum of the header after changing it */
+void seal_header (Session *session) {
+  get_header(session)->checksum = header_sum(get_header(session));
+}
+
+/* make the file size bytes long and map all of it, or remap it if it's mapped already */
+bool map_session (Session *session, size_t size) {
+  struct stat file = {};
+  if (fstat(session->fd, &file) || ((size_t) file.st_size < size && ftruncate(session->fd, (off_t) size))) {
+    LOG_ERROR("Could not grow the session %s: %s", session->path, strerror(errno));
+    return false;
+  }
+
+  void *map = session->map
+            ? mremap(session->map, session->size, size, MREMAP_MAYMOVE)
+            : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, session->fd, 0);
+
+  if (map == MAP_FAILED) {
+    LOG_ERROR("Could not map the session %s: %s", session->path, strerror(errno));
+    return false;
+  }
+
+  session->map  = (char *) map;
+  session->size = size;
+  return true;
+}
+
+/* start an empty file */
+bool create_file (Session *session) {
+  if (!map_session(session, SESSION_START_SIZE))
+    return false;
+
+  SessionHeader *header = get_header(session);
+  *header = { .magic = SESSION_MAGIC, .version = SESSION_VERSION, .reserved = 0, .checksum = 0, .used = 0, .records = 0 };
+  seal_header(session);
+
+  LOG_DEBUG("Started a new session at %s", session->path);
+  return true;
+}
+
+/* whether the mapped file is a session this version can read, reporting why it isn't */
+bool check_header (Session *session) {
+  SessionHeader *header = get_header(session);
+
+  if (header->magic != SESSION_MAGIC) {
+    LOG_ERROR("%s is not a session file!", session->path);
+    return false;
+  }
+
+  if (header->version != SESSION_VERSION) {
+    LOG_ERROR("The session %s has version %u, but only version %d can be read!",
+              session->path, header->version, SESSION_VERSION);
+    return false;
+  }
+
+  if (header->checksum != header_sum(header) || header->used > session->size - sizeof(SessionHeader)) {
+    LOG_ERROR("The session %s is corrupted!", session->path);
+    return false;
+  }
+
+  return true;
+}
+
+/* flush and unmap the file */
+void unmap_session (Session *session) {
+  if (!session->map)
+    return;
+
+  msync(session->map, session->size, MS_SYNC);
+  munmap(session->map, session->size);
+  session->map  = NULL;
+  session->size = 0;
+}
+
+/* make room for a record with len bytes after its header, returns it zeroed except for the size and type */
+SessionRecord *begin_record (Session *session, SessionRecordType type, size_t len) {
+  if (session->failed)
+    return NULL;
+
+  size_t size   = (sizeof(SessionRecord) + len + 7) & ~(size_t) 7;
+  size_t needed = sizeof(SessionHeader) + get_header(session)->used + size;
+
+  if (needed > session->size) {
+    size_t grown = session->size * 2;
+    while (grown < needed)
+      grown *= 2;
+
+    if (!map_session(session, grown)) {
+      LOG_ERROR("Not recording anything to the session any more");
+      session->failed = true;
+      return NULL;
+    }
+  }
+
+  SessionRecord *record = (SessionRecord *) (session->map + sizeof(SessionHeader) + get_header(session)->used);
+  memset((void *) record, 0, size);
+  record->size = (uint32_t) size;
+  record->type = (uint8_t) type;
+  return record;
+}
+
+/* seal a record from begin_record, and only then make it a part of the file */
+void end_record (Session *session, SessionRecord *record) {
+  record->checksum = checksum(&record->size, record->size - offsetof(SessionRecord, size));
+
+  SessionHeader *header = get_header(session);
+  header->used += record->size;
+  header->records++;
+  seal_header(session);
+}
+
+/* apply the records to env, dropping the ones after the first that doesn't check out. Returns the number applied */
+uint64_t replay (Session *session, Env *env) {
+  SessionHeader *header = get_header(session);
+  const char    *start  = session->map + sizeof(SessionHeader);
+
+  uint64_t records = 0;
+  uint64_t offset  = 0;
+  while (offset < header->used) {
+    const SessionRecord *record = (const SessionRecord *) (start + offset);
+    uint64_t left = header->used - offset;
+
+    bool valid = left >= sizeof(SessionRecord) && record->size >= sizeof(SessionRecord) &&
+                 record->size <= left && !(record->size % 8) &&
+                 record->checksum == checksum(&record->size, record->size - offsetof(SessionRecord, size));
+
+    if (!valid || !replay_record(record, env)) {
+      LOG_WARN("The session %s is corrupted after %llu records, dropping the rest of it",
+               session->path, (unsigned long long) records);
+      break;
+    }
+
+    offset += record->size;
+    records++;
+  }
+
+  header->used    = offset;
+  header->records = records;
+  seal_header(session);
+
+  LOG_DEBUG("Replayed %llu records of the session %s", (unsigned long long) records, session->path);
+  return records;
+}
+
+/* apply a record whose checksum is right, returns false if it doesn't make sense */
+bool replay_record (const SessionRecord *record, Env *env) {
+  switch ((SessionRecordType) record->type) {
+    case SESSION_SNAPSHOT:
+      env_push_snapshot(env);
+      return true;
+    case SESSION_ROLLBACK:
+      return env_rollback(env) > 0;
+    case SESSION_LET:
+      break;
+    default:
+      return false;
+  }
+
+  const char *name = (const char *) (record + 1);
+  const char *end  = name + record->name_len + record->expr_len;
+  if (!record->name_len || record->name_len >= SYMBOL_MAX_LEN ||
+      end > (const char *) record + record->size)
+    return false;
+
+  Expr *expr = NULL;
+  if (record->expr_len) {
+    const char *at = name + record->name_len;
+    expr = read_expr(&at, end);
+    if (!expr || at != end) {
+      destroy_expr(expr);
+      return false;
+    }
+  }
+
+  int   var   = symbol_intern(name, record->name_len);
+  Value value = load_value(&record->value);
+
+  if (env->reactive) {
+    env_bind(env, var, value, expr);
+
+    // it was written in order, so nothing after it made it dirty yet
+    if (record->dirty && var_tree_get(&env->vars, var)->expr)
+      var_tree_edit(&env->vars, var)->dirty = true;
+  } else {
+    env_set_value(env, var, value);
+  }
+
+  destroy_expr(expr);
+  return true;
+}
+
+/* replace the file with one that only sets the variables of env as they are now */
+void compact (Session *session, Env *env) {
+  size_t path_len = strlen(session->path);
+  char  *path     = (char *) counted_malloc(path_len + sizeof(".tmp"));
+  memcpy(path, session->path, path_len);
+  strcpy(path + path_len, ".tmp");
+
+  Session fresh = { .fd = -1, .map = NULL, .size = 0, .path = path, .failed = false };
+  fresh.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+  if (fresh.fd < 0 || !create_file(&fresh)) {
+    LOG_WARN("Could not rewrite the session %s: %s", session->path, strerror(errno));
+    session_close(&fresh);
+    return;
+  }
+
+  bool *written = (bool *) counted_calloc((size_t) symbol_count(), sizeof(bool));
+  for (int var = 0; var < symbol_count() && !fresh.failed; var++)
+    write_var(&fresh, env, var, written);
+  counted_free(written);
+
+  unmap_session(&fresh);
+  if (fresh.failed || rename(path, session->path)) {
+    LOG_WARN("Could not rewrite the session %s", session->path);
+    unlink(path);
+    session_close(&fresh);
+    return;
+  }
+
+  // the old mapping is of the file that was just replaced
+  unmap_session(session);
+  close(session->fd);
+  session->fd = fresh.fd;
+  fresh.fd    = -1;
+  session_close(&fresh);
+
+  struct stat file = {};
+  if (fstat(session->fd, &file) || !map_session(session, (size_t) file.st_size))
+    session->failed = true;
+}
+
+/* record var after the variables it reads, unless it's written already */
+void write_var (Session *session, Env *env, int var, bool *written) {
+  if (written[var])
+    return;
+
+  written[var] = true;
+
+  const VarDescription *desc = var_tree_get(&env->vars, var);
+  if (!desc || !desc->used)
+    return;
+
+  for (size_t i = 0; i < desc->reads.count; i++)
+    write_var(session, env, desc->reads.vars[i], written);
+
+  session_record_let(session, var, unpack_value(&desc->val), desc->expr, desc->dirty);
+}
+
+/* bytes that write_expr takes for expr */
+size_t expr_size (const Expr *expr) {
+  switch (expr->type) {
+    case OPERATOR:
+      return 3 + (expr->left  ? expr_size(expr->left)  : 0)
+               + (expr->right ? expr_size(expr->right) : 0);
+    case NUMBER:
+      return 1 + sizeof(complex_t);
+    case POLY_VAR:
+      return 2;
+    case IDENTIFIER:
+      return 2 + strlen(symbol_name(expr->symbol));
+    case CONSTANT_POLY:
+      return 2 + sizeof(expr->poly->coeffs);
+    case PARAMETER:
+    case SLOT:
+    default:
+      // never kept, and rejected when it's read back
+      return 1;
+  }
+}
+
+/* write expr in preorder, as its type and then what it holds. Returns where it ends */
+char *write_expr (char *at, const Expr *expr) {
+  *at++ = (char) expr->type;
+
+  switch (expr->type) {
+    case OPERATOR:
+      *at++ = (char) expr->op;
+      *at++ = (char) ((expr->left ? SESSION_LEFT : 0) | (expr->right ? SESSION_RIGHT : 0));
+      if (expr->left)
+        at = write_expr(at, expr->left);
+      if (expr->right)
+        at = write_expr(at, expr->right);
+      return at;
+    case NUMBER:
+      memcpy(at, &expr->val, sizeof(complex_t));
+      return at + sizeof(complex_t);
+    case POLY_VAR:
+      *at++ = expr->poly_name;
+      return at;
+    case IDENTIFIER: {
+      const char *name = symbol_name(expr->symbol);
+      size_t      len  = strlen(name);
+      *at++ = (char) len;
+      memcpy(at, name, len);
+      return at + len;
+    }
+    case CONSTANT_POLY:
+      *at++ = expr->poly->var;
+      memcpy(at, expr->poly->coeffs, sizeof(expr->poly->coeffs));
+      return at + sizeof(expr->poly->coeffs);
+    case PARAMETER:
+    case SLOT:
+    default:
+      return at;
+  }
+}
+
+/* read an expression from write_expr, advancing at. Returns NULL if it's malformed */
+Expr *read_expr (const char **at, const char *end) {
+  if (*at >= end)
+    return NULL;
+
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
+  expr->type = (NodeType) *(*at)++;
+
+  switch (expr->type) {
+    case OPERATOR: {
+      if (end - *at < 2)
+        break;
+
+      expr->op = (Operator) *(*at)++;
+      char children = *(*at)++;
+
+      if ((children & SESSION_LEFT) && !(expr->left = read_expr(at, end)))
+        break;
+      if ((children & SESSION_RIGHT) && !(expr->right = read_expr(at, end)))
+        break;
+      return expr;
+    }
+    case NUMBER:
+      if ((size_t) (end - *at) < sizeof(complex_t))
+        break;
+
+      memcpy(&expr->val, *at, sizeof(complex_t));
+      *at += sizeof(complex_t);
+      return expr;
+    case POLY_VAR:
+      if (end - *at < 1)
+        break;
+
+      expr->poly_name = *(*at)++;
+      return expr;
+    case IDENTIFIER: {
+      if (end - *at < 1)
+        break;
+
+      size_t len = (unsigned char) *(*at)++;
+      if (!len || len >= SYMBOL_MAX_LEN || (size_t) (end - *at) < len)
+        break;
+
+      expr->symbol = symbol_intern(*at, len);
+      *at += len;
+      return expr;
+    }
+    case CONSTANT_POLY:
+      if ((size_t) (end - *at) < 1 + sizeof(expr->poly->coeffs))
+        break;
+
+      expr->poly = (Polynomial *) counted_calloc(1, sizeof(Polynomial));
+      expr->poly->var = *(*at)++;
+      memcpy(expr->poly->coeffs, *at, sizeof(expr->poly->coeffs));
+      *at += sizeof(expr->poly->coeffs);
+      return expr;
+    case PARAMETER:
+    case SLOT:
+    default:
+      break;
+  }
+
+  // what isn't read yet is zeroed, which destroy_expr skips
+  destroy_expr(expr);
+  return NULL;
+}
+
+/* write a value the way it's kept in a file to stored, which is zeroed */
+void store_value (SessionValue *stored, Value value) {
+  stored->type = (uint32_t) value.type;
+
+  if (value.type == TP_POLYNOMIAL) {
+    stored->var = value.poly.var;
+    for (size_t i = 0; i < POLY_COEFF_LEN; i++) {
+      stored->coeffs[i][0] = value.poly.coeffs[i].real;
+      stored->coeffs[i][1] = value.poly.coeffs[i].imag;
+    }
+  } else {
+    stored->coeffs[0][0] = value.num.real;
+    stored->coeffs[0][1] = value.num.imag;
+  }
+}
+
+/* a value kept by store_value */
+Value load_value (const SessionValue *stored) {
+  Value value = {};
+
+  if (stored->type == TP_POLYNOMIAL) {
+    value.type     = TP_POLYNOMIAL;
+    value.poly.var = stored->var;
+    for (size_t i = 0; i < POLY_COEFF_LEN; i++)
+      value.poly.coeffs[i] = { stored->coeffs[i][0], stored->coeffs[i][1] };
+  } else {
+    value.type = TP_NUMBER;
+    value.num  = { stored->coeffs[0][0], stored->coeffs[0][1] };
+  }
+
+  return value;
+}
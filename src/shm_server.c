@@ -0,0 +1,179 @@
+/**
+ * @file
+ * @brief A solver server over a shared-memory ring, see shm_client.h
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+#endif
+
+#include "shm_server.h"
+#include "shm_client.h"
+#include "arith.h"
+#include "polynomial.h"
+#include "stats.h"
+#include "log.h"
+
+/// Empty polls before the server goes to sleep, the last ones yield the core
+#define SHM_SPIN_LIMIT 10000
+/// Longest sleep between checks for a stop request, in nanoseconds
+#define SHM_SLEEP_NS   100000000
+
+volatile sig_atomic_t _shm_stop = 0;
+
+void     shm_signal_handler (int signal);
+ShmRing *create_ring        (const char *name);
+void     wait_for_request   (ShmRing *ring, ShmSlot *slot, uint64_t ticket);
+
+bool serve_shm (const char *name) {
+  ShmRing *ring = create_ring(name);
+  if (!ring)
+    return false;
+
+  struct sigaction action = {};
+  action.sa_handler = shm_signal_handler;
+  sigaction(SIGINT,  &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  LOG_INFO("Serving on shared memory %s", name);
+
+  unsigned int idle   = 0;
+  uint64_t     ticket = 0;
+
+  while (!_shm_stop) {
+    ShmSlot *slot = &ring->slots[ticket % SHM_RING_SLOTS];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ticket + 1) {
+      if (idle < SHM_SPIN_LIMIT) {
+        shm_ring_pause(&idle);
+      } else {
+        wait_for_request(ring, slot, ticket);
+        idle = 0;
+      }
+      continue;
+    }
+
+    idle = 0;
+    shm_solve_request(&slot->request, &slot->response);
+    __atomic_store_n(&slot->seq, ticket + 2, __ATOMIC_RELEASE);
+    ticket++;
+  }
+
+  LOG_INFO("Shutting down");
+  __atomic_store_n(&ring->server_alive, 0, __ATOMIC_RELEASE);
+
+  munmap(ring, sizeof(ShmRing));
+  shm_unlink(name);
+  _shm_stop = 0;
+  return true;
+}
+
+void serve_shm_stop (void) {
+  _shm_stop = 1;
+}
+
+void shm_signal_handler (int) {
+  _shm_stop = 1;
+}
+
+ShmRing *create_ring (const char *name) {
+  ShmRing *existing = shm_ring_attach(name);
+  if (existing) {
+    bool serving = shm_ring_server_alive(existing);
+    shm_ring_detach(existing);
+
+    if (serving) {
+      LOG_ERROR("Shared memory %s is already being served", name);
+      return NULL;
+    }
+  }
+
+  // a region left over from a crashed run has stale tickets in it
+  shm_unlink(name);
+
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    LOG_ERROR("Could not create shared memory %s: %s", name, strerror(errno));
+    return NULL;
+  }
+
+  if (ftruncate(fd, sizeof(ShmRing))) {
+    LOG_ERROR("Could not size shared memory %s: %s", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  void *region = mmap(NULL, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED) {
+    LOG_ERROR("Could not map shared memory %s: %s", name, strerror(errno));
+    shm_unlink(name);
+    return NULL;
+  }
+
+  ShmRing *ring = (ShmRing *) region;
+  ring->version      = SHM_RING_VERSION;
+  ring->slot_count   = SHM_RING_SLOTS;
+  ring->server_alive = 1;
+  ring->server_pid   = getpid();
+  for (uint64_t i = 0; i < SHM_RING_SLOTS; i++)
+    ring->slots[i].seq = i;
+
+  // the magic goes last, clients don't attach before it's there
+  __atomic_store_n(&ring->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+  return ring;
+}
+
+/* sleep on the futex until a client wakes us up, or for SHM_SLEEP_NS at most */
+void wait_for_request (ShmRing *ring, ShmSlot *slot, uint64_t ticket) {
+  uint32_t wakeups = __atomic_load_n(&ring->wakeups, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&ring->server_sleeping, 1, __ATOMIC_RELAXED);
+
+  // pairs with the fence in shm_ring_solve: either the client sees us
+  // sleeping, or we see its request here
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ticket + 1) {
+#ifdef __linux__
+    struct timespec timeout = { 0, SHM_SLEEP_NS };
+    syscall(SYS_futex, &ring->wakeups, FUTEX_WAIT, wakeups, &timeout, NULL, 0);
+#else
+    usleep(SHM_SLEEP_NS / 1000);
+#endif
+  }
+
+  __atomic_store_n(&ring->server_sleeping, 0, __ATOMIC_RELAXED);
+}
+
+void shm_solve_request (const ShmRequest *request, ShmResponse *response) {
+  Polynomial poly = { .var = 'x' };
+  for (int i = 0; i < SHM_COEFFS; i++)
+    poly.coeffs[i] = { request->coeffs[i][0], request->coeffs[i][1] };
+
+  Solutions sols = {};
+
+  STATS_BEGIN(solve);
+  // the closed forms don't cover every cubic, the iteration does
+  int solved = solve_polynomial(poly, &sols) || solve_polynomial_iterative(poly, &sols);
+  STATS_END(solve, PHASE_SOLVE);
+
+  *response = {};
+  response->status = solved;
+  response->count  = sols.count == INFINITE_SOLUTIONS ? SHM_INFINITE : sols.count;
+
+  for (int i = 0; solved && i < sols.count && i < SHM_ROOTS; i++) {
+    response->roots[i][0] = sols.x[i].real;
+    response->roots[i][1] = sols.x[i].imag;
+  }
+}
@@ -0,0 +1,315 @@
+/**
+ * @file
+ * @brief Per-phase latency statistics of command execution
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+#include "timer.h"
+
+/// Allocation totals of a phase
+typedef struct {
+  uint64_t allocs;
+  uint64_t bytes;
+  /// Largest peak of live bytes above the start of the phase
+  uint64_t max_peak;
+} PhaseAllocs;
+
+/// Histograms of a single thread, so that recording never takes a lock
+typedef struct StatsThread {
+  Histogram   phases[PHASE_COUNT];
+  /// Hardware counter totals of each phase
+  PerfSample  counters[PHASE_COUNT];
+  PhaseAllocs allocs[PHASE_COUNT];
+  /// Roots found by #solve_polynomial, and how many were found again
+  uint64_t    roots;
+  uint64_t    escalated;
+  struct StatsThread *next;
+} StatsThread;
+
+const char *PHASE_NAMES[PHASE_COUNT] = {
+  "command",
+  "parse",
+  "eval",
+  "solve",
+  "print",
+};
+
+bool stats_enabled = false;
+bool _stats_perf    = false;
+
+StatsThread              *_stats_threads      = NULL;
+pthread_mutex_t           _stats_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+thread_local StatsThread *_stats_current      = NULL;
+
+StatsThread *stats_current_thread (void);
+size_t       bucket_index         (uint64_t value);
+uint64_t     bucket_lower_bound   (size_t index);
+void         histogram_merge      (Histogram *into, const Histogram *from);
+void         print_counters       (FILE *out, const Histogram *merged, const PerfSample *counters);
+void         print_allocs         (FILE *out, const Histogram *merged, const PhaseAllocs *allocs);
+void         print_escalations    (FILE *out, uint64_t roots, uint64_t escalated);
+
+void stats_enable (bool enable) {
+  __atomic_store_n(&stats_enabled, enable, __ATOMIC_RELAXED);
+}
+
+/* the calling thread's histograms, registered on first use */
+StatsThread *stats_current_thread (void) {
+  if (!_stats_current) {
+    _stats_current = (StatsThread *) calloc(1, sizeof(StatsThread));
+
+    pthread_mutex_lock(&_stats_threads_lock);
+    _stats_current->next = _stats_threads;
+    _stats_threads = _stats_current;
+    pthread_mutex_unlock(&_stats_threads_lock);
+  }
+
+  return _stats_current;
+}
+
+bool stats_enable_perf (void) {
+  bool perf = perf_enable();
+  __atomic_store_n(&_stats_perf, perf, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats_enabled, true, __ATOMIC_RELAXED);
+  return perf;
+}
+
+void stats_record (StatsPhase phase, uint64_t ticks) {
+  histogram_record(&stats_current_thread()->phases[phase], ticks);
+}
+
+void stats_count_roots (uint64_t roots, uint64_t escalated) {
+  StatsThread *thread = stats_current_thread();
+  thread->roots     += roots;
+  thread->escalated += escalated;
+}
+
+void stats_span_begin (StatsSpan *span) {
+  // the peak is measured per span, and folded back into the enclosing one at the end
+  span->outer_peak = alloc_reset_peak();
+  span->allocs     = alloc_stats();
+
+  if (__atomic_load_n(&_stats_perf, __ATOMIC_RELAXED))
+    perf_read(&span->counters);
+
+  // the clock is read last at the start and first at the end, so that
+  // the counter syscalls stay outside of the measured time
+  span->start = fl_ticks();
+}
+
+void stats_span_end (StatsSpan *span, StatsPhase phase) {
+  uint64_t end = fl_ticks();
+  StatsThread *thread = stats_current_thread();
+
+  histogram_record(&thread->phases[phase], end - span->start);
+
+  AllocStats   allocs = alloc_stats();
+  PhaseAllocs *totals = &thread->allocs[phase];
+  uint64_t     peak   = allocs.peak_bytes - span->allocs.live_bytes;
+
+  totals->allocs += allocs.allocs - span->allocs.allocs;
+  totals->bytes  += allocs.bytes  - span->allocs.bytes;
+  if (peak > totals->max_peak)
+    totals->max_peak = peak;
+
+  alloc_merge_peak(span->outer_peak);
+
+  if (__atomic_load_n(&_stats_perf, __ATOMIC_RELAXED)) {
+    PerfSample now = {};
+    perf_read(&now);
+
+    PerfSample diff = perf_diff(span->counters, now);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+      thread->counters[phase].values[i] += diff.values[i];
+  }
+}
+
+// ------- HISTOGRAMS -------
+
+/*
+ * Values below HISTOGRAM_SUB_BUCKETS get their own bucket, after that every
+ * power of two [2^k; 2^(k+1)) is split into HISTOGRAM_SUB_BUCKETS equal parts.
+ */
+size_t bucket_index (uint64_t value) {
+  if (value < HISTOGRAM_SUB_BUCKETS)
+    return value;
+
+  int msb = 63 - __builtin_clzll(value);
+  size_t sub_bucket = (value >> (msb - 4)) & (HISTOGRAM_SUB_BUCKETS - 1);
+  return (size_t) (msb - 3) * HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t bucket_lower_bound (size_t index) {
+  if (index < HISTOGRAM_SUB_BUCKETS)
+    return index;
+  // the bucket after the last one would start at 2^64
+  if (index >= HISTOGRAM_BUCKETS)
+    return UINT64_MAX;
+
+  size_t exponent   = index / HISTOGRAM_SUB_BUCKETS;
+  size_t sub_bucket = index % HISTOGRAM_SUB_BUCKETS;
+  return (HISTOGRAM_SUB_BUCKETS + sub_bucket) << (exponent - 1);
+}
+
+void histogram_record (Histogram *hist, uint64_t value) {
+  hist->counts[bucket_index(value)]++;
+
+  if (!hist->total_count || value < hist->min)
+    hist->min = value;
+  if (value > hist->max)
+    hist->max = value;
+
+  hist->total_count++;
+  hist->total += value;
+}
+
+uint64_t histogram_percentile (const Histogram *hist, double percentile) {
+  if (!hist->total_count)
+    return 0;
+
+  uint64_t rank = (uint64_t) (percentile / 100.0 * (double) hist->total_count);
+  if (rank == 0)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += hist->counts[i];
+    if (seen >= rank) {
+      // the middle of the bucket, but never outside of what was recorded. The
+      // bounds of the top buckets add up to more than 64 bits
+      uint64_t lower  = bucket_lower_bound(i);
+      uint64_t middle = lower + (bucket_lower_bound(i + 1) - lower) / 2;
+      return middle > hist->max ? hist->max : (middle < hist->min ? hist->min : middle);
+    }
+  }
+
+  return hist->max;
+}
+
+void histogram_merge (Histogram *into, const Histogram *from) {
+  if (!from->total_count)
+    return;
+
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    into->counts[i] += from->counts[i];
+
+  if (!into->total_count || from->min < into->min)
+    into->min = from->min;
+  if (from->max > into->max)
+    into->max = from->max;
+
+  into->total_count += from->total_count;
+  into->total       += from->total;
+}
+
+// ------- OUTPUT -------
+
+void stats_print (FILE *out) {
+  Histogram *merged = (Histogram *) calloc(PHASE_COUNT, sizeof(Histogram));
+  PerfSample  counters[PHASE_COUNT] = {};
+  PhaseAllocs allocs[PHASE_COUNT]   = {};
+  uint64_t    roots = 0, escalated = 0;
+
+  pthread_mutex_lock(&_stats_threads_lock);
+  for (StatsThread *thread = _stats_threads; thread; thread = thread->next) {
+    roots     += thread->roots;
+    escalated += thread->escalated;
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      histogram_merge(&merged[phase], &thread->phases[phase]);
+
+      for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        counters[phase].values[i] += thread->counters[phase].values[i];
+
+      allocs[phase].allocs += thread->allocs[phase].allocs;
+      allocs[phase].bytes  += thread->allocs[phase].bytes;
+      if (thread->allocs[phase].max_peak > allocs[phase].max_peak)
+        allocs[phase].max_peak = thread->allocs[phase].max_peak;
+    }
+  }
+  pthread_mutex_unlock(&_stats_threads_lock);
+
+  fprintf(out, "%-10s %10s %12s %12s %12s %12s %12s\n",
+          "phase", "count", "mean ns", "p50 ns", "p90 ns", "p99 ns", "max ns");
+
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    const Histogram *hist = &merged[phase];
+    double mean = hist->total_count ?
+                  fl_ticks_to_ns(hist->total) / (double) hist->total_count : 0;
+
+    fprintf(out, "%-10s %10llu %12.0lf %12.0lf %12.0lf %12.0lf %12.0lf\n",
+            PHASE_NAMES[phase], (unsigned long long) hist->total_count, mean,
+            fl_ticks_to_ns(histogram_percentile(hist, 50)),
+            fl_ticks_to_ns(histogram_percentile(hist, 90)),
+            fl_ticks_to_ns(histogram_percentile(hist, 99)),
+            fl_ticks_to_ns(hist->max));
+  }
+
+  print_allocs(out, merged, allocs);
+  print_escalations(out, roots, escalated);
+
+  if (__atomic_load_n(&_stats_perf, __ATOMIC_RELAXED))
+    print_counters(out, merged, counters);
+
+  free(merged);
+}
+
+/* per-operation averages of the hardware counters */
+void print_counters (FILE *out, const Histogram *merged, const PerfSample *counters) {
+  fprintf(out, "\n%-10s", "phase");
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    fprintf(out, " %14s", PERF_COUNTER_NAMES[i]);
+  fprintf(out, " %8s\n", "IPC");
+
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    uint64_t count = merged[phase].total_count;
+    fprintf(out, "%-10s", PHASE_NAMES[phase]);
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+      if (perf_has_counter((PerfCounter) i) && count)
+        fprintf(out, " %14.1lf", (double) counters[phase].values[i] / (double) count);
+      else
+        fprintf(out, " %14s", "-");
+    }
+
+    uint64_t cycles = counters[phase].values[PERF_CYCLES];
+    if (perf_has_counter(PERF_INSTRUCTIONS) && cycles)
+      fprintf(out, " %8.2lf\n", (double) counters[phase].values[PERF_INSTRUCTIONS] / (double) cycles);
+    else
+      fprintf(out, " %8s\n", "-");
+  }
+}
+
+/* per-operation allocation counts, see #counted_malloc */
+void print_allocs (FILE *out, const Histogram *merged, const PhaseAllocs *allocs) {
+  fprintf(out, "\n%-10s %12s %12s %12s\n", "phase", "allocs/op", "bytes/op", "peak bytes");
+
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    double count = (double) merged[phase].total_count;
+    if (!merged[phase].total_count) {
+      fprintf(out, "%-10s %12s %12s %12s\n", PHASE_NAMES[phase], "-", "-", "-");
+      continue;
+    }
+
+    fprintf(out, "%-10s %12.1lf %12.1lf %12llu\n", PHASE_NAMES[phase],
+            (double) allocs[phase].allocs / count, (double) allocs[phase].bytes / count,
+            (unsigned long long) allocs[phase].max_peak);
+  }
+}
+
+/* the share of the roots that had to be found again in double-double, see #escalate_roots */
+void print_escalations (FILE *out, uint64_t roots, uint64_t escalated) {
+  fprintf(out, "\n%-10s %12s %12s %12s\n", "roots", "found", "escalated", "rate");
+  fprintf(out, "%-10s %12llu %12llu", "solve", (unsigned long long) roots, (unsigned long long) escalated);
+
+  if (roots)
+    fprintf(out, " %11.2lf%%\n", 100.0 * (double) escalated / (double) roots);
+  else
+    fprintf(out, " %12s\n", "-");
+}
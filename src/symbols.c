@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @brief Interned names of variables
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symbols.h"
+
+/// Buckets of the table when the first symbol is added, always a power of two
+#define SYMBOL_TABLE_START 256
+
+/// Open-addressing table from names to symbols, along with a vector of the names
+typedef struct {
+  /// Symbol plus one in every bucket, or zero for an empty one
+  int          *buckets;
+  size_t        bucket_count;
+  /// Name of every symbol
+  const char  **names;
+  int           count;
+  size_t        names_cap;
+} SymbolTable;
+
+/// Allocated with plain malloc, as it lives as long as the program and shouldn't
+/// show up in the allocations of whatever command added a symbol
+SymbolTable     _symbols      = {};
+pthread_mutex_t _symbols_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t hash_name   (const char *name, size_t len);
+size_t   find_bucket (const char *name, size_t len);
+void     grow_table  (void);
+
+int symbol_intern (const char *name, size_t len) {
+  assert(len < SYMBOL_MAX_LEN);
+  pthread_mutex_lock(&_symbols_lock);
+
+  if ((size_t) _symbols.count * 2 >= _symbols.bucket_count)
+    grow_table();
+
+  size_t bucket = find_bucket(name, len);
+  if (!_symbols.buckets[bucket]) {
+    if ((size_t) _symbols.count == _symbols.names_cap) {
+      _symbols.names_cap = _symbols.names_cap ? _symbols.names_cap * 2 : SYMBOL_TABLE_START;
+      _symbols.names     = (const char **) realloc(_symbols.names, _symbols.names_cap * sizeof(const char *));
+    }
+
+    char *copy = (char *) malloc(len + 1);
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+
+    _symbols.names[_symbols.count++] = copy;
+    _symbols.buckets[bucket] = _symbols.count;
+  }
+
+  int symbol = _symbols.buckets[bucket] - 1;
+  pthread_mutex_unlock(&_symbols_lock);
+  return symbol;
+}
+
+const char *symbol_name (int symbol) {
+  pthread_mutex_lock(&_symbols_lock);
+  assert(0 <= symbol && symbol < _symbols.count);
+  const char *name = _symbols.names[symbol];
+  pthread_mutex_unlock(&_symbols_lock);
+  return name;
+}
+
+int symbol_count (void) {
+  pthread_mutex_lock(&_symbols_lock);
+  int count = _symbols.count;
+  pthread_mutex_unlock(&_symbols_lock);
+  return count;
+}
+
+/* FNV-1a */
+uint64_t hash_name (const char *name, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char) name[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/* the bucket that has name, or the empty one where it would go */
+size_t find_bucket (const char *name, size_t len) {
+  size_t mask   = _symbols.bucket_count - 1;
+  size_t bucket = hash_name(name, len) & mask;
+
+  while (_symbols.buckets[bucket]) {
+    const char *other = _symbols.names[_symbols.buckets[bucket] - 1];
+    if (!strncmp(other, name, len) && !other[len])
+      break;
+
+    bucket = (bucket + 1) & mask;
+  }
+
+  return bucket;
+}
+
+/* double the buckets and put every symbol back in */
+void grow_table (void) {
+  free(_symbols.buckets);
+  _symbols.bucket_count = _symbols.bucket_count ? _symbols.bucket_count * 2 : SYMBOL_TABLE_START;
+  _symbols.buckets      = (int *) calloc(_symbols.bucket_count, sizeof(int));
+
+  for (int symbol = 0; symbol < _symbols.count; symbol++) {
+    const char *name = _symbols.names[symbol];
+    _symbols.buckets[find_bucket(name, strlen(name))] = symbol + 1;
+  }
+}
@@ -14,6 +14,11 @@ _FL_Test           *_fl_test_data = {};
 size_t              _fl_test_count = 0;
 size_t              _fl_test_capacity = 0;
 size_t thread_local _fl_current_test_index = 0;
+FL_AllocCounter     _fl_alloc_counter = NULL;
+
+void fl_set_alloc_counter (FL_AllocCounter counter) {
+  _fl_alloc_counter = counter;
+}
 
 int _fl_add_test(const char test_name[], void (*test)()) {
   if (_fl_test_count == _fl_test_capacity) {
@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief The allocation counters and hardware counters of this program,
+ *        plugged into the testing library
+ */
+
+#include "test_ext.h"
+#include "alloc.h"
+#include "perf.h"
+
+uint64_t count_allocs         (void);
+bool     bench_perf_has       (size_t index);
+void     bench_perf_read      (uint64_t *values);
+
+const FL_BenchCounters PERF_BENCH_COUNTERS = {
+  .count   = PERF_COUNTER_COUNT,
+  .names   = PERF_COUNTER_NAMES,
+  .enable  = perf_enable,
+  .disable = perf_disable,
+  .has     = bench_perf_has,
+  .read    = bench_perf_read,
+};
+
+static_assert(PERF_COUNTER_COUNT <= FL_MAX_BENCH_COUNTERS, "FL_BenchCounters can't hold every counter");
+
+void fl_use_program_hooks (void) {
+  fl_set_alloc_counter(count_allocs);
+  fl_set_bench_counters(&PERF_BENCH_COUNTERS);
+}
+
+uint64_t count_allocs (void) {
+  return alloc_stats().allocs;
+}
+
+bool bench_perf_has (size_t index) {
+  return perf_has_counter((PerfCounter) index);
+}
+
+void bench_perf_read (uint64_t *values) {
+  PerfSample sample = {};
+  perf_read(&sample);
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    values[i] = sample.values[i];
+}
@@ -0,0 +1,44 @@
+/**
+ * @file
+ * @brief Timestamp counter calibration
+ */
+
+#include <time.h>
+
+#include "timer.h"
+
+/// How long to spin while calibrating #fl_ticks against the monotonic clock
+#define CALIBRATION_NS 10000000
+
+double _fl_ticks_per_ns = 0;
+
+uint64_t fl_now_ns (void) {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+double fl_ticks_per_ns (void) {
+  if (_fl_ticks_per_ns > 0)
+    return _fl_ticks_per_ns;
+
+#ifdef FL_HAS_TSC
+  uint64_t start_ns    = fl_now_ns();
+  uint64_t start_ticks = fl_ticks();
+
+  uint64_t now_ns = start_ns;
+  while (now_ns - start_ns < CALIBRATION_NS)
+    now_ns = fl_now_ns();
+
+  uint64_t end_ticks = fl_ticks();
+  _fl_ticks_per_ns = (double) (end_ticks - start_ticks) / (double) (now_ns - start_ns);
+#else
+  _fl_ticks_per_ns = 1;
+#endif
+
+  return _fl_ticks_per_ns;
+}
+
+double fl_ticks_to_ns (uint64_t ticks) {
+  return (double) ticks / fl_ticks_per_ns();
+}
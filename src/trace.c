@@ -0,0 +1,187 @@
+/**
+ * @file
+ * @brief Chrome trace-event (Perfetto) recording of command execution
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+  #include <sys/syscall.h>
+#endif
+
+#include "trace.h"
+#include "timer.h"
+#include "log.h"
+
+/// Initial number of events in a thread's buffer
+#define TRACE_INITIAL_CAPACITY 1024
+
+/// Spans of a single thread, so that recording never takes a lock
+typedef struct TraceThread {
+  TraceEvent *events;
+  size_t      count;
+  size_t      capacity;
+  /// OS thread id, shown as the track of the events
+  long        tid;
+  struct TraceThread *next;
+} TraceThread;
+
+bool trace_enabled = false;
+
+FILE    *_trace_file   = NULL;
+uint64_t _trace_origin = 0;
+
+TraceThread              *_trace_threads      = NULL;
+pthread_mutex_t           _trace_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+thread_local TraceThread *_trace_current      = NULL;
+
+TraceThread *trace_current_thread (void);
+long         current_tid          (void);
+void         write_json_string    (FILE *out, const char *str);
+void         write_event          (FILE *out, long pid, long tid, const TraceEvent *event);
+
+bool trace_enable (const char *path) {
+  _trace_file = fopen(path, "w");
+  if (!_trace_file) {
+    LOG_ERROR("Could not open %s for writing the trace", path);
+    return false;
+  }
+
+  // calibrate now rather than in the middle of the first span
+  fl_ticks_per_ns();
+
+  _trace_origin = fl_ticks();
+  trace_enabled = true;
+  atexit(trace_flush);
+  return true;
+}
+
+long current_tid (void) {
+#ifdef __linux__
+  return syscall(SYS_gettid);
+#else
+  return (long) getpid();
+#endif
+}
+
+/* the calling thread's buffer, registered on first use */
+TraceThread *trace_current_thread (void) {
+  if (!_trace_current) {
+    _trace_current = (TraceThread *) calloc(1, sizeof(TraceThread));
+    _trace_current->tid = current_tid();
+
+    pthread_mutex_lock(&_trace_threads_lock);
+    _trace_current->next = _trace_threads;
+    _trace_threads = _trace_current;
+    pthread_mutex_unlock(&_trace_threads_lock);
+  }
+
+  return _trace_current;
+}
+
+void trace_record (const char *name, uint64_t start, uint64_t end,
+                   const char *arg_name, const char *arg) {
+  TraceThread *thread = trace_current_thread();
+
+  if (thread->count == thread->capacity) {
+    size_t capacity = thread->capacity ? thread->capacity * 2 : TRACE_INITIAL_CAPACITY;
+    TraceEvent *events = (TraceEvent *) realloc(thread->events, capacity * sizeof(TraceEvent));
+    if (!events)
+      return;
+
+    thread->events   = events;
+    thread->capacity = capacity;
+  }
+
+  TraceEvent *event = &thread->events[thread->count++];
+  event->name     = name;
+  event->start    = start;
+  event->end      = end;
+  event->arg_name = arg_name;
+  event->arg[0]   = '\0';
+
+  if (arg_name && arg) {
+    strncpy(event->arg, arg, TRACE_ARG_LEN - 1);
+    event->arg[TRACE_ARG_LEN - 1] = '\0';
+  }
+}
+
+// ------- OUTPUT -------
+
+void trace_flush (void) {
+  if (!_trace_file)
+    return;
+
+  trace_enabled = false;
+  long pid = (long) getpid();
+
+  fprintf(_trace_file, "{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [\n");
+
+  bool first = true;
+
+  pthread_mutex_lock(&_trace_threads_lock);
+  for (TraceThread *thread = _trace_threads; thread;) {
+    fprintf(_trace_file, "%s    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %ld, "
+                         "\"tid\": %ld, \"args\": {\"name\": \"%s\"}}",
+            first ? "" : ",\n", pid, thread->tid, thread->tid == pid ? "main" : "worker");
+    first = false;
+
+    for (size_t i = 0; i < thread->count; i++) {
+      fprintf(_trace_file, ",\n");
+      write_event(_trace_file, pid, thread->tid, &thread->events[i]);
+    }
+
+    TraceThread *next = thread->next;
+    free(thread->events);
+    free(thread);
+    thread = next;
+  }
+
+  _trace_threads = NULL;
+  _trace_current = NULL;
+  pthread_mutex_unlock(&_trace_threads_lock);
+
+  fprintf(_trace_file, "\n  ]\n}\n");
+  fclose(_trace_file);
+  _trace_file = NULL;
+}
+
+/* a complete ("X") event, timestamps are in microseconds since #trace_enable */
+void write_event (FILE *out, long pid, long tid, const TraceEvent *event) {
+  double ts  = fl_ticks_to_ns(event->start - _trace_origin) / 1000.0;
+  double dur = fl_ticks_to_ns(event->end   - event->start ) / 1000.0;
+
+  fprintf(out, "    {\"name\": \"%s\", \"ph\": \"X\", \"pid\": %ld, \"tid\": %ld, "
+               "\"ts\": %.3lf, \"dur\": %.3lf",
+          event->name, pid, tid, ts, dur);
+
+  if (event->arg_name) {
+    fprintf(out, ", \"args\": {\"%s\": ", event->arg_name);
+    write_json_string(out, event->arg);
+    fputc('}', out);
+  }
+
+  fputc('}', out);
+}
+
+void write_json_string (FILE *out, const char *str) {
+  fputc('"', out);
+
+  for (; *str; str++) {
+    unsigned char c = (unsigned char) *str;
+
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
+  }
+
+  fputc('"', out);
+}
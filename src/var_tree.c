@@ -0,0 +1,154 @@
+/**
+ * @file
+ * @brief Persistent tree of variables, that is shared between snapshots of an #Env
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "var_tree.h"
+#include "alloc.h"
+#include "evaluate.h"
+#include "parser.h"
+
+struct VarNode {
+  /// Trees and nodes that point to this one, only a node with a single
+  /// reference can be changed in place
+  int refs;
+  union {
+    /// Children of a node above the leaves, NULL where nothing was set yet
+    VarNode        *children[VAR_TREE_WIDTH];
+    /// Variables of a leaf
+    VarDescription  vars[VAR_TREE_WIDTH];
+  };
+};
+
+size_t   tree_capacity (unsigned int depth);
+size_t   child_index   (int var, unsigned int level);
+VarNode *copy_node     (const VarNode *node, unsigned int level);
+void     release_node  (VarNode *node, unsigned int level);
+void     copy_list     (VarList *list);
+
+const VarDescription *var_tree_get (const VarTree *tree, int var) {
+  if (var < 0 || !tree->root || (size_t) var >= tree_capacity(tree->depth))
+    return NULL;
+
+  const VarNode *node = tree->root;
+  for (unsigned int level = tree->depth; level > 0 && node; level--)
+    node = node->children[child_index(var, level)];
+
+  return node ? &node->vars[child_index(var, 0)] : NULL;
+}
+
+VarDescription *var_tree_edit (VarTree *tree, int var) {
+  assert(var >= 0);
+
+  // a new root takes over the old one as its first child
+  while ((size_t) var >= tree_capacity(tree->depth)) {
+    if (tree->root) {
+      VarNode *root = (VarNode *) counted_calloc(1, sizeof(VarNode));
+      root->refs        = 1;
+      root->children[0] = tree->root;
+      tree->root        = root;
+    }
+
+    tree->depth++;
+  }
+
+  VarNode **slot = &tree->root;
+  for (unsigned int level = tree->depth; ; level--) {
+    VarNode *node = *slot;
+
+    if (!node) {
+      node = (VarNode *) counted_calloc(1, sizeof(VarNode));
+      node->refs = 1;
+      *slot = node;
+    } else if (__atomic_load_n(&node->refs, __ATOMIC_ACQUIRE) > 1) {
+      // the others may let go of it meanwhile, so it's released like any reference
+      *slot = copy_node(node, level);
+      release_node(node, level);
+      node = *slot;
+    }
+
+    if (!level)
+      return &node->vars[child_index(var, 0)];
+
+    slot = &node->children[child_index(var, level)];
+  }
+}
+
+VarTree var_tree_share (const VarTree *tree) {
+  if (tree->root)
+    __atomic_fetch_add(&tree->root->refs, 1, __ATOMIC_RELAXED);
+
+  return *tree;
+}
+
+void var_tree_release (VarTree *tree) {
+  release_node(tree->root, tree->depth);
+  *tree = {};
+}
+
+/* number of symbols a tree of this depth holds */
+size_t tree_capacity (unsigned int depth) {
+  return (size_t) VAR_TREE_WIDTH << (VAR_TREE_BITS * depth);
+}
+
+/* index of the child of a node at this level that var is under, level zero being the leaves */
+size_t child_index (int var, unsigned int level) {
+  return ((size_t) var >> (VAR_TREE_BITS * level)) & (VAR_TREE_WIDTH - 1);
+}
+
+/* a copy of node with a single reference, that shares its children or has copies of its variables */
+VarNode *copy_node (const VarNode *node, unsigned int level) {
+  VarNode *copy = (VarNode *) counted_malloc(sizeof(VarNode));
+  memcpy((void *) copy, (const void *) node, sizeof(VarNode));
+  copy->refs = 1;
+
+  if (level) {
+    for (size_t i = 0; i < VAR_TREE_WIDTH; i++)
+      if (copy->children[i])
+        __atomic_fetch_add(&copy->children[i]->refs, 1, __ATOMIC_RELAXED);
+
+    return copy;
+  }
+
+  for (size_t i = 0; i < VAR_TREE_WIDTH; i++) {
+    VarDescription *desc = &copy->vars[i];
+    desc->val  = copy_packed_value(&desc->val);
+    desc->expr = clone_expr(desc->expr);
+    copy_list(&desc->reads);
+    copy_list(&desc->dependents);
+  }
+
+  return copy;
+}
+
+/* drop a reference to node, freeing it and whatever only it pointed to once there are none left */
+void release_node (VarNode *node, unsigned int level) {
+  if (!node || __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL))
+    return;
+
+  for (size_t i = 0; i < VAR_TREE_WIDTH; i++) {
+    if (level) {
+      release_node(node->children[i], level - 1);
+    } else {
+      destroy_packed_value(&node->vars[i].val);
+      destroy_expr(node->vars[i].expr);
+      counted_free(node->vars[i].reads.vars);
+      counted_free(node->vars[i].dependents.vars);
+    }
+  }
+
+  counted_free(node);
+}
+
+/* give list a copy of the variables it points to */
+void copy_list (VarList *list) {
+  if (!list->vars)
+    return;
+
+  int *vars = (int *) counted_malloc(list->cap * sizeof(int));
+  memcpy(vars, list->vars, list->count * sizeof(int));
+  list->vars = vars;
+}
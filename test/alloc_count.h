@@ -0,0 +1,29 @@
+#include "test.h"
+#include "alloc.h"
+#include "parser.h"
+#include "evaluate.h"
+
+TEST(parse_stmt_allocations) {
+  Statement *stmt = (Statement *) counted_calloc(1, sizeof(Statement));
+  AllocStats before = alloc_stats();
+
+  // every grammar level allocates a scratch node that is copied into its
+  // parent and freed, so this is a lot more than the 9 nodes that are kept
+  ASSERT_MAX_ALLOCS(26, parse_stmt("solve x^2 + 3*x + 1", stmt));
+
+  destory_stmt(stmt);
+  AllocStats after = alloc_stats();
+
+  ASSERT_EQ(after.live_bytes + sizeof(Statement), before.live_bytes);
+}
+
+TEST(eval_expr_does_not_allocate) {
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
+  parse_expr("(x + 1) * (x - 2)^2 / 4 + 3i", expr);
+
+  Env env = {};
+  Value val = {};
+  ASSERT_MAX_ALLOCS(0, eval_expr(&env, expr, &val));
+
+  destroy_expr(expr);
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "async_io.h"
+
+/// Enough lines to span a few chunks, so some of them are split between two
+#define BATCH_IO_LINES 1500
+
+/* line i of the test file, lengths vary so that lines cross chunk boundaries */
+void batch_io_line (size_t i, char *line);
+
+void batch_io_line (size_t i, char *line) {
+  size_t len = i * 37 % 5000;
+  memset(line, 'a' + (int) (i % 26), len);
+  sprintf(line + len, "%zu", i);
+}
+
+/* write the test file through one backend and read it back through the other */
+bool batch_io_round_trip (AsyncIoBackend write_backend, AsyncIoBackend read_backend);
+
+bool batch_io_round_trip (AsyncIoBackend write_backend, AsyncIoBackend read_backend) {
+  FILE *file  = tmpfile();
+  char *line  = (char *) malloc(5100);
+  bool  equal = true;
+
+  AsyncIo    *io     = async_io_create(write_backend);
+  AsyncWriter writer = {};
+  async_writer_open(&writer, io, fileno(file));
+  FILE *out = async_writer_stream(&writer);
+
+  // the last line doesn't end with a newline, and an empty one is in the middle
+  for (size_t i = 0; i < BATCH_IO_LINES; i++) {
+    batch_io_line(i, line);
+    fprintf(out, i + 1 < BATCH_IO_LINES ? "%s\n" : "%s", line);
+    if (i == BATCH_IO_LINES / 2)
+      fputc('\n', out);
+  }
+
+  fclose(out);
+  equal = async_writer_close(&writer) && equal;
+  async_io_destroy(io);
+
+  lseek(fileno(file), 0, SEEK_SET);
+  io = async_io_create(read_backend);
+  AsyncReader reader = {};
+  async_reader_open(&reader, io, fileno(file));
+
+  size_t count = 0;
+  const char *read_line = NULL;
+  while ((read_line = async_reader_line(&reader))) {
+    if (!*read_line)
+      continue;
+
+    batch_io_line(count++, line);
+    equal = equal && !strcmp(read_line, line);
+  }
+
+  async_reader_close(&reader);
+  async_io_destroy(io);
+  free(line);
+  fclose(file);
+
+  return equal && count == BATCH_IO_LINES;
+}
+
+TEST(batch_io_uring_round_trip) {
+  ASSERT_BOOL(batch_io_round_trip(ASYNC_IO_URING, ASYNC_IO_URING));
+}
+
+TEST(batch_io_thread_round_trip) {
+  ASSERT_BOOL(batch_io_round_trip(ASYNC_IO_THREAD, ASYNC_IO_THREAD));
+}
+
+TEST(batch_io_backends_agree) {
+  ASSERT_BOOL(batch_io_round_trip(ASYNC_IO_URING, ASYNC_IO_THREAD));
+  ASSERT_BOOL(batch_io_round_trip(ASYNC_IO_THREAD, ASYNC_IO_URING));
+}
@@ -0,0 +1,147 @@
+#include <math.h>
+#include <string.h>
+
+#include "test.h"
+#include "arith.h"
+#include "batch_solve.h"
+#include "complex_array.h"
+#include "polynomial.h"
+
+/// Polynomials of every degree, with simple, multiple and complex roots
+const Polynomial BATCH_TEST_POLYS[] = {
+  { 'x', {.e = {2},  .d = {-3}, .c = {1}} },
+  { 'x', {.e = {-8}, .b = {1}} },
+  { 'x', {.e = {-1}, .a = {1}} },
+  { 'x', {.e = {5},  .d = {2},  .c = {1}} },
+  { 'x', {.e = {1},  .d = {-2}, .c = {1}} },
+  { 'x', {.e = {3},  .d = {2}} },
+  { 'x', {.e = {0, 1}, .b = {1}} },
+  { 'x', {.e = {2},  .d = {0, 1}, .c = {1}} },
+  { 'x', {.e = {2},  .d = {-3}, .c = {0}, .b = {1}} },
+  { 'x', {.e = {24}, .d = {-50}, .c = {35}, .b = {-10}, .a = {1}} },
+  { 'x', {.e = {1e6}, .d = {-1001}, .c = {1}} },
+};
+
+#define BATCH_TEST_COUNT (sizeof(BATCH_TEST_POLYS) / sizeof(BATCH_TEST_POLYS[0]))
+
+/* whether every root of sols has a root of the reference solver within its bound */
+bool roots_within_bounds (const Polynomial *p, const Solutions *sols, const RootErrors *errors);
+
+bool roots_within_bounds (const Polynomial *p, const Solutions *sols, const RootErrors *errors) {
+  // its iteration may not settle on multiple roots, but it does get them close
+  Solutions exact = {};
+  solve_polynomial_iterative(*p, &exact);
+  if (exact.count != sols->count)
+    return false;
+
+  for (int i = 0; i < sols->count; i++) {
+    double nearest = INFINITY;
+    for (int j = 0; j < exact.count; j++)
+      nearest = fmin(nearest, cmplx_mag(cmplx_sub(sols->x[i], exact.x[j])));
+
+    if (nearest > errors->radius[i] + 1e-9)
+      return false;
+  }
+
+  return true;
+}
+
+TEST(batch_solve_bounds_hold) {
+  const unsigned int precisions[] = { PRECISION_SINGLE, PRECISION_DOUBLE };
+
+  for (size_t k = 0; k < 2; k++) {
+    Solutions  sols[BATCH_TEST_COUNT]   = {};
+    RootErrors errors[BATCH_TEST_COUNT] = {};
+    batch_solve(BATCH_TEST_POLYS, BATCH_TEST_COUNT, precisions[k], sols, errors);
+
+    for (size_t i = 0; i < BATCH_TEST_COUNT; i++) {
+      ASSERT_EQ(sols[i].count, polynomial_deg(BATCH_TEST_POLYS[i]));
+      ASSERT_BOOL_MSG(roots_within_bounds(&BATCH_TEST_POLYS[i], &sols[i], &errors[i]),
+                      "polynomial #%zu in precision #%zu", i, k);
+    }
+  }
+}
+
+TEST(batch_solve_precision_shows_in_bounds) {
+  // 1 and 2, then 1, 2, 3 and 4: no roots that are close together
+  const Polynomial polys[] = { BATCH_TEST_POLYS[0], BATCH_TEST_POLYS[9] };
+  Solutions  sols[2]   = {};
+  RootErrors single[2] = {}, twice[2] = {};
+
+  batch_solve(polys, 2, PRECISION_DOUBLE, sols, twice);
+  batch_solve(polys, 2, PRECISION_SINGLE, sols, single);
+
+  for (size_t i = 0; i < 2; i++) {
+    for (int k = 0; k < sols[i].count; k++) {
+      ASSERT_BOOL(single[i].radius[k] < 1e-5 * cmplx_mag(sols[i].x[k]));
+      ASSERT_BOOL(twice[i].radius[k]  < 1e-10);
+    }
+  }
+}
+
+TEST(batch_solve_lanes_are_independent) {
+  // a polynomial has the same roots whatever is solved along with it
+  Solutions  together[BATCH_TEST_COUNT] = {};
+  RootErrors errors[BATCH_TEST_COUNT]   = {};
+  batch_solve(BATCH_TEST_POLYS, BATCH_TEST_COUNT, PRECISION_SINGLE, together, errors);
+
+  for (size_t i = 0; i < BATCH_TEST_COUNT; i++) {
+    Solutions  alone       = {};
+    RootErrors alone_error = {};
+    batch_solve(&BATCH_TEST_POLYS[i], 1, PRECISION_SINGLE, &alone, &alone_error);
+
+    ASSERT_BOOL(!memcmp(&alone, &together[i], sizeof(Solutions)));
+  }
+}
+
+TEST(batch_solve_small_degrees) {
+  const Polynomial polys[] = {
+    { 'x', {} },
+    { 'x', {.e = {3}} },
+    { 'x', {.e = {3}, .d = {2}} },
+  };
+  Solutions  sols[3]   = {};
+  RootErrors errors[3] = {};
+
+  batch_solve(polys, 3, PRECISION_SINGLE, sols, errors);
+  ASSERT_EQ(sols[0].count, INFINITE_SOLUTIONS);
+  ASSERT_EQ(sols[1].count, 0);
+  ASSERT_EQ(sols[2].count, 1);
+  ASSERT_BOOL(cmplx_eq(sols[2].x1, {-1.5}));
+  ASSERT_BOOL(errors[2].radius[0] < 1e-14);
+}
+
+TEST(batch_eval_matches_horner) {
+  const Polynomial p = BATCH_TEST_POLYS[7];
+  const size_t     count = 7;
+
+  complex_array_t        points = complex_array_new(count), values = complex_array_new(count);
+  complex_array_single_t single_points = complex_array_single_new(count);
+  complex_array_single_t single_values = complex_array_single_new(count);
+
+  for (size_t i = 0; i < count; i++) {
+    complex_t x = { 0.5 * (double) i - 1, 0.25 * (double) i };
+    cmplx_array_set(points, i, x);
+    single_points.real[i] = (float) x.real;
+    single_points.imag[i] = (float) x.imag;
+  }
+
+  batch_eval(&p, points, values, count);
+  batch_eval_single(&p, single_points, single_values, count);
+
+  for (size_t i = 0; i < count; i++) {
+    complex_t x = cmplx_array_get(points, i), value = {};
+    for (int k = POLY_MAX_DEG; k >= 0; k--)
+      value = cmplx_fma(value, x, p.coeffs[k]);
+
+    ASSERT_BOOL(cmplx_eq(cmplx_array_get(values, i), value));
+
+    complex_t single_value = { single_values.real[i], single_values.imag[i] };
+    ASSERT_BOOL(cmplx_mag(cmplx_sub(single_value, value)) < 1e-5 * (1 + cmplx_mag(value)));
+  }
+
+  complex_array_free(&points);
+  complex_array_free(&values);
+  complex_array_single_free(&single_points);
+  complex_array_single_free(&single_values);
+}
@@ -0,0 +1,6 @@
+#include "test.h"
+
+#include "complex_kernels.h"
+#include "poly_inplace.h"
+#include "batch_roots.h"
+#include "extended_precision.h"
@@ -0,0 +1,88 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "complex.h"
+#include "complex_array.h"
+
+#define COMPLEX_ARRAY_TEST_LEN 11
+
+/* random numbers of all sizes, with some on the axes where the kernels take other branches */
+void fill_complex_array (complex_array_t array, unsigned int seed);
+void fill_complex_array (complex_array_t array, unsigned int seed) {
+  srand(seed);
+  for (size_t i = 0; i < COMPLEX_ARRAY_TEST_LEN; i++) {
+    double real = (rand() / (double) RAND_MAX - 0.5) * pow(10, rand() % 7 - 3);
+    double imag = (rand() / (double) RAND_MAX - 0.5) * pow(10, rand() % 7 - 3);
+    if (i % 4 == 1)
+      imag = 0;
+    if (i % 4 == 2)
+      real = -real * 1e-3;
+
+    cmplx_array_set(array, i, { real, imag });
+  }
+}
+
+TEST(complex_array_matches_scalar) {
+  complex_array_t a   = complex_array_new(COMPLEX_ARRAY_TEST_LEN);
+  complex_array_t b   = complex_array_new(COMPLEX_ARRAY_TEST_LEN);
+  complex_array_t c   = complex_array_new(COMPLEX_ARRAY_TEST_LEN);
+  complex_array_t out = complex_array_new(COMPLEX_ARRAY_TEST_LEN);
+  fill_complex_array(a, 1);
+  fill_complex_array(b, 2);
+  fill_complex_array(c, 3);
+
+  for (int kernel = 0; kernel < 6; kernel++) {
+    switch (kernel) {
+      case 0:  cmplx_array_add(out, a, b, COMPLEX_ARRAY_TEST_LEN);     break;
+      case 1:  cmplx_array_sub(out, a, b, COMPLEX_ARRAY_TEST_LEN);     break;
+      case 2:  cmplx_array_mul(out, a, b, COMPLEX_ARRAY_TEST_LEN);     break;
+      case 3:  cmplx_array_div(out, a, b, COMPLEX_ARRAY_TEST_LEN);     break;
+      case 4:  cmplx_array_fma(out, a, b, c, COMPLEX_ARRAY_TEST_LEN);  break;
+      default: cmplx_array_sqrt(out, a, COMPLEX_ARRAY_TEST_LEN);       break;
+    }
+
+    for (size_t i = 0; i < COMPLEX_ARRAY_TEST_LEN; i++) {
+      complex_t x = cmplx_array_get(a, i), y = cmplx_array_get(b, i), z = cmplx_array_get(c, i);
+      complex_t expected = {};
+      switch (kernel) {
+        case 0:  expected = cmplx_add(x, y);     break;
+        case 1:  expected = cmplx_sub(x, y);     break;
+        case 2:  expected = cmplx_mul(x, y);     break;
+        case 3:  expected = cmplx_div(x, y);     break;
+        case 4:  expected = cmplx_fma(x, y, z);  break;
+        default: expected = cmplx_sqrt(x);       break;
+      }
+
+      complex_t got = cmplx_array_get(out, i);
+      ASSERT_BOOL_MSG(!memcmp(&got, &expected, sizeof(complex_t)),
+        "kernel %d, number %zu: (%.17g, %.17g) instead of (%.17g, %.17g)",
+        kernel, i, got.real, got.imag, expected.real, expected.imag);
+    }
+  }
+
+  complex_array_free(&a);
+  complex_array_free(&b);
+  complex_array_free(&c);
+  complex_array_free(&out);
+}
+
+TEST(complex_div_does_not_overflow) {
+  // |b|^2 is past the largest double, which the textbook formula divides by
+  complex_t quotient = cmplx_div({ 1e300, 1e300 }, { 2e300, 2e300 });
+  ASSERT_BOOL(fabs(quotient.real - 0.5) < 1e-15 && fabs(quotient.imag) < 1e-15);
+
+  quotient = cmplx_div({ 1e-300, 0 }, { 0, 1e-300 });
+  ASSERT_BOOL(fabs(quotient.real) < 1e-15 && fabs(quotient.imag + 1) < 1e-15);
+}
+
+TEST(complex_pow_squares) {
+  complex_t x = { 0.5, 1.5 };
+  complex_t expected = { 1 };
+  for (int power = 0; power <= 13; power++) {
+    complex_t got = cmplx_pow(x, power);
+    ASSERT_BOOL(cmplx_eq(got, expected));
+    expected = cmplx_mul(expected, x);
+  }
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "evaluate.h"
+#include "execute.h"
+#include "symbols.h"
+#include "var_tree.h"
+
+TEST(rollback_restores_variables) {
+  const char *lines[] = {
+    "let A = 1", "snapshot", "let A = 2", "let B = 3", "snapshot", "let B = 4",
+    "rollback", "B", "rollback", "A", "B", "rollback",
+  };
+
+  Env env = {};
+  char *output = run_reactive(&env, lines, 12);
+  env_destroy(&env);
+
+  ASSERT_BOOL(!strcmp(output,
+    "-> snapshot #1\n"
+    "-> snapshot #2\n"
+    "-> rolled back to snapshot #2\n"
+    "-> 3\n"
+    "-> rolled back to snapshot #1\n"
+    "-> 1\n"
+    "error: An unknown variable was referenced!\n"
+    "error: There is no snapshot to roll back to!\n"));
+  free(output);
+}
+
+TEST(snapshot_shares_variables) {
+  Env env = {};
+  char name[SYMBOL_MAX_LEN];
+  for (int i = 0; i < 2000; i++) {
+    int len = snprintf(name, sizeof(name), "Shared%d", i);
+    env_set_value(&env, symbol_intern(name, (size_t) len), { TP_NUMBER, { .num = { (double) i } } });
+  }
+
+  VarTree snapshot = env_snapshot(&env);
+  ASSERT_BOOL(snapshot.root == env.vars.root);
+
+  int changed = symbol_intern("Shared7", 7);
+  env_set_value(&env, changed, { TP_NUMBER, { .num = { -1 } } });
+  ASSERT_BOOL(snapshot.root != env.vars.root);
+
+  // the variables near the changed one are copied, the rest stay shared
+  int far = symbol_intern("Shared1999", 10);
+  ASSERT_BOOL(var_tree_get(&snapshot, far) == var_tree_get(&env.vars, far));
+  ASSERT_BOOL(cmplx_eq(unpack_value(&var_tree_get(&snapshot, changed)->val).num, {7}));
+  ASSERT_BOOL(cmplx_eq(unpack_value(&var_tree_get(&env.vars, changed)->val).num, {-1}));
+
+  env_restore(&env, &snapshot);
+  var_tree_release(&snapshot);
+
+  Value value = {};
+  ASSERT_EQ(env_get_value(&env, changed, &value), EVAL_OK);
+  ASSERT_BOOL(cmplx_eq(value.num, {7}));
+
+  env_destroy(&env);
+}
+
+TEST(forks_are_independent) {
+  const char *lines[] = { "let A = 1", "let B = A * 10" };
+
+  Env env = {};
+  env.reactive = REACTIVE_LAZY;
+  free(run_reactive(&env, lines, 2));
+
+  Env fork = {};
+  env_fork(&env, &fork);
+
+  const char *change[] = { "let A = 2", "B" };
+  char *forked = run_reactive(&fork, change, 2);
+  char *source = run_reactive(&env, change + 1, 1);
+
+  ASSERT_BOOL(!strcmp(forked, "-> 20\n"));
+  ASSERT_BOOL(!strcmp(source, "-> 10\n"));
+  free(forked);
+  free(source);
+
+  env_destroy(&fork);
+  env_destroy(&env);
+}
@@ -0,0 +1,7 @@
+#include "test.h"
+
+#include "reactive_env.h"
+#include "symbol_table.h"
+#include "env_snapshot.h"
+#include "session_file.h"
+#include "packed_value.h"
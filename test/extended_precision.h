@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "arith.h"
+#include "batch_solve.h"
+#include "double_double.h"
+#include "polynomial.h"
+
+TEST(double_double_keeps_the_digits) {
+  dd_t two   = dd_from(2);
+  dd_t root  = dd_sqrt(two);
+  dd_t third = dd_from(1) / dd_from(3);
+
+  // each of these is off by about 1e-16 in double
+  ASSERT_BOOL(fabs(dd_to_double(root * root - two)) < 1e-30);
+  ASSERT_BOOL(fabs(dd_to_double(third * 3 - 1)) < 1e-30);
+  ASSERT_BOOL(fabs(dd_to_double(dd_cbrt(two) * dd_cbrt(two) * dd_cbrt(two) - two)) < 1e-30);
+  ASSERT_BOOL(fabs(dd_to_double(dd_cbrt(-two) + dd_cbrt(two))) < 1e-30);
+
+  // 1 + 2^-80 isn't a double, but its parts add up to it
+  dd_t sum = dd_from(1) + ldexp(1, -80);
+  ASSERT_BOOL(sum - 1 > 0);
+  ASSERT_BOOL(dd_less(dd_from(1), sum));
+}
+
+TEST(double_double_tells_close_roots_apart) {
+  // roots 1 +- 1e-7, which are closer together than EPSILON
+  Polynomial p = { 'x', {.e = {1 - 1e-14}, .d = {-2}, .c = {1}} };
+  Solutions  sols = {};
+
+  ASSERT_BOOL(solve_polynomial_dd(p, &sols));
+  ASSERT_EQ(sols.count, 2);
+
+  double gap = sqrt(1 - p.e.real);
+  ASSERT_BOOL(fabs(sols.x1.real - (1 - gap)) < 1e-15);
+  ASSERT_BOOL(fabs(sols.x2.real - (1 + gap)) < 1e-15);
+
+  // doubles merge them, and escalate_roots finds both again
+  ASSERT_BOOL(solve_polynomial(p, &sols));
+  ASSERT_EQ(sols.count, 2);
+  ASSERT_BOOL(fabs(fmin(sols.x1.real, sols.x2.real) - (1 - gap)) < 1e-15);
+  ASSERT_BOOL(fabs(fmax(sols.x1.real, sols.x2.real) - (1 + gap)) < 1e-15);
+}
+
+TEST(double_double_splits_a_near_triple_root) {
+  // (x - 1)^3 + 2^-50: the cancellation in q is more than double can take,
+  // and the roots 1e-5 away from one look like a triple root to it
+  Polynomial p = { 'x', {.e = {-1 + ldexp(1, -50)}, .d = {3}, .c = {-3}, .b = {1}} };
+  Solutions  sols = {};
+
+  ASSERT_BOOL(solve_polynomial(p, &sols));
+  ASSERT_EQ(sols.count, 3);
+
+  ASSERT_BOOL(solve_polynomial_dd(p, &sols));
+  ASSERT_EQ(sols.count, 3);
+
+  double offset = cbrt(ldexp(1, -50));
+  ASSERT_BOOL(fabs(sols.x1.real - (1 + offset / 2)) < 1e-15);
+  ASSERT_BOOL(fabs(fabs(sols.x1.imag) - offset * sqrt(3.0) / 2) < 1e-15);
+  ASSERT_BOOL(fabs(sols.x3.real - (1 - offset)) < 1e-15);
+  ASSERT_BOOL(fabs(sols.x3.imag) < 1e-15);
+}
+
+TEST(double_double_batch_bounds_are_tight) {
+  // (x - 1)^2 (x + 2) with the double root 1e-7 apart
+  Polynomial p = { 'x', {.e = {2 - 2e-14}, .d = {-3 - 1e-14}, .c = {0}, .b = {1}} };
+  Solutions  sols = {};
+  RootErrors twice = {}, extended = {};
+
+  batch_solve(&p, 1, PRECISION_DOUBLE, &sols, &twice);
+  batch_solve(&p, 1, PRECISION_DOUBLE_DOUBLE, &sols, &extended);
+
+  ASSERT_EQ(sols.count, 3);
+  for (int k = 0; k < 3; k++) {
+    ASSERT_BOOL(extended.radius[k] < 1e-12);
+    ASSERT_BOOL(extended.radius[k] < twice.radius[k]);
+  }
+}
+
+TEST(double_double_batch_agrees_with_double) {
+  // the reference solver of batch_solve_bounds_hold only gets multiple roots
+  // to about 1e-8, which these bounds are far below, so every root is checked
+  // against one in double instead, whose bound has to overlap with its own
+  Solutions  twice[BATCH_TEST_COUNT] = {}, extended[BATCH_TEST_COUNT] = {};
+  RootErrors twice_errors[BATCH_TEST_COUNT] = {}, extended_errors[BATCH_TEST_COUNT] = {};
+
+  batch_solve(BATCH_TEST_POLYS, BATCH_TEST_COUNT, PRECISION_DOUBLE, twice, twice_errors);
+  batch_solve(BATCH_TEST_POLYS, BATCH_TEST_COUNT, PRECISION_DOUBLE_DOUBLE, extended, extended_errors);
+
+  for (size_t i = 0; i < BATCH_TEST_COUNT; i++) {
+    ASSERT_EQ(extended[i].count, twice[i].count);
+
+    for (int k = 0; k < extended[i].count; k++) {
+      bool overlaps = false;
+      for (int j = 0; j < twice[i].count; j++) {
+        double gap = cmplx_mag(cmplx_sub(extended[i].x[k], twice[i].x[j]));
+        overlaps = overlaps || gap <= extended_errors[i].radius[k] + twice_errors[i].radius[j];
+      }
+
+      ASSERT_BOOL_MSG(overlaps, "polynomial #%zu", i);
+      ASSERT_BOOL(extended_errors[i].radius[k] <= twice_errors[i].radius[k]);
+    }
+  }
+}
+
+TEST(escalation_leaves_good_roots_alone) {
+  // simple roots pass, and so does a multiple root that is exactly one
+  Polynomial simple = { 'x', {.e = {2}, .d = {-3}, .c = {1}} };
+  Polynomial triple = { 'x', {.e = {-1}, .d = {3}, .c = {-3}, .b = {1}} };
+  Solutions  sols = {};
+
+  ASSERT_BOOL(solve_polynomial(simple, &sols));
+  ASSERT_EQ(escalate_roots(&simple, 2, &sols), 0);
+  ASSERT_EQ(sols.count, 2);
+
+  ASSERT_BOOL(solve_polynomial(triple, &sols));
+  ASSERT_EQ(escalate_roots(&triple, 3, &sols), 0);
+  ASSERT_EQ(sols.count, 1);
+  ASSERT_BOOL(fabs(sols.x1.real - 1) < 1e-15);
+}
+
+/* what fprint_solutions_with_errors prints for the roots of p */
+bool prints_roots (Polynomial p, const double *errors, const char *expected);
+
+bool prints_roots (Polynomial p, const double *errors, const char *expected) {
+  Solutions sols = {};
+  if (!solve_polynomial(p, &sols))
+    return false;
+
+  char  *text = NULL;
+  size_t len  = 0;
+  FILE  *out  = open_memstream(&text, &len);
+  fprint_solutions_with_errors(out, sols, errors);
+  fclose(out);
+
+  bool same = !strcmp(text, expected);
+  free(text);
+  return same;
+}
+
+TEST(escalated_roots_print_once) {
+  // escalate_roots finds these apart, but they are one root at %lg
+  Polynomial close  = { 'x', {.e = {0.99999999999999}, .d = {-2}, .c = {1}} };
+  Polynomial tiny   = { 'x', {.e = {-1e-18}, .c = {1}} };
+  Polynomial tinier = { 'x', {.e = {-1e-30}, .c = {1}} };
+  double     errors[] = { 1e-7, 2e-7 };
+
+  ASSERT_BOOL(prints_roots(close,  NULL,   "1 solutions!\n  - 1\n"));
+  ASSERT_BOOL(prints_roots(close,  errors, "1 solutions!\n  - 1 +- 2e-07\n"));
+  ASSERT_BOOL(prints_roots(tiny,   NULL,   "1 solutions!\n  - 0\n"));
+  ASSERT_BOOL(prints_roots(tinier, NULL,   "1 solutions!\n  - 0\n"));
+
+  // roots that print apart stay apart
+  Polynomial apart = { 'x', {.e = {2}, .d = {-3}, .c = {1}} };
+  ASSERT_BOOL(prints_roots(apart, NULL, "2 solutions!\n  - 1\n  - 2\n"));
+}
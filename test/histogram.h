@@ -0,0 +1,46 @@
+#include <stdlib.h>
+
+#include "test.h"
+#include "stats.h"
+
+TEST(histogram_small_values_are_exact) {
+  Histogram *hist = (Histogram *) calloc(1, sizeof(Histogram));
+  for (uint64_t i = 1; i <= 10; i++)
+    histogram_record(hist, i);
+
+  uint64_t p50 = histogram_percentile(hist, 50);
+  uint64_t p100 = histogram_percentile(hist, 100);
+  free(hist);
+
+  ASSERT_EQ(p50, 5u);
+  ASSERT_EQ(p100, 10u);
+}
+
+TEST(histogram_relative_error) {
+  Histogram *hist = (Histogram *) calloc(1, sizeof(Histogram));
+  for (uint64_t i = 0; i < 1000; i++)
+    histogram_record(hist, 1000000 + i * 1000);
+
+  // the true p90 is 1899000, buckets are 1/16 of a power of two wide
+  double p90 = (double) histogram_percentile(hist, 90);
+  free(hist);
+
+  ASSERT_BOOL(p90 > 1899000 * (1 - 1.0 / 16) && p90 < 1899000 * (1 + 1.0 / 16));
+}
+
+TEST(histogram_extreme_values) {
+  Histogram *hist = (Histogram *) calloc(1, sizeof(Histogram));
+  histogram_record(hist, 0);
+  histogram_record(hist, UINT64_C(1) << 63);
+  histogram_record(hist, UINT64_MAX);
+
+  // the buckets of 2^63 and up have bounds that add up to more than 64 bits
+  uint64_t p1   = histogram_percentile(hist, 1);
+  uint64_t p67  = histogram_percentile(hist, 67);
+  uint64_t p100 = histogram_percentile(hist, 100);
+  free(hist);
+
+  ASSERT_EQ(p1, 0u);
+  ASSERT_BOOL(p67 >= UINT64_C(1) << 63 && p67 - (UINT64_C(1) << 63) <= UINT64_C(1) << 59);
+  ASSERT_BOOL(p100 >= UINT64_MAX - (UINT64_MAX >> 4));
+}
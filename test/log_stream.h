@@ -0,0 +1,53 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "log.h"
+
+#define LOG_TEST_THREADS 4
+#define LOG_TEST_LINES   200
+
+void *log_test_worker (void *unused);
+
+void *log_test_worker (void *unused) {
+  (void) unused;
+  for (int i = 0; i < LOG_TEST_LINES; i++)
+    LOG_INFO("line %d of a worker", i);
+  return NULL;
+}
+
+TEST(log_lines_stay_whole) {
+  FILE *stream = tmpfile();
+  ASSERT_BOOL(stream);
+
+  FL_LogFormat format = _fl_log_format;
+  fl_set_log_format(FL_TXT);
+  fl_set_log_stream(stream);
+  fl_logs_on();
+
+  pthread_t threads[LOG_TEST_THREADS] = {};
+  for (int i = 0; i < LOG_TEST_THREADS; i++)
+    pthread_create(&threads[i], NULL, log_test_worker, NULL);
+  for (int i = 0; i < LOG_TEST_THREADS; i++)
+    pthread_join(threads[i], NULL);
+
+  fl_logs_off();
+  fl_set_log_stream(NULL);
+  fl_set_log_format(format);
+
+  // every line is one log, none of them got into another
+  rewind(stream);
+  char line[256] = {};
+  int  lines     = 0;
+  bool whole     = true;
+  while (fgets(line, sizeof(line), stream)) {
+    int end = 0;
+    sscanf(line, "[info][log_test_worker:%*d] line %*d of a worker%n", &end);
+    whole = whole && end && line[end] == '\n' && !line[end + 1];
+    lines++;
+  }
+  fclose(stream);
+
+  ASSERT_BOOL(whole);
+  ASSERT_EQ(lines, LOG_TEST_THREADS * LOG_TEST_LINES);
+}
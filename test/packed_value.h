@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "test.h"
+#include "alloc.h"
+#include "evaluate.h"
+
+TEST(packed_value_round_trips) {
+  Value poly = { TP_POLYNOMIAL, {} };
+  poly.poly.var       = 'x';
+  poly.poly.coeffs[0] = { 1, -2 };
+  poly.poly.coeffs[2] = { 0.5 };
+
+  Value linear = { TP_POLYNOMIAL, {} };
+  linear.poly.var       = 'y';
+  linear.poly.coeffs[0] = { -0.0 };
+  linear.poly.coeffs[1] = { 2 };
+
+  Value values[] = {
+    { TP_NUMBER, { .num = { 3.25 } } },
+    { TP_NUMBER, { .num = { 3.25, -0.0 } } },
+    { TP_NUMBER, { .num = { -1, 4 } } },
+    poly,
+    linear,
+    { TP_POLYNOMIAL, {} },
+  };
+  PackedType types[] = {
+    PACKED_REAL, PACKED_COMPLEX, PACKED_COMPLEX, PACKED_POLY, PACKED_LINEAR, PACKED_LINEAR
+  };
+
+  for (size_t i = 0; i < sizeof(values) / sizeof(*values); i++) {
+    PackedValue packed = pack_value(values[i]);
+    Value unpacked = unpack_value(&packed);
+    ASSERT_EQ(packed.type, types[i]);
+    ASSERT_EQ(unpacked.type, values[i].type);
+    if (unpacked.type == TP_NUMBER)
+      ASSERT_BOOL(!memcmp(&unpacked.num, &values[i].num, sizeof(complex_t)))
+    else
+      ASSERT_BOOL(unpacked.poly.var == values[i].poly.var &&
+                  !memcmp(unpacked.poly.coeffs, values[i].poly.coeffs, sizeof(unpacked.poly.coeffs)));
+    destroy_packed_value(&packed);
+  }
+}
+
+TEST(packed_value_sized_to_degree) {
+  Value value = { TP_POLYNOMIAL, {} };
+  value.poly.var       = 'x';
+  value.poly.coeffs[1] = { 2, 1 };
+
+  PackedValue packed = pack_value(value);
+  ASSERT_EQ(packed.poly->degree, 1);
+
+  PackedValue copy = copy_packed_value(&packed);
+  ASSERT_NE(copy.poly, packed.poly);
+  ASSERT_BOOL(!memcmp(copy.poly->coeffs, packed.poly->coeffs, 2 * sizeof(complex_t)));
+  destroy_packed_value(&packed);
+  destroy_packed_value(&copy);
+
+  ASSERT_MAX_ALLOCS(0,
+    PackedValue number = pack_value({ TP_NUMBER, { .num = { 1, 1 } } });
+    destroy_packed_value(&number)
+  );
+
+  // a real one of that degree doesn't need the coefficients out of line
+  value.poly.coeffs[1] = { 2 };
+  ASSERT_MAX_ALLOCS(0,
+    PackedValue linear = pack_value(value);
+    destroy_packed_value(&linear)
+  );
+}
@@ -0,0 +1,61 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include "test.h"
+#include "perf.h"
+
+/* make perf_event_open fail with ENOSYS in the calling thread, like on a kernel without it */
+bool block_perf_event_open (void);
+void *perf_without_syscall (void *degraded);
+
+bool block_perf_event_open (void) {
+  struct sock_filter filter[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_perf_event_open, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+  };
+  struct sock_fprog program = { (unsigned short) (sizeof(filter) / sizeof(filter[0])), filter };
+
+  // without a thread sync flag, the filter only applies to this thread
+  return !prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) &&
+         !prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program, 0, 0);
+}
+
+void *perf_without_syscall (void *degraded) {
+  if (!block_perf_event_open())
+    return NULL;
+
+  bool enabled = perf_enable();
+
+  // a sample that isn't cleared would show up as garbage counts
+  PerfSample sample = {};
+  memset(&sample, 0xff, sizeof(sample));
+  perf_read(&sample);
+
+  bool zeros = true, missing = true;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    zeros   = zeros   && !sample.values[i];
+    missing = missing && !perf_has_counter((PerfCounter) i);
+  }
+
+  perf_disable();
+  *(bool *) degraded = !enabled && !perf_enabled() && zeros && missing;
+  return NULL;
+}
+
+TEST(perf_degrades_without_perf_event_open) {
+  pthread_t thread   = {};
+  bool      degraded = false;
+
+  pthread_create(&thread, NULL, perf_without_syscall, &degraded);
+  pthread_join(thread, NULL);
+
+  ASSERT_BOOL(degraded);
+}
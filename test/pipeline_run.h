@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "execute.h"
+#include "pipeline.h"
+
+const char *PIPELINE_TEST_INPUT =
+  "let A = 2\n"
+  "\n"
+  "solve x^2 - A\n"
+  "A * 3\n"
+  "!!bad\n"
+  "solve 3\n"
+  "1 / 0\n"
+  "let B = A + 1\n"
+  "solve (x - B) * (x + 1)\n"
+  "B";
+
+/* the output of a pipeline run must be what executing the lines one by one prints */
+bool pipeline_matches_sequential (unsigned int batch_size, AsyncIoBackend backend, unsigned int precision);
+
+bool pipeline_matches_sequential (unsigned int batch_size, AsyncIoBackend backend, unsigned int precision) {
+  char  *expected     = NULL;
+  size_t expected_len = 0;
+  FILE  *memory       = open_memstream(&expected, &expected_len);
+
+  Env   env    = {};
+  env.precision = precision;
+  char *input  = strdup(PIPELINE_TEST_INPUT);
+  char *saved  = NULL;
+  for (char *line = strtok_r(input, "\n", &saved); line; line = strtok_r(NULL, "\n", &saved))
+    execute_command(&env, line, memory);
+  fclose(memory);
+  free(input);
+  env_destroy(&env);
+
+  FILE *in  = tmpfile();
+  FILE *out = tmpfile();
+  fputs(PIPELINE_TEST_INPUT, in);
+  fflush(in);
+  lseek(fileno(in), 0, SEEK_SET);
+
+  PipelineConfig config = {
+    .in_fd      = fileno(in),
+    .out_fd     = fileno(out),
+    .batch_size = batch_size,
+    .backend    = backend,
+    .precision  = precision,
+  };
+  PipelineReport report = {};
+  bool written = run_pipeline(config, &report);
+
+  char   *actual     = (char *) calloc(expected_len + 2, 1);
+  ssize_t actual_len = pread(fileno(out), actual, expected_len + 1, 0);
+
+  bool equal = written && actual_len == (ssize_t) expected_len && !memcmp(actual, expected, expected_len) &&
+               report.stages[STAGE_WRITE].records == 9;
+
+  free(actual);
+  free(expected);
+  fclose(in);
+  fclose(out);
+  return equal;
+}
+
+TEST(pipeline_matches_sequential) {
+  ASSERT_BOOL(pipeline_matches_sequential(64, ASYNC_IO_URING, 0));
+}
+
+TEST(pipeline_small_batches) {
+  ASSERT_BOOL(pipeline_matches_sequential(1, ASYNC_IO_URING, 0));
+  ASSERT_BOOL(pipeline_matches_sequential(3, ASYNC_IO_THREAD, 0));
+}
+
+TEST(pipeline_batch_solves) {
+  // solving a batch at once finds the same roots as solving them one by one
+  ASSERT_BOOL(pipeline_matches_sequential(64, ASYNC_IO_URING, PRECISION_SINGLE));
+  ASSERT_BOOL(pipeline_matches_sequential(2, ASYNC_IO_THREAD, PRECISION_DOUBLE));
+}
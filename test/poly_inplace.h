@@ -0,0 +1,53 @@
+#include <string.h>
+
+#include "test.h"
+#include "alloc.h"
+#include "parser.h"
+#include "evaluate.h"
+#include "polynomial.h"
+
+TEST(poly_inplace_matches_copies) {
+  Polynomial a = { 'x', {.e = { 1, 2 }, .d = { -3 }} };
+  Polynomial b = { 'x', {.e = { 4 }, .d = { 0, 1 }, .c = { 2 }} };
+  Polynomial expected = {}, acc = {};
+
+  polynomial_add(a, b, &expected);
+  acc = a;
+  ASSERT_EQ(polynomial_add_inplace(&acc, &b), POLY_OK);
+  ASSERT_BOOL(!memcmp(acc.coeffs, expected.coeffs, sizeof(acc.coeffs)));
+
+  polynomial_mul(a, a, &expected);
+  acc = a;
+  ASSERT_EQ(polynomial_mul_inplace(&acc, &acc), POLY_OK);
+  ASSERT_BOOL(!memcmp(acc.coeffs, expected.coeffs, sizeof(acc.coeffs)));
+
+  // a + 3 * b in one pass is a + (3 * b)
+  Polynomial scaled = b;
+  polynomial_scale_inplace(&scaled, { 3 });
+  polynomial_add(a, scaled, &expected);
+  acc = a;
+  ASSERT_EQ(polynomial_fma_inplace(&acc, &b, { 3 }), POLY_OK);
+  ASSERT_BOOL(!memcmp(acc.coeffs, expected.coeffs, sizeof(acc.coeffs)));
+
+  // errors leave it as it was
+  Polynomial big = { 'x', {.a = { 1 }} };
+  Polynomial other = { 'y', {.e = { 1 }} };
+  acc = a;
+  ASSERT_EQ(polynomial_mul_inplace(&acc, &big), POLY_TOO_LARGE);
+  ASSERT_EQ(polynomial_add_inplace(&acc, &other), POLY_DIFFERENT_VAR);
+  ASSERT_BOOL(!memcmp(acc.coeffs, a.coeffs, sizeof(acc.coeffs)));
+}
+
+TEST(eval_fuses_scaled_add) {
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
+  parse_expr("(x + 1)^2 + 3 * (x - 2) + (x * 2i) * 0.5 - x * x", expr);
+
+  Env env = {};
+  Value val = {};
+  ASSERT_EQ(eval_expr(&env, expr, &val), EVAL_OK);
+  destroy_expr(expr);
+
+  Polynomial expected = { 'x', {.e = { -5 }, .d = { 5, 1 }} };
+  ASSERT_EQ(val.type, TP_POLYNOMIAL);
+  ASSERT_BOOL(!memcmp(val.poly.coeffs, expected.coeffs, sizeof(expected.coeffs)));
+}
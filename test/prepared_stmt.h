@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "alloc.h"
+#include "execute.h"
+#include "parser.h"
+#include "evaluate.h"
+
+/* run lines in a fresh env and compare what they print */
+bool prepared_output_equals (const char *const *lines, size_t count, const char *expected);
+
+bool prepared_output_equals (const char *const *lines, size_t count, const char *expected) {
+  char  *output     = NULL;
+  size_t output_len = 0;
+  FILE  *out        = open_memstream(&output, &output_len);
+
+  Env env = {};
+  for (size_t i = 0; i < count; i++)
+    execute_command(&env, lines[i], out);
+
+  fclose(out);
+  env_destroy(&env);
+
+  bool equal = !strcmp(output, expected);
+  free(output);
+  return equal;
+}
+
+TEST(exec_matches_solve) {
+  const char *prepared[] = { "prepare Q = solve ?1*x^2 + ?2*x + ?3", "exec Q 1 -3 2" };
+  const char *direct[]   = { "solve 1*x^2 + -3*x + 2" };
+
+  char  *expected     = NULL;
+  size_t expected_len = 0;
+  FILE  *out          = open_memstream(&expected, &expected_len);
+  execute_command(NULL, direct[0], out);
+  fclose(out);
+
+  bool equal = prepared_output_equals(prepared, 2, expected);
+  free(expected);
+  ASSERT_BOOL(equal);
+}
+
+TEST(exec_checks_values) {
+  const char *lines[] = { "prepare E = ?1 + ?2", "exec E 1", "exec F 1 2", "exec E 1 2i" };
+  ASSERT_BOOL(prepared_output_equals(lines, 4,
+    "error: The number of values doesn't match the parameters of the prepared statement!\n"
+    "error: No statement was prepared with this name!\n"
+    "-> (1 + 2i)\n"));
+}
+
+TEST(parameters_only_in_prepare) {
+  Statement *stmt = (Statement *) counted_calloc(1, sizeof(Statement));
+  ASSERT_EQ(parse_stmt("solve ?1*x + 1", stmt), 0);
+  ASSERT_EQ(parse_stmt("prepare P = prepare Q = ?1", stmt), 0);
+  counted_free(stmt);
+}
+
+TEST(exec_skips_the_parser) {
+  Statement *stmt = (Statement *) counted_calloc(1, sizeof(Statement));
+
+  // the statement and its values, nothing for the expression parser
+  ASSERT_MAX_ALLOCS(1, parse_stmt("exec Q 1 -3 2", stmt));
+  ASSERT_EQ(stmt->arg_count, 3);
+
+  destory_stmt(stmt);
+}
+
+TEST(fold_constants_folds_polynomials) {
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
+  parse_expr("?1 * (x + 1)^2 - 2 * 3", expr);
+  fold_constants(expr);
+
+  // (?1 * <x^2 + 2x + 1>) + -(6)
+  ASSERT_EQ(expr->type, OPERATOR);
+  ASSERT_EQ(expr->left->right->type, CONSTANT_POLY);
+  ASSERT_EQ(expr->right->type, NUMBER);
+
+  destroy_expr(expr);
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "evaluate.h"
+#include "execute.h"
+#include "symbols.h"
+
+/* run lines in an env and get what they print */
+char *run_reactive (Env *env, const char *const *lines, size_t count);
+
+char *run_reactive (Env *env, const char *const *lines, size_t count) {
+  char  *output     = NULL;
+  size_t output_len = 0;
+  FILE  *out        = open_memstream(&output, &output_len);
+
+  for (size_t i = 0; i < count; i++)
+    execute_command(env, lines[i], out);
+
+  fclose(out);
+  return output;
+}
+
+const char *REACTIVE_CHAIN[] = { "let A = 1", "let B = A + 1", "let C = B * 2", "let D = 5", "let A = 2" };
+
+TEST(reactive_eager_recomputes_downstream) {
+  Env env = {};
+  env.reactive = REACTIVE_EAGER;
+  free(run_reactive(&env, REACTIVE_CHAIN, 5));
+
+  // B and C, but not D
+  ASSERT_EQ(env.recomputed, 2);
+
+  Value value = {};
+  ASSERT_EQ(env_get_value(&env, symbol_intern("C", 1), &value), EVAL_OK);
+  ASSERT_BOOL(cmplx_eq(value.num, {6}));
+  ASSERT_EQ(env.recomputed, 2);
+
+  env_destroy(&env);
+}
+
+TEST(reactive_lazy_recomputes_on_read) {
+  Env env = {};
+  env.reactive = REACTIVE_LAZY;
+  free(run_reactive(&env, REACTIVE_CHAIN, 5));
+  ASSERT_EQ(env.recomputed, 0);
+
+  Value value = {};
+  ASSERT_EQ(env_get_value(&env, symbol_intern("B", 1), &value), EVAL_OK);
+  ASSERT_BOOL(cmplx_eq(value.num, {3}));
+  ASSERT_EQ(env.recomputed, 1);
+
+  ASSERT_EQ(env_get_value(&env, symbol_intern("C", 1), &value), EVAL_OK);
+  ASSERT_BOOL(cmplx_eq(value.num, {6}));
+  ASSERT_EQ(env.recomputed, 2);
+
+  env_destroy(&env);
+}
+
+TEST(reactive_watchers_run_on_change) {
+  const char *lines[] = { "let A = 1", "watch x - A", "let B = 3", "let A = 2" };
+
+  Env env = {};
+  env.reactive = REACTIVE_LAZY;
+  char *output = run_reactive(&env, lines, 4);
+
+  ASSERT_BOOL(!strcmp(output,
+    "-> watch #1\n-> x + -1\n-> 1 solutions!\n  - 1\n"
+    "-> watch #1\n-> x + -2\n-> 1 solutions!\n  - 2\n"));
+
+  free(output);
+  env_destroy(&env);
+}
+
+TEST(reactive_cycles_keep_values) {
+  // A would depend on itself through B, so it becomes a plain value
+  const char *lines[] = { "let A = 1", "let B = A", "let A = B + 1", "let A = 5" };
+
+  Env env = {};
+  env.reactive = REACTIVE_EAGER;
+  free(run_reactive(&env, lines, 3));
+  ASSERT_BOOL(!var_tree_get(&env.vars, symbol_intern("A", 1))->expr);
+  ASSERT_BOOL(var_tree_get(&env.vars, symbol_intern("B", 1))->expr);
+
+  free(run_reactive(&env, lines + 3, 1));
+
+  Value value = {};
+  ASSERT_EQ(env_get_value(&env, symbol_intern("B", 1), &value), EVAL_OK);
+  ASSERT_BOOL(cmplx_eq(value.num, {5}));
+
+  env_destroy(&env);
+}
@@ -0,0 +1,46 @@
+#include <math.h>
+
+#include "test.h"
+#include "arith.h"
+#include "complex.h"
+#include "polynomial.h"
+
+#define REAL_SOLVER_TEST(name, _coeffs, _count, ...)                   \
+  TEST(name) {                                                         \
+    Polynomial p = { 'x', { .coeffs = _coeffs } };                     \
+    complex_t expected[] = __VA_ARGS__;                                \
+    Solutions sols = {};                                               \
+                                                                       \
+    ASSERT_BOOL(polynomial_is_real(&p));                               \
+    ASSERT_BOOL(solve_polynomial(p, &sols));                           \
+    ASSERT_EQ(sols.count, _count);                                     \
+    for (int i = 0; i < _count; i++)                                   \
+      ASSERT_BOOL(cmplx_eq(sols.x[i], expected[i]));                   \
+  }
+
+// roots come in the order that the complex solvers give them
+REAL_SOLVER_TEST(real_solver_two_roots,   P({{2}, {-3}, {1}}),          2, {{1}, {2}})
+REAL_SOLVER_TEST(real_solver_pair,        P({{5}, {2}, {1}}),           2, {{-1, -2}, {-1, 2}})
+REAL_SOLVER_TEST(real_solver_negative_a,  P({{-6}, {1}, {-1}}),         2, {{0.5, 2.3979157616563596}, {0.5, -2.3979157616563596}})
+REAL_SOLVER_TEST(real_solver_cube_roots,  P({{8}, {0}, {0}, {1}}),      3, {{1, -sqrt(3.0)}, {1, sqrt(3.0)}, {-2}})
+REAL_SOLVER_TEST(real_solver_double_root, P({{2}, {-3}, {0}, {1}}),     2, {{-2}, {1}})
+
+TEST(real_solver_does_not_cancel) {
+  // the textbook formula gets the small root from -1e8 + (1e8 - 2e-4), and
+  // keeps only about four digits of it
+  Polynomial p = { 'x', {.e = {1e4}, .d = {1e8}, .c = {1}} };
+  Solutions sols = {};
+
+  ASSERT_BOOL(solve_polynomial(p, &sols));
+  ASSERT_EQ(sols.count, 2);
+  ASSERT_BOOL(fabs(sols.x1.real + 1e8) < 1e-3);
+  ASSERT_BOOL(fabs(sols.x2.real + 1e-4) < 1e-15);
+}
+
+TEST(polynomial_is_real_sees_imaginary_parts) {
+  Polynomial p = { 'x', {.e = {1, -0.0}, .d = {2}} };
+  ASSERT_BOOL(polynomial_is_real(&p));
+
+  p.b = { 0, 1e-300 };
+  ASSERT_BOOL(!polynomial_is_real(&p));
+}
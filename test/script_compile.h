@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "batch_solve.h"
+#include "execute.h"
+#include "script.h"
+
+const char *SCRIPT_TEST_INPUT =
+  "let A = 2\n"
+  "solve x^2 - A\n"
+  "prepare P = let B = A * ?1\n"
+  "\n"
+  "exec P 3\n"
+  "B + 1\n"
+  "C\n"
+  "solve (x - B) * (x + 1)";
+
+/* a compiled script must print what executing its lines one by one prints */
+bool script_matches_shell (const char *source, unsigned int threads, unsigned int precision);
+
+bool script_matches_shell (const char *source, unsigned int threads, unsigned int precision) {
+  char  *expected     = NULL;
+  size_t expected_len = 0;
+  FILE  *memory       = open_memstream(&expected, &expected_len);
+
+  Env   env    = {};
+  env.precision = precision;
+  char *input  = strdup(source);
+  char *saved  = NULL;
+  for (char *line = strtok_r(input, "\n", &saved); line; line = strtok_r(NULL, "\n", &saved))
+    execute_command(&env, line, memory);
+  fclose(memory);
+  free(input);
+  env_destroy(&env);
+
+  char  *actual     = NULL;
+  size_t actual_len = 0;
+  memory = open_memstream(&actual, &actual_len);
+
+  Script script = {};
+  size_t errors = compile_script(source, &script, memory);
+  run_script(&script, threads, precision, memory);
+  destroy_script(&script);
+  fclose(memory);
+
+  bool equal = !errors && !strcmp(actual, expected);
+  free(actual);
+  free(expected);
+  return equal;
+}
+
+TEST(script_matches_shell) {
+  ASSERT_BOOL(script_matches_shell(SCRIPT_TEST_INPUT, 1, 0));
+  ASSERT_BOOL(script_matches_shell(SCRIPT_TEST_INPUT, 4, 0));
+}
+
+TEST(script_parallel_matches_shell) {
+  const char *source =
+    "let A = 1\n"
+    "let B = 2\n"
+    "solve (x - A) * (x - B)\n"
+    "let A = B + 1\n"
+    "A + B\n"
+    "let C = A * A\n"
+    "let A = C / 0\n"
+    "solve x^2 - C\n"
+    "prepare P = let B = ?1\n"
+    "exec P 10\n"
+    "B * C\n"
+    "let C = B - A\n"
+    "solve x - C\n"
+    "D\n"
+    "let B = x\n"
+    "solve B^2 - 4";
+
+  for (unsigned int threads = 1; threads <= 8; threads *= 2)
+    for (int repeat = 0; repeat < 10; repeat++)
+      ASSERT_BOOL(script_matches_shell(source, threads, 0));
+}
+
+TEST(script_links_dependencies) {
+  Script script = {};
+  ASSERT_EQ(compile_script("let A = 1\nlet B = 2\nA + B\nlet A = 3\nstats\nA", &script, stderr), 0);
+
+  // the sum waits for both lets, and the second let of A waits for the sum to read the first
+  ASSERT_EQ(script.stmts[0].dependency_count, 0);
+  ASSERT_EQ(script.stmts[1].dependency_count, 0);
+  ASSERT_EQ(script.stmts[2].dependency_count, 2);
+  ASSERT_EQ(script.stmts[3].dependency_count, 2);
+  ASSERT_EQ(script.stmts[2].dependent_count, 1);
+  ASSERT_EQ(script.stmts[2].dependents[0], 3);
+
+  // nothing crosses the barrier
+  ASSERT_BOOL(script.stmts[4].barrier);
+  ASSERT_EQ(script.stmts[3].dependent_count, 0);
+  ASSERT_EQ(script.stmts[5].dependency_count, 0);
+
+  destroy_script(&script);
+}
+
+TEST(script_resolves_slots) {
+  Script script = {};
+  ASSERT_EQ(compile_script(SCRIPT_TEST_INPUT, &script, stderr), 0);
+
+  // A and B get slots, C is never assigned and stays an identifier
+  ASSERT_EQ(script.slot_count, 2);
+  ASSERT_EQ(script.stmt_count, 7);
+  ASSERT_EQ(script.stmts[0].stmt->slot, 1);
+  ASSERT_EQ(script.stmts[3].line, 5);
+  ASSERT_EQ(script.stmts[4].stmt->expr->left->type, SLOT);
+  ASSERT_EQ(script.stmts[5].stmt->expr->type, IDENTIFIER);
+
+  destroy_script(&script);
+}
+
+TEST(script_reports_every_parse_error) {
+  char  *output     = NULL;
+  size_t output_len = 0;
+  FILE  *memory     = open_memstream(&output, &output_len);
+
+  Script script = {};
+  size_t errors = compile_script("let A = 1\n!!bad\nsolve x - A\n\n(1 +\n", &script, memory);
+  fclose(memory);
+
+  ASSERT_EQ(errors, 2);
+  ASSERT_EQ(script.stmt_count, 0);
+  ASSERT_BOOL(!strcmp(output,
+    "error: line 2: Could not parse command!\n"
+    "error: line 5: Could not parse command!\n"));
+
+  free(output);
+  destroy_script(&script);
+}
+
+TEST(script_keeps_precision) {
+  ASSERT_BOOL(script_matches_shell(SCRIPT_TEST_INPUT, 1, PRECISION_SINGLE));
+  ASSERT_BOOL(script_matches_shell(SCRIPT_TEST_INPUT, 4, PRECISION_SINGLE));
+
+  char  *output     = NULL;
+  size_t output_len = 0;
+  FILE  *memory     = open_memstream(&output, &output_len);
+
+  Script script = {};
+  size_t errors = compile_script("solve x^2 - 2", &script, memory);
+  run_script(&script, 1, PRECISION_SINGLE, memory);
+  destroy_script(&script);
+  fclose(memory);
+
+  // the roots come with their bounds, like in the shell
+  bool bounded = strstr(output, " +- ") != NULL;
+  free(output);
+
+  ASSERT_EQ(errors, 0);
+  ASSERT_BOOL(bounded);
+}
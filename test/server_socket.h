@@ -0,0 +1,272 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "test.h"
+#include "batch_solve.h"
+#include "server.h"
+
+/// How long a test waits for the server before it gives up, in milliseconds
+#define SERVER_TEST_TIMEOUT 5000
+
+/// A #serve run in a thread of its own
+typedef struct {
+  pthread_t    thread;
+  ServerConfig config;
+  char         path[108];
+  bool         ok;
+} ServerTest;
+
+void *server_test_thread (void *server);
+int   server_test_start  (ServerTest *server, unsigned int max_buffer);
+int   server_test_connect (const char *path);
+bool  server_test_stop   (ServerTest *server);
+char *server_test_answers (int fd, size_t count);
+bool  server_test_send   (int fd, const char *text);
+
+void *server_test_thread (void *server) {
+  ServerTest *test = (ServerTest *) server;
+  test->ok = serve(test->config);
+  return NULL;
+}
+
+/* start a server, with the precision set in server->config, and connect to it.
+   Returns the socket or -1 */
+int server_test_start (ServerTest *server, unsigned int max_buffer) {
+  static int servers = 0;
+  snprintf(server->path, sizeof(server->path), "/tmp/equation_solver_test_%d_%d.sock",
+           getpid(), servers++);
+
+  server->config = {
+    .path            = server->path,
+    .workers         = 2,
+    .max_connections = 8,
+    .max_buffer      = max_buffer,
+    .precision       = server->config.precision,
+  };
+
+  if (pthread_create(&server->thread, NULL, server_test_thread, server))
+    return -1;
+
+  return server_test_connect(server->path);
+}
+
+/* connect, waiting for the server to start listening */
+int server_test_connect (const char *path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  for (int attempt = 0; attempt < SERVER_TEST_TIMEOUT; attempt++) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (!connect(fd, (struct sockaddr *) &addr, sizeof(addr)))
+      return fd;
+
+    close(fd);
+    usleep(1000);
+  }
+
+  return -1;
+}
+
+/* stop the server, which has to have answered something, so that it waits for signals */
+bool server_test_stop (ServerTest *server) {
+  pthread_kill(server->thread, SIGTERM);
+  pthread_join(server->thread, NULL);
+  return server->ok && access(server->path, F_OK);
+}
+
+bool server_test_send (int fd, const char *text) {
+  size_t len = strlen(text);
+  return send(fd, text, len, MSG_NOSIGNAL) == (ssize_t) len;
+}
+
+/* read until count answers came, each ends with a "." line. NULL on a timeout */
+char *server_test_answers (int fd, size_t count) {
+  size_t len = 0, cap = 256, answers = 0;
+  char  *text = (char *) malloc(cap);
+
+  while (answers < count) {
+    struct pollfd waiting = { fd, POLLIN, 0 };
+    if (poll(&waiting, 1, SERVER_TEST_TIMEOUT) <= 0)
+      break;
+
+    if (len + 128 > cap)
+      text = (char *) realloc(text, cap *= 2);
+
+    ssize_t got = recv(fd, text + len, cap - len - 1, 0);
+    if (got <= 0)
+      break;
+
+    for (ssize_t i = 0; i < got; i++, len++) {
+      if (text[len] == '\n' && len >= 1 && text[len - 1] == '.' && (len == 1 || text[len - 2] == '\n'))
+        answers++;
+    }
+  }
+
+  text[len] = '\0';
+  if (answers < count) {
+    free(text);
+    return NULL;
+  }
+  return text;
+}
+
+TEST(server_round_trip) {
+  ServerTest server = {};
+  int fd = server_test_start(&server, 4096);
+  ASSERT_BOOL(fd >= 0);
+
+  ASSERT_BOOL(server_test_send(fd, "let A = 4\nsolve x^2 - A\n"));
+  char *answers = server_test_answers(fd, 2);
+
+  // every connection has variables of its own
+  int other = server_test_connect(server.path);
+  ASSERT_BOOL(server_test_send(other, "solve x - A\n"));
+  char *other_answers = server_test_answers(other, 1);
+
+  close(fd);
+  close(other);
+  bool stopped = server_test_stop(&server);
+
+  bool same       = answers && !strcmp(answers, ".\n-> x^2 + -4\n-> 2 solutions!\n  - -2\n  - 2\n.\n");
+  bool other_same = other_answers && !strcmp(other_answers, "error: An unknown variable was referenced!\n.\n");
+  free(answers);
+  free(other_answers);
+
+  ASSERT_BOOL(same);
+  ASSERT_BOOL(other_same);
+  ASSERT_BOOL(stopped);
+}
+
+TEST(server_keeps_precision) {
+  ServerTest server = {};
+  server.config.precision = PRECISION_SINGLE;
+  int fd = server_test_start(&server, 4096);
+  ASSERT_BOOL(fd >= 0);
+
+  // the roots come with their bounds, like in the shell
+  ASSERT_BOOL(server_test_send(fd, "solve x^2 - 4\n"));
+  char *answers = server_test_answers(fd, 1);
+
+  close(fd);
+  bool stopped = server_test_stop(&server);
+
+  bool bounded = answers && strstr(answers, "  - 2 +- ");
+  free(answers);
+
+  ASSERT_BOOL(bounded);
+  ASSERT_BOOL(stopped);
+}
+
+TEST(server_reports_errors) {
+  ServerTest server = {};
+  int fd = server_test_start(&server, 4096);
+  ASSERT_BOOL(fd >= 0);
+
+  // a bad statement is answered with an error, and the next one still runs
+  ASSERT_BOOL(server_test_send(fd, "solve (x\nrollback\nsolve x^5 + 1\nsolve x - 1\n"));
+  char *answers = server_test_answers(fd, 4);
+
+  close(fd);
+  bool stopped = server_test_stop(&server);
+
+  bool same = answers && !strcmp(answers,
+    "error: Could not parse command!\n.\n"
+    "error: There is no snapshot to roll back to!\n.\n"
+    "error: Encountered a polynomial of degree larger than 4, which is currently not supported\n.\n"
+    "-> x + -1\n-> 1 solutions!\n  - 1\n.\n");
+  free(answers);
+
+  ASSERT_BOOL(same);
+  ASSERT_BOOL(stopped);
+}
+
+TEST(server_limits_line_length) {
+  ServerTest server = {};
+  int fd = server_test_start(&server, 4096);
+  ASSERT_BOOL(fd >= 0);
+
+  // the line is answered once, as soon as the limit is hit, and the rest of it is dropped
+  char *line = (char *) malloc(3 * SERVER_MAX_LINE);
+  memset(line, 'x', 3 * SERVER_MAX_LINE - 2);
+  line[3 * SERVER_MAX_LINE - 2] = '\n';
+  line[3 * SERVER_MAX_LINE - 1] = '\0';
+
+  bool sent = server_test_send(fd, line) && server_test_send(fd, "solve x - 1\n");
+  free(line);
+  char *answers = server_test_answers(fd, 2);
+
+  close(fd);
+  bool stopped = server_test_stop(&server);
+
+  bool same = answers && !strcmp(answers, "error: Line is too long\n.\n-> x + -1\n-> 1 solutions!\n  - 1\n.\n");
+  free(answers);
+
+  ASSERT_BOOL(sent);
+  ASSERT_BOOL(same);
+  ASSERT_BOOL(stopped);
+}
+
+TEST(server_backpressure) {
+  ServerTest server = {};
+  int fd = server_test_start(&server, 256);
+  ASSERT_BOOL(fd >= 0);
+
+  const char  *line  = "x^4 + 2*x^3 + 3*x^2 + 4*x + 5\n";
+  const char  *reply = "-> x^4 + 2*x^3 + 3*x^2 + 4*x + 5\n.\n";
+  const size_t lines = 20000, line_len = strlen(line), reply_len = strlen(reply);
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  // a client that doesn't read is soon not read from either: the server
+  // stops taking lines while it can't send the answers, long before all of
+  // them were sent
+  size_t sent = 0;
+  bool   stalled = false;
+  for (int round = 0; round < SERVER_TEST_TIMEOUT / 100 && !stalled && sent < lines; round++) {
+    size_t before = sent;
+    while (sent < lines && send(fd, line, line_len, MSG_NOSIGNAL) == (ssize_t) line_len)
+      sent++;
+
+    stalled = round && sent == before;
+    usleep(100000);
+  }
+
+  // and once it reads, everything it sent is answered, in order
+  char  *buffer   = (char *) malloc(reply_len);
+  size_t received = 0, answered = 0;
+  bool   same     = true;
+  while (answered < lines) {
+    struct pollfd waiting = { fd, (short) (sent < lines ? POLLIN | POLLOUT : POLLIN), 0 };
+    if (poll(&waiting, 1, SERVER_TEST_TIMEOUT) <= 0)
+      break;
+
+    if ((waiting.revents & POLLOUT) && send(fd, line, line_len, MSG_NOSIGNAL) == (ssize_t) line_len)
+      sent++;
+
+    ssize_t got = recv(fd, buffer + received, reply_len - received, 0);
+    if (got > 0 && (received += (size_t) got) == reply_len) {
+      same = same && !memcmp(buffer, reply, reply_len);
+      received = 0;
+      answered++;
+    }
+  }
+
+  free(buffer);
+  close(fd);
+  bool stopped = server_test_stop(&server);
+
+  ASSERT_BOOL(stalled);
+  ASSERT_EQ(answered, lines);
+  ASSERT_BOOL(same);
+  ASSERT_BOOL(stopped);
+}
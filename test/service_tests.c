@@ -0,0 +1,4 @@
+#include "test.h"
+
+#include "server_socket.h"
+#include "shm_ring.h"
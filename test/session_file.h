@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "evaluate.h"
+#include "execute.h"
+#include "session.h"
+#include "symbols.h"
+
+/* a path to a session file that doesn't exist yet */
+void temp_session_path (char *path, size_t len);
+
+void temp_session_path (char *path, size_t len) {
+  static int sessions = 0;
+  snprintf(path, len, "/tmp/equation_solver_test_%d_%d.session", getpid(), sessions++);
+  unlink(path);
+}
+
+TEST(session_resumes_variables) {
+  char path[128];
+  temp_session_path(path, sizeof(path));
+
+  const char *lines[] = { "let A = 2", "let Long_B = A * x + 1", "snapshot", "let A = 3" };
+
+  Env env = {};
+  env.reactive = REACTIVE_LAZY;
+  Session session = {};
+  ASSERT_BOOL(session_open(&session, path, &env));
+  free(run_reactive(&env, lines, 4));
+  session_close(&session);
+  env_destroy(&env);
+
+  // picked up with the snapshot, and the expression that B is computed from
+  env = {};
+  env.reactive = REACTIVE_LAZY;
+  ASSERT_BOOL(session_open(&session, path, &env));
+  ASSERT_EQ(env.snapshot_count, 1);
+
+  const char *check[] = { "Long_B", "rollback", "Long_B" };
+  char *output = run_reactive(&env, check, 3);
+  session_close(&session);
+  env_destroy(&env);
+  unlink(path);
+
+  ASSERT_BOOL(!strcmp(output, "-> 3*x + 1\n-> rolled back to snapshot #1\n-> 2*x + 1\n"));
+  free(output);
+}
+
+TEST(session_detects_corruption) {
+  char path[128];
+  temp_session_path(path, sizeof(path));
+
+  const char *lines[] = { "let A = 1", "let B = 2" };
+
+  Env env = {};
+  Session session = {};
+  ASSERT_BOOL(session_open(&session, path, &env));
+  free(run_reactive(&env, lines, 2));
+
+  // the second record, and then the header
+  char *second = session.map + sizeof(SessionHeader) + ((SessionRecord *) (session.map + sizeof(SessionHeader)))->size;
+  second[sizeof(SessionRecord)] ^= 1;
+  session_close(&session);
+  env_destroy(&env);
+
+  env = {};
+  ASSERT_BOOL(session_open(&session, path, &env));
+
+  Value value = {};
+  ASSERT_EQ(env_get_value(&env, symbol_intern("A", 1), &value), EVAL_OK);
+  ASSERT_EQ(env_get_value(&env, symbol_intern("B", 1), &value), NO_VARIABLE);
+  ASSERT_EQ(((SessionHeader *) session.map)->records, 1);
+
+  ((SessionHeader *) session.map)->used++;
+  session_close(&session);
+  env_destroy(&env);
+
+  env = {};
+  ASSERT_BOOL(!session_open(&session, path, &env));
+  env_destroy(&env);
+  unlink(path);
+}
+
+TEST(session_compacts_overwritten_variables) {
+  char path[128];
+  temp_session_path(path, sizeof(path));
+
+  Env env = {};
+  env.reactive = REACTIVE_EAGER;
+  Session session = {};
+  ASSERT_BOOL(session_open(&session, path, &env));
+
+  const char *lines[] = { "let A = 0", "let B = A + 1", "let A = A + 1" };
+  free(run_reactive(&env, lines, 2));
+  for (int i = 0; i < 2 * SESSION_MIN_COMPACT; i++)
+    free(run_reactive(&env, lines + 2, 1));
+
+  session_close(&session);
+  env_destroy(&env);
+
+  env = {};
+  env.reactive = REACTIVE_EAGER;
+  ASSERT_BOOL(session_open(&session, path, &env));
+  ASSERT_EQ(((SessionHeader *) session.map)->records, 2);
+
+  const char *check[] = { "let A = 10", "B" };
+  char *output = run_reactive(&env, check, 2);
+  session_close(&session);
+  env_destroy(&env);
+  unlink(path);
+
+  ASSERT_BOOL(!strcmp(output, "-> 11\n"));
+  free(output);
+}
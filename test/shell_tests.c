@@ -0,0 +1,11 @@
+#include "test.h"
+
+#include "histogram.h"
+#include "perf_counters.h"
+#include "trace_file.h"
+#include "alloc_count.h"
+#include "batch_io.h"
+#include "pipeline_run.h"
+#include "log_stream.h"
+#include "prepared_stmt.h"
+#include "script_compile.h"
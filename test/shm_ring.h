@@ -0,0 +1,184 @@
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "test.h"
+#include "shm_client.h"
+#include "shm_server.h"
+
+/// How long a test waits for the server before it gives up, in milliseconds
+#define SHM_TEST_TIMEOUT 5000
+
+/// A #serve_shm run in a thread of its own
+typedef struct {
+  pthread_t thread;
+  char      name[64];
+  bool      ok;
+} ShmTest;
+
+void    *shm_test_thread (void *server);
+void     shm_test_name   (ShmTest *server);
+ShmRing *shm_test_start  (ShmTest *server);
+bool     shm_test_stop   (ShmTest *server, ShmRing *ring);
+bool     shm_test_solves (ShmRing *ring, double c0, double c1, double root0, double root1);
+int      shm_test_request (ShmRing *ring, const ShmRequest *request, ShmResponse *response);
+
+void *shm_test_thread (void *server) {
+  ShmTest *test = (ShmTest *) server;
+  test->ok = serve_shm(test->name);
+  return NULL;
+}
+
+void shm_test_name (ShmTest *server) {
+  static int servers = 0;
+  snprintf(server->name, sizeof(server->name), "/equation_solver_test_%d_%d", getpid(), servers++);
+}
+
+/* start a server under server->name and attach to it, NULL if it doesn't come up */
+ShmRing *shm_test_start (ShmTest *server) {
+  if (pthread_create(&server->thread, NULL, shm_test_thread, server))
+    return NULL;
+
+  for (int attempt = 0; attempt < SHM_TEST_TIMEOUT; attempt++) {
+    ShmRing *ring = shm_ring_attach(server->name);
+    if (ring && shm_ring_server_alive(ring))
+      return ring;
+
+    if (ring)
+      shm_ring_detach(ring);
+    usleep(1000);
+  }
+
+  return NULL;
+}
+
+/* stop the server, which has to remove its region on the way out */
+bool shm_test_stop (ShmTest *server, ShmRing *ring) {
+  serve_shm_stop();
+  pthread_join(server->thread, NULL);
+
+  bool told_clients = !shm_ring_server_alive(ring);
+  shm_ring_detach(ring);
+
+  int fd = shm_open(server->name, O_RDWR, 0);
+  if (fd >= 0)
+    close(fd);
+  return server->ok && told_clients && fd < 0;
+}
+
+/* the one call of shm_ring_solve, which is too big to inline everywhere */
+__attribute__((noinline))
+int shm_test_request (ShmRing *ring, const ShmRequest *request, ShmResponse *response) {
+  return shm_ring_solve(ring, request, response);
+}
+
+/* solve x^2 + c1*x + c0 and compare the roots in either order */
+bool shm_test_solves (ShmRing *ring, double c0, double c1, double root0, double root1) {
+  ShmRequest  request  = { { { c0, 0 }, { c1, 0 }, { 1, 0 } } };
+  ShmResponse response = {};
+
+  if (!shm_test_request(ring, &request, &response) || !response.status || response.count != 2)
+    return false;
+
+  double a = response.roots[0][0], b = response.roots[1][0];
+  if (fabs(response.roots[0][1]) + fabs(response.roots[1][1]) > 1e-9)
+    return false;
+  return (fabs(a - root0) < 1e-9 && fabs(b - root1) < 1e-9) ||
+         (fabs(a - root1) < 1e-9 && fabs(b - root0) < 1e-9);
+}
+
+TEST(shm_round_trip) {
+  ShmTest server = {};
+  shm_test_name(&server);
+  ShmRing *ring = shm_test_start(&server);
+  ASSERT_BOOL(ring);
+
+  // more requests than slots, so that every slot goes around at least once
+  bool solved = true;
+  for (int i = 0; i < 3 * SHM_RING_SLOTS; i++)
+    solved = solved && shm_test_solves(ring, (double) (-3 - i), (double) (-2 - i), -1, 3 + i);
+
+  ShmRequest  request  = { { { 0, 0 } } };
+  ShmResponse response = {};
+  bool zero = shm_test_request(ring, &request, &response) && response.count == SHM_INFINITE;
+
+  bool stopped = shm_test_stop(&server, ring);
+
+  ASSERT_BOOL(solved);
+  ASSERT_BOOL(zero);
+  ASSERT_BOOL(stopped);
+}
+
+TEST(shm_refuses_a_served_name) {
+  ShmTest server = {};
+  shm_test_name(&server);
+  ShmRing *ring = shm_test_start(&server);
+  ASSERT_BOOL(ring);
+
+  // a second server must leave the region of the first one alone
+  bool refused = !serve_shm(server.name);
+  bool solved  = shm_test_solves(ring, 2, -3, 1, 2);
+
+  bool stopped = shm_test_stop(&server, ring);
+
+  ASSERT_BOOL(refused);
+  ASSERT_BOOL(solved);
+  ASSERT_BOOL(stopped);
+}
+
+TEST(shm_notices_a_dead_server) {
+  ShmTest server = {};
+  shm_test_name(&server);
+
+  // a process that is gone for sure
+  pid_t dead = fork();
+  if (!dead)
+    _exit(0);
+  ASSERT_BOOL(dead > 0);
+  ASSERT_BOOL(waitpid(dead, NULL, 0) == dead);
+
+  // the region a server leaves behind when it crashes: still marked alive
+  int fd = shm_open(server.name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  ASSERT_BOOL(fd >= 0);
+  bool sized = !ftruncate(fd, sizeof(ShmRing));
+  void *region = mmap(NULL, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (!sized || region == MAP_FAILED)
+    shm_unlink(server.name);
+  ASSERT_BOOL(sized);
+  ASSERT_BOOL(region != MAP_FAILED);
+
+  ShmRing *crashed = (ShmRing *) region;
+  crashed->magic        = SHM_RING_MAGIC;
+  crashed->version      = SHM_RING_VERSION;
+  crashed->slot_count   = SHM_RING_SLOTS;
+  crashed->server_alive = 1;
+  crashed->server_pid   = dead;
+  for (uint64_t i = 0; i < SHM_RING_SLOTS; i++)
+    crashed->slots[i].seq = i;
+
+  // the client gives up instead of waiting for an answer forever
+  ShmRequest  request  = { { { 2, 0 }, { -3, 0 }, { 1, 0 } } };
+  ShmResponse response = {};
+  bool gave_up = !shm_test_request(crashed, &request, &response);
+  shm_ring_detach(crashed);
+
+  // and a new server takes the name over
+  ShmRing *ring = shm_test_start(&server);
+  if (!ring)
+    shm_unlink(server.name);
+  ASSERT_BOOL(gave_up);
+  ASSERT_BOOL(ring);
+
+  bool solved  = shm_test_solves(ring, 2, -3, 1, 2);
+  bool stopped = shm_test_stop(&server, ring);
+
+  ASSERT_BOOL(solved);
+  ASSERT_BOOL(stopped);
+}
@@ -0,0 +1,361 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "arith.h"
+#include "equation.h"
+#include "complex.h"
+#include "polynomial.h"
+
+// ------- FAST PATHS -------
+
+/// A solver under test. It's roots are compared against #solve_polynomial_iterative
+typedef struct {
+  const char *name;
+  /// Returns zero if it doesn't support the polynomial, the case is skipped and counted then
+  int  (*solve) (Polynomial p, Solutions *sols);
+  /// Highest degree the path handles
+  int  max_degree;
+  /// Whether the path only takes real coefficients
+  bool real_only;
+} SolverPath;
+
+int compute_solutions_path (Polynomial p, Solutions *sols);
+int compute_solutions_path (Polynomial p, Solutions *sols) {
+  Equation eq = { p.c.real, p.d.real, p.e.real };
+  compute_solutions(&eq);
+
+  switch (eq.tag) {
+    case NONE:
+      sols->count = 0;
+      break;
+    case SINGLE:
+      sols->count = 1;
+      break;
+    case DOUBLE:
+      sols->count = 2;
+      break;
+    case INFINITE:
+      sols->count = INFINITE_SOLUTIONS;
+      break;
+    case NOT_COMPUTED:
+    default:
+      return 0;
+  }
+
+  sols->x1 = eq.solutions[0];
+  sols->x2 = eq.solutions[1];
+  return 1;
+}
+
+const SolverPath COMPUTE_SOLUTIONS = { "compute_solutions", compute_solutions_path, 2,           true  };
+const SolverPath SOLVE_POLYNOMIAL  = { "solve_polynomial",  solve_polynomial,       3,            false };
+
+// ------- GENERATOR -------
+
+/// What kind of polynomials to generate
+typedef struct {
+  int    min_degree;
+  int    max_degree;
+  /// Root magnitudes are log-uniform in [min_magnitude; max_magnitude]
+  double min_magnitude;
+  double max_magnitude;
+  /// Largest multiplicity of a single root
+  int    max_multiplicity;
+  /// Smallest distance between distinct roots, relative to the larger one.
+  /// Smaller values give worse conditioned polynomials
+  double min_separation;
+  /// Whether roots don't have to come in conjugate pairs
+  bool   complex_coeffs;
+
+  /// Allowed distance between a computed root and a reference one, relative to max(1, |root|)
+  double root_tol;
+  /// Allowed backward error |p(x)| / sum |a_i| |x|^i of a computed root
+  double residual_tol;
+} PolyProfile;
+
+/// How many of the generated cases were compared, and how many the path didn't take
+typedef struct {
+  size_t compared;
+  size_t skipped;
+} DiffCounts;
+
+typedef struct {
+  const SolverPath  *path;
+  const PolyProfile *profile;
+  DiffCounts        *counts;
+} SolverDiff;
+
+complex_t random_root (FL_Rng *rng, const PolyProfile *profile, bool real);
+bool      well_separated (complex_t root, const complex_t *roots, int count, double separation);
+void      generate_poly_case (const void *context, FL_Rng *rng, void *test_case);
+
+complex_t random_root (FL_Rng *rng, const PolyProfile *profile, bool real) {
+  double magnitude = exp(fl_rng_uniform(rng, log(profile->min_magnitude),
+                                             log(profile->max_magnitude)));
+  if (real)
+    return { fl_rng_next(rng) % 2 ? magnitude : -magnitude };
+
+  double angle = fl_rng_uniform(rng, -M_PI, M_PI);
+  return { magnitude * cos(angle), magnitude * sin(angle) };
+}
+
+bool well_separated (complex_t root, const complex_t *roots, int count, double separation) {
+  for (int i = 0; i < count; i++) {
+    double scale = fmax(cmplx_mag(root), cmplx_mag(roots[i]));
+    if (cmplx_mag(cmplx_sub(root, roots[i])) < separation * scale)
+      return false;
+  }
+  return true;
+}
+
+/* lead * (x - r_1)^m_1 * ... with the roots and multiplicities picked by the profile */
+void generate_poly_case (const void *context, FL_Rng *rng, void *test_case) {
+  const SolverDiff  *diff    = (const SolverDiff *) context;
+  const PolyProfile *profile = diff->profile;
+  bool real = diff->path->real_only || !profile->complex_coeffs;
+
+  int max_degree = profile->max_degree < diff->path->max_degree ?
+                   profile->max_degree : diff->path->max_degree;
+  int degree = profile->min_degree + (int) fl_rng_below(rng, (size_t) (max_degree - profile->min_degree + 1));
+
+  complex_t distinct[POLY_MAX_DEG] = {};
+  int distinct_count = 0;
+
+  double lead_magnitude = exp(fl_rng_uniform(rng, log(0.5), log(2.0)));
+  Polynomial poly = { 'x', {.e = { fl_rng_next(rng) % 2 ? lead_magnitude : -lead_magnitude }} };
+  if (!real)
+    poly.e = cmplx_mul(poly.e, random_root(rng, profile, false));
+
+  for (int count = 0; count < degree; ) {
+    int left = degree - count;
+    int multiplicity = 1 + (int) fl_rng_below(rng, (size_t) (profile->max_multiplicity < left ?
+                                                             profile->max_multiplicity : left));
+    // a real polynomial gets either a real root or a conjugate pair
+    bool pair = real && 2 * multiplicity <= left && fl_rng_next(rng) % 2;
+
+    complex_t root = {};
+    for (int attempt = 0; attempt < 100; attempt++) {
+      root = random_root(rng, profile, real && !pair);
+      if (well_separated(root, distinct, distinct_count, profile->min_separation) &&
+          (!pair || fabs(root.imag) >= profile->min_separation * cmplx_mag(root)))
+        break;
+    }
+
+    distinct[distinct_count++] = root;
+    for (int i = 0; i < multiplicity; i++) {
+      polynomial_mul(poly, { 'x', {.e = cmplx_negate(root), .d = {1}} }, &poly);
+      if (pair)
+        polynomial_mul(poly, { 'x', {.e = { -root.real, root.imag }, .d = {1}} }, &poly);
+    }
+
+    count += pair ? 2 * multiplicity : multiplicity;
+  }
+
+  // a product of conjugate pairs is real up to rounding
+  if (real) {
+    for (int i = 0; i < POLY_COEFF_LEN; i++)
+      poly.coeffs[i].imag = 0;
+  }
+
+  *(Polynomial *) test_case = poly;
+}
+
+// ------- CHECKS -------
+
+int    format_poly   (char *buf, size_t len, Polynomial p);
+double backward_error (Polynomial p, complex_t x);
+double distance_to_nearest (complex_t x, const Solutions *sols);
+int    check_poly_case (const void *context, const void *test_case, char *msg);
+
+int format_poly (char *buf, size_t len, Polynomial p) {
+  int written = 0;
+  for (int i = polynomial_deg(p); i >= 0; i--) {
+    written += snprintf(buf + written, len - (size_t) written, "%s(%.17lg%+.17lgi)x^%d",
+                        written ? " + " : "", p.coeffs[i].real, p.coeffs[i].imag, i);
+    if ((size_t) written >= len)
+      break;
+  }
+  return written;
+}
+
+double backward_error (Polynomial p, complex_t x) {
+  double scale = 0;
+  for (int i = 0; i < POLY_COEFF_LEN; i++)
+    scale += cmplx_mag(p.coeffs[i]) * pow(cmplx_mag(x), i);
+
+  return scale > 0 ? cmplx_mag(polynomial_eval(p, x)) / scale : 0;
+}
+
+double distance_to_nearest (complex_t x, const Solutions *sols) {
+  double best = INFINITY;
+  for (int i = 0; i < sols->count; i++) {
+    double tolerance_scale = fmax(1, cmplx_mag(sols->x[i]));
+    best = fmin(best, cmplx_mag(cmplx_sub(x, sols->x[i])) / tolerance_scale);
+  }
+  return best;
+}
+
+int check_poly_case (const void *context, const void *test_case, char *msg) {
+  const SolverDiff  *diff    = (const SolverDiff *) context;
+  const PolyProfile *profile = diff->profile;
+  const Polynomial   poly    = *(const Polynomial *) test_case;
+
+  // the cases the path doesn't take are counted, so that a test can't pass
+  // by skipping most of them
+  Solutions fast = {}, reference = {};
+  if (!diff->path->solve(poly, &fast)) {
+    diff->counts->skipped++;
+    return 1;
+  }
+  diff->counts->compared++;
+
+  // the iteration doesn't always converge on multiple roots, and then only
+  // the backward error is checked
+  bool has_reference = solve_polynomial_iterative(poly, &reference);
+
+  char poly_str[512] = {};
+  format_poly(poly_str, sizeof(poly_str), poly);
+
+  int degree = polynomial_deg(poly);
+  if (fast.count < 0 || fast.count > degree) {
+    snprintf(msg, FL_MAX_MSG, "%s returned %d roots for %s",
+             diff->path->name, fast.count, poly_str);
+    return 0;
+  }
+
+  for (int i = 0; i < fast.count; i++) {
+    complex_t x = fast.x[i];
+
+    double residual = backward_error(poly, x);
+    if (!(residual <= profile->residual_tol)) {
+      snprintf(msg, FL_MAX_MSG, "%s: root %.17lg%+.17lgi has backward error %lg in %s",
+               diff->path->name, x.real, x.imag, residual, poly_str);
+      return 0;
+    }
+
+    double distance = has_reference ? distance_to_nearest(x, &reference) : 0;
+    if (!(distance <= profile->root_tol)) {
+      snprintf(msg, FL_MAX_MSG, "%s: root %.17lg%+.17lgi is %lg away from reference roots of %s",
+               diff->path->name, x.real, x.imag, distance, poly_str);
+      return 0;
+    }
+  }
+
+  // every reference root has to be found, multiple roots may be reported once
+  for (int i = 0; has_reference && i < reference.count; i++) {
+    complex_t x = reference.x[i];
+    double distance = distance_to_nearest(x, &fast);
+    if (!(distance <= profile->root_tol)) {
+      snprintf(msg, FL_MAX_MSG, "%s missed root %.17lg%+.17lgi of %s",
+               diff->path->name, x.real, x.imag, poly_str);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// ------- SHRINKING -------
+
+/// Simplifications tried on every coefficient, from the most aggressive one
+typedef enum {
+  SHRINK_ZERO,
+  SHRINK_INTEGER,
+  SHRINK_ONE_DIGIT,
+  SHRINK_THREE_DIGITS,
+  SHRINK_REAL,
+  SHRINK_OP_COUNT,
+} ShrinkOp;
+
+double round_to    (double x, double step);
+int    shrink_poly_case (const void *context, const void *test_case, size_t attempt, void *candidate);
+
+double round_to (double x, double step) {
+  return round(x / step) * step;
+}
+
+/* the attempt'th coefficient simplification that actually changes something */
+int shrink_poly_case (const void *context, const void *test_case, size_t attempt, void *candidate) {
+  (void) context;
+  const Polynomial poly   = *(const Polynomial *) test_case;
+  const int        degree = polynomial_deg(poly);
+
+  size_t found = 0;
+  for (int op = 0; op < SHRINK_OP_COUNT; op++) {
+    for (int i = 0; i <= degree; i++) {
+      Polynomial shrunk = poly;
+      complex_t *coeff  = &shrunk.coeffs[i];
+
+      switch ((ShrinkOp) op) {
+        case SHRINK_ZERO:
+          *coeff = {};
+          break;
+        case SHRINK_INTEGER:
+          *coeff = { round_to(coeff->real, 1), round_to(coeff->imag, 1) };
+          break;
+        case SHRINK_ONE_DIGIT:
+          *coeff = { round_to(coeff->real, 0.1), round_to(coeff->imag, 0.1) };
+          break;
+        case SHRINK_THREE_DIGITS:
+          *coeff = { round_to(coeff->real, 0.001), round_to(coeff->imag, 0.001) };
+          break;
+        case SHRINK_REAL:
+          coeff->imag = 0;
+          break;
+        case SHRINK_OP_COUNT:
+        default:
+          break;
+      }
+
+      // keep the degree, and don't offer candidates that change nothing
+      if (polynomial_deg(shrunk) != degree || !memcmp(&shrunk, &poly, sizeof(Polynomial)))
+        continue;
+
+      if (found++ == attempt) {
+        *(Polynomial *) candidate = shrunk;
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// ------- TESTS -------
+
+#define SOLVER_DIFF_TEST(test_name, solver_path, poly_profile, iterations, max_skipped) \
+  TEST(test_name) {                                                         \
+    DiffCounts        counts = {};                                          \
+    const SolverDiff  diff = { &solver_path, &poly_profile, &counts };      \
+    const FL_Property prop = {                                              \
+      .case_size = sizeof(Polynomial),                                      \
+      .context   = &diff,                                                   \
+      .generate  = generate_poly_case,                                      \
+      .check     = check_poly_case,                                         \
+      .shrink    = shrink_poly_case,                                        \
+    };                                                                      \
+    ASSERT_PROPERTY(prop, iterations);                                      \
+    ASSERT_BOOL_MSG((double) counts.skipped <=                              \
+                    max_skipped * (double) (counts.compared + counts.skipped), \
+                    "%s skipped %zu of %zu cases", diff.path->name,         \
+                    counts.skipped, counts.compared + counts.skipped);      \
+  }
+
+//                                   deg    magnitude     mult  sep   complex  root_tol  residual_tol
+const PolyProfile SIMPLE_ROOTS   = { 1, 4,  0.1,  10,     1,    0.1,  false,   1e-6,     1e-9 };
+const PolyProfile COMPLEX_ROOTS  = { 1, 4,  0.1,  10,     1,    0.1,  true,    1e-6,     1e-9 };
+const PolyProfile DOUBLE_ROOTS   = { 2, 4,  0.1,  10,     2,    0.1,  false,   1e-5,     1e-9 };
+const PolyProfile TRIPLE_ROOTS   = { 3, 4,  0.1,  10,     3,    0.1,  false,   1e-3,     1e-9 };
+const PolyProfile WIDE_MAGNITUDE = { 1, 4,  1e-2, 1e2,    1,    0.1,  false,   1e-6,     1e-9 };
+
+// general cubics have no closed form in solve_polynomial, so it skips some of
+// them, and the last column is the share of the cases that may be skipped
+SOLVER_DIFF_TEST(diff_compute_solutions_simple,     COMPUTE_SOLUTIONS, SIMPLE_ROOTS,   2000, 0)
+SOLVER_DIFF_TEST(diff_compute_solutions_double,     COMPUTE_SOLUTIONS, DOUBLE_ROOTS,   2000, 0)
+SOLVER_DIFF_TEST(diff_compute_solutions_magnitude,  COMPUTE_SOLUTIONS, WIDE_MAGNITUDE, 2000, 0)
+SOLVER_DIFF_TEST(diff_solve_polynomial_simple,      SOLVE_POLYNOMIAL,  SIMPLE_ROOTS,   2000, 0.4)
+SOLVER_DIFF_TEST(diff_solve_polynomial_complex,     SOLVE_POLYNOMIAL,  COMPLEX_ROOTS,  2000, 0.4)
+SOLVER_DIFF_TEST(diff_solve_polynomial_double,      SOLVE_POLYNOMIAL,  DOUBLE_ROOTS,   2000, 0.25)
+SOLVER_DIFF_TEST(diff_solve_polynomial_triple,      SOLVE_POLYNOMIAL,  TRIPLE_ROOTS,   2000, 0.3)
+SOLVER_DIFF_TEST(diff_solve_polynomial_magnitude,   SOLVE_POLYNOMIAL,  WIDE_MAGNITUDE, 2000, 0.4)
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "alloc.h"
+#include "evaluate.h"
+#include "execute.h"
+#include "parser.h"
+#include "symbols.h"
+
+TEST(symbols_are_interned) {
+  int first  = symbol_intern("Interned", 8);
+  int second = symbol_intern("Interned_Too", 12);
+
+  ASSERT_BOOL(first != second);
+  ASSERT_EQ(symbol_intern("Interned_Too_long", 8), first);
+  ASSERT_BOOL(!strcmp(symbol_name(second), "Interned_Too"));
+
+  // enough of them to grow the table a few times
+  char name[SYMBOL_MAX_LEN];
+  for (int i = 0; i < 5000; i++) {
+    int len = snprintf(name, sizeof(name), "Many%d", i);
+    int symbol = symbol_intern(name, (size_t) len);
+    ASSERT_BOOL(!strcmp(symbol_name(symbol), name));
+  }
+
+  ASSERT_EQ(symbol_intern("Interned", 8), first);
+}
+
+TEST(long_identifiers) {
+  const char *lines[] = { "let Long_Name2 = 3", "let B = Long_Name2 * 2", "B + Long_Name2" };
+
+  char  *output     = NULL;
+  size_t output_len = 0;
+  FILE  *out        = open_memstream(&output, &output_len);
+
+  Env env = {};
+  for (size_t i = 0; i < 3; i++)
+    execute_command(&env, lines[i], out);
+  fclose(out);
+  env_destroy(&env);
+
+  ASSERT_BOOL(!strcmp(output, "-> 9\n"));
+  free(output);
+
+  // too long to be interned
+  char source[SYMBOL_MAX_LEN + 16] = "let ";
+  memset(source + 4, 'A', SYMBOL_MAX_LEN);
+  Expr *expr = (Expr *) counted_calloc(1, sizeof(Expr));
+  ASSERT_EQ(parse_expr(source + 4, expr), 0);
+  counted_free(expr);
+}
+
+TEST(env_grows_for_symbols) {
+  Env env = {};
+
+  char name[SYMBOL_MAX_LEN];
+  for (int i = 0; i < 3000; i++) {
+    int len = snprintf(name, sizeof(name), "Var%d", i);
+    env_set_value(&env, symbol_intern(name, (size_t) len), { TP_NUMBER, { .num = { (double) i } } });
+  }
+
+  Value value = {};
+  ASSERT_EQ(env_get_value(&env, symbol_intern("Var2999", 7), &value), EVAL_OK);
+  ASSERT_BOOL(cmplx_eq(value.num, {2999}));
+  ASSERT_EQ(env_get_value(&env, symbol_intern("Var3000", 7), &value), NO_VARIABLE);
+
+  env_destroy(&env);
+}
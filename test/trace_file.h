@@ -0,0 +1,69 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "trace.h"
+
+/// Every character that JSON strings can't hold as is
+#define TRACE_TEST_ARG "say \"hi\" to C:\\dir\n\t\x01"
+
+void *trace_worker_spans (void *unused);
+char *read_whole_file    (const char *path);
+
+void *trace_worker_spans (void *unused) {
+  (void) unused;
+  TRACE_BEGIN(worker);
+  TRACE_END_ARG(worker, "worker_span", "arg", TRACE_TEST_ARG);
+  return NULL;
+}
+
+char *read_whole_file (const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return NULL;
+
+  fseek(file, 0, SEEK_END);
+  size_t len  = (size_t) ftell(file);
+  char  *text = (char *) calloc(len + 1, 1);
+  fseek(file, 0, SEEK_SET);
+  len = fread(text, 1, len, file);
+  fclose(file);
+  return text;
+}
+
+TEST(trace_escapes_and_flushes_every_thread) {
+  char path[128];
+  snprintf(path, sizeof(path), "/tmp/equation_solver_test_%d.trace.json", getpid());
+  ASSERT_BOOL(trace_enable(path));
+
+  TRACE_BEGIN(main);
+  pthread_t thread = {};
+  pthread_create(&thread, NULL, trace_worker_spans, NULL);
+  pthread_join(thread, NULL);
+  TRACE_END(main, "main_span");
+
+  trace_flush();
+  ASSERT_BOOL(!trace_enabled);
+
+  char *json = read_whole_file(path);
+  unlink(path);
+  ASSERT_BOOL(json);
+
+  // both buffers are written, each with a track name, and the file is closed off
+  bool main_span   = strstr(json, "{\"name\": \"main_span\", \"ph\": \"X\"");
+  bool worker_span = strstr(json, "{\"name\": \"worker_span\", \"ph\": \"X\"");
+  bool tracks      = strstr(json, "\"args\": {\"name\": \"main\"}") &&
+                     strstr(json, "\"args\": {\"name\": \"worker\"}");
+  bool escaped     = strstr(json, "\"args\": {\"arg\": \"say \\\"hi\\\" to C:\\\\dir\\u000a\\u0009\\u0001\"}");
+  bool closed      = strstr(json, "\n  ]\n}\n");
+  free(json);
+
+  ASSERT_BOOL(main_span);
+  ASSERT_BOOL(worker_span);
+  ASSERT_BOOL(tracks);
+  ASSERT_BOOL(escaped);
+  ASSERT_BOOL(closed);
+}
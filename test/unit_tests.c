@@ -1,10 +1,12 @@
 #include "test.h"
+#include "test_ext.h"
 
 #include "equation_solve.h"
 #include "test_args.h"
+#include "solver_diff.h"
+#include "real_solver.h"
 
 int main() {
+  fl_use_program_hooks();
   fl_run_tests();
 }
-
-